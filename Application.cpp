@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <future>
 #include <stdio.h>
 #include <limits>
@@ -11,6 +12,7 @@
 #include "DataProvider.hpp"
 #include "Debug.hpp"
 #include "Dither.hpp"
+#include "EffortBudget.hpp"
 #include "Error.hpp"
 #include "System.hpp"
 #include "TaskDispatch.hpp"
@@ -50,13 +52,111 @@ void Usage()
     fprintf( stderr, "  -a          disable alpha channel processing\n" );
     fprintf( stderr, "  -s          display image quality measurements\n" );
     fprintf( stderr, "  -b          benchmark mode\n" );
+    fprintf( stderr, "  -bt         benchmark thread scaling (1 to N threads)\n" );
     fprintf( stderr, "  -m          generate mipmaps\n" );
     fprintf( stderr, "  -d          enable dithering\n" );
+    fprintf( stderr, "  -q level    ETC1 encoding effort (0 - fast; 1 - normal, default; 2 - exhaustive)\n" );
+    fprintf( stderr, "                note: ETC2 textures always use the full ETC2 encoder\n" );
+    fprintf( stderr, "  -budget ms  pick the effort level of each part to encode within the given time\n" );
+    fprintf( stderr, "                note: the fast level of ETC2 textures leaves out the planar, T and H modes\n" );
+    fprintf( stderr, "  -cache      encode repeated blocks once\n" );
+    fprintf( stderr, "                note: ignored by plain ETC1 and EAC textures, which encode faster than they look blocks up\n" );
     fprintf( stderr, "  -debug      dissect ETC texture\n" );
     fprintf( stderr, "  -etc2       enable ETC2 mode\n" );
+    fprintf( stderr, "  -rgba       enable ETC2 RGBA8 mode, alpha stored in EAC blocks (implies -etc2)\n" );
+    fprintf( stderr, "  -rgba1      enable ETC2 RGB8A1 mode, alpha below 128 is transparent (implies -etc2)\n" );
+    fprintf( stderr, "  -r11 c      output EAC R11 texture of channel c (r, g, b or a)\n" );
+    fprintf( stderr, "  -rg11 cc    output EAC RG11 texture of channels cc (e.g. rg)\n" );
     fprintf( stderr, "  -pkm        output to PKM(.pkm) format\n" );
     fprintf( stderr, "  -atlas      make pixel+alpha atlas(etc1)\n" );
     fprintf( stderr, "  -dds        export DDS texture\n" );
+    fprintf( stderr, "                note: BC1, or BC3 with -rgba, BC4 with -r11 and BC5 with -rg11\n" );
+    fprintf( stderr, "  -ddshq      export DDS texture encoded with squish (slower, higher quality; implies -dds)\n" );
+    fprintf( stderr, "  -ddsetc r   export DDS texture transcoded from the ETC blocks (implies -dds)\n" );
+    fprintf( stderr, "                r: 0 - keep the ETC colors (fastest); 1 - refit to the source pixels\n" );
+    fprintf( stderr, "                note: with -v, the blocks of the loaded file are transcoded to out.dds\n" );
+    fprintf( stderr, "                note: -rgba1 textures are not transcoded, their BC1 blocks are encoded from the pixels\n" );
+    fprintf( stderr, "  -bc7        export DDS texture encoded as BC7 (slower, higher quality; implies -dds)\n" );
+    fprintf( stderr, "                note: BC4 and BC5 are kept with -r11 and -rg11, -v writes BC1 or BC3\n" );
+    fprintf( stderr, "                note: blocks are opaque unless -rgba or -rgba1 is given\n" );
+    fprintf( stderr, "  -astc f     output ASTC texture of f x f pixel blocks (4 or 6), to a .astc file or to a .ktx file with -m\n" );
+    fprintf( stderr, "                note: -q 0 tries a single weight grid per block, ETC and DDS options are ignored\n" );
+}
+
+// Bit offset of a channel in the loaded pixels, or -1
+static int ChannelOffset( char c )
+{
+    switch( c )
+    {
+    case 'r':
+        return 16;
+    case 'g':
+        return 8;
+    case 'b':
+        return 0;
+    case 'a':
+        return 24;
+    default:
+        return -1;
+    }
+}
+
+// Channels encoded into textures of the given type
+static Channels ColorChannels( BlockData::Type type )
+{
+    switch( type )
+    {
+    case BlockData::Etc2_RGBA:
+        return Channels::RGBA;
+    case BlockData::Etc2_RGBA1:
+        return Channels::RGBA1;
+    default:
+        return Channels::RGB;
+    }
+}
+
+// Encodes a part at the given effort level, or at the one picked by the budget
+static void ProcessPart( BlockData& bd, const DataPart& part, Channels channels, bool dither, Effort effort, EffortBudget* budget )
+{
+    const uint32 blocks = part.width / 4 * part.lines;
+    if( budget )
+    {
+        effort = budget->Pick( blocks );
+        const auto start = GetTime();
+        bd.Process( part.src, blocks, part.offset, part.width, channels, dither, part.tiled, effort );
+        budget->Done( effort, blocks, GetTime() - start );
+    }
+    else
+    {
+        bd.Process( part.src, blocks, part.offset, part.width, channels, dither, part.tiled, effort );
+    }
+}
+
+static float Benchmark( const std::shared_ptr<Bitmap>& bmp, int tasks, bool dither, BlockData::Type type, const int* channels, Effort effort )
+{
+    const auto start = GetTime();
+    for( int i=0; i<tasks; i++ )
+    {
+        TaskDispatch::Queue( [&bmp, dither, type, channels, effort]()
+        {
+            auto bd = std::make_shared<BlockData>( bmp->Size(), false, type );
+            if( type == BlockData::Eac_R11 || type == BlockData::Eac_RG11 )
+            {
+                bd->ProcessEac( bmp->Data(), bmp->Size().x * bmp->Size().y / 16, 0, bmp->Size().x, channels[0], channels[1], bmp->Tiled() );
+            }
+            else if( type == BlockData::Astc_4x4 || type == BlockData::Astc_6x6 )
+            {
+                bd->ProcessAstc( bmp->Data(), bmp->Size().y / 4, 0, bmp->Size().x, true, bmp->Tiled(), effort );
+            }
+            else
+            {
+                bd->Process( bmp->Data(), bmp->Size().x * bmp->Size().y / 16, 0, bmp->Size().x, ColorChannels( type ), dither, bmp->Tiled(), effort );
+            }
+        } );
+    }
+    TaskDispatch::Sync();
+    const auto end = GetTime();
+    return ( end - start ) / ( tasks * 1000.f );
 }
 
 int main( int argc, char** argv )
@@ -68,13 +168,23 @@ int main( int argc, char** argv )
     bool alpha = true;
     bool stats = false;
     bool benchmark = false;
+    bool scaling = false;
     bool mipmap = false;
     bool dither = false;
+    Effort effort = Effort::Normal;
+    float budgetTime = 0;
+    bool cache = false;
     bool debug = false;
     bool etc2 = false;
+    bool rgba = false;
+    bool rgba1 = false;
+    int eac = 0;
+    int eacChannel[2] = {};
+    int astc = 0;
 	bool etc_pkm = false;
 	bool atlas = false;
 	bool dds = false;
+	DdsMode ddsMode = DdsMode::Native;
 	const char *target_dir = "output";
 
     if( argc < 2 )
@@ -114,6 +224,10 @@ int main( int argc, char** argv )
         {
             benchmark = true;
         }
+        else if( CSTR( "-bt" ) )
+        {
+            scaling = true;
+        }
         else if( CSTR( "-m" ) )
         {
             mipmap = true;
@@ -122,6 +236,29 @@ int main( int argc, char** argv )
         {
             dither = true;
         }
+        else if( CSTR( "-q" ) )
+        {
+            i++;
+            if( i == argc || argv[i][0] < '0' || argv[i][0] > '2' || argv[i][1] != '\0' )
+            {
+                Usage();
+                return 1;
+            }
+            effort = (Effort)( argv[i][0] - '0' );
+        }
+        else if( CSTR( "-budget" ) )
+        {
+            i++;
+            if( i == argc || ( budgetTime = atof( argv[i] ) ) <= 0 )
+            {
+                Usage();
+                return 1;
+            }
+        }
+        else if( CSTR( "-cache" ) )
+        {
+            cache = true;
+        }
         else if( CSTR( "-debug" ) )
         {
             debug = true;
@@ -133,6 +270,35 @@ int main( int argc, char** argv )
         else if( CSTR( "-etc2" ) )
         {
             etc2 = true;
+        }
+        else if( CSTR( "-rgba" ) )
+        {
+            rgba = true;
+            etc2 = true;
+        }
+        else if( CSTR( "-rgba1" ) )
+        {
+            rgba1 = true;
+            etc2 = true;
+        }
+        else if( CSTR( "-r11" ) || CSTR( "-rg11" ) )
+        {
+            eac = CSTR( "-r11" ) ? 1 : 2;
+            i++;
+            if( i == argc || strlen( argv[i] ) != size_t( eac ) )
+            {
+                Usage();
+                return 1;
+            }
+            for( int j=0; j<eac; j++ )
+            {
+                eacChannel[j] = ChannelOffset( argv[i][j] );
+                if( eacChannel[j] < 0 )
+                {
+                    Usage();
+                    return 1;
+                }
+            }
         }
 		else if( CSTR( "-atlas" ) )
 		{
@@ -142,6 +308,37 @@ int main( int argc, char** argv )
 		{
 			dds = true;
 		}
+		else if( CSTR( "-ddshq" ) )
+		{
+			dds = true;
+			ddsMode = DdsMode::Squish;
+		}
+		else if( CSTR( "-ddsetc" ) )
+		{
+			i++;
+			if( i == argc || ( argv[i][0] != '0' && argv[i][0] != '1' ) || argv[i][1] != '\0' )
+			{
+				Usage();
+				return 1;
+			}
+			dds = true;
+			ddsMode = argv[i][0] == '1' ? DdsMode::TranscodeRefine : DdsMode::Transcode;
+		}
+		else if( CSTR( "-bc7" ) )
+		{
+			dds = true;
+			ddsMode = DdsMode::Bc7;
+		}
+        else if( CSTR( "-astc" ) )
+        {
+            i++;
+            if( i == argc || ( strcmp( argv[i], "4" ) != 0 && strcmp( argv[i], "6" ) != 0 ) )
+            {
+                Usage();
+                return 1;
+            }
+            astc = atoi( argv[i] );
+        }
         else
         {
             Usage();
@@ -150,40 +347,97 @@ int main( int argc, char** argv )
     }
 #undef CSTR
 
+    // RGBA textures hold their alpha, so it is never written to a separate texture or an atlas. EAC textures hold
+    // only the selected channels.
+    if( rgba || rgba1 || eac != 0 || astc != 0 )
+    {
+        atlas = false;
+    }
+    if( eac != 0 )
+    {
+        alpha = false;
+    }
+    // ASTC data is written to its own containers, without the ETC cache and budget
+    if( astc != 0 )
+    {
+        etc_pkm = false;
+        dds = false;
+        cache = false;
+        budgetTime = 0;
+    }
+    // Plain ETC1 blocks are encoded faster than they are looked up in the cache, and EAC blocks are never cached
+    if( ( !etc2 && !dds ) || eac != 0 )
+    {
+        cache = false;
+    }
+    // At the fast level ETC2 textures leave out the planar, T and H modes. Only the budget picks it for them, -q 0
+    // keeps the full ETC2 encoder.
+    if( etc2 && astc == 0 && effort == Effort::Fast )
+    {
+        effort = Effort::Normal;
+    }
+    BlockData::Type type = rgba ? BlockData::Etc2_RGBA : ( etc2 ? BlockData::Etc2_RGB : BlockData::Etc1 );
+    if( rgba1 )
+    {
+        type = BlockData::Etc2_RGBA1;
+    }
+    if( eac != 0 )
+    {
+        type = eac == 1 ? BlockData::Eac_R11 : BlockData::Eac_RG11;
+    }
+    if( astc != 0 )
+    {
+        type = astc == 4 ? BlockData::Astc_4x4 : BlockData::Astc_6x6;
+    }
+
     if( dither )
     {
         InitDither();
     }
 
+    if( scaling )
+    {
+        auto bmp = std::make_shared<Bitmap>( argv[1], std::numeric_limits<uint>::max(), true );
+        auto data = bmp->Data();
+
+        const int cores = System::CPUCores();
+        const int NumTasks = cores * 10;
+        float single = 0;
+        for( int threads=1;; threads = std::min( threads * 2, cores ) )
+        {
+            TaskDispatch taskDispatch( threads );
+            // Warm up the workers before measuring.
+            Benchmark( bmp, threads, dither, type, eacChannel, effort );
+            const float time = Benchmark( bmp, NumTasks, dither, type, eacChannel, effort );
+            if( threads == 1 ) single = time;
+            printf( "%3i threads: %0.3f ms per image, %0.1f MP/s, speedup %0.2fx\n", threads, time, bmp->Size().x * bmp->Size().y / ( time * 1000.f ), single / time );
+            if( threads == cores ) break;
+        }
+        return 0;
+    }
+
     TaskDispatch taskDispatch( System::CPUCores() );
 
     if( benchmark )
     {
         auto start = GetTime();
-        auto bmp = std::make_shared<Bitmap>( argv[1], std::numeric_limits<uint>::max() );
+        auto bmp = std::make_shared<Bitmap>( argv[1], std::numeric_limits<uint>::max(), true );
         auto data = bmp->Data();
         auto end = GetTime();
         printf( "Image load time: %0.3f ms\n", ( end - start ) / 1000.f );
 
         const int NumTasks = System::CPUCores() * 10;
-        start = GetTime();
-        for( int i=0; i<NumTasks; i++ )
-        {
-            TaskDispatch::Queue( [&bmp, &dither, i, etc2]()
-            {
-                auto bd = std::make_shared<BlockData>( bmp->Size(), false );
-                bd->Process( bmp->Data(), bmp->Size().x * bmp->Size().y / 16, 0, bmp->Size().x, Channels::RGB, dither, etc2 );
-            } );
-        }
-        TaskDispatch::Sync();
-        end = GetTime();
-        printf( "Mean compression time for %i runs: %0.3f ms\n", NumTasks, ( end - start ) / ( NumTasks * 1000.f ) );
+        printf( "Mean compression time for %i runs: %0.3f ms\n", NumTasks, Benchmark( bmp, NumTasks, dither, type, eacChannel, effort ) );
     }
     else if( viewMode )
     {
         auto bd = std::make_shared<BlockData>( argv[1] );
         auto out = bd->Decode();
         out->Write( "out.png" );
+        if( dds )
+        {
+            bd->TranscodeDds( "out", *out, ddsMode != DdsMode::Transcode );
+        }
     }
     else if( debug )
     {
@@ -192,7 +446,7 @@ int main( int argc, char** argv )
     }
     else
     {
-        DataProvider dp( argv[1], mipmap );
+        DataProvider dp( argv[1], mipmap, astc );
         auto num = dp.NumberOfParts();
 
 		CreateDirectoryA(target_dir, NULL);
@@ -200,26 +454,68 @@ int main( int argc, char** argv )
 		std::string fn = argv[1];
 		fn = std::string(target_dir) + "/" + fn.substr(0, fn.rfind("."));
 
-        auto bd = std::make_shared<BlockData>( fn.c_str(), dp.Size(), mipmap, atlas, etc_pkm, dds );
+        auto bd = std::make_shared<BlockData>( fn.c_str(), dp.Size(), mipmap, atlas, etc_pkm, dds, ddsMode, type );
         BlockDataPtr bda;
-        if( alpha && dp.Alpha() && !atlas )
+        if( alpha && dp.Alpha() && !atlas && !rgba && !rgba1 && astc == 0 )
+        {
+            bda = std::make_shared<BlockData>( (fn + "_alpha").c_str(), dp.Size(), mipmap, atlas, etc_pkm, dds, ddsMode, type );
+        }
+        if( cache )
+        {
+            bd->EnableCache();
+            if( bda )
+            {
+                bda->EnableCache();
+            }
+        }
+
+        // Alpha parts are encoded at the given level, their time only shows in the time left for the color parts
+        std::unique_ptr<EffortBudget> budget;
+        if( budgetTime > 0 && eac == 0 )
+        {
+            const uint32 blocks = dp.NumberOfBlocks();
+            budget.reset( new EffortBudget( uint64( budgetTime * 1000 ), blocks, System::CPUCores(), etc2 ? Effort::Normal : Effort::Best ) );
+        }
+        EffortBudget* pb = budget.get();
+
+        if( eac != 0 )
         {
-            bda = std::make_shared<BlockData>( (fn + "_alpha").c_str(), dp.Size(), mipmap, atlas, etc_pkm, dds );
+            for( uint i=0; i<num; i++ )
+            {
+                auto part = dp.NextPart();
+
+                TaskDispatch::Queue( [part, i, &bd, &eacChannel]()
+                {
+                    bd->ProcessEac( part.src, part.width / 4 * part.lines, part.offset, part.width, eacChannel[0], eacChannel[1], part.tiled );
+                } );
+            }
         }
+        else if( astc != 0 )
+        {
+            const bool astcAlpha = alpha && dp.Alpha();
+            for( uint i=0; i<num; i++ )
+            {
+                auto part = dp.NextPart();
 
-        if( bda )
+                TaskDispatch::Queue( [part, &bd, astcAlpha, effort]()
+                {
+                    bd->ProcessAstc( part.src, part.lines, part.offset, part.width, astcAlpha, part.tiled, effort );
+                } );
+            }
+        }
+        else if( bda )
         {
             for( int i=0; i<num; i++ )
             {
                 auto part = dp.NextPart();
 
-                TaskDispatch::Queue( [part, i, &bd, &dither, etc2]()
+                TaskDispatch::Queue( [part, i, &bd, &dither, effort, pb]()
                 {
-                    bd->Process( part.src, part.width / 4 * part.lines, part.offset, part.width, Channels::RGB, dither, etc2 );
+                    ProcessPart( *bd, part, Channels::RGB, dither, effort, pb );
                 } );
-                TaskDispatch::Queue( [part, i, &bda, etc2]()
+                TaskDispatch::Queue( [part, i, &bda, effort]()
                 {
-                    bda->Process( part.src, part.width / 4 * part.lines, part.offset, part.width, Channels::Alpha, false, etc2 );
+                    ProcessPart( *bda, part, Channels::Alpha, false, effort, nullptr );
                 } );
             }
         }
@@ -229,14 +525,14 @@ int main( int argc, char** argv )
             {
                 auto part = dp.NextPart();
 
-                TaskDispatch::Queue( [part, i, &bd, &dither, etc2]()
+                TaskDispatch::Queue( [part, i, &bd, &dither, type, effort, pb]()
                 {
-                    bd->Process( part.src, part.width / 4 * part.lines, part.offset, part.width, Channels::RGB, dither, etc2 );
+                    ProcessPart( *bd, part, ColorChannels( type ), dither, effort, pb );
                 } );
 				if(atlas) {
-					TaskDispatch::Queue( [part, i, &bd, etc2]()
+					TaskDispatch::Queue( [part, i, &bd, effort]()
 					{
-						bd->Process( part.src, part.width / 4 * part.lines, part.offset, part.width, Channels::Alpha, false, etc2 );
+						ProcessPart( *bd, part, Channels::Alpha, false, effort, nullptr );
 					} );
 				}
             }
@@ -244,13 +540,50 @@ int main( int argc, char** argv )
 
         TaskDispatch::Sync();
 
-        if( stats )
+        if( budget )
+        {
+            printf( "Encoded in %0.3f ms, budget %0.3f ms\n", budget->Elapsed() / 1000.f, budgetTime );
+            printf( "  Fast blocks: %u\n", budget->Blocks( Effort::Fast ) );
+            printf( "  Normal blocks: %u\n", budget->Blocks( Effort::Normal ) );
+            if( !etc2 )
+            {
+                printf( "  Exhaustive blocks: %u\n", budget->Blocks( Effort::Best ) );
+            }
+        }
+
+        if( bd->RoundedAlphaBlocks() != 0 )
+        {
+            fprintf( stderr, "Warning: %u blocks have alpha other than 0 and 255, rounded to opaque or transparent\n", bd->RoundedAlphaBlocks() );
+        }
+
+        if( stats && eac != 0 )
+        {
+            // Decoded EAC channels are stored in red and green
+            auto out = bd->Decode();
+            for( int i=0; i<eac; i++ )
+            {
+                float mse = CalcMSEChannel( dp.ImageData(), eacChannel[i], *out, i * 8 );
+                printf( "%s data\n", i == 0 ? "R" : "G" );
+                printf( "  RMSE: %f\n", sqrt( mse ) );
+                printf( "  PSNR: %f\n", 20 * log10( 255 ) - 10 * log10( mse ) );
+            }
+        }
+        else if( stats )
         {
             auto out = bd->Decode();
-            float mse = CalcMSE3( dp.ImageData(), *out );
+            float mse = rgba1 ? CalcMSE3Opaque( dp.ImageData(), *out ) : CalcMSE3( dp.ImageData(), *out );
             printf( "RGB data\n" );
             printf( "  RMSE: %f\n", sqrt( mse ) );
             printf( "  PSNR: %f\n", 20 * log10( 255 ) - 10 * log10( mse ) );
+            if( bd->GrayBlocks() != 0 )
+            {
+                printf( "  Gray blocks encoded from a single channel: %u\n", bd->GrayBlocks() );
+            }
+            if( cache )
+            {
+                const uint32 blocks = dp.NumberOfBlocks() * ( atlas ? 2 : 1 );
+                printf( "  Blocks reused from the cache: %u of %u (%0.1f%%)\n", bd->CachedBlocks(), blocks, 100.f * bd->CachedBlocks() / blocks );
+            }
             if( bda )
             {
                 auto out = bda->Decode();
@@ -258,6 +591,18 @@ int main( int argc, char** argv )
                 printf( "A data\n" );
                 printf( "  RMSE: %f\n", sqrt( mse ) );
                 printf( "  PSNR: %f\n", 20 * log10( 255 ) - 10 * log10( mse ) );
+                if( cache )
+                {
+                    const uint32 blocks = dp.NumberOfBlocks();
+                    printf( "  Blocks reused from the cache: %u of %u (%0.1f%%)\n", bda->CachedBlocks(), blocks, 100.f * bda->CachedBlocks() / blocks );
+                }
+            }
+            else if( ( rgba || rgba1 || ( astc != 0 && alpha ) ) && dp.Alpha() )
+            {
+                float mse = CalcMSEA( dp.ImageData(), *out );
+                printf( "A data\n" );
+                printf( "  RMSE: %f\n", sqrt( mse ) );
+                printf( "  PSNR: %f\n", 20 * log10( 255 ) - 10 * log10( mse ) );
             }
         }
 
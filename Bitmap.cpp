@@ -7,13 +7,33 @@
 #include "lz4/lz4.h"
 
 #include "Bitmap.hpp"
+#include "BitmapDownsampled.hpp"
 #include "Debug.hpp"
+#include "TaskDispatch.hpp"
 
-Bitmap::Bitmap( const char* fn, uint lines )
+// Converts four pixel rows to a row of 4x4 blocks
+static void TileBlockRow( const uint32* src, uint32* dst, int width )
+{
+    for( int i=0; i<width/4; i++ )
+    {
+        for( int x=0; x<4; x++ )
+        {
+            *dst++ = src[0];
+            *dst++ = src[width];
+            *dst++ = src[width*2];
+            *dst++ = src[width*3];
+            src++;
+        }
+    }
+}
+
+Bitmap::Bitmap( const char* fn, uint lines, bool tiled )
     : m_block( nullptr )
     , m_lines( lines )
     , m_alpha( true )
-    , m_sema( 0 )
+    , m_tiled( tiled )
+    , m_ready( 0 )
+    , m_child( nullptr )
 {
     FILE* f = fopen( fn, "rb" );
     assert( f );
@@ -30,6 +50,7 @@ Bitmap::Bitmap( const char* fn, uint lines )
         m_size.x = d;
         fread( &d, 1, 4, f );
         m_size.y = d;
+        m_stride = m_size.x;
         DBGPRINT( "Raw bitmap " << fn << "  " << m_size.x << "x" << m_size.y );
 
         assert( m_size.x % 4 == 0 );
@@ -42,15 +63,25 @@ Bitmap::Bitmap( const char* fn, uint lines )
         fclose( f );
 
         m_block = m_data = new uint32[m_size.x*m_size.y];
-        m_linesLeft = m_size.y / 4;
-
-        LZ4_decompress_fast( cbuf, (char*)m_data, m_size.x*m_size.y*4 );
-        delete[] cbuf;
+        m_blockRows = m_linesLeft = m_size.y / 4;
 
-        for( int i=0; i<m_size.y/4; i++ )
+        if( m_tiled )
+        {
+            uint32* tmp = new uint32[m_size.x*m_size.y];
+            LZ4_decompress_fast( cbuf, (char*)tmp, m_size.x*m_size.y*4 );
+            for( int i=0; i<m_size.y/4; i++ )
+            {
+                TileBlockRow( tmp + i * m_size.x * 4, m_data + i * m_size.x * 4, m_size.x );
+            }
+            delete[] tmp;
+        }
+        else
         {
-            m_sema.unlock();
+            LZ4_decompress_fast( cbuf, (char*)m_data, m_size.x*m_size.y*4 );
         }
+        delete[] cbuf;
+
+        SetReady( m_blockRows );
     }
     else
     {
@@ -118,40 +149,47 @@ Bitmap::Bitmap( const char* fn, uint lines )
 		if(h % 4 != 0)
 			h = h + (4 - h % 4);
         m_size = v2i( w, h );
+        m_stride = w;
 
         //assert( w % 4 == 0 );
         //assert( h % 4 == 0 );
 
         m_block = m_data = new uint32[w*h];
 		memset(m_block, 0, w * h * sizeof(uint32));
-        m_linesLeft = h / 4;
+        m_blockRows = m_linesLeft = h / 4;
 
         m_load = std::async( std::launch::async, [this, f, png_ptr, info_ptr]() mutable
         {
             auto ptr = m_data;
-            uint lines = 0;
+            uint32* rows = nullptr;
+            if( m_tiled )
+            {
+                // Rows of one block are decoded to a temporary buffer, then stored as blocks
+                rows = new uint32[m_size.x * 4];
+                memset( rows, 0, m_size.x * 4 * sizeof( uint32 ) );
+            }
             for( int i=0; i<m_size.y / 4; i++ )
             {
+                auto row = m_tiled ? rows : ptr;
                 for( int j=0; j<4; j++ )
                 {
-					if(i * 4 + j >= m_orgsize.y)
+					if(i * 4 + j >= m_orgsize.y) {
+						if(m_tiled)
+							memset(row, 0, ( 4 - j ) * m_size.x * sizeof(uint32));
 						break;
-                    png_read_rows( png_ptr, (png_bytepp)&ptr, NULL, 1 );
-                    ptr += m_size.x;
+					}
+                    png_read_rows( png_ptr, (png_bytepp)&row, NULL, 1 );
+                    row += m_size.x;
                 }
-                lines++;
-                if( lines >= m_lines )
+                if( m_tiled )
                 {
-                    lines = 0;
-                    m_sema.unlock();
+                    TileBlockRow( rows, ptr, m_size.x );
                 }
+                ptr += m_size.x * 4;
+                SetReady( i + 1 );
             }
 
-            if( lines != 0 )
-            {
-                m_sema.unlock();
-            }
-
+            delete[] rows;
             png_read_end( png_ptr, info_ptr );
             png_destroy_read_struct( &png_ptr, &info_ptr, NULL );
             fclose( f );
@@ -164,15 +202,21 @@ Bitmap::Bitmap( const v2i& size )
     , m_block( nullptr )
     , m_lines( 1 )
     , m_linesLeft( size.y / 4 )
+    , m_blockRows( size.y / 4 )
     , m_size( size )
-    , m_sema( 0 )
+    , m_stride( size.x )
+    , m_tiled( false )
+    , m_ready( size.y / 4 )
+    , m_child( nullptr )
 {
 }
 
 Bitmap::Bitmap( const Bitmap& src, uint lines )
     : m_lines( lines )
     , m_alpha( src.Alpha() )
-    , m_sema( 0 )
+    , m_tiled( src.Tiled() )
+    , m_ready( 0 )
+    , m_child( nullptr )
 {
 }
 
@@ -195,11 +239,27 @@ void Bitmap::Write( const char* fn )
 
     png_write_info( png_ptr, info_ptr );
 
-    uint32* ptr = m_data;
-    for( int i=0; i<m_size.y; i++ )
+    if( m_tiled )
+    {
+        uint32* row = new uint32[m_size.x];
+        for( int i=0; i<m_size.y; i++ )
+        {
+            for( int j=0; j<m_size.x; j++ )
+            {
+                row[j] = m_data[Offset( j, i )];
+            }
+            png_write_rows( png_ptr, (png_bytepp)(&row), 1 );
+        }
+        delete[] row;
+    }
+    else
     {
-        png_write_rows( png_ptr, (png_bytepp)(&ptr), 1 );
-        ptr += m_size.x;
+        uint32* ptr = m_data;
+        for( int i=0; i<m_size.y; i++ )
+        {
+            png_write_rows( png_ptr, (png_bytepp)(&ptr), 1 );
+            ptr += m_stride;
+        }
     }
 
     png_write_end( png_ptr, info_ptr );
@@ -213,9 +273,36 @@ const uint32* Bitmap::NextBlock( uint& lines, bool& done )
     std::lock_guard<std::mutex> lock( m_lock );
     lines = std::min( m_lines, m_linesLeft );
     auto ret = m_block;
-    m_sema.lock();
-    m_block += m_size.x * 4 * lines;
+    WaitRows( m_blockRows - m_linesLeft + lines );
+    if( m_tiled )
+    {
+        m_block += m_stride / 4 * 16 * lines;
+    }
+    else
+    {
+        m_block += m_stride * 4 * lines;
+    }
     m_linesLeft -= lines;
     done = m_linesLeft == 0;
     return ret;
 }
+
+void Bitmap::WaitRows( uint rows ) const
+{
+    if( m_ready >= rows ) return;
+    TaskDispatch::WaitFor( [this, rows]{ return m_ready >= rows; } );
+}
+
+void Bitmap::SetReady( uint rows )
+{
+    {
+        std::lock_guard<std::mutex> lock( m_readyLock );
+        if( rows <= m_ready ) return;
+        m_ready = rows;
+        if( m_child )
+        {
+            m_child->ParentReady( rows );
+        }
+    }
+    TaskDispatch::Wake();
+}
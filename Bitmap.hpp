@@ -1,48 +1,80 @@
 #ifndef __DARKRL__BITMAP_HPP__
 #define __DARKRL__BITMAP_HPP__
 
+#include <atomic>
 #include <future>
 #include <memory>
 #include <mutex>
 
-#include "Semaphore.hpp"
 #include "Types.hpp"
 #include "Vector.hpp"
 
 enum class Channels
 {
     RGB,
-    Alpha
+    Alpha,
+    RGBA,
+    RGBA1
 };
 
+class BitmapDownsampled;
+
 class Bitmap
 {
 public:
-    Bitmap( const char* fn, uint lines );
+    Bitmap( const char* fn, uint lines, bool tiled );
     Bitmap( const v2i& size );
     virtual ~Bitmap();
 
     void Write( const char* fn );
 
-    uint32* Data() { if( m_load.valid() ) m_load.wait(); return m_data; }
-    const uint32* Data() const { if( m_load.valid() ) m_load.wait(); return m_data; }
+    uint32* Data() { if( m_load.valid() ) m_load.wait(); WaitRows( m_blockRows ); return m_data; }
+    const uint32* Data() const { if( m_load.valid() ) m_load.wait(); WaitRows( m_blockRows ); return m_data; }
     const v2i& Size() const { return m_size; }
+    // Pixels in a row of Data(). Rows are padded to whole blocks, see BitmapDownsampled.
+    int Stride() const { return m_stride; }
     bool Alpha() const { return m_alpha; }
+    bool Tiled() const { return m_tiled; }
+
+    // Position of a pixel in Data(). Tiled bitmaps store 4x4 blocks one after another, each in the column-major order
+    // used by the block encoders, so that a row of blocks occupies the same memory range as in a linear bitmap.
+    size_t Offset( int x, int y ) const
+    {
+        if( m_tiled )
+        {
+            return ( ( y / 4 ) * ( m_stride / 4 ) + x / 4 ) * 16 + ( x % 4 ) * 4 + ( y % 4 );
+        }
+        return y * m_stride + x;
+    }
 
     const uint32* NextBlock( uint& lines, bool& done );
 
+    // Waits until the first rows of blocks are available, helping the task dispatcher in the meantime.
+    void WaitRows( uint rows ) const;
+
 protected:
+    friend class BitmapDownsampled;
+
     Bitmap( const Bitmap& src, uint lines );
 
+    // Publishes the first rows of blocks as available. Rows become available in order.
+    void SetReady( uint rows );
+
     uint32* m_data;
     uint32* m_block;
     uint m_lines;
     uint m_linesLeft;
+    uint m_blockRows;
     v2i m_size, m_orgsize;
+    int m_stride;
     bool m_alpha;
-    Semaphore m_sema;
+    bool m_tiled;
     std::mutex m_lock;
     std::future<void> m_load;
+
+    std::atomic<uint> m_ready;
+    std::mutex m_readyLock;
+    BitmapDownsampled* m_child;
 };
 
 typedef std::shared_ptr<Bitmap> BitmapPtr;
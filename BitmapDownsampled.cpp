@@ -1,86 +1,256 @@
+#include <algorithm>
 #include <string.h>
 #include <utility>
 
 #include "BitmapDownsampled.hpp"
+#include "BitmapDownsampled_AVX2.hpp"
+#include "CpuArch.hpp"
 #include "Debug.hpp"
 
-BitmapDownsampled::BitmapDownsampled( const Bitmap& bmp, uint lines )
+#ifdef __SSE4_1__
+#  ifdef _MSC_VER
+#    include <intrin.h>
+#  else
+#    include <x86intrin.h>
+#  endif
+#endif
+
+// Rows of blocks filtered by one task
+enum { BandRows = 4 };
+
+static inline uint32 Average( uint32 c0, uint32 c1, uint32 c2, uint32 c3 )
+{
+    int r = ( ( c0 & 0x000000FF ) + ( c1 & 0x000000FF ) + ( c2 & 0x000000FF ) + ( c3 & 0x000000FF ) ) / 4;
+    int g = ( ( ( c0 & 0x0000FF00 ) + ( c1 & 0x0000FF00 ) + ( c2 & 0x0000FF00 ) + ( c3 & 0x0000FF00 ) ) / 4 ) & 0x0000FF00;
+    int b = ( ( ( c0 & 0x00FF0000 ) + ( c1 & 0x00FF0000 ) + ( c2 & 0x00FF0000 ) + ( c3 & 0x00FF0000 ) ) / 4 ) & 0x00FF0000;
+    int a = ( ( ( ( ( c0 & 0xFF000000 ) >> 8 ) + ( ( c1 & 0xFF000000 ) >> 8 ) + ( ( c2 & 0xFF000000 ) >> 8 ) + ( ( c3 & 0xFF000000 ) >> 8 ) ) / 4 ) & 0x00FF0000 ) << 8;
+    return r | g | b | a;
+}
+
+#ifdef __SSE4_1__
+// Averages pixels 0-1 of a and b, and pixels 2-3 of a and b. Results are left as 16-bit channels, rounded down like
+// Average().
+static inline __m128i Filter2x2( __m128i a, __m128i b )
+{
+    const __m128i z = _mm_setzero_si128();
+    __m128i lo = _mm_add_epi16( _mm_unpacklo_epi8( a, z ), _mm_unpacklo_epi8( b, z ) );
+    __m128i hi = _mm_add_epi16( _mm_unpackhi_epi8( a, z ), _mm_unpackhi_epi8( b, z ) );
+    __m128i sum = _mm_add_epi16( _mm_unpacklo_epi64( lo, hi ), _mm_unpackhi_epi64( lo, hi ) );
+    return _mm_srli_epi16( sum, 2 );
+}
+
+// Filters a 4x4 source block to 2x2 pixels: pixel pairs of source columns 0-1, then of columns 2-3.
+static inline __m128i FilterBlock( const uint32* b )
+{
+    __m128i c0 = _mm_loadu_si128( (const __m128i*)b );
+    __m128i c1 = _mm_loadu_si128( (const __m128i*)( b + 4 ) );
+    __m128i c2 = _mm_loadu_si128( (const __m128i*)( b + 8 ) );
+    __m128i c3 = _mm_loadu_si128( (const __m128i*)( b + 12 ) );
+
+    return _mm_packus_epi16( Filter2x2( c0, c1 ), Filter2x2( c2, c3 ) );
+}
+
+static void DownsampleTiled_SSE( const uint32* src, size_t stride, uint32* dst, int blocks )
+{
+    for( int i=0; i<blocks; i++ )
+    {
+        __m128i tl = FilterBlock( src );
+        __m128i tr = FilterBlock( src + 16 );
+        __m128i bl = FilterBlock( src + stride );
+        __m128i br = FilterBlock( src + stride + 16 );
+
+        _mm_storeu_si128( (__m128i*)dst, _mm_unpacklo_epi64( tl, bl ) );
+        _mm_storeu_si128( (__m128i*)( dst + 4 ), _mm_unpackhi_epi64( tl, bl ) );
+        _mm_storeu_si128( (__m128i*)( dst + 8 ), _mm_unpacklo_epi64( tr, br ) );
+        _mm_storeu_si128( (__m128i*)( dst + 12 ), _mm_unpackhi_epi64( tr, br ) );
+
+        src += 32;
+        dst += 16;
+    }
+}
+
+// Filters width / 4 * 4 pixels, the remainder is left to the caller.
+static void DownsampleLinear_SSE( const uint32* src1, const uint32* src2, uint32* dst, int width )
+{
+    for( int i=0; i+4<=width; i+=4 )
+    {
+        __m128i a0 = _mm_loadu_si128( (const __m128i*)src1 );
+        __m128i a1 = _mm_loadu_si128( (const __m128i*)( src1 + 4 ) );
+        __m128i b0 = _mm_loadu_si128( (const __m128i*)src2 );
+        __m128i b1 = _mm_loadu_si128( (const __m128i*)( src2 + 4 ) );
+
+        _mm_storeu_si128( (__m128i*)dst, _mm_packus_epi16( Filter2x2( a0, b0 ), Filter2x2( a1, b1 ) ) );
+
+        src1 += 8;
+        src2 += 8;
+        dst += 4;
+    }
+}
+#endif
+
+BitmapDownsampled::BitmapDownsampled( Bitmap& bmp, uint lines, bool pad )
     : Bitmap( bmp, lines )
+    , m_parent( bmp )
+    , m_bands( 0 )
+    , m_queued( 0 )
+    , m_done( 0 )
+    , m_pad( pad )
 {
     m_size.x = std::max( 1, bmp.Size().x / 2 );
     m_size.y = std::max( 1, bmp.Size().y / 2 );
 
-    int w = std::max( m_size.x, 4 );
-    int h = std::max( m_size.y, 4 );
+    int w = pad ? ( m_size.x + 3 ) & ~3 : std::max( m_size.x, 4 );
+    int h = pad ? ( m_size.y + 3 ) & ~3 : std::max( m_size.y, 4 );
 
     DBGPRINT( "Subbitmap " << m_size.x << "x" << m_size.y );
 
     m_block = m_data = new uint32[w*h];
+    m_blockRows = m_linesLeft = h / 4;
+    m_stride = w;
 
-    if( m_size.x < w || m_size.y < h )
+    if( !pad && ( m_size.x < w || m_size.y < h ) )
     {
         memset( m_data, 0, w*h*sizeof( uint32 ) );
-        m_linesLeft = h / 4;
-        uint lines = 0;
-        for( int i=0; i<h/4; i++ )
+        SetReady( m_blockRows );
+    }
+    else
+    {
+        m_bands = ( m_blockRows + BandRows - 1 ) / BandRows;
+        m_filtered.resize( m_bands, false );
+
+        std::lock_guard<std::mutex> lock( bmp.m_readyLock );
+        bmp.m_child = this;
+        ParentReady( bmp.m_ready );
+    }
+}
+
+BitmapDownsampled::~BitmapDownsampled()
+{
+    {
+        std::lock_guard<std::mutex> lock( m_parent.m_readyLock );
+        m_parent.m_child = nullptr;
+    }
+    TaskDispatch::Wait( m_group );
+}
+
+// Called with the parent's ready lock held.
+void BitmapDownsampled::ParentReady( uint rows )
+{
+    std::lock_guard<std::mutex> lock( m_bandLock );
+    while( m_queued < m_bands )
+    {
+        const uint end = std::min<uint>( ( m_queued + 1 ) * BandRows, m_blockRows );
+        if( std::min( end * 2, m_parent.m_blockRows ) > rows ) break;
+        const uint band = m_queued++;
+        TaskDispatch::Queue( [this, band]{ Filter( band ); }, m_group );
+    }
+}
+
+void BitmapDownsampled::Filter( uint band )
+{
+    const uint end = std::min<uint>( ( band + 1 ) * BandRows, m_blockRows );
+    for( uint i=band*BandRows; i<end; i++ )
+    {
+        if( m_pad )
+        {
+            FilterRowPadded( i );
+        }
+        else
+        {
+            FilterRow( i );
+        }
+    }
+
+    std::unique_lock<std::mutex> lock( m_bandLock );
+    m_filtered[band] = true;
+    uint done = m_done;
+    while( done < m_bands && m_filtered[done] ) done++;
+    if( done == m_done ) return;
+    m_done = done;
+    lock.unlock();
+
+    SetReady( std::min<uint>( done * BandRows, m_blockRows ) );
+}
+
+void BitmapDownsampled::FilterRow( int i )
+{
+    const int w = m_size.x;
+    const uint32* src = m_parent.m_data;
+    if( m_tiled )
+    {
+        // Each 4x4 block is filtered from 2x2 source blocks
+        const int stride = m_parent.Size().x / 4 * 16;
+        auto ptr = m_data + i * ( w / 4 ) * 16;
+        auto row = src + i * 2 * stride;
+#ifdef __SSE4_1__
+        if( can_use_intel_core_4th_gen_features() )
         {
-            for( int j=0; j<4; j++ )
+            DownsampleTiled_AVX2( row, stride, ptr, w / 4 );
+        }
+        else
+        {
+            DownsampleTiled_SSE( row, stride, ptr, w / 4 );
+        }
+#else
+        for( int j=0; j<w/4; j++ )
+        {
+            for( int x=0; x<4; x++ )
             {
-                lines++;
-                if( lines > m_lines )
+                for( int y=0; y<4; y++ )
                 {
-                    lines = 0;
-                    m_sema.unlock();
+                    auto src = row + j * 32 + ( x / 2 ) * 16 + ( y / 2 ) * stride + ( x % 2 ) * 8 + ( y % 2 ) * 2;
+                    *ptr++ = Average( src[0], src[4], src[1], src[5] );
                 }
             }
         }
-        if( lines != 0 )
-        {
-            m_sema.unlock();
-        }
+#endif
     }
     else
     {
-        m_linesLeft = h / 4;
-        m_load = std::async( std::launch::async, [this, &bmp, w, h]() mutable
+        auto ptr = m_data + i * 4 * w;
+        for( int j=0; j<4; j++ )
         {
-            auto ptr = m_data;
-            auto src1 = bmp.Data();
-            auto src2 = src1 + bmp.Size().x;
-            uint lines = 0;
-            for( int i=0; i<h/4; i++ )
+            auto src1 = src + ( i * 4 + j ) * 4 * w;
+            auto src2 = src1 + m_parent.Size().x;
+            int k = 0;
+#ifdef __SSE4_1__
+            if( can_use_intel_core_4th_gen_features() )
             {
-                for( int j=0; j<4; j++ )
-                {
-                    for( int k=0; k<m_size.x; k++ )
-                    {
-                        int r = ( ( *src1 & 0x000000FF ) + ( *(src1+1) & 0x000000FF ) + ( *src2 & 0x000000FF ) + ( *(src2+1) & 0x000000FF ) ) / 4;
-                        int g = ( ( ( *src1 & 0x0000FF00 ) + ( *(src1+1) & 0x0000FF00 ) + ( *src2 & 0x0000FF00 ) + ( *(src2+1) & 0x0000FF00 ) ) / 4 ) & 0x0000FF00;
-                        int b = ( ( ( *src1 & 0x00FF0000 ) + ( *(src1+1) & 0x00FF0000 ) + ( *src2 & 0x00FF0000 ) + ( *(src2+1) & 0x00FF0000 ) ) / 4 ) & 0x00FF0000;
-                        int a = ( ( ( ( ( *src1 & 0xFF000000 ) >> 8 ) + ( ( *(src1+1) & 0xFF000000 ) >> 8 ) + ( ( *src2 & 0xFF000000 ) >> 8 ) + ( ( *(src2+1) & 0xFF000000 ) >> 8 ) ) / 4 ) & 0x00FF0000 ) << 8;
-                        *ptr++ = r | g | b | a;
-                        src1 += 2;
-                        src2 += 2;
-                    }
-                    src1 += m_size.x * 2;
-                    src2 += m_size.x * 2;
-                }
-                lines++;
-                if( lines >= m_lines )
-                {
-                    lines = 0;
-                    m_sema.unlock();
-                }
+                k = w & ~7;
+                DownsampleLinear_AVX2( src1, src2, ptr, k );
             }
-
-            if( lines != 0 )
+            else
+            {
+                k = w & ~3;
+                DownsampleLinear_SSE( src1, src2, ptr, k );
+            }
+            ptr += k;
+            src1 += k * 2;
+            src2 += k * 2;
+#endif
+            for( ; k<w; k++ )
             {
-                m_sema.unlock();
+                *ptr++ = Average( *src1, *(src1+1), *src2, *(src2+1) );
+                src1 += 2;
+                src2 += 2;
             }
-        } );
+        }
     }
 }
 
-BitmapDownsampled::~BitmapDownsampled()
+// Pixels past the edges of the level repeat the last row and column. The parent is either the top level, whose size is
+// whole blocks, or padded the same way, so the 2x2 source pixels are always within its data.
+void BitmapDownsampled::FilterRowPadded( int i )
 {
+    const uint32* src = m_parent.m_data;
+    for( int y=i*4; y<i*4+4; y++ )
+    {
+        const int sy = std::min( y, m_size.y - 1 ) * 2;
+        for( int x=0; x<m_stride; x++ )
+        {
+            const int sx = std::min( x, m_size.x - 1 ) * 2;
+            m_data[Offset( x, y )] = Average( src[m_parent.Offset( sx, sy )], src[m_parent.Offset( sx + 1, sy )],
+                src[m_parent.Offset( sx, sy + 1 )], src[m_parent.Offset( sx + 1, sy + 1 )] );
+        }
+    }
 }
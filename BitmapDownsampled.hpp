@@ -1,14 +1,40 @@
 #ifndef __DARKRL__BITMAPDOWNSAMPLED_HPP__
 #define __DARKRL__BITMAPDOWNSAMPLED_HPP__
 
+#include <mutex>
+#include <vector>
+
 #include "Bitmap.hpp"
+#include "TaskDispatch.hpp"
 #include "Types.hpp"
 
+// Mip level filtered from its parent bitmap. Rows of blocks are filtered in bands on the task dispatcher, each band
+// queued as soon as the parent rows it reads are available, so a whole mip chain is generated while the top level is
+// still loading.
 class BitmapDownsampled : public Bitmap
 {
 public:
-    BitmapDownsampled( const Bitmap& bmp, uint lines );
+    // Without padding, the level is cut to whole 4x4 blocks, and levels smaller than a block are left black. With
+    // padding, the level is filtered whole and extended to whole blocks by repeating its last row and column.
+    BitmapDownsampled( Bitmap& bmp, uint lines, bool pad );
     ~BitmapDownsampled();
+
+private:
+    friend class Bitmap;
+
+    void ParentReady( uint rows );
+    void Filter( uint band );
+    void FilterRow( int row );
+    void FilterRowPadded( int row );
+
+    Bitmap& m_parent;
+    uint m_bands;
+    uint m_queued;
+    uint m_done;
+    bool m_pad;
+    std::vector<bool> m_filtered;
+    std::mutex m_bandLock;
+    TaskGroup m_group;
 };
 
 #endif
@@ -0,0 +1,128 @@
+#ifdef __SSE4_1__
+
+#include "BitmapDownsampled_AVX2.hpp"
+#ifdef _MSC_VER
+#  include <intrin.h>
+#  define VS_VECTORCALL _vectorcall
+#else
+#  include <x86intrin.h>
+#  pragma GCC push_options
+#  pragma GCC target ("avx2")
+#  define VS_VECTORCALL
+#endif
+
+namespace
+{
+
+// Averages pixels 0-1 of a and b, and pixels 2-3 of a and b, in each 128-bit lane. Results are left as 16-bit
+// channels, rounded down like the scalar filter.
+static inline __m256i VS_VECTORCALL Filter2x2_AVX2( __m256i a, __m256i b )
+{
+    const __m256i z = _mm256_setzero_si256();
+    __m256i lo = _mm256_add_epi16( _mm256_unpacklo_epi8( a, z ), _mm256_unpacklo_epi8( b, z ) );
+    __m256i hi = _mm256_add_epi16( _mm256_unpackhi_epi8( a, z ), _mm256_unpackhi_epi8( b, z ) );
+    __m256i sum = _mm256_add_epi16( _mm256_unpacklo_epi64( lo, hi ), _mm256_unpackhi_epi64( lo, hi ) );
+    return _mm256_srli_epi16( sum, 2 );
+}
+
+static inline __m128i VS_VECTORCALL Filter2x2_SSE( __m128i a, __m128i b )
+{
+    const __m128i z = _mm_setzero_si128();
+    __m128i lo = _mm_add_epi16( _mm_unpacklo_epi8( a, z ), _mm_unpacklo_epi8( b, z ) );
+    __m128i hi = _mm_add_epi16( _mm_unpackhi_epi8( a, z ), _mm_unpackhi_epi8( b, z ) );
+    __m128i sum = _mm_add_epi16( _mm_unpacklo_epi64( lo, hi ), _mm_unpackhi_epi64( lo, hi ) );
+    return _mm_srli_epi16( sum, 2 );
+}
+
+// Filters one 4x4 source block of two lanes to 2x2 pixels: columns of the result hold pixel pairs of source columns
+// 0-1 and 2-3.
+static inline __m256i VS_VECTORCALL FilterBlock_AVX2( const uint32* b0, const uint32* b1 )
+{
+    __m256i l0 = _mm256_loadu_si256( (const __m256i*)b0 );
+    __m256i l1 = _mm256_loadu_si256( (const __m256i*)( b0 + 8 ) );
+    __m256i h0 = _mm256_loadu_si256( (const __m256i*)b1 );
+    __m256i h1 = _mm256_loadu_si256( (const __m256i*)( b1 + 8 ) );
+
+    __m256i c0 = _mm256_permute2x128_si256( l0, h0, 0x20 );
+    __m256i c1 = _mm256_permute2x128_si256( l0, h0, 0x31 );
+    __m256i c2 = _mm256_permute2x128_si256( l1, h1, 0x20 );
+    __m256i c3 = _mm256_permute2x128_si256( l1, h1, 0x31 );
+
+    return _mm256_packus_epi16( Filter2x2_AVX2( c0, c1 ), Filter2x2_AVX2( c2, c3 ) );
+}
+
+static inline __m128i VS_VECTORCALL FilterBlock_SSE( const uint32* b )
+{
+    __m128i c0 = _mm_loadu_si128( (const __m128i*)b );
+    __m128i c1 = _mm_loadu_si128( (const __m128i*)( b + 4 ) );
+    __m128i c2 = _mm_loadu_si128( (const __m128i*)( b + 8 ) );
+    __m128i c3 = _mm_loadu_si128( (const __m128i*)( b + 12 ) );
+
+    return _mm_packus_epi16( Filter2x2_SSE( c0, c1 ), Filter2x2_SSE( c2, c3 ) );
+}
+
+}
+
+void DownsampleTiled_AVX2( const uint32* src, size_t stride, uint32* dst, int blocks )
+{
+    int i = 0;
+    for( ; i+2<=blocks; i+=2 )
+    {
+        // Lane 0 filters output block i, lane 1 output block i+1
+        auto s = src + i * 32;
+        __m256i tl = FilterBlock_AVX2( s, s + 32 );
+        __m256i tr = FilterBlock_AVX2( s + 16, s + 48 );
+        __m256i bl = FilterBlock_AVX2( s + stride, s + stride + 32 );
+        __m256i br = FilterBlock_AVX2( s + stride + 16, s + stride + 48 );
+
+        __m256i x0 = _mm256_unpacklo_epi64( tl, bl );
+        __m256i x1 = _mm256_unpackhi_epi64( tl, bl );
+        __m256i x2 = _mm256_unpacklo_epi64( tr, br );
+        __m256i x3 = _mm256_unpackhi_epi64( tr, br );
+
+        _mm256_storeu_si256( (__m256i*)dst, _mm256_permute2x128_si256( x0, x1, 0x20 ) );
+        _mm256_storeu_si256( (__m256i*)( dst + 8 ), _mm256_permute2x128_si256( x2, x3, 0x20 ) );
+        _mm256_storeu_si256( (__m256i*)( dst + 16 ), _mm256_permute2x128_si256( x0, x1, 0x31 ) );
+        _mm256_storeu_si256( (__m256i*)( dst + 24 ), _mm256_permute2x128_si256( x2, x3, 0x31 ) );
+        dst += 32;
+    }
+    if( i < blocks )
+    {
+        auto s = src + i * 32;
+        __m128i tl = FilterBlock_SSE( s );
+        __m128i tr = FilterBlock_SSE( s + 16 );
+        __m128i bl = FilterBlock_SSE( s + stride );
+        __m128i br = FilterBlock_SSE( s + stride + 16 );
+
+        _mm_storeu_si128( (__m128i*)dst, _mm_unpacklo_epi64( tl, bl ) );
+        _mm_storeu_si128( (__m128i*)( dst + 4 ), _mm_unpackhi_epi64( tl, bl ) );
+        _mm_storeu_si128( (__m128i*)( dst + 8 ), _mm_unpacklo_epi64( tr, br ) );
+        _mm_storeu_si128( (__m128i*)( dst + 12 ), _mm_unpackhi_epi64( tr, br ) );
+    }
+}
+
+// Filters width / 8 * 8 pixels, the remainder is left to the caller.
+void DownsampleLinear_AVX2( const uint32* src1, const uint32* src2, uint32* dst, int width )
+{
+    for( int i=0; i+8<=width; i+=8 )
+    {
+        __m256i a0 = _mm256_loadu_si256( (const __m256i*)src1 );
+        __m256i a1 = _mm256_loadu_si256( (const __m256i*)( src1 + 8 ) );
+        __m256i b0 = _mm256_loadu_si256( (const __m256i*)src2 );
+        __m256i b1 = _mm256_loadu_si256( (const __m256i*)( src2 + 8 ) );
+
+        // Lanes hold output pixels 0-1, 4-5 and 2-3, 6-7
+        __m256i px = _mm256_packus_epi16( Filter2x2_AVX2( a0, b0 ), Filter2x2_AVX2( a1, b1 ) );
+        _mm256_storeu_si256( (__m256i*)dst, _mm256_permute4x64_epi64( px, _MM_SHUFFLE( 3, 1, 2, 0 ) ) );
+
+        src1 += 16;
+        src2 += 16;
+        dst += 8;
+    }
+}
+
+#ifndef _MSC_VER
+#  pragma GCC pop_options
+#endif
+
+#endif
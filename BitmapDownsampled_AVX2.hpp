@@ -0,0 +1,15 @@
+#ifndef __BITMAPDOWNSAMPLED_AVX2_HPP__
+#define __BITMAPDOWNSAMPLED_AVX2_HPP__
+
+#ifdef __SSE4_1__
+
+#include <stddef.h>
+
+#include "Types.hpp"
+
+void DownsampleTiled_AVX2( const uint32* src, size_t stride, uint32* dst, int blocks );
+void DownsampleLinear_AVX2( const uint32* src1, const uint32* src2, uint32* dst, int width );
+
+#endif
+
+#endif
@@ -0,0 +1,68 @@
+#include <string.h>
+
+#include "BlockCache.hpp"
+
+BlockCache::BlockCache( uint32 blocks )
+    : m_shards( new Shard[Shards] )
+{
+    // About one slot per block, up to 2 MB. Larger tables cost more in cache misses than they gain in hits.
+    uint32 size = 16;
+    while( size * Shards < blocks && size < 256 )
+    {
+        size *= 2;
+    }
+    m_mask = size - 1;
+
+    for( int i=0; i<Shards; i++ )
+    {
+        m_shards[i].entries.resize( size );
+        for( auto& e : m_shards[i].entries )
+        {
+            e.tag = 0;
+        }
+    }
+}
+
+uint64 BlockCache::Hash( const uint32 px[16] )
+{
+    // Independent multiplies of the eight words, mixed at the end
+    static const uint64 k[8] = {
+        0x9E3779B97F4A7C15ull, 0xC2B2AE3D27D4EB4Full, 0x165667B19E3779F9ull, 0xD6E8FEB86659FD93ull,
+        0xFF51AFD7ED558CCDull, 0xC4CEB9FE1A85EC53ull, 0x27D4EB2F165667C5ull, 0x94D049BB133111EBull
+    };
+    uint64 h = 0;
+    for( int i=0; i<8; i++ )
+    {
+        uint64 v;
+        memcpy( &v, px + i*2, 8 );
+        h += ( v ^ ( v >> 29 ) ) * k[i];
+    }
+    h ^= h >> 32;
+    return h * k[0];
+}
+
+bool BlockCache::Find( const uint32 px[16], uint64 hash, uint32 tag, uint64* data, int num )
+{
+    auto& shard = m_shards[hash % Shards];
+
+    std::lock_guard<std::mutex> lock( shard.lock );
+    const auto& e = shard.entries[( hash >> 32 ) & m_mask];
+    if( e.hash != hash || e.tag != tag || memcmp( e.px, px, sizeof( e.px ) ) != 0 )
+    {
+        return false;
+    }
+    memcpy( data, e.data, num * sizeof( uint64 ) );
+    return true;
+}
+
+void BlockCache::Insert( const uint32 px[16], uint64 hash, uint32 tag, const uint64* data, int num )
+{
+    auto& shard = m_shards[hash % Shards];
+
+    std::lock_guard<std::mutex> lock( shard.lock );
+    auto& e = shard.entries[( hash >> 32 ) & m_mask];
+    e.hash = hash;
+    memcpy( e.px, px, sizeof( e.px ) );
+    memcpy( e.data, data, num * sizeof( uint64 ) );
+    e.tag = tag;
+}
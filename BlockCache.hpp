@@ -0,0 +1,52 @@
+#ifndef __DARKRL__BLOCKCACHE_HPP__
+#define __DARKRL__BLOCKCACHE_HPP__
+
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "Types.hpp"
+
+// Encoded blocks keyed on the contents of their source pixels, so that repeated blocks are encoded once. The table is
+// split into shards with a lock each, so that the worker threads rarely wait for each other. Each shard is direct
+// mapped: a block replaces the one stored in its slot.
+class BlockCache
+{
+public:
+    // Encoded data of a block, e.g. alpha and color blocks and the two words of the DDS block
+    enum { MaxData = 4 };
+
+    // Sized for the given number of blocks, up to a limit
+    explicit BlockCache( uint32 blocks );
+
+    static uint64 Hash( const uint32 px[16] );
+
+    // Tag tells apart the encodings of a block into different data, it must not be zero. Hash is the one of the pixels.
+    bool Find( const uint32 px[16], uint64 hash, uint32 tag, uint64* data, int num );
+    void Insert( const uint32 px[16], uint64 hash, uint32 tag, const uint64* data, int num );
+
+private:
+    enum { Shards = 64 };
+
+    struct Entry
+    {
+        uint64 hash;
+        uint32 px[16];
+        uint64 data[MaxData];
+        uint32 tag;
+    };
+
+    // The shard array is not cache line aligned, so the padding keeps the locks of neighbouring shards at least a
+    // cache line apart instead
+    struct Shard
+    {
+        std::mutex lock;
+        std::vector<Entry> entries;
+        char pad[64];
+    };
+
+    std::unique_ptr<Shard[]> m_shards;
+    uint32 m_mask;
+};
+
+#endif
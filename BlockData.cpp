@@ -1,22 +1,36 @@
+#include <algorithm>
 #include <assert.h>
 #include <string.h>
 
+#include "BlockCache.hpp"
 #include "BlockData.hpp"
 #include "ColorSpace.hpp"
 #include "CpuArch.hpp"
 #include "Debug.hpp"
+#include "DecodeRGB.hpp"
+#include "DecodeRGB_AVX2.hpp"
 #include "Dither.hpp"
 #include "MipMap.hpp"
 #include "mmap.hpp"
 #include "ProcessAlpha.hpp"
+#include "ProcessAstc.hpp"
+#include "ProcessBC7.hpp"
+#include "ProcessDxtc.hpp"
 #include "ProcessRGB.hpp"
 #include "ProcessRGB_AVX2.hpp"
+#include "ProcessRGB_AVX512.hpp"
+#include "ProcessTH.hpp"
 #include "Tables.hpp"
 #include "TaskDispatch.hpp"
 
 #include "squish/squish.h"
 
 BlockData::BlockData( const char* fn )
+    : m_ddsMode( DdsMode::Native )
+    , m_levelSizes( false )
+    , m_roundedAlpha( 0 )
+    , m_grayBlocks( 0 )
+    , m_cachedBlocks( 0 )
 {
 	m_etc1.file = fopen(fn, "rb");
     assert( m_etc1.file );
@@ -28,15 +42,88 @@ BlockData::BlockData( const char* fn )
     auto data32 = (uint32*)m_etc1.data;
     if( *data32 == 0x03525650 )
     {
+        switch( *(data32+2) )
+        {
+        case 6:
+            m_type = Etc1;
+            break;
+        case 22:
+            m_type = Etc2_RGB;
+            break;
+        case 23:
+            m_type = Etc2_RGBA;
+            break;
+        case 24:
+            m_type = Etc2_RGBA1;
+            break;
+        case 25:
+            m_type = Eac_R11;
+            break;
+        case 26:
+            m_type = Eac_RG11;
+            break;
+        case 27:
+            m_type = Astc_4x4;
+            break;
+        case 31:
+            m_type = Astc_6x6;
+            break;
+        default:
+            assert( false );
+            break;
+        }
+
         m_size.y = *(data32+6);
         m_size.x = *(data32+7);
         m_etc1.offset = 52 + *(data32+12);
     }
     else if( *data32 == 0x58544BAB )
     {
+        switch( *(data32+7) )
+        {
+        case 0x8D64:
+            m_type = Etc1;
+            break;
+        case 0x9274:
+            m_type = Etc2_RGB;
+            break;
+        case 0x9278:
+            m_type = Etc2_RGBA;
+            break;
+        case 0x9276:
+            m_type = Etc2_RGBA1;
+            break;
+        case 0x9270:
+            m_type = Eac_R11;
+            break;
+        case 0x9272:
+            m_type = Eac_RG11;
+            break;
+        case 0x93B0:
+            m_type = Astc_4x4;
+            break;
+        case 0x93B4:
+            m_type = Astc_6x6;
+            break;
+        default:
+            assert( false );
+            break;
+        }
+
         m_size.x = *(data32+9);
         m_size.y = *(data32+10);
-        m_etc1.offset = 17 + *(data32+15);
+        // 64 byte header, key/value data and the image size of the first level
+        m_etc1.offset = 68 + *(data32+15);
+    }
+    else if( *data32 == 0x5CA1AB13 )
+    {
+        // 16 byte .astc header: the footprint, then the size in 24 bit values
+        const uint8* h = m_etc1.data;
+        assert( h[4] == h[5] && h[6] == 1 && ( h[4] == 4 || h[4] == 6 ) );
+        m_type = h[4] == 4 ? Astc_4x4 : Astc_6x6;
+        m_size.x = h[7] | ( h[8] << 8 ) | ( h[9] << 16 );
+        m_size.y = h[10] | ( h[11] << 8 ) | ( h[12] << 16 );
+        m_etc1.offset = 16;
     }
     else
     {
@@ -97,13 +184,103 @@ typedef struct {
 
 } DDSHeader;
 
+typedef struct {
+	uint8 identifier[12];
+	uint32 endianness;
+	uint32 gl_type;
+	uint32 gl_type_size;
+	uint32 gl_format;
+	uint32 gl_internal_format;
+	uint32 gl_base_internal_format;
+	uint32 width;
+	uint32 height;
+	uint32 depth;
+	uint32 array_elements;
+	uint32 faces;
+	uint32 mipmaps;
+	uint32 kv_bytes;
+} KTXHeader;
+
+typedef struct {
+	uint32 magic;
+	uint8 block_x;
+	uint8 block_y;
+	uint8 block_z;
+	uint8 width[3];
+	uint8 height[3];
+	uint8 depth[3];
+} ASTCHeader;
+
+// Follows DDSHeader when its FourCC is DX10
+typedef struct {
+	uint32 dxgi_format;
+	uint32 dimension;
+	uint32 misc_flags;
+	uint32 array_size;
+	uint32 misc_flags2;
+} DDSHeaderDX10;
+
 typedef enum {
 	FormatPvr,
 	FormatPkm,
 	FormatDds,
+	FormatDdsBc7,
+	FormatAstc,
+	FormatKtx,
 } eFormat;
 
-static uint8* OpenForWriting( const char* fn_, size_t len, const v2i& size, FILE** f, int levels, bool atlas, eFormat fmt)
+// Number of 64-bit words in a block
+static int BlockSize( BlockData::Type type )
+{
+    return ( type == BlockData::Etc2_RGBA || type == BlockData::Eac_RG11 || type == BlockData::Astc_4x4 || type == BlockData::Astc_6x6 ) ? 2 : 1;
+}
+
+// Width and height of the ASTC blocks of the type, 0 for the ETC and EAC types
+static int AstcFootprint( BlockData::Type type )
+{
+    switch( type )
+    {
+    case BlockData::Astc_4x4:
+        return 4;
+    case BlockData::Astc_6x6:
+        return 6;
+    default:
+        return 0;
+    }
+}
+
+// Bytes of the blocks of all levels, with the sizes which precede each level in KTX files
+static size_t AstcLength( const v2i& size, int levels, int footprint, bool levelSizes )
+{
+    size_t len = 0;
+    v2i current = size;
+    for( int i=0; i<levels; i++ )
+    {
+        len += LevelBlocks( current, footprint ) * 16 + ( levelSizes ? 4 : 0 );
+        current.x = std::max( 1, current.x / 2 );
+        current.y = std::max( 1, current.y / 2 );
+    }
+    return len;
+}
+
+// BC7 blocks are 128 bits. They replace the BC1 and BC3 blocks of the color types, EAC data stays BC4 or BC5.
+static bool DdsBc7( BlockData::Type type, DdsMode mode )
+{
+    return mode == DdsMode::Bc7 && type != BlockData::Eac_R11 && type != BlockData::Eac_RG11;
+}
+
+// BC4, BC5 and BC7 have no FourCC of their own in the original header, they are written with the DX10 extension
+static bool DdsDx10( BlockData::Type type, eFormat fmt )
+{
+    return fmt == FormatDdsBc7 || type == BlockData::Eac_R11 || type == BlockData::Eac_RG11;
+}
+
+static size_t DdsHeaderSize( BlockData::Type type, eFormat fmt )
+{
+    return sizeof(DDSHeader) + (DdsDx10(type, fmt) ? sizeof(DDSHeaderDX10) : 0);
+}
+
+static uint8* OpenForWriting( const char* fn_, size_t len, const v2i& size, FILE** f, int levels, bool atlas, eFormat fmt, BlockData::Type type )
 {
 	std::string fn = fn_;
 	switch(fmt) {
@@ -114,8 +291,15 @@ static uint8* OpenForWriting( const char* fn_, size_t len, const v2i& size, FILE
 		fn += ".pkm";
 		break;
 	case FormatDds:
+	case FormatDdsBc7:
 		fn += ".dds";
 		break;
+	case FormatAstc:
+		fn += ".astc";
+		break;
+	case FormatKtx:
+		fn += ".ktx";
+		break;
 	}
 
     *f = fopen( fn.c_str(), "wb+" );
@@ -131,9 +315,39 @@ static uint8* OpenForWriting( const char* fn_, size_t len, const v2i& size, FILE
 	switch(fmt) {
 	case FormatPkm:
 	{
+		// PKM stores a single level. Version 2.0 files hold the ETC2 formats.
 		PKMHeader *h = (PKMHeader *) ret;
-		memcpy(h->tag, "PKM 10", sizeof(h->tag));
-		h->format = levels - 1;
+		switch(type) {
+		case BlockData::Etc1:
+			memcpy(h->tag, "PKM 10", sizeof(h->tag));
+			h->format = _byteswap_ushort(0);
+			break;
+		case BlockData::Etc2_RGB:
+			memcpy(h->tag, "PKM 20", sizeof(h->tag));
+			h->format = _byteswap_ushort(1);
+			break;
+		case BlockData::Etc2_RGBA:
+			memcpy(h->tag, "PKM 20", sizeof(h->tag));
+			h->format = _byteswap_ushort(3);
+			break;
+		case BlockData::Etc2_RGBA1:
+			memcpy(h->tag, "PKM 20", sizeof(h->tag));
+			h->format = _byteswap_ushort(4);
+			break;
+		case BlockData::Eac_R11:
+			memcpy(h->tag, "PKM 20", sizeof(h->tag));
+			h->format = _byteswap_ushort(5);
+			break;
+		case BlockData::Eac_RG11:
+			memcpy(h->tag, "PKM 20", sizeof(h->tag));
+			h->format = _byteswap_ushort(6);
+			break;
+		case BlockData::Astc_4x4:
+		case BlockData::Astc_6x6:
+			// PKM has no ASTC formats
+			assert(false);
+			break;
+		}
 		h->orig_height = _byteswap_ushort(atlas ? size.y * 2: size.y);
 		h->orig_width = _byteswap_ushort(size.x);
 		h->tex_height = h->orig_height;
@@ -145,7 +359,32 @@ static uint8* OpenForWriting( const char* fn_, size_t len, const v2i& size, FILE
 		PVRHeader *h = (PVRHeader *) ret;
 		h->tag = 0x03525650;
 		h->flags = 0;
-		h->pixel_formats[0] = 6; // pixelformat[0], value 22 is needed for etc2
+		switch(type) {
+		case BlockData::Etc1:
+			h->pixel_formats[0] = 6;
+			break;
+		case BlockData::Etc2_RGB:
+			h->pixel_formats[0] = 22;
+			break;
+		case BlockData::Etc2_RGBA:
+			h->pixel_formats[0] = 23;
+			break;
+		case BlockData::Etc2_RGBA1:
+			h->pixel_formats[0] = 24;
+			break;
+		case BlockData::Eac_R11:
+			h->pixel_formats[0] = 25;
+			break;
+		case BlockData::Eac_RG11:
+			h->pixel_formats[0] = 26;
+			break;
+		case BlockData::Astc_4x4:
+			h->pixel_formats[0] = 27;
+			break;
+		case BlockData::Astc_6x6:
+			h->pixel_formats[0] = 31;
+			break;
+		}
 		h->pixel_formats[1] = 0;
 		h->colour_space = 0;
 		h->channel_type = 0;
@@ -159,6 +398,7 @@ static uint8* OpenForWriting( const char* fn_, size_t len, const v2i& size, FILE
 	}
 	break;
 	case FormatDds:
+	case FormatDdsBc7:
 	{
 		DDSHeader *h = (DDSHeader *) ret;
 		strncpy(h->tag, "DDS ", 4);
@@ -166,13 +406,19 @@ static uint8* OpenForWriting( const char* fn_, size_t len, const v2i& size, FILE
 		h->flags = 0x000A1007;
 		h->height = atlas ? size.y * 2 : size.y;
 		h->width = size.x;
-		h->pitch = h->width * h->height / 2;
+		// Linear size of the first level
+		h->pitch = h->width * h->height / 2 * (fmt == FormatDdsBc7 ? 2 : BlockSize(type));
 		h->depth = 0;
 		h->mipmaps = levels;
 		memset(h->dummy, 0, sizeof(h->dummy));
 		h->format_size = 0x20;
 		h->format_flags = 5;
-		h->format_fourcc = 0x31545844; // DXT1
+		if(DdsDx10(type, fmt))
+			h->format_fourcc = 0x30315844; // DX10
+		else if(type == BlockData::Etc2_RGBA)
+			h->format_fourcc = 0x35545844; // DXT5
+		else
+			h->format_fourcc = 0x31545844; // DXT1
 		h->format_rgb_bits = 0;
 		h->format_red_mask = 0;
 		h->format_green_mask = 0;
@@ -184,6 +430,66 @@ static uint8* OpenForWriting( const char* fn_, size_t len, const v2i& size, FILE
 		h->caps_ddsx = 0;
 		h->skip1 = 0;
 		h->skip2 = 0;
+
+		if(DdsDx10(type, fmt)) {
+			DDSHeaderDX10 *h10 = (DDSHeaderDX10 *) (h + 1);
+			if(fmt == FormatDdsBc7)
+				h10->dxgi_format = 98; // DXGI_FORMAT_BC7_UNORM
+			else
+				h10->dxgi_format = type == BlockData::Eac_R11 ? 80 : 83; // DXGI_FORMAT_BC4_UNORM, DXGI_FORMAT_BC5_UNORM
+			h10->dimension = 3; // Texture 2D
+			h10->misc_flags = 0;
+			h10->array_size = 1;
+			h10->misc_flags2 = 0;
+		}
+	}
+	break;
+	case FormatAstc:
+	{
+		// A single level, the size is stored in 24 bits
+		ASTCHeader *h = (ASTCHeader *) ret;
+		const int footprint = AstcFootprint(type);
+		h->magic = 0x5CA1AB13;
+		h->block_x = footprint;
+		h->block_y = footprint;
+		h->block_z = 1;
+		for(int i=0; i<3; i++) {
+			h->width[i] = size.x >> (i * 8);
+			h->height[i] = size.y >> (i * 8);
+			h->depth[i] = i == 0 ? 1 : 0;
+		}
+	}
+	break;
+	case FormatKtx:
+	{
+		static const uint8 identifier[12] = { 0xAB, 0x4B, 0x54, 0x58, 0x20, 0x31, 0x31, 0xBB, 0x0D, 0x0A, 0x1A, 0x0A };
+		KTXHeader *h = (KTXHeader *) ret;
+		const int footprint = AstcFootprint(type);
+		memcpy(h->identifier, identifier, sizeof(identifier));
+		h->endianness = 0x04030201;
+		h->gl_type = 0;
+		h->gl_type_size = 1;
+		h->gl_format = 0;
+		h->gl_internal_format = footprint == 4 ? 0x93B0 : 0x93B4; // GL_COMPRESSED_RGBA_ASTC_4x4_KHR, GL_COMPRESSED_RGBA_ASTC_6x6_KHR
+		h->gl_base_internal_format = 0x1908; // GL_RGBA
+		h->width = size.x;
+		h->height = size.y;
+		h->depth = 0;
+		h->array_elements = 0;
+		h->faces = 1;
+		h->mipmaps = levels;
+		h->kv_bytes = 0;
+
+		// Each level is preceded by its size
+		uint8* level = (uint8*) (h + 1);
+		v2i current = size;
+		for(int i=0; i<levels; i++) {
+			const uint32 bytes = LevelBlocks(current, footprint) * 16;
+			memcpy(level, &bytes, 4);
+			level += 4 + bytes;
+			current.x = std::max(1, current.x / 2);
+			current.y = std::max(1, current.y / 2);
+		}
 	}
 	break;
 	}
@@ -205,9 +511,30 @@ static int AdjustSizeForMipmaps( const v2i& size, int levels )
     return len;
 }
 
-BlockData::BlockData( const char* fn, const v2i& size, bool mipmap, bool atlas, bool etc_pkm, bool dds )
+BlockData::BlockData( const char* fn, const v2i& size, bool mipmap, bool atlas, bool etc_pkm, bool dds, DdsMode ddsMode, Type type )
     : m_size( size )
+    , m_type( type )
+    , m_ddsMode( ddsMode )
+    , m_levelSizes( false )
+    , m_roundedAlpha( 0 )
+    , m_grayBlocks( 0 )
+    , m_cachedBlocks( 0 )
 {
+    const int footprint = AstcFootprint( type );
+    if( footprint != 0 )
+    {
+        // ASTC data is written to a .astc file, which holds a single level, or to a KTX file with mipmaps
+        assert( !atlas && !etc_pkm && !dds );
+        const int levels = mipmap ? NumberOfMipLevels( size ) : 1;
+        const eFormat fmt = mipmap ? FormatKtx : FormatAstc;
+        const size_t hsize = mipmap ? sizeof(KTXHeader) : sizeof(ASTCHeader);
+        m_levelSizes = mipmap;
+        m_etc1.offset = hsize + ( m_levelSizes ? 4 : 0 );
+        m_maplen = hsize + AstcLength( size, levels, footprint, m_levelSizes );
+        m_etc1.data = OpenForWriting( fn, m_maplen, m_size, &m_etc1.file, levels, false, fmt, type );
+        return;
+    }
+
 	size_t hsize = (etc_pkm ? sizeof(PKMHeader) : sizeof(PVRHeader));
     m_etc1.offset = hsize;
     m_maplen = m_size.x*m_size.y/2;
@@ -227,30 +554,52 @@ BlockData::BlockData( const char* fn, const v2i& size, bool mipmap, bool atlas,
 	if(atlas)
 		m_maplen *= 2;
 
-    m_etc1.data = OpenForWriting( fn, hsize + m_maplen, m_size, &m_etc1.file, levels, atlas, (etc_pkm ? FormatPkm : FormatPvr) );
+	// DDS blocks have the size of the ETC ones: BC3 and BC5 blocks are 128 bits, like ETC2 RGBA and RG11
+	m_maplen *= BlockSize(type);
+	const bool bc7 = DdsBc7(type, ddsMode);
+	const size_t ddslen = bc7 ? m_maplen / BlockSize(type) * 2 : m_maplen;
+
+    m_etc1.data = OpenForWriting( fn, hsize + m_maplen, m_size, &m_etc1.file, levels, atlas, (etc_pkm ? FormatPkm : FormatPvr), type );
 	if(atlas)
 		m_etc1.atlas = m_etc1.data + (hsize + m_maplen / 2);
 
 	if(dds) {
-		m_dds.offset = sizeof(DDSHeader);
-	    m_dds.data = OpenForWriting( fn, sizeof(DDSHeader) + m_maplen, m_size, &m_etc1.file, levels, atlas, FormatDds );
+		const eFormat fmt = bc7 ? FormatDdsBc7 : FormatDds;
+		m_dds.offset = DdsHeaderSize(type, fmt);
+	    m_dds.data = OpenForWriting( fn, m_dds.offset + ddslen, m_size, &m_etc1.file, levels, atlas, fmt, type );
 		if(atlas)
-			m_dds.atlas = m_dds.data + (sizeof(DDSHeader) + m_maplen / 2);
+			m_dds.atlas = m_dds.data + (m_dds.offset + ddslen / 2);
 	}
 	m_maplen += hsize;
 }
 
-BlockData::BlockData( const v2i& size, bool mipmap )
+BlockData::BlockData( const v2i& size, bool mipmap, Type type )
     : m_size( size )
-    , m_maplen( 52 + m_size.x*m_size.y/2 )
+    , m_maplen( m_size.x*m_size.y/2 )
+    , m_type( type )
+    , m_ddsMode( DdsMode::Native )
+    , m_levelSizes( false )
+    , m_roundedAlpha( 0 )
+    , m_grayBlocks( 0 )
+    , m_cachedBlocks( 0 )
 {
     m_etc1.offset = sizeof(PVRHeader);
     assert( m_size.x%4 == 0 && m_size.y%4 == 0 );
-    if( mipmap )
+    const int levels = mipmap ? NumberOfMipLevels( size ) : 1;
+    const int footprint = AstcFootprint( type );
+    if( footprint != 0 )
     {
-        const int levels = NumberOfMipLevels( size );
-        m_maplen += AdjustSizeForMipmaps( size, levels );
+        m_maplen = AstcLength( size, levels, footprint, false );
+    }
+    else
+    {
+        if( mipmap )
+        {
+            m_maplen += AdjustSizeForMipmaps( size, levels );
+        }
+        m_maplen *= BlockSize( type );
     }
+    m_maplen += sizeof(PVRHeader);
     m_etc1.data = new uint8[m_maplen];
 }
 
@@ -267,251 +616,905 @@ BlockData::~BlockData()
     }
 }
 
-static uint64 _f_rgb( uint8* ptr )
+#pragma pack(push,1)
+typedef struct {
+	uint8 r, g, b, a;
+} Pixel;
+#pragma pack(pop)
+
+enum class Isa
 {
-    return ProcessRGB( ptr );
+    Generic,
+    Avx2,
+    Avx512
+};
+
+// Effort levels only change the ETC1 encoders, see BlockData::Process for ETC2
+template<bool Etc2, Isa I>
+static inline uint64 EncodeBlock( const uint8* ptr, Effort effort )
+{
+    if( !Etc2 && effort == Effort::Best )
+    {
+        return ProcessRGB_Best( ptr );
+    }
+#ifdef __SSE4_1__
+    if( I != Isa::Generic )
+    {
+        if( Etc2 )
+        {
+            return ProcessRGB_ETC2_AVX2( ptr );
+        }
+        return effort == Effort::Fast ? ProcessRGB_Fast_AVX2( ptr ) : ProcessRGB_AVX2( ptr );
+    }
+#endif
+    return Etc2 ? ProcessRGB_ETC2( ptr ) : ProcessRGB( ptr );
 }
 
-static uint64 _f_rgb_avx2( uint8* ptr )
+template<Isa I>
+static inline uint64 EncodePunchThrough( const uint8* ptr )
 {
-    return ProcessRGB_AVX2( ptr );
+#ifdef __SSE4_1__
+    if( I != Isa::Generic )
+    {
+        return ProcessRGB_ETC2_A1_AVX2( ptr );
+    }
+#endif
+    return ProcessRGB_ETC2_A1( ptr );
 }
 
-static uint64 _f_rgb_dither( uint8* ptr )
+// Etc is the encoded color block, which may be transcoded. Punch-through blocks are always encoded from the pixels.
+// RGBA blocks are written as BC3: a BC4 alpha block followed by the color block, which is always read in the four
+// color mode. Opaque pixels never get the three color mode from ProcessBC1 or TranscodeBC1. BC7 blocks keep the
+// alpha of RGBA and punch-through pixels as it is.
+template<Channels Type, bool Tiled, Isa I>
+static inline void CompressDds( const uint32* src, size_t width, uint64* dst, DdsMode mode, uint64 etc )
 {
-    Dither( ptr );
-    return ProcessRGB( ptr );
+	uint32 buf[4*4];
+	uint8 alpha[16];
+	auto ptr = buf;
+	for(int y = 0; y < 4; y ++) {
+
+		for(int x = 0; x < 4; x++) {
+
+			const uint32* s = Tiled ? src + x * 4 + y : src + y * width + x;
+			if(Type == Channels::Alpha) {
+				uint32 a = *s >> 24;
+				*ptr++ = a | (a << 8) | (a << 16) | 0xFF000000;
+			}
+			else {
+				const Pixel& c = *(const Pixel *) s;
+				Pixel p;
+				p.r = c.b;
+				p.g = c.g;
+				p.b = c.r;
+				p.a = Type == Channels::RGBA1 || (Type == Channels::RGBA && mode == DdsMode::Bc7) ? c.a : 255;
+				*ptr++ = *(uint32 *)&p;
+				if(Type == Channels::RGBA)
+					alpha[y * 4 + x] = c.a;
+			}
+		}
+	}
+	if(mode == DdsMode::Bc7) {
+#ifdef __SSE4_1__
+		if(I != Isa::Generic) {
+			ProcessBC7_AVX2((const uint8*)buf, dst);
+			return;
+		}
+#endif
+		ProcessBC7((const uint8*)buf, dst);
+		return;
+	}
+	uint64* color = Type == Channels::RGBA ? dst + 1 : dst;
+	if(mode == DdsMode::Squish) {
+		// The DXT5 color block is encoded in the four color mode, the alpha block is replaced below
+		squish::Compress((squish::u8*)buf, dst, Type == Channels::RGBA ? squish::kDxt5 : squish::kDxt1);
+	}
+	else if(mode != DdsMode::Native && Type != Channels::RGBA1) {
+		*color = TranscodeBC1(etc, (const uint8*)buf, mode == DdsMode::TranscodeRefine);
+	}
+	else {
+		*color = ProcessBC1((const uint8*)buf);
+	}
+	if(Type == Channels::RGBA) {
+		dst[0] = ProcessBC4(alpha);
+	}
 }
 
-static uint64 _f_rgb_dither_avx2( uint8* ptr )
+// Alpha values of a block of pixels
+static inline void LoadAlpha( const uint32* block, uint8* alpha )
 {
-    Dither( ptr );
-    return ProcessRGB_AVX2( ptr );
+    for( int i=0; i<16; i++ )
+    {
+        alpha[i] = block[i] >> 24;
+    }
 }
 
-static uint64 _f_rgb_etc2( uint8* ptr )
+#ifdef __SSE4_1__
+// Checks if red, green and blue are equal in all pixels. The number of pixels must be a multiple of 4.
+static inline bool IsGray( const uint32* src, size_t num )
 {
-    return ProcessRGB_ETC2( ptr );
+    __m128i diff = _mm_setzero_si128();
+    for( size_t i=0; i<num; i+=4 )
+    {
+        __m128i px = _mm_loadu_si128((const __m128i*)( src + i ));
+        diff = _mm_or_si128(diff, _mm_xor_si128(px, _mm_srli_epi32(px, 8)));
+    }
+    return _mm_testz_si128(diff, _mm_set1_epi32(0xFFFF)) != 0;
 }
 
-static uint64 _f_rgb_etc2_avx2( uint8* ptr )
+template<bool Tiled>
+static inline bool IsGrayRun( const uint32* src, size_t width, uint32 run )
 {
-    return ProcessRGB_ETC2_AVX2( ptr );
+    if( Tiled )
+    {
+        return IsGray( src, run * 16 );
+    }
+    for( int y=0; y<4; y++ )
+    {
+        if( !IsGray( src + y * width, run * 4 ) )
+        {
+            return false;
+        }
+    }
+    return true;
 }
 
-static uint64 _f_rgb_etc2_dither( uint8* ptr )
+// Encodes a run of 8 or 16 blocks with the batch kernels. Alpha and gray blocks need only a single channel encoded.
+template<Channels Type, bool Etc2, bool Tiled>
+static void EncodeRun( const uint8* src, size_t pitch, uint32 run, bool gray, bool fast, uint64* dst )
 {
-    Dither( ptr );
-    return ProcessRGB_ETC2( ptr );
+    if( run == 16 )
+    {
+        if( Type == Channels::Alpha )
+        {
+            if( Tiled )
+            {
+                ProcessAlpha_AVX512_x16_Tiled( src, dst );
+            }
+            else
+            {
+                ProcessAlpha_AVX512_x16( src, pitch, dst );
+            }
+        }
+        else if( gray )
+        {
+            if( Tiled )
+            {
+                ProcessGray_AVX512_x16_Tiled( src, dst );
+            }
+            else
+            {
+                ProcessGray_AVX512_x16( src, pitch, dst );
+            }
+        }
+        else if( Etc2 )
+        {
+            if( Tiled )
+            {
+                ProcessRGB_ETC2_AVX512_x16_Tiled( src, dst );
+            }
+            else
+            {
+                ProcessRGB_ETC2_AVX512_x16( src, pitch, dst );
+            }
+        }
+        else if( fast )
+        {
+            if( Tiled )
+            {
+                ProcessRGB_Fast_AVX512_x16_Tiled( src, dst );
+            }
+            else
+            {
+                ProcessRGB_Fast_AVX512_x16( src, pitch, dst );
+            }
+        }
+        else
+        {
+            if( Tiled )
+            {
+                ProcessRGB_AVX512_x16_Tiled( src, dst );
+            }
+            else
+            {
+                ProcessRGB_AVX512_x16( src, pitch, dst );
+            }
+        }
+    }
+    else
+    {
+        if( Type == Channels::Alpha )
+        {
+            if( Tiled )
+            {
+                ProcessAlpha_AVX2_x8_Tiled( src, dst );
+            }
+            else
+            {
+                ProcessAlpha_AVX2_x8( src, pitch, dst );
+            }
+        }
+        else if( gray )
+        {
+            if( Tiled )
+            {
+                ProcessGray_AVX2_x8_Tiled( src, dst );
+            }
+            else
+            {
+                ProcessGray_AVX2_x8( src, pitch, dst );
+            }
+        }
+        else if( fast )
+        {
+            if( Tiled )
+            {
+                ProcessRGB_Fast_AVX2_x8_Tiled( src, dst );
+            }
+            else
+            {
+                ProcessRGB_Fast_AVX2_x8( src, pitch, dst );
+            }
+        }
+        else
+        {
+            if( Tiled )
+            {
+                ProcessRGB_AVX2_x8_Tiled( src, dst );
+            }
+            else
+            {
+                ProcessRGB_AVX2_x8( src, pitch, dst );
+            }
+        }
+    }
 }
+#endif
+
+// Block counts of a call to ProcessBlocks
+struct ProcessStats
+{
+    uint32 rounded;     // RGBA1 blocks with alpha that is not binary
+    uint32 gray;        // RGB blocks encoded with a single channel kernel
+    uint32 cached;      // Blocks copied from the cache
+};
 
-static uint64 _f_rgb_etc2_dither_avx2( uint8* ptr )
+// Source pixels of a run of blocks, in the column-major order of the encoders, and their hashes. Alpha blocks keep only
+// the alpha channel, so that blocks which differ in color share the cache entry. The color encoders also look at alpha
+// when checking for solid blocks.
+template<Channels Type, bool Tiled>
+static void LoadKeys( const uint32* src, size_t width, uint32 run, uint32 keys[][16], uint64* hashes )
 {
-    Dither( ptr );
-    return ProcessRGB_ETC2_AVX2( ptr );
+    const uint32 mask = Type == Channels::Alpha ? 0xFF000000 : 0xFFFFFFFF;
+    for( uint32 i=0; i<run; i++ )
+    {
+        const uint32* block = Tiled ? src + i * 16 : src + i * 4;
+        for( int x=0; x<4; x++ )
+        {
+            for( int y=0; y<4; y++ )
+            {
+                keys[i][x*4+y] = ( Tiled ? block[x*4+y] : block[y*width + x] ) & mask;
+            }
+        }
+        hashes[i] = BlockCache::Hash( keys[i] );
+    }
 }
 
-#pragma pack(push,1)
-typedef struct {
-	uint8 r, g, b, a;
-} Pixel;
-#pragma pack(pop)
+// Advances past a run of blocks, which may span block rows
+template<bool Tiled>
+static inline void SkipBlocks( const uint32*& src, size_t& w, size_t width, uint32 num )
+{
+    if( Tiled )
+    {
+        src += num * 16;
+    }
+    else
+    {
+        src += num * 4;
+        w += num;
+        if( w == width/4 )
+        {
+            src += width * 3;
+            w = 0;
+        }
+    }
+}
+
+// RGBA blocks are encoded as an alpha and a color block, in both the ETC and the DDS (BC3) data. The DDS block follows
+// in the cache.
+template<Channels Type>
+static inline int EncodedWords()
+{
+    return Type == Channels::RGBA ? 2 : 1;
+}
+
+// Parts of a texture may be encoded at different effort levels, and fast ETC2 parts without the ETC2 modes, so these
+// are part of the tag along with the channels
+template<Channels Type, bool Etc2>
+static inline uint32 CacheTag( Effort effort )
+{
+    return ( (uint32)Type + 1 ) | ( Etc2 ? 0x100 : 0 ) | ( (uint32)effort << 16 );
+}
+
+// Looks up a run of blocks in the cache. Returns a bit for each block found, its data is copied to data.
+template<Channels Type, bool Dds>
+static uint32 FindBlocks( BlockCache* cache, uint32 tag, const uint32 keys[][16], const uint64* hashes, uint32 run, uint64 data[][BlockCache::MaxData], int ddsWords )
+{
+    uint32 found = 0;
+    for( uint32 i=0; i<run; i++ )
+    {
+        if( cache->Find( keys[i], hashes[i], tag, data[i], EncodedWords<Type>() + ( Dds ? ddsWords : 0 ) ) )
+        {
+            found |= 1 << i;
+        }
+    }
+    return found;
+}
+
+// Writes the data of a block found in the cache. The DDS block follows the ETC one, BC7 blocks are always two words.
+template<Channels Type, bool Dds>
+static inline void StoreBlock( const uint64* data, uint64* dst, uint64* dst_dds, int ddsWords )
+{
+    const int words = EncodedWords<Type>();
+    memcpy( dst, data, words * sizeof( uint64 ) );
+    if( Dds )
+    {
+        memcpy( dst_dds, data + words, ddsWords * sizeof( uint64 ) );
+    }
+}
+
+template<Channels Type, bool Dds>
+static inline void InsertBlock( BlockCache* cache, uint32 tag, const uint32* key, uint64 hash, const uint64* dst, const uint64* dst_dds, int ddsWords )
+{
+    const int words = EncodedWords<Type>();
+    uint64 data[BlockCache::MaxData];
+    memcpy( data, dst, words * sizeof( uint64 ) );
+    if( Dds )
+    {
+        memcpy( data + words, dst_dds, ddsWords * sizeof( uint64 ) );
+    }
+    cache->Insert( key, hash, tag, data, words + ( Dds ? ddsWords : 0 ) );
+}
 
-void BlockData::Process( const uint32* src, uint32 blocks, size_t offset, size_t width, Channels type, bool dither, bool etc2 )
+// Encodes a run of blocks. All per-block decisions are template parameters, so each variant is a straight loop.
+// Tiled sources store each block as 16 consecutive pixels, which the kernels can read in place. RGBA blocks are written
+// as an EAC alpha block followed by the color block. With a cache, blocks which were encoded before are copied from it.
+// Runs are still encoded by the batch kernels unless all their blocks are found, only the per-block work is left out.
+template<Channels Type, bool Etc2, bool UseDither, Isa I, bool Dds, bool Tiled>
+static ProcessStats ProcessBlocks( const uint32* src, uint32 blocks, size_t width, uint64* dst, uint64* dst_dds, Effort effort, BlockCache* cache, DdsMode ddsMode )
 {
+    const int words = EncodedWords<Type>();
+    const int ddsWords = ddsMode == DdsMode::Bc7 ? 2 : words;
+
+    // The exhaustive ETC1 search has no batch kernel
+    const bool exhaustive = effort == Effort::Best && Type == Channels::RGB && !Etc2;
+    const uint32 tag = CacheTag<Type, Etc2>( effort );
+
+    uint32 keys[16][16];
+    uint64 hashes[16];
+    uint64 data[16][BlockCache::MaxData];
     uint32 buf[4*4];
-    int w = 0;
+    uint8 alpha[16];
+    ProcessStats stats = {};
+    size_t w = 0;
+
+    while( blocks > 0 )
+    {
+#ifdef __SSE4_1__
+        // Full runs of blocks are encoded at once, when no per-block preprocessing is needed. Runs in tiled sources may
+        // span block rows. The batch kernels may pick the individual mode, which punch-through blocks do not have. ETC1
+        // alpha blocks use the single-channel encoders, which cost up to 0.1 dB of PSNR against encoding them as gray
+        // color. ETC2 alpha blocks go through the color encoders, see below.
+        const bool batch = Type == Channels::RGB || Type == Channels::RGBA || ( Type == Channels::Alpha && !Etc2 );
+        if( batch && !UseDither && I != Isa::Generic && !exhaustive )
+        {
+            // Color blocks of RGBA runs are interleaved with alpha afterwards
+            uint64 color[16];
+            uint64* out = Type == Channels::RGBA ? color : dst;
+
+            uint32 run = 0;
+            if( I == Isa::Avx512 && blocks >= 16 && ( Tiled || w + 16 <= width/4 ) )
+            {
+                run = 16;
+            }
+            else if( !Etc2 && blocks >= 8 && ( Tiled || w + 8 <= width/4 ) )
+            {
+                run = 8;
+            }
+
+            const bool cached = cache != nullptr;
+            uint32 found = 0;
+            if( run != 0 && cached )
+            {
+                LoadKeys<Type, Tiled>( src, width, run, keys, hashes );
+                found = FindBlocks<Type, Dds>( cache, tag, keys, hashes, run, data, ddsWords );
+            }
+            if( run != 0 && found == ( 1u << run ) - 1 )
+            {
+                for( uint32 i=0; i<run; i++ )
+                {
+                    StoreBlock<Type, Dds>( data[i], dst + i * words, dst_dds + i * ddsWords, ddsWords );
+                }
+                stats.cached += run;
+                dst += run * words;
+                if( Dds )
+                {
+                    dst_dds += run * ddsWords;
+                }
+                SkipBlocks<Tiled>( src, w, width, run );
+                blocks -= run;
+                continue;
+            }
+
+            if( run != 0 )
+            {
+                // The single channel kernels only produce ETC1 blocks
+                const bool gray = Type == Channels::RGB && !Etc2 && IsGrayRun<Tiled>( src, width, run );
+                if( gray )
+                {
+                    stats.gray += run;
+                }
+                EncodeRun<Type, Etc2, Tiled>( (const uint8*)src, width * 4, run, gray, effort == Effort::Fast, out );
+
+                if( Etc2 )
+                {
+                    // The batch kernels leave out the T and H modes
+                    for( uint32 i=0; i<run; i++ )
+                    {
+                        if( found & ( 1 << i ) ) continue;
+
+                        const uint32* block = buf;
+                        if( Tiled )
+                        {
+                            block = src + i * 16;
+                        }
+                        else
+                        {
+                            for( int x=0; x<4; x++ )
+                            {
+                                for( int y=0; y<4; y++ )
+                                {
+                                    buf[x*4+y] = src[i*4 + y*width + x];
+                                }
+                            }
+                        }
+                        out[i] = ProcessTH_SSE41( (const uint8*)block, out[i] );
+
+                        if( Type == Channels::RGBA )
+                        {
+                            LoadAlpha( block, alpha );
+                            dst[i*2] = ProcessAlpha_ETC2( alpha );
+                            dst[i*2+1] = out[i];
+                        }
+                    }
+                }
+
+                if( Dds )
+                {
+                    for( uint32 i=0; i<run; i++ )
+                    {
+                        if( found & ( 1 << i ) ) continue;
+                        CompressDds<Type, Tiled, I>( Tiled ? src + i * 16 : src + i * 4, width, dst_dds + i * ddsWords, ddsMode, out[i] );
+                    }
+                }
+
+                if( cached )
+                {
+                    for( uint32 i=0; i<run; i++ )
+                    {
+                        if( found & ( 1 << i ) )
+                        {
+                            StoreBlock<Type, Dds>( data[i], dst + i * words, dst_dds + i * ddsWords, ddsWords );
+                            stats.cached++;
+                        }
+                        else
+                        {
+                            InsertBlock<Type, Dds>( cache, tag, keys[i], hashes[i], dst + i * words, dst_dds + i * ddsWords, ddsWords );
+                        }
+                    }
+                }
+
+                dst += run * words;
+                if( Dds )
+                {
+                    dst_dds += run * ddsWords;
+                }
+                SkipBlocks<Tiled>( src, w, width, run );
+                blocks -= run;
+                continue;
+            }
+        }
+#endif
+
+        if( cache != nullptr )
+        {
+            LoadKeys<Type, Tiled>( src, width, 1, keys, hashes );
+        }
+        if( cache != nullptr && FindBlocks<Type, Dds>( cache, tag, keys, hashes, 1, data, ddsWords ) != 0 )
+        {
+            StoreBlock<Type, Dds>( data[0], dst, dst_dds, ddsWords );
+            stats.cached++;
+            dst += words;
+            if( Dds )
+            {
+                dst_dds += ddsWords;
+            }
+            SkipBlocks<Tiled>( src, w, width, 1 );
+            blocks--;
+            continue;
+        }
+
+        const uint32 *src_dds = src;
+        uint64* const dst_block = dst;
+        const uint32 *block = buf;
+
+        auto ptr = buf;
+        if( Tiled )
+        {
+            if( Type == Channels::Alpha )
+            {
+                LoadAlpha( src, alpha );
+            }
+            else if( UseDither )
+            {
+                memcpy( buf, src, sizeof( buf ) );
+            }
+            else
+            {
+                block = src;
+            }
+            src += 16;
+        }
+        else
+        {
+            if( Type == Channels::Alpha )
+            {
+                auto a = alpha;
+                for( int x=0; x<4; x++ )
+                {
+                    *a++ = *src >> 24;
+                    src += width;
+                    *a++ = *src >> 24;
+                    src += width;
+                    *a++ = *src >> 24;
+                    src += width;
+                    *a++ = *src >> 24;
+                    src -= width * 3 - 1;
+                }
+            }
+            else
+            {
+                for( int x=0; x<4; x++ )
+                {
+                    *ptr++ = *src;
+                    src += width;
+                    *ptr++ = *src;
+                    src += width;
+                    *ptr++ = *src;
+                    src += width;
+                    *ptr++ = *src;
+                    src -= width * 3 - 1;
+                }
+            }
+            if( ++w == width/4 )
+            {
+                src += width * 3;
+                w = 0;
+            }
+        }
+
+        if( Type == Channels::Alpha && Etc2 )
+        {
+            // ETC2 alpha blocks are encoded as gray color, which makes the planar, T and H modes available
+            for( int i=0; i<16; i++ )
+            {
+                buf[i] = alpha[i] * 0x010101 | 0xFF000000;
+            }
+        }
+        if( UseDither )
+        {
+            Dither( (uint8*)buf );
+        }
+        if( Type == Channels::RGBA )
+        {
+            LoadAlpha( block, alpha );
+            *dst++ = ProcessAlpha_ETC2( alpha );
+        }
+        if( Type == Channels::Alpha && !Etc2 )
+        {
+            *dst++ = ProcessAlpha( alpha );
+        }
+        else if( Type == Channels::RGBA1 )
+        {
+            // Alpha is rounded to opaque or transparent at 128
+            if( !IsAlphaBinary( (const uint8*)block ) )
+            {
+                stats.rounded++;
+            }
+            *dst++ = EncodePunchThrough<I>( (const uint8*)block );
+        }
+        else
+        {
+            *dst++ = EncodeBlock<Etc2, I>( (const uint8*)block, effort );
+        }
+
+        if( Dds )
+        {
+            CompressDds<Type, Tiled, I>( src_dds, width, dst_dds, ddsMode, dst[-1] );
+        }
+        if( cache != nullptr )
+        {
+            InsertBlock<Type, Dds>( cache, tag, keys[0], hashes[0], dst_block, dst_dds, ddsWords );
+        }
+        if( Dds )
+        {
+            dst_dds += ddsWords;
+        }
+        blocks--;
+    }
+    return stats;
+}
+
+typedef ProcessStats(*ProcessFunc)( const uint32* src, uint32 blocks, size_t width, uint64* dst, uint64* dst_dds, Effort effort, BlockCache* cache, DdsMode ddsMode );
+
+template<Channels Type, bool Etc2, bool UseDither, Isa I, bool Dds>
+static ProcessFunc SelectTiled( bool tiled )
+{
+    return tiled ? ProcessBlocks<Type, Etc2, UseDither, I, Dds, true> : ProcessBlocks<Type, Etc2, UseDither, I, Dds, false>;
+}
+
+template<Channels Type, bool Etc2, bool UseDither, Isa I>
+static ProcessFunc SelectDds( bool dds, bool tiled )
+{
+    return dds ? SelectTiled<Type, Etc2, UseDither, I, true>( tiled ) : SelectTiled<Type, Etc2, UseDither, I, false>( tiled );
+}
+
+template<Channels Type, bool Etc2, bool UseDither>
+static ProcessFunc SelectIsa( Isa isa, bool dds, bool tiled )
+{
+    switch( isa )
+    {
+    case Isa::Avx512:
+        return SelectDds<Type, Etc2, UseDither, Isa::Avx512>( dds, tiled );
+    case Isa::Avx2:
+        return SelectDds<Type, Etc2, UseDither, Isa::Avx2>( dds, tiled );
+    default:
+        return SelectDds<Type, Etc2, UseDither, Isa::Generic>( dds, tiled );
+    }
+}
+
+template<Channels Type, bool Etc2>
+static ProcessFunc SelectDither( bool dither, Isa isa, bool dds, bool tiled )
+{
+    return dither ? SelectIsa<Type, Etc2, true>( isa, dds, tiled ) : SelectIsa<Type, Etc2, false>( isa, dds, tiled );
+}
+
+template<Channels Type>
+static ProcessFunc SelectEtc2( bool etc2, bool dither, Isa isa, bool dds, bool tiled )
+{
+    return etc2 ? SelectDither<Type, true>( dither, isa, dds, tiled ) : SelectDither<Type, false>( dither, isa, dds, tiled );
+}
 
-	uint64 *dst, *dst_dds;
-	if(type == Channels::Alpha && m_etc1.atlas) {
+void BlockData::Process( const uint32* src, uint32 blocks, size_t offset, size_t width, Channels type, bool dither, bool tiled, Effort effort )
+{
+	uint64 *dst, *dst_dds = nullptr;
+	// BC7 blocks are two words for all types
+	const size_t offset_dds = m_ddsMode == DdsMode::Bc7 ? offset * 2 : offset;
+	if(type == Channels::RGBA) {
+		assert(m_type == Etc2_RGBA);
+		dst = ((uint64*)( m_etc1.data + m_etc1.offset )) + offset * 2;
+		if(m_dds.data)
+			dst_dds = ((uint64*)( m_dds.data + m_dds.offset )) + offset * 2;
+	}
+	else if(type == Channels::Alpha && m_etc1.atlas) {
 		dst = ((uint64*)( m_etc1.atlas )) + offset;
 		if(m_dds.atlas)
-			dst_dds = ((uint64*)( m_dds.atlas )) + offset;
+			dst_dds = ((uint64*)( m_dds.atlas )) + offset_dds;
 	}
 	else {
 		dst = ((uint64*)( m_etc1.data + m_etc1.offset )) + offset;
 		if(m_dds.data)
-			dst_dds = ((uint64*)( m_dds.data + m_dds.offset )) + offset;
+			dst_dds = ((uint64*)( m_dds.data + m_dds.offset )) + offset_dds;
 	}
 
-    uint64 (*func)(uint8*);
+    Isa isa = Isa::Generic;
+#ifdef __SSE4_1__
+    if( can_use_intel_avx512bw_features() )
+    {
+        isa = Isa::Avx512;
+    }
+    else if( can_use_intel_core_4th_gen_features() )
+    {
+        isa = Isa::Avx2;
+    }
+#endif
+
+    // ETC1 blocks are valid ETC2 blocks, fast ETC2 RGB and alpha leave out the planar, T and H modes
+    const bool etc2 = m_type != Etc1 && effort != Effort::Fast;
+
+    ProcessFunc func;
+    if( type == Channels::Alpha )
+    {
+        // Alpha channel is never dithered
+        func = SelectEtc2<Channels::Alpha>( etc2, false, isa, dst_dds != nullptr, tiled );
+    }
+    else if( type == Channels::RGBA )
+    {
+        func = SelectDither<Channels::RGBA, true>( dither, isa, dst_dds != nullptr, tiled );
+    }
+    else if( type == Channels::RGBA1 )
+    {
+        assert( m_type == Etc2_RGBA1 );
+        func = SelectDither<Channels::RGBA1, true>( dither, isa, dst_dds != nullptr, tiled );
+    }
+    else
+    {
+        func = SelectEtc2<Channels::RGB>( etc2, dither, isa, dst_dds != nullptr, tiled );
+    }
+
+    const ProcessStats stats = func( src, blocks, width, dst, dst_dds, effort, m_cache.get(), m_ddsMode );
+    if( stats.rounded != 0 )
+    {
+        m_roundedAlpha += stats.rounded;
+    }
+    if( stats.gray != 0 )
+    {
+        m_grayBlocks += stats.gray;
+    }
+    if( stats.cached != 0 )
+    {
+        m_cachedBlocks += stats.cached;
+    }
+}
+
+void BlockData::EnableCache()
+{
+    m_cache.reset( new BlockCache( m_size.x * m_size.y / 16 ) );
+}
+
+// Encodes a run of blocks of one or two channels as EAC blocks, the second channel's block following the first one's
+template<bool Rg, bool Tiled>
+static void ProcessBlocksEac( const uint32* src, uint32 blocks, size_t width, uint64* dst, uint64* dst_dds, int channel0, int channel1 )
+{
+    uint32 buf[4*4];
+    uint8 values[16];
+    uint8 rows[16];
+    size_t w = 0;
 
-    if( type == Channels::Alpha )
+    while( blocks > 0 )
     {
-#ifdef __SSE4_1__
-        if( can_use_intel_core_4th_gen_features() )
+        const uint32* block = buf;
+        if( Tiled )
         {
-            if( etc2 )
-            {
-                func = _f_rgb_etc2_avx2;
-            }
-            else
-            {
-                func = _f_rgb_avx2;
-            }
+            block = src;
+            src += 16;
         }
         else
-#endif
-        {
-            if( etc2 )
-            {
-                func = _f_rgb_etc2;
-            }
-            else
-            {
-                func = _f_rgb;
-            }
-        }
-
-        do
         {
-			const uint32 *src_dds = src;
-
-            auto ptr = buf;
             for( int x=0; x<4; x++ )
             {
-                uint a = *src >> 24;
-                *ptr++ = a | ( a << 8 ) | ( a << 16 ) | 0xFF000000;
-                src += width;
-                a = *src >> 24;
-                *ptr++ = a | ( a << 8 ) | ( a << 16 ) | 0xFF000000;
-                src += width;
-                a = *src >> 24;
-                *ptr++ = a | ( a << 8 ) | ( a << 16 ) | 0xFF000000;
-                src += width;
-                a = *src >> 24;
-                *ptr++ = a | ( a << 8 ) | ( a << 16 ) | 0xFF000000;
-                src -= width * 3 - 1;
+                for( int y=0; y<4; y++ )
+                {
+                    buf[x*4+y] = src[y*width + x];
+                }
             }
+            src += 4;
             if( ++w == width/4 )
             {
                 src += width * 3;
                 w = 0;
             }
-
-            *dst++ = func( (uint8*)buf );
-
-			if(dst_dds) {
-
-				auto ptr = buf;
-				for(int y = 0; y < 4; y ++) {
-
-					for(int x = 0; x < 4; x++) {
-
-						uint32 a = *src_dds++ >> 24;
-						*ptr++ = a | (a << 8) | (a << 16) | 0xFF000000;
-					}
-					src_dds += width - 4;
-				}
-				squish::Compress((squish::u8*)buf, dst_dds++, squish::kDxt1);
-			}
         }
-        while( --blocks );
-    }
-    else
-    {
-#ifdef __SSE4_1__
-        if( can_use_intel_core_4th_gen_features() )
+
+        // DDS data holds the same channels as BC4 or BC5 blocks, whose values are ordered by rows
+        for( int c=0; c<( Rg ? 2 : 1 ); c++ )
         {
-            if( etc2 )
+            const int channel = c == 0 ? channel0 : channel1;
+            for( int i=0; i<16; i++ )
             {
-                if( dither )
-                {
-                    func = _f_rgb_etc2_dither_avx2;
-                }
-                else
-                {
-                    func = _f_rgb_etc2_avx2;
-                }
+                values[i] = block[i] >> channel;
             }
-            else
+            *dst++ = ProcessAlpha_EAC11( values );
+
+            if( dst_dds )
             {
-                if( dither )
-                {
-                    func = _f_rgb_dither_avx2;
-                }
-                else
+                for( int i=0; i<16; i++ )
                 {
-                    func = _f_rgb_avx2;
+                    rows[( i & 3 ) * 4 + ( i >> 2 )] = values[i];
                 }
+                *dst_dds++ = ProcessBC4( rows );
             }
         }
-        else
+        blocks--;
+    }
+}
+
+void BlockData::ProcessEac( const uint32* src, uint32 blocks, size_t offset, size_t width, int channel0, int channel1, bool tiled )
+{
+    assert( m_type == Eac_R11 || m_type == Eac_RG11 );
+    uint64* dst = ((uint64*)( m_etc1.data + m_etc1.offset )) + offset * BlockSize( m_type );
+    uint64* dst_dds = m_dds.data ? ((uint64*)( m_dds.data + m_dds.offset )) + offset * BlockSize( m_type ) : nullptr;
+
+    if( m_type == Eac_RG11 )
+    {
+        auto func = tiled ? ProcessBlocksEac<true, true> : ProcessBlocksEac<true, false>;
+        func( src, blocks, width, dst, dst_dds, channel0, channel1 );
+    }
+    else
+    {
+        auto func = tiled ? ProcessBlocksEac<false, true> : ProcessBlocksEac<false, false>;
+        func( src, blocks, width, dst, dst_dds, channel0, channel1 );
+    }
+}
+
+void BlockData::ProcessAstc( const uint32* src, uint32 lines, size_t offset, size_t width, bool alpha, bool tiled, Effort effort )
+{
+    const int footprint = AstcFootprint( m_type );
+    assert( footprint != 0 );
+    size_t pos = m_etc1.offset + offset * 16;
+
+    // Parts lie within a level and start on a row of its blocks. The sizes of the levels before it are skipped.
+    v2i size = m_size;
+    size_t start = 0;
+    while( offset >= start + LevelBlocks( size, footprint ) )
+    {
+        start += LevelBlocks( size, footprint );
+        pos += m_levelSizes ? 4 : 0;
+        size.x = std::max( 1, size.x / 2 );
+        size.y = std::max( 1, size.y / 2 );
+    }
+    uint64* dst = (uint64*)( m_etc1.data + pos );
+    const int columns = ( size.x + footprint - 1 ) / footprint;
+    const int top = int( offset - start ) / columns * footprint;
+
+    bool avx2 = false;
+#ifdef __SSE4_1__
+    avx2 = can_use_intel_core_4th_gen_features();
 #endif
+    const bool fast = effort == Effort::Fast;
+
+    // Texels are gathered in RGBA order, the pixels are BGRA. Texels past the edges of the level repeat its last row
+    // and column.
+    const int height = std::min<int>( lines * 4, size.y - top );
+    uint8 texels[6*6*4];
+    for( int by=0; by<height; by+=footprint )
+    {
+        for( int bx=0; bx<size.x; bx+=footprint )
         {
-            if( etc2 )
-            {
-                if( dither )
-                {
-                    func = _f_rgb_etc2_dither;
-                }
-                else
-                {
-                    func = _f_rgb_etc2;
-                }
-            }
-            else
+            for( int y=0; y<footprint; y++ )
             {
-                if( dither )
+                const size_t py = std::min( by + y, height - 1 );
+                for( int x=0; x<footprint; x++ )
                 {
-                    func = _f_rgb_dither;
-                }
-                else
-                {
-                    func = _f_rgb;
+                    const size_t px = std::min( bx + x, size.x - 1 );
+                    const uint32 c = src[tiled ? ( ( py / 4 ) * ( width / 4 ) + px / 4 ) * 16 + ( px % 4 ) * 4 + py % 4 : py * width + px];
+                    uint8* t = texels + ( y * footprint + x ) * 4;
+                    t[0] = c >> 16;
+                    t[1] = c >> 8;
+                    t[2] = c;
+                    t[3] = alpha ? c >> 24 : 255;
                 }
             }
-        }
-
-        do
-        {
-			const uint32 *src_dds = src;
-
-            auto ptr = buf;
-            for( int x=0; x<4; x++ )
+#ifdef __SSE4_1__
+            if( avx2 )
             {
-                *ptr++ = *src;
-                src += width;
-                *ptr++ = *src;
-                src += width;
-                *ptr++ = *src;
-                src += width;
-                *ptr++ = *src;
-                src -= width * 3 - 1;
+                ProcessAstc_AVX2( texels, footprint, footprint, fast, dst );
             }
-            if( ++w == width/4 )
+            else
+#endif
             {
-                src += width * 3;
-                w = 0;
+                ::ProcessAstc( texels, footprint, footprint, fast, dst );
             }
-            *dst++ = func( (uint8*)buf );
-
-			if(dst_dds) {
-
-				auto ptr = buf;
-				for(int y = 0; y < 4; y ++) {
-
-					for(int x = 0; x < 4; x++) {
-
-						Pixel& s = *(Pixel *) src_dds++;
-						Pixel p;
-						p.r = s.b;
-						p.g = s.g;
-						p.b = s.r;
-						p.a = 255;
-						*ptr++ = *(uint32 *)&p;
-					}
-					src_dds += width - 4;
-				}
-				squish::Compress((squish::u8*)buf, dst_dds++, squish::kDxt1);
-			}
+            dst += 2;
         }
-        while( --blocks );
     }
 }
 
 namespace
 {
+// Rows of blocks decoded by one task
+enum { DecodeBandRows = 8 };
+
 struct BlockColor
 {
     uint32 r1, g1, b1;
@@ -559,11 +1562,23 @@ Etc2Mode DecodeBlockColor( uint64 d, BlockColor& c )
 
         if ((r < 0) || (r > 31))
         {
+            c.r1 = ( ( ( d & 0x18000000 ) >> 25 ) | ( ( d & 0x03000000 ) >> 24 ) ) * 17;
+            c.g1 = ( ( d & 0x00F00000 ) >> 20 ) * 17;
+            c.b1 = ( ( d & 0x000F0000 ) >> 16 ) * 17;
+            c.r2 = ( ( d & 0x0000F000 ) >> 12 ) * 17;
+            c.g2 = ( ( d & 0x00000F00 ) >> 8 ) * 17;
+            c.b2 = ( ( d & 0x000000F0 ) >> 4 ) * 17;
             return Etc2Mode::t;
         }
 
         if ((g < 0) || (g > 31))
         {
+            c.r1 = ( ( d & 0x78000000 ) >> 27 ) * 17;
+            c.g1 = ( ( ( d & 0x07000000 ) >> 23 ) | ( ( d & 0x00100000 ) >> 20 ) ) * 17;
+            c.b1 = ( ( ( d & 0x00080000 ) >> 16 ) | ( ( d & 0x00038000 ) >> 15 ) ) * 17;
+            c.r2 = ( ( d & 0x00007800 ) >> 11 ) * 17;
+            c.g2 = ( ( d & 0x00000780 ) >> 7 ) * 17;
+            c.b2 = ( ( d & 0x00000078 ) >> 3 ) * 17;
             return Etc2Mode::h;
         }
 
@@ -640,27 +1655,202 @@ void DecodePlanar(uint64 block, uint32* l[4])
     }
 }
 
+inline uint32 PaintColor( uint32 r, uint32 g, uint32 b, int32 dist )
+{
+    return clampu8( int32( r ) + dist ) | ( clampu8( int32( g ) + dist ) << 8 ) | ( clampu8( int32( b ) + dist ) << 16 ) | 0xFF000000;
 }
 
-BitmapPtr BlockData::Decode()
+// T and H mode blocks select one of four paint colors for each pixel
+void DecodeTH( uint64 d, Etc2Mode mode, const BlockColor& c, uint32* dst, size_t pitch )
 {
-	v2i size = m_size;
-	if(m_etc1.atlas)
-		size.y *= 2;
-    auto ret = std::make_shared<Bitmap>( size );
+    uint32 paint[4];
+    if( mode == Etc2Mode::t )
+    {
+        const int32 dist = g_tableTH[( ( d & 0xC ) >> 1 ) | ( d & 0x1 )];
+        paint[0] = PaintColor( c.r1, c.g1, c.b1, 0 );
+        paint[1] = PaintColor( c.r2, c.g2, c.b2, dist );
+        paint[2] = PaintColor( c.r2, c.g2, c.b2, 0 );
+        paint[3] = PaintColor( c.r2, c.g2, c.b2, -dist );
+    }
+    else
+    {
+        // Lowest bit of the distance is given by the order of the colors
+        const uint32 order = ( ( c.r1 << 16 ) | ( c.g1 << 8 ) | c.b1 ) >= ( ( c.r2 << 16 ) | ( c.g2 << 8 ) | c.b2 ) ? 1 : 0;
+        const int32 dist = g_tableTH[( d & 0x4 ) | ( ( d & 0x1 ) << 1 ) | order];
+        paint[0] = PaintColor( c.r1, c.g1, c.b1, dist );
+        paint[1] = PaintColor( c.r1, c.g1, c.b1, -dist );
+        paint[2] = PaintColor( c.r2, c.g2, c.b2, dist );
+        paint[3] = PaintColor( c.r2, c.g2, c.b2, -dist );
+    }
+
+    for( int x=0; x<4; x++ )
+    {
+        for( int y=0; y<4; y++ )
+        {
+            const int o = x * 4 + y;
+            dst[y * pitch + x] = paint[( ( d >> ( o + 32 ) ) & 0x1 ) | ( ( d >> ( o + 47 ) ) & 0x2 )];
+        }
+    }
+}
+
+// Punch-through blocks without the opaque bit paint selector 2 transparent. In the differential mode selector 0 paints
+// the color of the half block unchanged.
+void DecodePunchThrough( uint64 d, Etc2Mode mode, const BlockColor& c, uint32* dst, size_t pitch )
+{
+    if( mode != Etc2Mode::none )
+    {
+        DecodeTH( d, mode, c, dst, pitch );
+    }
+
+    const uint32 tcw[2] = { uint32( ( d & 0xE0 ) >> 5 ), uint32( ( d & 0x1C ) >> 2 ) };
+    for( int x=0; x<4; x++ )
+    {
+        for( int y=0; y<4; y++ )
+        {
+            const int o = x * 4 + y;
+            const uint32 idx = ( ( d >> ( o + 32 ) ) & 0x1 ) | ( ( d >> ( o + 47 ) ) & 0x2 );
+            uint32& px = dst[y * pitch + x];
+            if( idx == 2 )
+            {
+                px = 0;
+            }
+            else if( mode == Etc2Mode::none )
+            {
+                const int sub = ( d & 0x1 ) ? ( y >> 1 ) : ( x >> 1 );
+                const int32 dist = idx == 0 ? 0 : g_table[tcw[sub]][idx];
+                px = sub == 0 ? PaintColor( c.r1, c.g1, c.b1, dist ) : PaintColor( c.r2, c.g2, c.b2, dist );
+            }
+        }
+    }
+}
+
+// EAC blocks store a base value, a multiplier, a modifier table and 3-bit selectors in big endian order
+uint64 EacSelectors( uint64 d )
+{
+    uint64 sel = 0;
+    for( int i=0; i<6; i++ )
+    {
+        sel = ( sel << 8 ) | ( ( d >> ( 16 + i * 8 ) ) & 0xFF );
+    }
+    return sel;
+}
+
+void DecodeAlpha( uint64 d, uint32* dst, size_t pitch )
+{
+    const int32 base = d & 0xFF;
+    const int32 mul = ( d >> 12 ) & 0xF;
+    const int32* table = g_alpha[( d >> 8 ) & 0xF];
+    const uint64 sel = EacSelectors( d );
+
+    for( int x=0; x<4; x++ )
+    {
+        for( int y=0; y<4; y++ )
+        {
+            const int o = x * 4 + y;
+            const uint32 a = clampu8( base + table[( sel >> ( 45 - o * 3 ) ) & 0x7] * mul );
+            uint32& px = dst[y * pitch + x];
+            px = ( px & 0x00FFFFFF ) | ( a << 24 );
+        }
+    }
+}
+
+// R11 blocks paint 11-bit values, which are stored as 8-bit values in the channel at the given bit offset
+void DecodeEac11( uint64 d, uint32* dst, size_t pitch, int channel )
+{
+    const int32 base = ( d & 0xFF ) * 8 + 4;
+    const int32 mul = ( d >> 12 ) & 0xF;
+    const int32 scale = mul == 0 ? 1 : mul * 8;
+    const int32* table = g_alpha[( d >> 8 ) & 0xF];
+    const uint64 sel = EacSelectors( d );
+
+    for( int x=0; x<4; x++ )
+    {
+        for( int y=0; y<4; y++ )
+        {
+            const int o = x * 4 + y;
+            const int32 v = std::min( std::max( 0, base + table[( sel >> ( 45 - o * 3 ) ) & 0x7] * scale ), 2047 );
+            dst[y * pitch + x] |= uint32( ( v * 255 + 1023 ) / 2047 ) << channel;
+        }
+    }
+}
+
+// Decodes rows of R11 or RG11 blocks to the red and green channels of an image of the given width
+void DecodeRowsEac( const uint64* src, uint32* dst, int width, int rows, bool rg )
+{
+    for( int y=0; y<rows; y++ )
+    {
+        for( int x=0; x<width/4; x++ )
+        {
+            uint32* block = dst + y * 4 * width + x * 4;
+            for( int i=0; i<4; i++ )
+            {
+                for( int j=0; j<4; j++ )
+                {
+                    block[i * width + j] = 0xFF000000;
+                }
+            }
+
+            DecodeEac11( *src++, block, width, 0 );
+            if( rg )
+            {
+                DecodeEac11( *src++, block, width, 8 );
+            }
+        }
+    }
+}
+
+// Decodes rows of ASTC blocks, starting at the given row of blocks, to an image of the given size. The texels of the
+// last blocks which lie past its edges are left out.
+void DecodeRowsAstc( const uint64* src, uint32* dst, const v2i& size, int row, int rows, int footprint )
+{
+    uint32 block[6*6];
+    const int columns = ( size.x + footprint - 1 ) / footprint;
+    for( int by=row; by<row+rows; by++ )
+    {
+        for( int bx=0; bx<columns; bx++ )
+        {
+            DecodeAstc( src, footprint, footprint, (uint8*)block );
+            src += 2;
+
+            const int w = std::min( footprint, size.x - bx * footprint );
+            const int h = std::min( footprint, size.y - by * footprint );
+            for( int y=0; y<h; y++ )
+            {
+                memcpy( dst + ( by * footprint + y ) * size.x + bx * footprint, block + y * footprint, w * sizeof( uint32 ) );
+            }
+        }
+    }
+}
+
+// Decodes rows of blocks to an image of the given width. Each color block of RGBA data follows its alpha block.
+void DecodeRows( const uint64* src, uint32* dst, int width, int rows, BlockData::Type type )
+{
+    const bool alpha = type == BlockData::Etc2_RGBA;
+    const bool punchThrough = type == BlockData::Etc2_RGBA1;
+
+    v2i size( width, rows * 4 );
 
     uint32* l[4];
-    l[0] = ret->Data();
+    l[0] = dst;
     l[1] = l[0] + size.x;
     l[2] = l[1] + size.x;
     l[3] = l[2] + size.x;
 
-    const uint64* src = (const uint64*)( m_etc1.data + m_etc1.offset );
+#ifdef __SSE4_1__
+    const bool avx2 = can_use_intel_core_4th_gen_features();
+#endif
 
-    for( int y=0; y<size.y/4; y++ )
+    for( int y=0; y<rows; y++ )
     {
+        const uint64* rowSrc = src;
+        uint32* rowDst = l[0];
+
         for( int x=0; x<size.x/4; x++ )
         {
+            if( alpha )
+            {
+                src++;
+            }
             uint64 d = *src++;
 
             d = ( ( d & 0xFF000000FF000000 ) >> 24 ) |
@@ -668,15 +1858,76 @@ BitmapPtr BlockData::Decode()
                 ( ( d & 0x00FF000000FF0000 ) >> 8 ) |
                 ( ( d & 0x0000FF000000FF00 ) << 8 );
 
+            // Punch-through blocks are always in the differential mode, its bit tells if they are opaque
+            const bool opaque = !punchThrough || ( d & 0x2 ) != 0;
+            if( punchThrough )
+            {
+                d |= 0x2;
+            }
+
             BlockColor c;
             const auto mode = DecodeBlockColor( d, c );
 
+            if( !opaque && mode != Etc2Mode::planar )
+            {
+                DecodePunchThrough( d, mode, c, l[0], size.x );
+                l[0] += 4;
+                l[1] += 4;
+                l[2] += 4;
+                l[3] += 4;
+                continue;
+            }
+
+#ifdef __SSE4_1__
+            if( mode == Etc2Mode::planar )
+            {
+                if( avx2 )
+                {
+                    DecodePlanar_AVX2( d, l[0], size.x );
+                }
+                else
+                {
+                    DecodePlanar_SSE41( d, l[0], size.x );
+                }
+            }
+            else if( mode != Etc2Mode::none )
+            {
+                DecodeTH( d, mode, c, l[0], size.x );
+            }
+            else
+            {
+                const uint32 c1 = c.r1 | ( c.g1 << 8 ) | ( c.b1 << 16 ) | 0xFF000000;
+                const uint32 c2 = c.r2 | ( c.g2 << 8 ) | ( c.b2 << 16 ) | 0xFF000000;
+                if( avx2 )
+                {
+                    DecodeRGB_AVX2( d, c1, c2, l[0], size.x );
+                }
+                else
+                {
+                    DecodeRGB_SSE41( d, c1, c2, l[0], size.x );
+                }
+            }
+            l[0] += 4;
+            l[1] += 4;
+            l[2] += 4;
+            l[3] += 4;
+#else
             if (mode == Etc2Mode::planar)
             {
                 DecodePlanar(d, l);
                 continue;
             }
 
+            if( mode != Etc2Mode::none )
+            {
+                DecodeTH( d, mode, c, l[0], size.x );
+                l[0] += 4;
+                l[1] += 4;
+                l[2] += 4;
+                l[3] += 4;
+                continue;
+            }
+
             uint tcw[2];
             tcw[0] = ( d & 0xE0 ) >> 5;
             tcw[1] = ( d & 0x1C ) >> 2;
@@ -769,6 +2020,16 @@ BitmapPtr BlockData::Decode()
                     o += 4;
                 }
             }
+#endif
+        }
+
+        // Alpha replaces the opaque alpha written by the color decoders
+        if( alpha )
+        {
+            for( int x=0; x<size.x/4; x++ )
+            {
+                DecodeAlpha( rowSrc[x*2], rowDst + x * 4, size.x );
+            }
         }
 
         l[0] += size.x * 3;
@@ -776,15 +2037,149 @@ BitmapPtr BlockData::Decode()
         l[2] += size.x * 3;
         l[3] += size.x * 3;
     }
+}
+
+}
+
+BitmapPtr BlockData::Decode()
+{
+	v2i size = m_size;
+	if(m_etc1.atlas)
+		size.y *= 2;
+    auto ret = std::make_shared<Bitmap>( size );
+
+    const uint64* src = (const uint64*)( m_etc1.data + m_etc1.offset );
+    uint32* dst = ret->Data();
+    const Type type = m_type;
+    const int blockSize = BlockSize( type );
+
+    // Bands of block rows are decoded in parallel, each to its own rows of the bitmap
+    TaskGroup group;
+    const int footprint = AstcFootprint( type );
+    if( footprint != 0 )
+    {
+        const int rows = ( size.y + footprint - 1 ) / footprint;
+        const size_t columns = ( size.x + footprint - 1 ) / footprint;
+        for( int y=0; y<rows; y+=DecodeBandRows )
+        {
+            const int num = std::min<int>( DecodeBandRows, rows - y );
+            TaskDispatch::Queue( [src, dst, y, num, size, columns, footprint]
+            {
+                DecodeRowsAstc( src + y * columns * 2, dst, size, y, num, footprint );
+            }, group );
+        }
+        TaskDispatch::Wait( group );
+        return ret;
+    }
+
+    const int rows = size.y / 4;
+    for( int y=0; y<rows; y+=DecodeBandRows )
+    {
+        const int num = std::min<int>( DecodeBandRows, rows - y );
+        const int width = size.x;
+        TaskDispatch::Queue( [src, dst, y, num, width, type, blockSize]
+        {
+            const uint64* bandSrc = src + y * ( width / 4 ) * blockSize;
+            uint32* bandDst = dst + y * 4 * width;
+            if( type == Eac_R11 || type == Eac_RG11 )
+            {
+                DecodeRowsEac( bandSrc, bandDst, width, num, type == Eac_RG11 );
+            }
+            else
+            {
+                DecodeRows( bandSrc, bandDst, width, num, type );
+            }
+        }, group );
+    }
+    TaskDispatch::Wait( group );
 
     return ret;
 }
 
+void BlockData::TranscodeDds( const char* fn, const Bitmap& decoded, bool refine )
+{
+    // ASTC blocks have no DDS counterpart
+    if( AstcFootprint( m_type ) != 0 ) return;
+
+    const Type type = m_type;
+    const int blockSize = BlockSize( type );
+    const size_t header = DdsHeaderSize( type, FormatDds );
+    const size_t len = header + m_size.x * m_size.y / 2 * blockSize;
+    FILE* file;
+    uint8* data = OpenForWriting( fn, len, m_size, &file, 1, false, FormatDds, type );
+
+    const uint64* src = (const uint64*)( m_etc1.data + m_etc1.offset );
+    uint64* dst = (uint64*)( data + header );
+    const uint32* px = decoded.Data();
+
+    const int rows = m_size.y / 4;
+    const int width = m_size.x;
+    TaskGroup group;
+    for( int y=0; y<rows; y+=DecodeBandRows )
+    {
+        const int num = std::min<int>( DecodeBandRows, rows - y );
+        TaskDispatch::Queue( [src, dst, px, y, num, width, type, blockSize, refine]
+        {
+            uint32 buf[16];
+            uint8 values[16];
+            for( int by=y; by<y+num; by++ )
+            {
+                for( int bx=0; bx<width/4; bx++ )
+                {
+                    for( int i=0; i<4; i++ )
+                    {
+                        memcpy( buf + i*4, px + ( by * 4 + i ) * width + bx * 4, 16 );
+                    }
+                    const size_t block = ( by * ( width / 4 ) + bx ) * blockSize;
+
+                    // EAC channels are decoded to red and green, RGBA alpha goes to the BC4 block of BC3 data
+                    if( type == Eac_R11 || type == Eac_RG11 || type == Etc2_RGBA )
+                    {
+                        const int channels = type == Etc2_RGBA ? 1 : blockSize;
+                        for( int c=0; c<channels; c++ )
+                        {
+                            const int shift = type == Etc2_RGBA ? 24 : c * 8;
+                            for( int i=0; i<16; i++ )
+                            {
+                                values[i] = buf[i] >> shift;
+                            }
+                            dst[block + c] = ProcessBC4( values );
+                        }
+                        if( type != Etc2_RGBA ) continue;
+                    }
+
+                    // Punch-through blocks have no ETC1 palette to transcode
+                    if( type != Etc2_RGBA1 )
+                    {
+                        for( int i=0; i<16; i++ )
+                        {
+                            buf[i] |= 0xFF000000;
+                        }
+                        dst[block + blockSize - 1] = TranscodeBC1( src[block + blockSize - 1], (const uint8*)buf, refine );
+                    }
+                    else
+                    {
+                        dst[block] = ProcessBC1( (const uint8*)buf );
+                    }
+                }
+            }
+        }, group );
+    }
+    TaskDispatch::Wait( group );
+
+    munmap( data, len );
+    fclose( file );
+}
+
 // Block type:
 //  red - 2x4, green - 4x2, blue - planar
 //  dark - 444, bright - 555 + 333
+//  yellow - T, magenta - H
 void BlockData::Dissect()
 {
+    // EAC and ASTC data have no ETC block types
+    if( m_type == Eac_R11 || m_type == Eac_RG11 || AstcFootprint( m_type ) != 0 ) return;
+
     auto size = m_size / 4;
     const uint64* data = (const uint64*)( m_etc1.data + m_etc1.offset );
 
@@ -807,12 +2202,20 @@ void BlockData::Dissect()
     {
         for( int x=0; x<size.x; x++ )
         {
+            if( m_type == Etc2_RGBA )
+            {
+                src++;
+            }
             uint64 d = *src++;
 
             d = ( ( d & 0xFF000000FF000000 ) >> 24 ) |
                 ( ( d & 0x000000FF000000FF ) << 24 ) |
                 ( ( d & 0x00FF000000FF0000 ) >> 8 ) |
                 ( ( d & 0x0000FF000000FF00 ) << 8 );
+            if( m_type == Etc2_RGBA1 )
+            {
+                d |= 0x2;
+            }
 
             BlockColor c;
             const auto mode = DecodeBlockColor( d, c );
@@ -839,6 +2242,12 @@ void BlockData::Dissect()
                     break;
                 }
                 break;
+            case Etc2Mode::t:
+                *dst++ = 0xFF00FFFF;
+                break;
+            case Etc2Mode::h:
+                *dst++ = 0xFFFF00FF;
+                break;
             case Etc2Mode::planar:
                 *dst++ = 0xFFFF0000;
                 break;
@@ -1,6 +1,7 @@
 #ifndef __BLOCKDATA_HPP__
 #define __BLOCKDATA_HPP__
 
+#include <atomic>
 #include <condition_variable>
 #include <future>
 #include <memory>
@@ -12,18 +13,69 @@
 #include "Types.hpp"
 #include "Vector.hpp"
 
+class BlockCache;
+
+// Trade-off between encoding speed and quality. Levels above normal only change ETC1 encoding.
+enum class Effort
+{
+    Fast,       // Guesses the subdivision and searches half of the tables, ETC2 RGB data is encoded as ETC1
+    Normal,
+    Best        // Searches all subdivisions and modifiers for the least error, per block
+};
+
+// Encoders of the DDS (BC1) output
+enum class DdsMode
+{
+    Native,             // Encoded from the source pixels
+    Squish,             // Encoded from the source pixels with squish, slower and of higher quality
+    Transcode,          // Converted from the ETC blocks, of about their quality
+    TranscodeRefine,    // Converted from the ETC blocks, then fitted once to the source pixels
+    Bc7                 // Encoded from the source pixels as BC7 instead, EAC data is still written as BC4 or BC5
+};
+
 class BlockData
 {
 public:
+    enum Type
+    {
+        Etc1,
+        Etc2_RGB,
+        Etc2_RGBA,
+        Etc2_RGBA1,
+        Eac_R11,
+        Eac_RG11,
+        Astc_4x4,
+        Astc_6x6
+    };
+
     BlockData( const char* fn );
-    BlockData( const char* fn, const v2i& size, bool mipmap, bool atlas, bool etc_pkm, bool dds );
-    BlockData( const v2i& size, bool mipmap );
+    BlockData( const char* fn, const v2i& size, bool mipmap, bool atlas, bool etc_pkm, bool dds, DdsMode ddsMode, Type type );
+    BlockData( const v2i& size, bool mipmap, Type type );
     ~BlockData();
 
     BitmapPtr Decode();
     void Dissect();
+    // Writes the first level of a loaded file to a DDS file, with ETC1 blocks transcoded to BC1. Decoded is the output of
+    // Decode, the other blocks are encoded from it, and refine fits the transcoded ones to it. RGBA data is written as
+    // BC3, EAC R11 and RG11 data as BC4 and BC5.
+    void TranscodeDds( const char* fn, const Bitmap& decoded, bool refine );
+
+    void Process( const uint32* src, uint32 blocks, size_t offset, size_t width, Channels type, bool dither, bool tiled, Effort effort );
+    // Encodes the source channels at the given bit offsets in the pixels, the second one only for RG11 data
+    void ProcessEac( const uint32* src, uint32 blocks, size_t offset, size_t width, int channel0, int channel1, bool tiled );
+    // Encodes lines of 4 pixels to ASTC blocks of the footprint of the type, offset counts the blocks before them. The
+    // blocks at the right and bottom edges repeat the last pixels. Without alpha, the pixels are encoded as opaque.
+    void ProcessAstc( const uint32* src, uint32 lines, size_t offset, size_t width, bool alpha, bool tiled, Effort effort );
+
+    // Number of RGBA1 blocks with alpha other than 0 and 255, which was rounded to opaque or transparent
+    uint32 RoundedAlphaBlocks() const { return m_roundedAlpha; }
+    // Number of gray RGB blocks, which were encoded from a single channel
+    uint32 GrayBlocks() const { return m_grayBlocks; }
 
-    void Process( const uint32* src, uint32 blocks, size_t offset, size_t width, Channels type, bool dither, bool etc2 );
+    // Reuses the data of blocks with the same source pixels in later calls of Process, across all parts
+    void EnableCache();
+    // Number of blocks which were copied from the cache instead of encoded
+    uint32 CachedBlocks() const { return m_cachedBlocks; }
 
 private:
 	struct DataFile {
@@ -39,6 +91,14 @@ private:
 
     v2i m_size;
     size_t m_maplen;
+    Type m_type;
+    DdsMode m_ddsMode;
+    // Levels are preceded by their size, as in KTX files
+    bool m_levelSizes;
+    std::atomic<uint32> m_roundedAlpha;
+    std::atomic<uint32> m_grayBlocks;
+    std::atomic<uint32> m_cachedBlocks;
+    std::unique_ptr<BlockCache> m_cache;
 };
 
 typedef std::shared_ptr<BlockData> BlockDataPtr;
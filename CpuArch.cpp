@@ -13,6 +13,13 @@ int check_4th_gen_intel_core_features()
     return _may_i_use_cpu_feature( the_4th_gen_features );
 }
 
+int check_avx512bw_features()
+{
+    const int the_avx512bw_features =
+        (_FEATURE_AVX512F | _FEATURE_AVX512BW | _FEATURE_AVX512VL);
+    return _may_i_use_cpu_feature( the_avx512bw_features );
+}
+
 #else /* non-Intel compiler */
 
 #include <stdint.h>
@@ -48,6 +55,17 @@ int check_xcr0_ymm()
     return ((xcr0 & 6) == 6); /* checking if xmm and ymm state are enabled in XCR0 */
 }
 
+int check_xcr0_zmm()
+{
+    uint32_t xcr0;
+#if defined(_MSC_VER)
+    xcr0 = (uint32_t)_xgetbv(0);
+#else
+    __asm__ ("xgetbv" : "=a" (xcr0) : "c" (0) : "%edx" );
+#endif
+    return ((xcr0 & 0xE6) == 0xE6); /* checking if xmm, ymm, opmask and zmm state are enabled in XCR0 */
+}
+
 
 int check_4th_gen_intel_core_features()
 {
@@ -80,6 +98,24 @@ int check_4th_gen_intel_core_features()
     return 1;
 }
 
+int check_avx512bw_features()
+{
+    uint32_t abcd[4];
+    uint32_t avx512_f_bw_vl_mask = (1 << 16) | (1 << 30) | (1u << 31);
+
+    if ( ! check_xcr0_zmm() )
+        return 0;
+
+    /*  CPUID.(EAX=07H, ECX=0H):EBX.AVX512F[bit 16]==1  &&
+    CPUID.(EAX=07H, ECX=0H):EBX.AVX512BW[bit 30]==1 &&
+    CPUID.(EAX=07H, ECX=0H):EBX.AVX512VL[bit 31]==1 */
+    run_cpuid( 7, 0, abcd );
+    if ( (abcd[1] & avx512_f_bw_vl_mask) != avx512_f_bw_vl_mask )
+        return 0;
+
+    return 1;
+}
+
 #endif /* non-Intel compiler */
 
 
@@ -93,6 +129,16 @@ bool can_use_intel_core_4th_gen_features()
     return the_4th_gen_features_available == 1;
 }
 
+bool can_use_intel_avx512bw_features()
+{
+    static int the_avx512bw_features_available = -1;
+    /* test is performed once, AVX-512 code paths also rely on the 4th gen features */
+    if (the_avx512bw_features_available < 0 )
+        the_avx512bw_features_available = can_use_intel_core_4th_gen_features() && check_avx512bw_features();
+
+    return the_avx512bw_features_available == 1;
+}
+
 #else
 
 bool can_use_intel_core_4th_gen_features()
@@ -100,4 +146,9 @@ bool can_use_intel_core_4th_gen_features()
     return false;
 }
 
+bool can_use_intel_avx512bw_features()
+{
+    return false;
+}
+
 #endif
@@ -2,5 +2,6 @@
 #define __CPUARCH_HPP__
 
 bool can_use_intel_core_4th_gen_features();
+bool can_use_intel_avx512bw_features();
 
 #endif
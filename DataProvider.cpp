@@ -5,18 +5,45 @@
 #include "DataProvider.hpp"
 #include "MipMap.hpp"
 
-DataProvider::DataProvider( const char* fn, bool mipmap )
+DataProvider::DataProvider( const char* fn, bool mipmap, int footprint )
     : m_offset( 0 )
     , m_mipmap( mipmap )
     , m_done( false )
     , m_lines( 32 )
+    , m_level( 0 )
+    , m_row( 0 )
+    , m_levelOffset( 0 )
+    , m_footprint( footprint )
 {
-    m_bmp.emplace_back( new Bitmap( fn, m_lines ) );
+    // Parts end on a row of ASTC blocks, 30 lines of 4 pixels hold 20 rows of 6x6 blocks
+    while( m_footprint != 0 && m_lines * 4 % m_footprint != 0 )
+    {
+        m_lines--;
+    }
+
+    m_bmp.emplace_back( new Bitmap( fn, m_lines, true ) );
+
+    if( m_mipmap )
+    {
+        // The whole chain is set up front, so that lower levels are filtered while upper levels load
+        uint lines = m_lines;
+        while( m_bmp.back()->Size().x != 1 || m_bmp.back()->Size().y != 1 )
+        {
+            lines *= 2;
+            m_bmp.emplace_back( new BitmapDownsampled( *m_bmp.back(), lines, m_footprint != 0 ) );
+        }
+    }
+
     m_current = m_bmp[0].get();
 }
 
 DataProvider::~DataProvider()
 {
+    // Lower levels read from the upper ones until they are done
+    while( !m_bmp.empty() )
+    {
+        m_bmp.pop_back();
+    }
 }
 
 uint DataProvider::NumberOfParts() const
@@ -34,7 +61,9 @@ uint DataProvider::NumberOfParts() const
             current.x = std::max( 1, current.x / 2 );
             current.y = std::max( 1, current.y / 2 );
             lines *= 2;
-            parts += ( ( std::max( 4, current.y ) / 4 ) + lines - 1 ) / lines;
+            // ASTC levels are padded to whole blocks, ETC levels are cut
+            const int rows = m_footprint != 0 ? ( current.y + 3 ) / 4 : std::max( 4, current.y ) / 4;
+            parts += ( rows + lines - 1 ) / lines;
         }
         assert( current.x == 1 && current.y == 1 );
     }
@@ -42,6 +71,25 @@ uint DataProvider::NumberOfParts() const
     return parts;
 }
 
+uint32 DataProvider::NumberOfBlocks() const
+{
+    v2i current = m_bmp[0]->Size();
+    uint32 blocks = LevelBlocks( current, m_footprint );
+
+    if( m_mipmap )
+    {
+        int levels = NumberOfMipLevels( current );
+        for( int i=1; i<levels; i++ )
+        {
+            current.x = std::max( 1, current.x / 2 );
+            current.y = std::max( 1, current.y / 2 );
+            blocks += LevelBlocks( current, m_footprint );
+        }
+    }
+
+    return blocks;
+}
+
 DataPart DataProvider::NextPart()
 {
     assert( !m_done );
@@ -51,20 +99,31 @@ DataPart DataProvider::NextPart()
 
     DataPart ret = {
         m_current->NextBlock( lines, done ),
-        std::max<uint>( 4, m_current->Size().x ),
+        uint( m_current->Stride() ),
         lines,
-        m_offset
+        m_offset,
+        m_current->Tiled()
     };
 
-    m_offset += m_current->Size().x / 4 * lines;
+    m_row += lines;
+    if( m_footprint == 0 )
+    {
+        m_offset += m_current->Size().x / 4 * lines;
+    }
+    else
+    {
+        // Parts start on a row of ASTC blocks, the last one of a level holds the rows that overlap its bottom edge
+        const v2i& size = m_current->Size();
+        m_offset = m_levelOffset + LevelBlocks( v2i( size.x, std::min<int>( size.y, m_row * 4 ) ), m_footprint );
+    }
 
     if( done )
     {
-        if( m_mipmap && ( m_current->Size().x != 1 || m_current->Size().y != 1 ) )
+        m_levelOffset = m_offset;
+        m_row = 0;
+        if( m_level + 1 < m_bmp.size() )
         {
-            m_lines *= 2;
-            m_bmp.emplace_back( new BitmapDownsampled( *m_current, m_lines ) );
-            m_current = m_bmp[m_bmp.size()-1].get();
+            m_current = m_bmp[++m_level].get();
         }
         else
         {
@@ -13,15 +13,19 @@ struct DataPart
     uint width;
     uint lines;
     uint offset;
+    bool tiled;
 };
 
 class DataProvider
 {
 public:
-    DataProvider( const char* fn, bool mipmap );
+    // Parts of ASTC data hold whole rows of blocks of the given footprint, 0 for ETC and EAC data in 4x4 blocks
+    DataProvider( const char* fn, bool mipmap, int footprint );
     ~DataProvider();
 
     uint NumberOfParts() const;
+    // Blocks in all parts
+    uint32 NumberOfBlocks() const;
 
     DataPart NextPart();
 
@@ -34,6 +38,10 @@ private:
     Bitmap* m_current;
     uint m_offset;
     uint m_lines;
+    uint m_level;
+    uint m_row;                 // Rows of 4x4 blocks of the level in the parts so far
+    uint m_levelOffset;         // Blocks before the level
+    int m_footprint;
     bool m_mipmap;
     bool m_done;
 };
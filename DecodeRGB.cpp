@@ -0,0 +1,113 @@
+#ifdef __SSE4_1__
+
+#include "DecodeRGB.hpp"
+#include "Tables.hpp"
+#ifdef _MSC_VER
+#  include <intrin.h>
+#else
+#  include <x86intrin.h>
+#endif
+
+namespace
+{
+
+// Selector bit masks of the pixels in row-major order. The selector bit of pixel (x, y) is bit x * 4 + y of the
+// 16-bit selector half, i.e. bit ( x & 1 ) * 4 + y of its byte x >> 1.
+static const uint8 s_selByte[16] = { 0, 0, 1, 1, 0, 0, 1, 1, 0, 0, 1, 1, 0, 0, 1, 1 };
+static const uint8 s_selBit[16] = { 0x01, 0x10, 0x01, 0x10, 0x02, 0x20, 0x02, 0x20, 0x04, 0x40, 0x04, 0x40, 0x08, 0x80, 0x08, 0x80 };
+
+// Subblock of the pixels in row-major order, times two.
+static const uint8 s_subFlip[16] = { 0, 0, 0, 0, 0, 0, 0, 0, 2, 2, 2, 2, 2, 2, 2, 2 };
+static const uint8 s_subNoFlip[16] = { 0, 0, 2, 2, 0, 0, 2, 2, 0, 0, 2, 2, 0, 0, 2, 2 };
+
+// Spreads the four per-pixel bytes of a row to the color channels of the pixels.
+static const uint8 s_expand[4][16] = {
+    {  0,  0,  0, 0x80,  1,  1,  1, 0x80,  2,  2,  2, 0x80,  3,  3,  3, 0x80 },
+    {  4,  4,  4, 0x80,  5,  5,  5, 0x80,  6,  6,  6, 0x80,  7,  7,  7, 0x80 },
+    {  8,  8,  8, 0x80,  9,  9,  9, 0x80, 10, 10, 10, 0x80, 11, 11, 11, 0x80 },
+    { 12, 12, 12, 0x80, 13, 13, 13, 0x80, 14, 14, 14, 0x80, 15, 15, 15, 0x80 }
+};
+
+inline int32 Expand6( uint32 value )
+{
+    return ( value << 2 ) | ( value >> 4 );
+}
+
+inline int32 Expand7( uint32 value )
+{
+    return ( value << 1 ) | ( value >> 6 );
+}
+
+}
+
+void DecodeRGB_SSE41( uint64 d, uint32 c1, uint32 c2, uint32* dst, size_t pitch )
+{
+    const uint tcw0 = ( d & 0xE0 ) >> 5;
+    const uint tcw1 = ( d & 0x1C ) >> 2;
+
+    // Both selector halves, lsb in bytes 0-1, msb in bytes 2-3
+    const __m128i sel = _mm_set1_epi32( uint32( d >> 32 ) );
+    const __m128i bit = _mm_loadu_si128( (const __m128i*)s_selBit );
+    const __m128i byte = _mm_loadu_si128( (const __m128i*)s_selByte );
+
+    const __m128i lsb = _mm_cmpeq_epi8( _mm_and_si128( _mm_shuffle_epi8( sel, byte ), bit ), bit );
+    const __m128i msb = _mm_cmpeq_epi8( _mm_and_si128( _mm_shuffle_epi8( sel, _mm_add_epi8( byte, _mm_set1_epi8( 2 ) ) ), bit ), bit );
+
+    // Table magnitudes of both subblocks; the msb selects the sign
+    const __m128i table = _mm_cvtsi32_si128( g_table[tcw0][0] | ( g_table[tcw0][1] << 8 ) | ( g_table[tcw1][0] << 16 ) | ( g_table[tcw1][1] << 24 ) );
+    const __m128i sub = _mm_loadu_si128( (const __m128i*)( ( d & 0x1 ) ? s_subFlip : s_subNoFlip ) );
+    const __m128i mag = _mm_shuffle_epi8( table, _mm_or_si128( sub, _mm_and_si128( lsb, _mm_set1_epi8( 1 ) ) ) );
+
+    __m128i base[4];
+    if( d & 0x1 )
+    {
+        base[0] = base[1] = _mm_set1_epi32( c1 );
+        base[2] = base[3] = _mm_set1_epi32( c2 );
+    }
+    else
+    {
+        base[0] = base[1] = base[2] = base[3] = _mm_set_epi32( c2, c2, c1, c1 );
+    }
+
+    for( int y=0; y<4; y++ )
+    {
+        const __m128i expand = _mm_loadu_si128( (const __m128i*)s_expand[y] );
+        const __m128i m = _mm_shuffle_epi8( mag, expand );
+        const __m128i neg = _mm_shuffle_epi8( msb, expand );
+        const __m128i px = _mm_blendv_epi8( _mm_adds_epu8( base[y], m ), _mm_subs_epu8( base[y], m ), neg );
+        _mm_storeu_si128( (__m128i*)( dst + y * pitch ), px );
+    }
+}
+
+void DecodePlanar_SSE41( uint64 d, uint32* dst, size_t pitch )
+{
+    const int32 bv = Expand6( ( d >> ( 0 + 32 ) ) & 0x3F );
+    const int32 gv = Expand7( ( d >> ( 6 + 32 ) ) & 0x7F );
+    const int32 rv = Expand6( ( d >> ( 13 + 32 ) ) & 0x3F );
+
+    const int32 bh = Expand6( ( d >> ( 19 + 32 ) ) & 0x3F );
+    const int32 gh = Expand7( ( d >> ( 25 + 32 ) ) & 0x7F );
+    const int32 rh = Expand6( ( ( d >> ( 32 - 32 ) ) & 0x01 ) | ( ( ( d >> ( 34 - 32 ) ) & 0x1F ) << 1 ) );
+
+    const int32 bo = Expand6( ( ( d >> ( 39 - 32 ) ) & 0x07 ) | ( ( ( d >> ( 43 - 32 ) ) & 0x3 ) << 3 ) | ( ( ( d >> ( 48 - 32 ) ) & 0x1 ) << 5 ) );
+    const int32 go = Expand7( ( ( d >> ( 49 - 32 ) ) & 0x3F ) | ( ( ( d >> ( 56 - 32 ) ) & 0x01 ) << 6 ) );
+    const int32 ro = Expand6( ( d >> ( 57 - 32 ) ) & 0x3F );
+
+    // 16-bit channels of two pixels: ( 4 * o + 2 + x * ( h - o ) + y * ( v - o ) ) >> 2
+    const __m128i dh = _mm_setr_epi16( rh - ro, gh - go, bh - bo, 0, rh - ro, gh - go, bh - bo, 0 );
+    const __m128i dv = _mm_setr_epi16( rv - ro, gv - go, bv - bo, 0, rv - ro, gv - go, bv - bo, 0 );
+    __m128i row = _mm_setr_epi16( 4 * ro + 2, 4 * go + 2, 4 * bo + 2, 0, 4 * ro + 2, 4 * go + 2, 4 * bo + 2, 0 );
+    const __m128i x01 = _mm_mullo_epi16( dh, _mm_setr_epi16( 0, 0, 0, 0, 1, 1, 1, 1 ) );
+    const __m128i x23 = _mm_mullo_epi16( dh, _mm_setr_epi16( 2, 2, 2, 2, 3, 3, 3, 3 ) );
+    const __m128i alpha = _mm_set1_epi32( 0xFF000000 );
+
+    for( int y=0; y<4; y++ )
+    {
+        const __m128i p01 = _mm_srai_epi16( _mm_add_epi16( row, x01 ), 2 );
+        const __m128i p23 = _mm_srai_epi16( _mm_add_epi16( row, x23 ), 2 );
+        _mm_storeu_si128( (__m128i*)( dst + y * pitch ), _mm_or_si128( _mm_packus_epi16( p01, p23 ), alpha ) );
+        row = _mm_add_epi16( row, dv );
+    }
+}
+
+#endif
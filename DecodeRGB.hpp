@@ -0,0 +1,17 @@
+#ifndef __DECODERGB_HPP__
+#define __DECODERGB_HPP__
+
+#ifdef __SSE4_1__
+
+#include <stddef.h>
+
+#include "Types.hpp"
+
+// Blocks are passed with the byte order already swapped, as done by BlockData::Decode(). Block colors are packed
+// as 0xFFBBGGRR, pitch is the width of the destination in pixels.
+void DecodeRGB_SSE41( uint64 d, uint32 c1, uint32 c2, uint32* dst, size_t pitch );
+void DecodePlanar_SSE41( uint64 d, uint32* dst, size_t pitch );
+
+#endif
+
+#endif
@@ -0,0 +1,127 @@
+#ifdef __SSE4_1__
+
+#include "DecodeRGB_AVX2.hpp"
+#include "Tables.hpp"
+#ifdef _MSC_VER
+#  include <intrin.h>
+#  define VS_VECTORCALL _vectorcall
+#else
+#  include <x86intrin.h>
+#  pragma GCC push_options
+#  pragma GCC target ("avx2")
+#  define VS_VECTORCALL
+#endif
+
+namespace
+{
+
+// See DecodeRGB.cpp. Each 128-bit lane handles one row of pixels.
+static const uint8 s_selByte[16] = { 0, 0, 1, 1, 0, 0, 1, 1, 0, 0, 1, 1, 0, 0, 1, 1 };
+static const uint8 s_selBit[16] = { 0x01, 0x10, 0x01, 0x10, 0x02, 0x20, 0x02, 0x20, 0x04, 0x40, 0x04, 0x40, 0x08, 0x80, 0x08, 0x80 };
+
+static const uint8 s_subFlip[16] = { 0, 0, 0, 0, 0, 0, 0, 0, 2, 2, 2, 2, 2, 2, 2, 2 };
+static const uint8 s_subNoFlip[16] = { 0, 0, 2, 2, 0, 0, 2, 2, 0, 0, 2, 2, 0, 0, 2, 2 };
+
+// Rows 0-1 and 2-3
+static const uint8 s_expand[2][32] = {
+    {  0,  0,  0, 0x80,  1,  1,  1, 0x80,  2,  2,  2, 0x80,  3,  3,  3, 0x80,
+       4,  4,  4, 0x80,  5,  5,  5, 0x80,  6,  6,  6, 0x80,  7,  7,  7, 0x80 },
+    {  8,  8,  8, 0x80,  9,  9,  9, 0x80, 10, 10, 10, 0x80, 11, 11, 11, 0x80,
+      12, 12, 12, 0x80, 13, 13, 13, 0x80, 14, 14, 14, 0x80, 15, 15, 15, 0x80 }
+};
+
+inline int32 Expand6( uint32 value )
+{
+    return ( value << 2 ) | ( value >> 4 );
+}
+
+inline int32 Expand7( uint32 value )
+{
+    return ( value << 1 ) | ( value >> 6 );
+}
+
+static inline void VS_VECTORCALL StoreRows( __m256i px, uint32* dst, size_t pitch )
+{
+    _mm_storeu_si128( (__m128i*)dst, _mm256_castsi256_si128( px ) );
+    _mm_storeu_si128( (__m128i*)( dst + pitch ), _mm256_extracti128_si256( px, 1 ) );
+}
+
+}
+
+void DecodeRGB_AVX2( uint64 d, uint32 c1, uint32 c2, uint32* dst, size_t pitch )
+{
+    const uint tcw0 = ( d & 0xE0 ) >> 5;
+    const uint tcw1 = ( d & 0x1C ) >> 2;
+
+    const __m128i sel = _mm_set1_epi32( uint32( d >> 32 ) );
+    const __m128i bit = _mm_loadu_si128( (const __m128i*)s_selBit );
+    const __m128i byte = _mm_loadu_si128( (const __m128i*)s_selByte );
+
+    const __m128i lsb = _mm_cmpeq_epi8( _mm_and_si128( _mm_shuffle_epi8( sel, byte ), bit ), bit );
+    const __m128i msb = _mm_cmpeq_epi8( _mm_and_si128( _mm_shuffle_epi8( sel, _mm_add_epi8( byte, _mm_set1_epi8( 2 ) ) ), bit ), bit );
+
+    const __m128i table = _mm_cvtsi32_si128( g_table[tcw0][0] | ( g_table[tcw0][1] << 8 ) | ( g_table[tcw1][0] << 16 ) | ( g_table[tcw1][1] << 24 ) );
+    const __m128i sub = _mm_loadu_si128( (const __m128i*)( ( d & 0x1 ) ? s_subFlip : s_subNoFlip ) );
+    const __m256i mag = _mm256_broadcastsi128_si256( _mm_shuffle_epi8( table, _mm_or_si128( sub, _mm_and_si128( lsb, _mm_set1_epi8( 1 ) ) ) ) );
+    const __m256i neg = _mm256_broadcastsi128_si256( msb );
+
+    __m256i base[2];
+    if( d & 0x1 )
+    {
+        base[0] = _mm256_set1_epi32( c1 );
+        base[1] = _mm256_set1_epi32( c2 );
+    }
+    else
+    {
+        base[0] = base[1] = _mm256_set_epi32( c2, c2, c1, c1, c2, c2, c1, c1 );
+    }
+
+    for( int i=0; i<2; i++ )
+    {
+        const __m256i expand = _mm256_loadu_si256( (const __m256i*)s_expand[i] );
+        const __m256i m = _mm256_shuffle_epi8( mag, expand );
+        const __m256i n = _mm256_shuffle_epi8( neg, expand );
+        const __m256i px = _mm256_blendv_epi8( _mm256_adds_epu8( base[i], m ), _mm256_subs_epu8( base[i], m ), n );
+        StoreRows( px, dst + i * 2 * pitch, pitch );
+    }
+}
+
+void DecodePlanar_AVX2( uint64 d, uint32* dst, size_t pitch )
+{
+    const int32 bv = Expand6( ( d >> ( 0 + 32 ) ) & 0x3F );
+    const int32 gv = Expand7( ( d >> ( 6 + 32 ) ) & 0x7F );
+    const int32 rv = Expand6( ( d >> ( 13 + 32 ) ) & 0x3F );
+
+    const int32 bh = Expand6( ( d >> ( 19 + 32 ) ) & 0x3F );
+    const int32 gh = Expand7( ( d >> ( 25 + 32 ) ) & 0x7F );
+    const int32 rh = Expand6( ( ( d >> ( 32 - 32 ) ) & 0x01 ) | ( ( ( d >> ( 34 - 32 ) ) & 0x1F ) << 1 ) );
+
+    const int32 bo = Expand6( ( ( d >> ( 39 - 32 ) ) & 0x07 ) | ( ( ( d >> ( 43 - 32 ) ) & 0x3 ) << 3 ) | ( ( ( d >> ( 48 - 32 ) ) & 0x1 ) << 5 ) );
+    const int32 go = Expand7( ( ( d >> ( 49 - 32 ) ) & 0x3F ) | ( ( ( d >> ( 56 - 32 ) ) & 0x01 ) << 6 ) );
+    const int32 ro = Expand6( ( d >> ( 57 - 32 ) ) & 0x3F );
+
+    // Lane 0 holds row y, lane 1 row y + 1
+    const __m256i dh = _mm256_setr_epi16( rh - ro, gh - go, bh - bo, 0, rh - ro, gh - go, bh - bo, 0, rh - ro, gh - go, bh - bo, 0, rh - ro, gh - go, bh - bo, 0 );
+    const __m256i dv = _mm256_setr_epi16( rv - ro, gv - go, bv - bo, 0, rv - ro, gv - go, bv - bo, 0, rv - ro, gv - go, bv - bo, 0, rv - ro, gv - go, bv - bo, 0 );
+    const __m256i o = _mm256_setr_epi16( 4 * ro + 2, 4 * go + 2, 4 * bo + 2, 0, 4 * ro + 2, 4 * go + 2, 4 * bo + 2, 0, 4 * ro + 2, 4 * go + 2, 4 * bo + 2, 0, 4 * ro + 2, 4 * go + 2, 4 * bo + 2, 0 );
+    const __m256i x01 = _mm256_mullo_epi16( dh, _mm256_setr_epi16( 0, 0, 0, 0, 1, 1, 1, 1, 0, 0, 0, 0, 1, 1, 1, 1 ) );
+    const __m256i x23 = _mm256_mullo_epi16( dh, _mm256_setr_epi16( 2, 2, 2, 2, 3, 3, 3, 3, 2, 2, 2, 2, 3, 3, 3, 3 ) );
+    const __m256i alpha = _mm256_set1_epi32( 0xFF000000 );
+
+    __m256i row = _mm256_add_epi16( o, _mm256_mullo_epi16( dv, _mm256_setr_epi16( 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 1, 1, 1, 1 ) ) );
+    const __m256i dv2 = _mm256_add_epi16( dv, dv );
+
+    for( int i=0; i<2; i++ )
+    {
+        const __m256i p01 = _mm256_srai_epi16( _mm256_add_epi16( row, x01 ), 2 );
+        const __m256i p23 = _mm256_srai_epi16( _mm256_add_epi16( row, x23 ), 2 );
+        StoreRows( _mm256_or_si256( _mm256_packus_epi16( p01, p23 ), alpha ), dst + i * 2 * pitch, pitch );
+        row = _mm256_add_epi16( row, dv2 );
+    }
+}
+
+#ifndef _MSC_VER
+#  pragma GCC pop_options
+#endif
+
+#endif
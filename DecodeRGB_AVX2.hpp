@@ -0,0 +1,15 @@
+#ifndef __DECODERGB_AVX2_HPP__
+#define __DECODERGB_AVX2_HPP__
+
+#ifdef __SSE4_1__
+
+#include <stddef.h>
+
+#include "Types.hpp"
+
+void DecodeRGB_AVX2( uint64 d, uint32 c1, uint32 c2, uint32* dst, size_t pitch );
+void DecodePlanar_AVX2( uint64 d, uint32* dst, size_t pitch );
+
+#endif
+
+#endif
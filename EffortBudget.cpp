@@ -0,0 +1,85 @@
+#include <algorithm>
+
+#include "EffortBudget.hpp"
+#include "Timing.hpp"
+
+// Cost of each level relative to the normal one, until it is measured
+static const float RelativeCost[] = { 0.6f, 1.f, 50.f };
+
+EffortBudget::EffortBudget( uint64 budget, uint32 blocks, int workers, Effort top )
+    : m_start( GetTime() )
+    , m_budget( budget )
+    , m_remaining( blocks )
+    , m_workers( workers )
+    , m_top( (int)top )
+    , m_time()
+    , m_measured()
+    , m_pending()
+    , m_blocks()
+{
+}
+
+float EffortBudget::Cost( int level ) const
+{
+    if( m_measured[level] != 0 )
+    {
+        return float( m_time[level] ) / m_measured[level];
+    }
+    for( int i=0; i<Levels; i++ )
+    {
+        if( m_measured[i] != 0 )
+        {
+            return float( m_time[i] ) / m_measured[i] * RelativeCost[level] / RelativeCost[i];
+        }
+    }
+    return 0;
+}
+
+Effort EffortBudget::Pick( uint32 blocks )
+{
+    std::lock_guard<std::mutex> lock( m_lock );
+
+    m_remaining -= std::min( blocks, m_remaining );
+
+    int level = (int)Effort::Normal;
+    if( m_measured[0] + m_measured[1] + m_measured[2] != 0 )
+    {
+        // Worker time left, less the time of the parts being encoded
+        const uint64 now = GetTime() - m_start;
+        float available = float( m_budget > now ? m_budget - now : 0 ) * m_workers;
+        for( int i=0; i<Levels; i++ )
+        {
+            available -= m_pending[i] * Cost( i );
+        }
+
+        const float rest = m_remaining * Cost( (int)Effort::Fast );
+        level = m_top;
+        while( level > (int)Effort::Fast && blocks * Cost( level ) + rest > available )
+        {
+            level--;
+        }
+    }
+    else if( m_top < level )
+    {
+        level = m_top;
+    }
+
+    m_pending[level] += blocks;
+    m_blocks[level] += blocks;
+    return (Effort)level;
+}
+
+void EffortBudget::Done( Effort effort, uint32 blocks, uint64 time )
+{
+    std::lock_guard<std::mutex> lock( m_lock );
+
+    const int level = (int)effort;
+    m_pending[level] -= blocks;
+    m_measured[level] += blocks;
+    m_time[level] += time;
+}
+
+uint64 EffortBudget::Elapsed() const
+{
+    return GetTime() - m_start;
+}
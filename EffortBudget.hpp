@@ -0,0 +1,45 @@
+#ifndef __DARKRL__EFFORTBUDGET_HPP__
+#define __DARKRL__EFFORTBUDGET_HPP__
+
+#include <mutex>
+
+#include "BlockData.hpp"
+#include "Types.hpp"
+
+// Picks the encoding effort of each part of an image, so that the whole image is encoded within a time budget. The
+// first parts are encoded at the normal level to measure the throughput. Each later part gets the highest level which
+// still leaves enough time to encode the remaining blocks at the fast level. Costs of levels which were not used yet
+// are estimated from the measured ones.
+class EffortBudget
+{
+public:
+    // Budget in microseconds, from construction. Top is the highest level to pick.
+    EffortBudget( uint64 budget, uint32 blocks, int workers, Effort top );
+
+    Effort Pick( uint32 blocks );
+    // Reports the encoding time of a part, in microseconds
+    void Done( Effort effort, uint32 blocks, uint64 time );
+
+    uint32 Blocks( Effort effort ) const { return m_blocks[(int)effort]; }
+    uint64 Elapsed() const;
+
+private:
+    enum { Levels = 3 };
+
+    // Microseconds per block of one worker
+    float Cost( int level ) const;
+
+    std::mutex m_lock;
+    uint64 m_start;
+    uint64 m_budget;
+    uint32 m_remaining;             // Blocks not picked yet
+    int m_workers;
+    int m_top;
+
+    uint64 m_time[Levels];
+    uint32 m_measured[Levels];      // Blocks with known encoding time
+    uint32 m_pending[Levels];       // Blocks being encoded
+    uint32 m_blocks[Levels];
+};
+
+#endif
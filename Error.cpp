@@ -1,24 +1,60 @@
 #include "Error.hpp"
 #include "Math.hpp"
 
-float CalcMSE3( const Bitmap& bmp, const Bitmap& out )
+// Source images are loaded with blue in the low byte, decoded images have red there
+static inline void Error3( float& err, uint32 c1, uint32 c2 )
+{
+    err += sq( ( c1 & 0x000000FF ) - ( ( c2 & 0x00FF0000 ) >> 16 ) );
+    err += sq( ( ( c1 & 0x0000FF00 ) >> 8 ) - ( ( c2 & 0x0000FF00 ) >> 8 ) );
+    err += sq( ( ( c1 & 0x00FF0000 ) >> 16 ) - ( c2 & 0x000000FF ) );
+}
+
+static inline void Error1( float& err, uint32 c1, uint32 c2 )
+{
+    err += sq( ( c1 >> 24 ) - ( c2 & 0xFF ) );
+}
+
+static inline void ErrorA( float& err, uint32 c1, uint32 c2 )
+{
+    err += sq( ( c1 >> 24 ) - ( c2 >> 24 ) );
+}
+
+// Sums the error over all pixels. Bitmaps with different storage layouts are compared pixel by pixel.
+template<class ErrorFunc>
+static float CalcError( const Bitmap& bmp, const Bitmap& out, ErrorFunc error )
 {
     float err = 0;
 
     const uint32* p1 = bmp.Data();
     const uint32* p2 = out.Data();
-    size_t cnt = bmp.Size().x * bmp.Size().y;
 
-    for( size_t i=0; i<cnt; i++ )
+    if( bmp.Tiled() == out.Tiled() )
     {
-        uint32 c1 = *p1++;
-        uint32 c2 = *p2++;
-
-        err += sq( ( c1 & 0x000000FF ) - ( c2 & 0x000000FF ) );
-        err += sq( ( ( c1 & 0x0000FF00 ) >> 8 ) - ( ( c2 & 0x0000FF00 ) >> 8 ) );
-        err += sq( ( ( c1 & 0x00FF0000 ) >> 16 ) - ( ( c2 & 0x00FF0000 ) >> 16 ) );
+        size_t cnt = bmp.Size().x * bmp.Size().y;
+        for( size_t i=0; i<cnt; i++ )
+        {
+            error( err, *p1++, *p2++ );
+        }
     }
+    else
+    {
+        for( int y=0; y<bmp.Size().y; y++ )
+        {
+            for( int x=0; x<bmp.Size().x; x++ )
+            {
+                error( err, p1[bmp.Offset( x, y )], p2[out.Offset( x, y )] );
+            }
+        }
+    }
+
+    return err;
+}
 
+float CalcMSE3( const Bitmap& bmp, const Bitmap& out )
+{
+    float err = CalcError( bmp, out, Error3 );
+
+    size_t cnt = bmp.Size().x * bmp.Size().y;
     err /= cnt * 3;
 
     return err;
@@ -26,21 +62,48 @@ float CalcMSE3( const Bitmap& bmp, const Bitmap& out )
 
 float CalcMSE1( const Bitmap& bmp, const Bitmap& out )
 {
-    float err = 0;
+    float err = CalcError( bmp, out, Error1 );
 
-    const uint32* p1 = bmp.Data();
-    const uint32* p2 = out.Data();
     size_t cnt = bmp.Size().x * bmp.Size().y;
+    err /= cnt;
 
-    for( size_t i=0; i<cnt; i++ )
-    {
-        uint32 c1 = *p1++;
-        uint32 c2 = *p2++;
+    return err;
+}
 
-        err += sq( ( c1 >> 24 ) - ( c2 & 0xFF ) );
-    }
+float CalcMSEA( const Bitmap& bmp, const Bitmap& out )
+{
+    float err = CalcError( bmp, out, ErrorA );
+
+    size_t cnt = bmp.Size().x * bmp.Size().y;
+    err /= cnt;
+
+    return err;
+}
+
+float CalcMSEChannel( const Bitmap& bmp, int channel, const Bitmap& out, int outChannel )
+{
+    float err = CalcError( bmp, out, [channel, outChannel]( float& err, uint32 c1, uint32 c2 )
+    {
+        err += sq( ( ( c1 >> channel ) & 0xFF ) - ( ( c2 >> outChannel ) & 0xFF ) );
+    } );
 
+    size_t cnt = bmp.Size().x * bmp.Size().y;
     err /= cnt;
 
     return err;
 }
+
+float CalcMSE3Opaque( const Bitmap& bmp, const Bitmap& out )
+{
+    size_t cnt = 0;
+    float err = CalcError( bmp, out, [&cnt]( float& err, uint32 c1, uint32 c2 )
+    {
+        if( c1 >= 0x80000000 )
+        {
+            Error3( err, c1, c2 );
+            cnt++;
+        }
+    } );
+
+    return cnt == 0 ? 0 : err / ( cnt * 3 );
+}
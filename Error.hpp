@@ -5,5 +5,10 @@
 
 float CalcMSE3( const Bitmap& bmp, const Bitmap& out );
 float CalcMSE1( const Bitmap& bmp, const Bitmap& out );
+float CalcMSEA( const Bitmap& bmp, const Bitmap& out );
+// Color error of the source pixels with alpha of at least 128, others are transparent in punch-through textures
+float CalcMSE3Opaque( const Bitmap& bmp, const Bitmap& out );
+// Compares the channels at the given bit offsets in the pixels of both bitmaps
+float CalcMSEChannel( const Bitmap& bmp, int channel, const Bitmap& out, int outChannel );
 
 #endif
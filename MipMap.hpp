@@ -9,4 +9,15 @@ inline int NumberOfMipLevels( const v2i& size )
     return (int)floor( log2( std::max( size.x, size.y ) ) ) + 1;
 }
 
+// Blocks of a mip level. ETC blocks cover the whole 4x4 blocks of the level, a level smaller than a block takes one.
+// ASTC blocks of the given footprint cover the whole level, the last ones overlap its edges.
+inline uint32 LevelBlocks( const v2i& size, int footprint )
+{
+    if( footprint == 0 )
+    {
+        return ( std::max( 4, size.x ) / 4 ) * ( std::max( 4, size.y ) / 4 );
+    }
+    return uint32( ( size.x + footprint - 1 ) / footprint ) * ( ( size.y + footprint - 1 ) / footprint );
+}
+
 #endif
@@ -1,3 +1,7 @@
+#include <limits>
+#include <stdlib.h>
+#include <string.h>
+
 #include "Math.hpp"
 #include "ProcessAlpha.hpp"
 #include "ProcessCommon.hpp"
@@ -102,10 +106,13 @@ uint64 ProcessAlpha( const uint8* src )
     uint8 b23[2][8];
     const uint8* b[4] = { src+8, src, b23[0], b23[1] };
 
+    // Top and bottom halves, for the flipped layout
     for( int i=0; i<4; i++ )
     {
-        *(b23[1]+i*2) = *(src+i*4);
-        *(b23[0]+i*2) = *(src+i*4+3);
+        b23[1][i*2] = src[i*4];
+        b23[1][i*2+1] = src[i*4+1];
+        b23[0][i*2] = src[i*4+2];
+        b23[0][i*2+1] = src[i*4+3];
     }
 
     uint a[8];
@@ -193,3 +200,258 @@ uint64 ProcessAlpha( const uint8* src )
 
     return FixByteOrder( EncodeSelectors( d, terr, tsel, id ) );
 }
+
+// Base, multiplier and table in the first two bytes, then the 3-bit selectors in big endian order
+static uint64 EncodeEac( int base, int mul, int table, const uint8* sel )
+{
+    uint64 s = 0;
+    for( int i=0; i<16; i++ )
+    {
+        s = ( s << 3 ) | sel[i];
+    }
+    uint64 d = base | ( mul << 12 ) | ( table << 8 );
+    for( int i=0; i<6; i++ )
+    {
+        d |= ( ( s >> ( 40 - i * 8 ) ) & 0xFF ) << ( 16 + i * 8 );
+    }
+    return d;
+}
+
+// Spreads a modifier table over the range of the block and centers it. Returns the base value and the multiplier.
+static void FitAlphaTable( int table, int min, int max, int& base, int& mul )
+{
+    mul = std::min( std::max( 1, ( max - min + g_alphaRange[table] / 2 ) / g_alphaRange[table] ), 15 );
+    base = clampu8( ( min + max - mul * ( g_alpha[table][3] + g_alpha[table][7] ) + 1 ) >> 1 );
+}
+
+uint64 ProcessAlpha_ETC2( const uint8* src )
+{
+    int min = src[0];
+    int max = src[0];
+    for( int i=1; i<16; i++ )
+    {
+        min = std::min<int>( min, src[i] );
+        max = std::max<int>( max, src[i] );
+    }
+    if( min == max )
+    {
+        // Zero multiplier paints the base value
+        return src[0];
+    }
+
+    uint bestErr = std::numeric_limits<uint>::max();
+    int bestTable = 0;
+    int bestBase = 0;
+    int bestMul = 0;
+    uint8 bestSel[16];
+
+#ifdef __SSE4_1__
+    const __m128i pix = _mm_loadu_si128( (const __m128i*)src );
+    __m128i bestIdx = _mm_setzero_si128();
+#endif
+
+    for( int t=0; t<16; t++ )
+    {
+        int base, mul;
+        FitAlphaTable( t, min, max, base, mul );
+
+#ifdef __SSE4_1__
+        // All eight painted values of the table, clamped by the pack
+        const __m128i val16 = _mm_add_epi16( _mm_set1_epi16( base ), _mm_mullo_epi16( g_alpha_SIMD[t], _mm_set1_epi16( mul ) ) );
+        const __m128i val = _mm_packus_epi16( val16, val16 );
+
+        __m128i minError = _mm_set1_epi8( -1 );
+        __m128i index = _mm_setzero_si128();
+        for( int j=0; j<8; j++ )
+        {
+            const __m128i v = _mm_shuffle_epi8( val, _mm_set1_epi8( j ) );
+            const __m128i error = _mm_or_si128( _mm_subs_epu8( pix, v ), _mm_subs_epu8( v, pix ) );
+
+            const __m128i less = _mm_cmpeq_epi8( _mm_max_epu8( error, minError ), minError );
+            index = _mm_blendv_epi8( index, _mm_set1_epi8( j ), less );
+            minError = _mm_min_epu8( minError, error );
+        }
+
+        // Squaring the minimum error to produce correct values when adding
+        const __m128i errLo = _mm_unpacklo_epi8( minError, _mm_setzero_si128() );
+        const __m128i errHi = _mm_unpackhi_epi8( minError, _mm_setzero_si128() );
+        __m128i sum = _mm_add_epi32( _mm_madd_epi16( errLo, errLo ), _mm_madd_epi16( errHi, errHi ) );
+        sum = _mm_add_epi32( sum, _mm_shuffle_epi32( sum, _MM_SHUFFLE( 1, 0, 3, 2 ) ) );
+        sum = _mm_add_epi32( sum, _mm_shuffle_epi32( sum, _MM_SHUFFLE( 2, 3, 0, 1 ) ) );
+        const uint err = _mm_cvtsi128_si32( sum );
+#else
+        uint8 sel[16];
+        uint err = 0;
+        for( int i=0; i<16; i++ )
+        {
+            uint localErr = std::numeric_limits<uint>::max();
+            for( int j=0; j<8; j++ )
+            {
+                const uint local = sq( clampu8( base + g_alpha[t][j] * mul ) - src[i] );
+                if( local < localErr )
+                {
+                    localErr = local;
+                    sel[i] = j;
+                }
+            }
+            err += localErr;
+        }
+#endif
+
+        if( err < bestErr )
+        {
+            bestErr = err;
+            bestTable = t;
+            bestBase = base;
+            bestMul = mul;
+#ifdef __SSE4_1__
+            bestIdx = index;
+#else
+            memcpy( bestSel, sel, 16 );
+#endif
+            if( err == 0 ) break;
+        }
+    }
+
+#ifdef __SSE4_1__
+    _mm_storeu_si128( (__m128i*)bestSel, bestIdx );
+#endif
+
+    return EncodeEac( bestBase, bestMul, bestTable, bestSel );
+}
+
+// EAC R11 blocks paint base * 8 + 4 plus the modifier times the multiplier times 8, or times 1 for a zero multiplier,
+// clamped to 11 bits
+static void FitEac11Table( int table, int min, int max, int& base, int& mul )
+{
+    const int step = int( ( max - min ) / float( g_alphaRange[table] ) + 0.5f );
+    mul = step < 3 ? 0 : std::min( std::max( 1, ( step + 4 ) / 8 ), 15 );
+    const int scale = mul == 0 ? 1 : mul * 8;
+    base = clampu8( ( min + max - scale * ( g_alpha[table][3] + g_alpha[table][7] ) ) >> 4 );
+}
+
+// Tables that cover most blocks, most useful first. Trying the other eight gains about a quarter dB for twice the time.
+static const int g_eac11Tables[8] = { 9, 14, 13, 2, 3, 5, 4, 10 };
+
+uint64 ProcessAlpha_EAC11( const uint8* src )
+{
+    // 8-bit values scaled to the 11-bit range
+    uint16 val[16];
+    int min = 2047;
+    int max = 0;
+    for( int i=0; i<16; i++ )
+    {
+        val[i] = ( src[i] << 3 ) | ( src[i] >> 5 );
+        min = std::min<int>( min, val[i] );
+        max = std::max<int>( max, val[i] );
+    }
+    if( min == max )
+    {
+        // Modifiers of table 13 reach from -3 to 2 with a zero multiplier
+        const int base = clampu8( ( min - 1 ) >> 3 );
+        const int offset = min - ( base * 8 + 4 );
+        int sel = 0;
+        for( int j=1; j<8; j++ )
+        {
+            if( abs( g_alpha[13][j] - offset ) < abs( g_alpha[13][sel] - offset ) )
+            {
+                sel = j;
+            }
+        }
+        uint8 sels[16];
+        memset( sels, sel, 16 );
+        return EncodeEac( base, 0, 13, sels );
+    }
+
+    uint bestErr = std::numeric_limits<uint>::max();
+    int bestTable = 0;
+    int bestBase = 0;
+    int bestMul = 0;
+    uint8 bestSel[16];
+
+#ifdef __SSE4_1__
+    // Signed for the byte compares below
+    const __m128i pix = _mm_xor_si128( _mm_loadu_si128( (const __m128i*)src ), _mm_set1_epi8( -128 ) );
+    const __m128i pix0 = _mm_loadu_si128( (const __m128i*)val );
+    const __m128i pix1 = _mm_loadu_si128( ( (const __m128i*)val ) + 1 );
+    __m128i bestRank = _mm_setzero_si128();
+#endif
+
+    for( int i=0; i<8; i++ )
+    {
+        const int t = g_eac11Tables[i];
+        int base, mul;
+        FitEac11Table( t, min, max, base, mul );
+        const int scale = mul == 0 ? 1 : mul * 8;
+
+#ifdef __SSE4_1__
+        // Painted values of the table in ascending order, which is modifiers 3, 2, 1, 0, 4, 5, 6, 7
+        __m128i values = _mm_add_epi16( _mm_set1_epi16( base * 8 + 4 ), _mm_mullo_epi16( g_alpha_SIMD[t], _mm_set1_epi16( scale ) ) );
+        values = _mm_min_epi16( _mm_max_epi16( values, _mm_setzero_si128() ), _mm_set1_epi16( 2047 ) );
+        values = _mm_shuffle_epi8( values, _mm_setr_epi8( 6, 7, 4, 5, 2, 3, 0, 1, 8, 9, 10, 11, 12, 13, 14, 15 ) );
+
+        // Each pixel is nearest to the value whose rank is the number of midpoints between values below it. A scaled
+        // value is above a midpoint exactly when the 8-bit source is above the largest source that scales to at most
+        // the midpoint, so the ranks of all 16 pixels are counted at once with byte compares.
+        const __m128i mid = _mm_srli_epi16( _mm_add_epi16( values, _mm_srli_si128( values, 2 ) ), 1 );
+        const __m128i c = _mm_srli_epi16( mid, 3 );
+        const __m128i c11 = _mm_or_si128( _mm_slli_epi16( c, 3 ), _mm_srli_epi16( c, 5 ) );
+        const __m128i lim = _mm_add_epi16( c, _mm_cmpgt_epi16( c11, mid ) );
+        const __m128i lim8 = _mm_xor_si128( _mm_packus_epi16( lim, lim ), _mm_set1_epi8( -128 ) );
+        __m128i rank = _mm_setzero_si128();
+        for( int j=0; j<7; j++ )
+        {
+            rank = _mm_sub_epi8( rank, _mm_cmpgt_epi8( pix, _mm_shuffle_epi8( lim8, _mm_set1_epi8( j ) ) ) );
+        }
+        // Byte pairs of the painted value at each rank
+        const __m128i lo = _mm_add_epi8( rank, rank );
+        const __m128i hi = _mm_add_epi8( lo, _mm_set1_epi8( 1 ) );
+        const __m128i error0 = _mm_sub_epi16( pix0, _mm_shuffle_epi8( values, _mm_unpacklo_epi8( lo, hi ) ) );
+        const __m128i error1 = _mm_sub_epi16( pix1, _mm_shuffle_epi8( values, _mm_unpackhi_epi8( lo, hi ) ) );
+
+        __m128i sum = _mm_add_epi32( _mm_madd_epi16( error0, error0 ), _mm_madd_epi16( error1, error1 ) );
+        sum = _mm_add_epi32( sum, _mm_shuffle_epi32( sum, _MM_SHUFFLE( 1, 0, 3, 2 ) ) );
+        sum = _mm_add_epi32( sum, _mm_shuffle_epi32( sum, _MM_SHUFFLE( 2, 3, 0, 1 ) ) );
+        const uint err = _mm_cvtsi128_si32( sum );
+#else
+        uint8 sel[16];
+        uint err = 0;
+        for( int k=0; k<16; k++ )
+        {
+            uint localErr = std::numeric_limits<uint>::max();
+            for( int j=0; j<8; j++ )
+            {
+                const int v = std::min( std::max( 0, base * 8 + 4 + g_alpha[t][j] * scale ), 2047 );
+                const uint local = sq( v - val[k] );
+                if( local < localErr )
+                {
+                    localErr = local;
+                    sel[k] = j;
+                }
+            }
+            err += localErr;
+        }
+#endif
+
+        if( err < bestErr )
+        {
+            bestErr = err;
+            bestTable = t;
+            bestBase = base;
+            bestMul = mul;
+#ifdef __SSE4_1__
+            bestRank = rank;
+#else
+            memcpy( bestSel, sel, 16 );
+#endif
+            if( err == 0 ) break;
+        }
+    }
+
+#ifdef __SSE4_1__
+    // Ranks back to modifier indices
+    _mm_storeu_si128( (__m128i*)bestSel, _mm_shuffle_epi8( _mm_setr_epi8( 3, 2, 1, 0, 4, 5, 6, 7, 0, 0, 0, 0, 0, 0, 0, 0 ), bestRank ) );
+#endif
+
+    return EncodeEac( bestBase, bestMul, bestTable, bestSel );
+}
@@ -3,6 +3,11 @@
 
 #include "Types.hpp"
 
+// Encodes 16 values of a single channel, in the pixel order of the color blocks, as an ETC1 block with gray colors
 uint64 ProcessAlpha( const uint8* src );
+// Encodes the 16 alpha values of a block, in the pixel order of the color blocks, as an ETC2 EAC block
+uint64 ProcessAlpha_ETC2( const uint8* src );
+// Encodes 16 values of a single channel as an EAC R11 block. RG11 blocks are two of these.
+uint64 ProcessAlpha_EAC11( const uint8* src );
 
 #endif
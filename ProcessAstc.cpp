@@ -0,0 +1,885 @@
+#include <algorithm>
+#include <assert.h>
+#include <limits>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "Math.hpp"
+#include "ProcessAstc.hpp"
+#include "ProcessAstc_AVX2.hpp"
+#include "ProcessFit.hpp"
+#include "Tables.hpp"
+
+namespace
+{
+
+enum
+{
+    ColorLevels = 21,
+    WeightLevels = 12,
+    // Rounded up from 36 for the kernels, which read texel weights in groups of eight
+    MaxTexels = 40,
+    MaxWeights = 64,
+    MaxGrids = 4
+};
+
+// Quantization levels of the integer sequences: the number of values, stored as bits and a trit or a quint
+struct Level
+{
+    int values;
+    int trits;
+    int quints;
+    int bits;
+};
+
+const Level Levels[ColorLevels] = {
+    { 2, 0, 0, 1 }, { 3, 1, 0, 0 }, { 4, 0, 0, 2 }, { 5, 0, 1, 0 }, { 6, 1, 0, 1 }, { 8, 0, 0, 3 }, { 10, 0, 1, 1 },
+    { 12, 1, 0, 2 }, { 16, 0, 0, 4 }, { 20, 0, 1, 2 }, { 24, 1, 0, 3 }, { 32, 0, 0, 5 }, { 40, 0, 1, 3 },
+    { 48, 1, 0, 4 }, { 64, 0, 0, 6 }, { 80, 0, 1, 4 }, { 96, 1, 0, 5 }, { 128, 0, 0, 7 }, { 160, 0, 1, 5 },
+    { 192, 1, 0, 6 }, { 256, 0, 0, 8 }
+};
+
+// Weight grids tried for each footprint, in order, with the quantization level of their weights. The endpoints get the
+// highest level which fits in the rest of the block.
+struct GridSpec
+{
+    int bw, bh;
+    int gw, gh;
+    int level;
+};
+
+const GridSpec GridSpecs[] = {
+    { 4, 4, 4, 4, 7 },
+    { 4, 4, 4, 4, 5 },
+    { 4, 4, 4, 4, 8 },
+    { 6, 6, 6, 6, 2 },
+    { 6, 6, 6, 6, 1 },
+    { 6, 6, 5, 5, 4 },
+};
+
+struct Grid
+{
+    int w, h;
+    int weightLevel;
+    // Levels of RGB and RGBA endpoints
+    int colorLevel[2];
+    uint32 mode;
+    // The texel weights are interpolated from four grid weights, with factors in 1/16. Total holds the sum of the
+    // factors of each grid weight, by which the texel weights are averaged back to the grid.
+    uint8 idx[MaxTexels][4];
+    uint8 factor[MaxTexels][4];
+    float total[MaxWeights];
+};
+
+struct Footprint
+{
+    int w, h;
+    int grids;
+    Grid grid[MaxGrids];
+};
+
+int SequenceBits( int level, int n )
+{
+    const Level& l = Levels[level];
+    return n * l.bits + ( l.trits ? ( 8 * n + 4 ) / 5 : 0 ) + ( l.quints ? ( 7 * n + 2 ) / 3 : 0 );
+}
+
+// Repeats the bits of v down to the given width
+int Replicate( int v, int bits, int width )
+{
+    int r = 0;
+    for( int s=width-bits; s>-bits; s-=bits )
+    {
+        r |= s >= 0 ? v << s : v >> -s;
+    }
+    return r;
+}
+
+// Endpoint values are expanded to 8 bits. The lowest bit stored next to a trit or quint flips the others.
+int UnquantizeColor( int level, int v )
+{
+    const Level& l = Levels[level];
+    if( !l.trits && !l.quints )
+    {
+        return Replicate( v, l.bits, 8 );
+    }
+    assert( l.bits > 0 );
+    const int d = v >> l.bits;
+    const int a = ( v & 1 ) ? 0x1FF : 0;
+    const int x = ( v & ( ( 1 << l.bits ) - 1 ) ) >> 1;
+    int c = 0, b = 0;
+    if( l.trits )
+    {
+        switch( l.bits )
+        {
+        case 1: c = 204; break;
+        case 2: c = 93; b = x * 0x116; break;
+        case 3: c = 44; b = ( x << 7 ) | ( x << 2 ) | x; break;
+        case 4: c = 22; b = ( x << 6 ) | x; break;
+        case 5: c = 11; b = ( x << 5 ) | ( x >> 2 ); break;
+        case 6: c = 5; b = ( x << 4 ) | ( x >> 4 ); break;
+        }
+    }
+    else
+    {
+        switch( l.bits )
+        {
+        case 1: c = 113; break;
+        case 2: c = 54; b = x * 0x10C; break;
+        case 3: c = 26; b = ( x << 7 ) | ( x << 1 ) | ( x >> 1 ); break;
+        case 4: c = 13; b = ( x << 6 ) | ( x >> 1 ); break;
+        case 5: c = 6; b = ( x << 5 ) | ( x >> 3 ); break;
+        }
+    }
+    const int t = ( d * c + b ) ^ a;
+    return ( a & 0x80 ) | ( t >> 2 );
+}
+
+// Weights are expanded to 0-64
+int UnquantizeWeight( int level, int v )
+{
+    const Level& l = Levels[level];
+    int r;
+    if( !l.trits && !l.quints )
+    {
+        r = Replicate( v, l.bits, 6 );
+    }
+    else if( l.bits == 0 )
+    {
+        return v * ( l.trits ? 32 : 16 );
+    }
+    else
+    {
+        const int d = v >> l.bits;
+        const int a = ( v & 1 ) ? 0x7F : 0;
+        const int x = ( v & ( ( 1 << l.bits ) - 1 ) ) >> 1;
+        int c = 0, b = 0;
+        if( l.trits )
+        {
+            switch( l.bits )
+            {
+            case 1: c = 50; break;
+            case 2: c = 23; b = ( x << 6 ) | ( x << 2 ) | x; break;
+            case 3: c = 11; b = ( x << 5 ) | x; break;
+            }
+        }
+        else
+        {
+            switch( l.bits )
+            {
+            case 1: c = 28; break;
+            case 2: c = 13; b = ( x << 6 ) | ( x << 1 ); break;
+            }
+        }
+        const int t = ( d * c + b ) ^ a;
+        r = ( a & 0x20 ) | ( t >> 2 );
+    }
+    return r > 32 ? r + 1 : r;
+}
+
+// Bits 0-10 of a block with a grid of weights of the given level, in a single plane
+uint32 BlockMode( int w, int h, int level )
+{
+    const uint32 r = level % 6 + 2;
+    const uint32 hp = level / 6;
+    const uint32 lo = ( ( r & 1 ) << 4 ) | ( r >> 1 );
+    if( w >= 4 && w <= 7 && h >= 2 && h <= 5 )
+    {
+        return ( hp << 9 ) | ( ( w - 4 ) << 7 ) | ( ( h - 2 ) << 5 ) | lo;
+    }
+    if( w >= 2 && w <= 5 && h >= 6 && h <= 7 )
+    {
+        return ( hp << 9 ) | ( ( h - 6 ) << 7 ) | ( ( w - 2 ) << 5 ) | ( 3 << 2 ) | lo;
+    }
+    // Grids of 6 to 9 weights per side have no high precision levels, the low bits of the level are moved up
+    assert( w >= 6 && w <= 9 && h >= 6 && h <= 9 && hp == 0 );
+    return ( ( h - 6 ) << 9 ) | ( 2 << 7 ) | ( ( w - 6 ) << 5 ) | ( ( r & 1 ) << 4 ) | ( ( r >> 1 ) << 2 );
+}
+
+// Weights of texels are interpolated bilinearly from the grid, which spans the block
+void Infill( int bw, int bh, int gw, int gh, uint8 idx[][4], uint8 factor[][4] )
+{
+    const int ds = ( 1024 + bw / 2 ) / ( bw - 1 );
+    const int dt = ( 1024 + bh / 2 ) / ( bh - 1 );
+    for( int t=0; t<bh; t++ )
+    {
+        for( int s=0; s<bw; s++ )
+        {
+            const int gs = ( ds * s * ( gw - 1 ) + 32 ) >> 6;
+            const int gt = ( dt * t * ( gh - 1 ) + 32 ) >> 6;
+            const int fs = gs & 15;
+            const int ft = gt & 15;
+            const int v = ( gs >> 4 ) + ( gt >> 4 ) * gw;
+            const int w11 = ( fs * ft + 8 ) >> 4;
+            const int i = t * bw + s;
+            factor[i][0] = 16 - fs - ft + w11;
+            factor[i][1] = fs - w11;
+            factor[i][2] = ft - w11;
+            factor[i][3] = w11;
+            // Weights past the grid have no factor
+            idx[i][0] = v;
+            idx[i][1] = std::min( v + 1, gw * gh - 1 );
+            idx[i][2] = std::min( v + gw, gw * gh - 1 );
+            idx[i][3] = std::min( v + gw + 1, gw * gh - 1 );
+        }
+    }
+}
+
+struct AstcTables
+{
+    uint8 colorUnquant[ColorLevels][256];
+    // Values of each level closest to the 8 bit values, and to the weights 0-64
+    uint8 colorQuant[ColorLevels][256];
+    uint8 weightUnquant[WeightLevels][32];
+    uint8 weightQuant[WeightLevels][65];
+    Footprint footprint[2];
+
+    AstcTables()
+    {
+        for( int level=0; level<ColorLevels; level++ )
+        {
+            // Endpoints of fewer than 6 values do not fit in any block
+            if( level < 4 ) continue;
+            const int n = Levels[level].values;
+            for( int v=0; v<n; v++ )
+            {
+                colorUnquant[level][v] = UnquantizeColor( level, v );
+            }
+            for( int c=0; c<256; c++ )
+            {
+                int best = 0;
+                for( int v=1; v<n; v++ )
+                {
+                    if( abs( colorUnquant[level][v] - c ) < abs( colorUnquant[level][best] - c ) ) best = v;
+                }
+                colorQuant[level][c] = best;
+            }
+        }
+        for( int level=0; level<WeightLevels; level++ )
+        {
+            const int n = Levels[level].values;
+            for( int v=0; v<n; v++ )
+            {
+                weightUnquant[level][v] = UnquantizeWeight( level, v );
+            }
+            for( int w=0; w<=64; w++ )
+            {
+                int best = 0;
+                for( int v=1; v<n; v++ )
+                {
+                    if( abs( weightUnquant[level][v] - w ) < abs( weightUnquant[level][best] - w ) ) best = v;
+                }
+                weightQuant[level][w] = best;
+            }
+        }
+
+        footprint[0].w = footprint[0].h = 4;
+        footprint[1].w = footprint[1].h = 6;
+        footprint[0].grids = footprint[1].grids = 0;
+        for( auto& spec : GridSpecs )
+        {
+            Footprint& fp = footprint[spec.bw == 4 ? 0 : 1];
+            Grid& g = fp.grid[fp.grids++];
+            g.w = spec.gw;
+            g.h = spec.gh;
+            g.weightLevel = spec.level;
+            g.mode = BlockMode( g.w, g.h, g.weightLevel );
+
+            // 17 bits of block mode, partition count and endpoint mode come first
+            const int bits = 128 - 17 - SequenceBits( g.weightLevel, g.w * g.h );
+            for( int c=0; c<2; c++ )
+            {
+                int level = ColorLevels - 1;
+                while( SequenceBits( level, 6 + c * 2 ) > bits ) level--;
+                assert( level >= 4 );
+                g.colorLevel[c] = level;
+            }
+
+            Infill( spec.bw, spec.bh, g.w, g.h, g.idx, g.factor );
+            memset( g.total, 0, sizeof( g.total ) );
+            for( int i=0; i<spec.bw*spec.bh; i++ )
+            {
+                for( int k=0; k<4; k++ )
+                {
+                    g.total[g.idx[i][k]] += g.factor[i][k];
+                }
+            }
+        }
+    }
+};
+
+const AstcTables s_tables;
+
+const Footprint& FindFootprint( int w, int h )
+{
+    assert( ( w == 4 && h == 4 ) || ( w == 6 && h == 6 ) );
+    return s_tables.footprint[w == 4 ? 0 : 1];
+}
+
+struct BitReader
+{
+    const uint64* d;
+    int pos;
+
+    uint32 Get( int bits )
+    {
+        uint64 v = pos < 64 ? d[0] >> pos : d[1] >> ( pos - 64 );
+        if( pos < 64 && pos + bits > 64 )
+        {
+            v |= d[1] << ( 64 - pos );
+        }
+        pos += bits;
+        return uint32( v & ( ( 1ull << bits ) - 1 ) );
+    }
+};
+
+uint64 Reverse( uint64 v )
+{
+    v = ( ( v >> 1 ) & 0x5555555555555555ull ) | ( ( v & 0x5555555555555555ull ) << 1 );
+    v = ( ( v >> 2 ) & 0x3333333333333333ull ) | ( ( v & 0x3333333333333333ull ) << 2 );
+    v = ( ( v >> 4 ) & 0x0F0F0F0F0F0F0F0Full ) | ( ( v & 0x0F0F0F0F0F0F0F0Full ) << 4 );
+    v = ( ( v >> 8 ) & 0x00FF00FF00FF00FFull ) | ( ( v & 0x00FF00FF00FF00FFull ) << 8 );
+    v = ( ( v >> 16 ) & 0x0000FFFF0000FFFFull ) | ( ( v & 0x0000FFFF0000FFFFull ) << 16 );
+    return ( v >> 32 ) | ( v << 32 );
+}
+
+// Trits are packed by five and quints by three, their codes are split between the bits of the values. The bits of the
+// code after the last value are left out.
+void PutSequence( BitWriter& bw, const uint8* v, int n, int level )
+{
+    static const int tritBits[5] = { 2, 2, 1, 2, 1 };
+    static const int quintBits[3] = { 3, 2, 2 };
+    const Level& l = Levels[level];
+    const int mask = ( 1 << l.bits ) - 1;
+    const int group = l.trits ? 5 : l.quints ? 3 : 1;
+    for( int i=0; i<n; i+=group )
+    {
+        int code = 0;
+        if( l.trits || l.quints )
+        {
+            int t[5] = {};
+            for( int j=0; j<group && i+j<n; j++ )
+            {
+                t[j] = v[i+j] >> l.bits;
+            }
+            code = l.trits ? g_astcTrits[t[0] + t[1] * 3 + t[2] * 9 + t[3] * 27 + t[4] * 81] : g_astcQuints[t[0] + t[1] * 5 + t[2] * 25];
+        }
+        for( int j=0; j<group && i+j<n; j++ )
+        {
+            bw.Put( v[i+j] & mask, l.bits );
+            if( l.trits || l.quints )
+            {
+                const int bits = l.trits ? tritBits[j] : quintBits[j];
+                bw.Put( code & ( ( 1 << bits ) - 1 ), bits );
+                code >>= bits;
+            }
+        }
+    }
+}
+
+void DecodeTrits( int t, int v[5] )
+{
+    int c;
+    if( ( ( t >> 2 ) & 7 ) == 7 )
+    {
+        c = ( ( t >> 5 ) << 2 ) | ( t & 3 );
+        v[3] = v[4] = 2;
+    }
+    else
+    {
+        c = t & 0x1F;
+        if( ( ( t >> 5 ) & 3 ) == 3 )
+        {
+            v[4] = 2;
+            v[3] = t >> 7;
+        }
+        else
+        {
+            v[4] = t >> 7;
+            v[3] = ( t >> 5 ) & 3;
+        }
+    }
+    if( ( c & 3 ) == 3 )
+    {
+        v[2] = 2;
+        v[1] = c >> 4;
+        v[0] = ( ( c >> 2 ) & 2 ) | ( ( c >> 2 ) & 1 & ~( c >> 3 ) );
+    }
+    else if( ( ( c >> 2 ) & 3 ) == 3 )
+    {
+        v[2] = v[1] = 2;
+        v[0] = c & 3;
+    }
+    else
+    {
+        v[2] = c >> 4;
+        v[1] = ( c >> 2 ) & 3;
+        v[0] = ( c & 2 ) | ( c & 1 & ~( c >> 1 ) );
+    }
+}
+
+void DecodeQuints( int q, int v[3] )
+{
+    if( ( ( q >> 1 ) & 3 ) == 3 && ( ( q >> 5 ) & 3 ) == 0 )
+    {
+        v[2] = ( ( q & 1 ) << 2 ) | ( ( ( q >> 4 ) & ~q & 1 ) << 1 ) | ( ( q >> 3 ) & ~q & 1 );
+        v[1] = v[0] = 4;
+        return;
+    }
+    int c;
+    if( ( ( q >> 1 ) & 3 ) == 3 )
+    {
+        v[2] = 4;
+        c = ( ( ( q >> 3 ) & 3 ) << 3 ) | ( ( ~q >> 4 ) & 6 ) | ( q & 1 );
+    }
+    else
+    {
+        v[2] = ( q >> 5 ) & 3;
+        c = q & 0x1F;
+    }
+    if( ( c & 7 ) == 5 )
+    {
+        v[1] = 4;
+        v[0] = ( c >> 3 ) & 3;
+    }
+    else
+    {
+        v[1] = ( c >> 3 ) & 3;
+        v[0] = c & 7;
+    }
+}
+
+void GetSequence( BitReader& br, int n, int level, uint8* v )
+{
+    static const int tritBits[5] = { 2, 2, 1, 2, 1 };
+    static const int quintBits[3] = { 3, 2, 2 };
+    const Level& l = Levels[level];
+    const int group = l.trits ? 5 : l.quints ? 3 : 1;
+    for( int i=0; i<n; i+=group )
+    {
+        int m[5];
+        int code = 0, shift = 0;
+        for( int j=0; j<group && i+j<n; j++ )
+        {
+            m[j] = br.Get( l.bits );
+            if( l.trits || l.quints )
+            {
+                const int bits = l.trits ? tritBits[j] : quintBits[j];
+                code |= br.Get( bits ) << shift;
+                shift += bits;
+            }
+        }
+        int t[5] = {};
+        if( l.trits )
+        {
+            DecodeTrits( code, t );
+        }
+        else if( l.quints )
+        {
+            DecodeQuints( code, t );
+        }
+        for( int j=0; j<group && i+j<n; j++ )
+        {
+            v[i+j] = ( t[j] << l.bits ) | m[j];
+        }
+    }
+}
+
+// Decoded texels are the highest 8 bits of the endpoints interpolated at 16 bits
+inline int Interpolate( int c0, int c1, int w )
+{
+    return ( ( c0 * 257 * ( 64 - w ) + c1 * 257 * w + 32 ) >> 6 ) >> 8;
+}
+
+// Endpoints and weights of a block with a single partition
+struct Block
+{
+    const Grid* grid;
+    int channels;
+    // Values of the endpoints, by channel: r0 r1 g0 g1 b0 b1 a0 a1
+    uint8 color[8];
+    uint8 weight[MaxWeights];
+    // Texel weights, 0-64
+    uint8 texel[MaxTexels];
+    uint32 err;
+};
+
+// Moments of the texels, with AVX2 where it is available
+template<bool Avx2>
+void Moments( const uint8* src, int n, int sum[4], int prod[10] )
+{
+#ifdef __SSE4_1__
+    if( Avx2 )
+    {
+        MomentsAstc_AVX2( src, n, sum, prod );
+        return;
+    }
+#endif
+    ::Moments( src, n, sum, prod );
+}
+
+// Positions of the texels along the segment from v0 in direction d, multiplied by scale and clamped to 0-64
+template<bool Avx2>
+void Project( const uint8* src, int n, const int v0[4], const float d[4], float scale, float* ideal )
+{
+#ifdef __SSE4_1__
+    if( Avx2 )
+    {
+        ProjectAstc_AVX2( src, n, v0, d, scale, ideal );
+        return;
+    }
+#endif
+    for( int i=0; i<n; i++ )
+    {
+        float t = 0;
+        for( int c=0; c<4; c++ )
+        {
+            t += ( src[i*4+c] - v0[c] ) * d[c];
+        }
+        ideal[i] = std::min( 64.f, std::max( 0.f, t * scale ) );
+    }
+}
+
+// Squared error of the texels decoded from the endpoints with the texel weights
+template<bool Avx2>
+uint32 Error( const uint8* src, int n, const int v0[4], const int v1[4], const uint8* texel )
+{
+#ifdef __SSE4_1__
+    if( Avx2 )
+    {
+        return ErrorAstc_AVX2( src, n, v0, v1, texel );
+    }
+#endif
+    uint32 err = 0;
+    for( int i=0; i<n; i++ )
+    {
+        for( int c=0; c<4; c++ )
+        {
+            err += sq( Interpolate( v0[c], v1[c], texel[i] ) - src[i*4+c] );
+        }
+    }
+    return err;
+}
+
+// Quantizes the endpoints, then fits the weights of the grid to the texels' positions between the decoded endpoints.
+// Endpoints are ordered so that the second one has the larger sum of RGB, otherwise the decoder would move them
+// towards blue.
+template<bool Avx2>
+void EncodeGrid( const uint8* src, int n, const Grid& g, int channels, const float e0[4], const float e1[4], Block& b )
+{
+    const int level = g.colorLevel[channels - 3];
+    const uint8* quant = s_tables.colorQuant[level];
+    const uint8* unquant = s_tables.colorUnquant[level];
+
+    b.grid = &g;
+    b.channels = channels;
+    int v[2][4] = { { 0, 0, 0, 255 }, { 0, 0, 0, 255 } };
+    int sum[2] = {};
+    for( int c=0; c<channels; c++ )
+    {
+        b.color[c*2] = quant[int( e0[c] + 0.5f )];
+        b.color[c*2+1] = quant[int( e1[c] + 0.5f )];
+        v[0][c] = unquant[b.color[c*2]];
+        v[1][c] = unquant[b.color[c*2+1]];
+        if( c < 3 )
+        {
+            sum[0] += v[0][c];
+            sum[1] += v[1][c];
+        }
+    }
+    if( sum[1] < sum[0] )
+    {
+        for( int c=0; c<4; c++ )
+        {
+            std::swap( b.color[c*2], b.color[c*2+1] );
+            std::swap( v[0][c], v[1][c] );
+        }
+    }
+
+    float d[4] = {};
+    float dd = 0;
+    for( int c=0; c<channels; c++ )
+    {
+        d[c] = float( v[1][c] - v[0][c] );
+        dd += d[c] * d[c];
+    }
+    const float scale = dd > 0 ? 64.f / dd : 0;
+
+    float ideal[MaxTexels];
+    Project<Avx2>( src, n, v[0], d, scale, ideal );
+
+    const int weights = g.w * g.h;
+    const uint8* wquant = s_tables.weightQuant[g.weightLevel];
+    const uint8* wunquant = s_tables.weightUnquant[g.weightLevel];
+    int grid[MaxWeights];
+    if( weights == n )
+    {
+        for( int i=0; i<n; i++ )
+        {
+            b.weight[i] = wquant[int( ideal[i] + 0.5f )];
+            b.texel[i] = wunquant[b.weight[i]];
+        }
+    }
+    else
+    {
+        // Grid weights are the averages of the texel weights they contribute to
+        float acc[MaxWeights] = {};
+        for( int i=0; i<n; i++ )
+        {
+            for( int k=0; k<4; k++ )
+            {
+                acc[g.idx[i][k]] += g.factor[i][k] * ideal[i];
+            }
+        }
+        for( int j=0; j<weights; j++ )
+        {
+            b.weight[j] = wquant[int( acc[j] / g.total[j] + 0.5f )];
+            grid[j] = wunquant[b.weight[j]];
+        }
+        for( int i=0; i<n; i++ )
+        {
+            int w = 8;
+            for( int k=0; k<4; k++ )
+            {
+                w += grid[g.idx[i][k]] * g.factor[i][k];
+            }
+            b.texel[i] = w >> 4;
+        }
+    }
+
+    // Alpha of opaque blocks is decoded exactly
+    b.err = Error<Avx2>( src, n, v[0], v[1], b.texel );
+}
+
+void PackBlock( const Block& b, uint64* dst )
+{
+    const Grid& g = *b.grid;
+    BitWriter bw;
+    bw.Put( g.mode, 11 );
+    bw.Put( 0, 2 );
+    bw.Put( b.channels == 3 ? 8 : 12, 4 );
+    PutSequence( bw, b.color, b.channels * 2, g.colorLevel[b.channels - 3] );
+
+    // Weights are stored from the highest bit down
+    BitWriter ww;
+    PutSequence( ww, b.weight, g.w * g.h, g.weightLevel );
+    dst[0] = bw.d[0] | Reverse( ww.d[1] );
+    dst[1] = bw.d[1] | Reverse( ww.d[0] );
+}
+
+template<bool Avx2>
+void EncodeAstc( const uint8* src, int w, int h, bool fast, uint64* dst )
+{
+    const Footprint& fp = FindFootprint( w, h );
+    const int n = w * h;
+
+    uint32 first;
+    memcpy( &first, src, 4 );
+    bool constant = true;
+    bool opaque = true;
+    for( int i=0; i<n; i++ )
+    {
+        uint32 px;
+        memcpy( &px, src + i*4, 4 );
+        constant &= px == first;
+        opaque &= src[i*4+3] == 255;
+    }
+    if( constant )
+    {
+        // Void-extent block of 16 bit channels, the extent is left unknown
+        dst[0] = 0xFFFFFFFFFFFFFDFCull;
+        dst[1] = uint64( src[0] * 257 ) | ( uint64( src[1] * 257 ) << 16 ) | ( uint64( src[2] * 257 ) << 32 ) | ( uint64( src[3] * 257 ) << 48 );
+        return;
+    }
+    const int channels = opaque ? 3 : 4;
+
+    int sum[4];
+    int prod[10];
+    Moments<Avx2>( src, n, sum, prod );
+    float e[2][4];
+    float axis[4];
+    FitLine( src, n, channels, sum, prod, e[0], e[1], axis );
+
+    Block best;
+    best.err = std::numeric_limits<uint32>::max();
+    const int grids = fast ? 1 : fp.grids;
+    for( int k=0; k<grids; k++ )
+    {
+        Block b;
+        EncodeGrid<Avx2>( src, n, fp.grid[k], channels, e[0], e[1], b );
+        if( b.err < best.err )
+        {
+            best = b;
+        }
+        if( fast || b.err == 0 ) continue;
+        float weight[MaxTexels];
+        for( int i=0; i<n; i++ )
+        {
+            weight[i] = b.texel[i] / 64.f;
+        }
+        float r[2][4];
+        if( !Refine( src, n, weight, channels, r[0], r[1] ) ) continue;
+        EncodeGrid<Avx2>( src, n, fp.grid[k], channels, r[0], r[1], b );
+        if( b.err < best.err )
+        {
+            best = b;
+        }
+    }
+    PackBlock( best, dst );
+}
+
+}
+
+void ProcessAstc( const uint8* src, int w, int h, bool fast, uint64* dst )
+{
+    EncodeAstc<false>( src, w, h, fast, dst );
+}
+
+#ifdef __SSE4_1__
+void ProcessAstc_AVX2( const uint8* src, int w, int h, bool fast, uint64* dst )
+{
+    EncodeAstc<true>( src, w, h, fast, dst );
+}
+#endif
+
+void DecodeAstc( const uint64* src, int w, int h, uint8* dst )
+{
+    const int n = w * h;
+    assert( n <= MaxTexels );
+    for( int i=0; i<n; i++ )
+    {
+        dst[i*4] = 255;
+        dst[i*4+1] = 0;
+        dst[i*4+2] = 255;
+        dst[i*4+3] = 255;
+    }
+
+    const uint32 mode = src[0] & 0x7FF;
+    if( ( mode & 0x1FF ) == 0x1FC )
+    {
+        // HDR void-extent blocks are not decoded
+        if( mode & 0x200 ) return;
+        for( int i=0; i<n; i++ )
+        {
+            for( int c=0; c<4; c++ )
+            {
+                dst[i*4+c] = src[1] >> ( c * 16 + 8 );
+            }
+        }
+        return;
+    }
+
+    // Grid size and weight level, the reserved modes and two planes are errors
+    int gw, gh, r;
+    uint32 hp = ( mode >> 9 ) & 1;
+    uint32 dual = mode >> 10;
+    const int a = ( mode >> 5 ) & 3;
+    if( mode & 3 )
+    {
+        r = ( ( mode >> 4 ) & 1 ) | ( ( mode & 3 ) << 1 );
+        const int b = ( mode >> 7 ) & 3;
+        switch( ( mode >> 2 ) & 3 )
+        {
+        case 0: gw = b + 4; gh = a + 2; break;
+        case 1: gw = b + 8; gh = a + 2; break;
+        case 2: gw = a + 2; gh = b + 8; break;
+        default:
+            if( mode & 0x100 )
+            {
+                gw = ( b & 1 ) + 2;
+                gh = a + 2;
+            }
+            else
+            {
+                gw = a + 2;
+                gh = ( b & 1 ) + 6;
+            }
+            break;
+        }
+    }
+    else
+    {
+        r = ( ( mode >> 4 ) & 1 ) | ( ( ( mode >> 2 ) & 3 ) << 1 );
+        if( ( mode & 0xF ) == 0 ) return;
+        const int b = ( mode >> 9 ) & 3;
+        switch( ( mode >> 7 ) & 3 )
+        {
+        case 0: gw = 12; gh = a + 2; break;
+        case 1: gw = a + 2; gh = 12; break;
+        case 2:
+            gw = a + 6;
+            gh = b + 6;
+            hp = dual = 0;
+            break;
+        default:
+            if( a > 1 ) return;
+            gw = a == 0 ? 6 : 10;
+            gh = a == 0 ? 10 : 6;
+            break;
+        }
+    }
+    const int weightLevel = r - 2 + hp * 6;
+    const int weights = gw * gh;
+    if( dual || weights > MaxWeights || gw > w || gh > h ) return;
+    const int weightBits = SequenceBits( weightLevel, weights );
+    if( weightBits < 24 || weightBits > 96 ) return;
+
+    BitReader br = { src, 11 };
+    if( br.Get( 2 ) != 0 ) return;
+    const int cem = br.Get( 4 );
+    if( cem != 8 && cem != 12 ) return;
+    const int values = cem == 8 ? 6 : 8;
+    int colorLevel = ColorLevels - 1;
+    while( colorLevel >= 4 && SequenceBits( colorLevel, values ) > 128 - 17 - weightBits ) colorLevel--;
+    if( colorLevel < 4 ) return;
+
+    uint8 color[8];
+    GetSequence( br, values, colorLevel, color );
+    int v[2][4] = { { 0, 0, 0, 255 }, { 0, 0, 0, 255 } };
+    for( int c=0; c<values/2; c++ )
+    {
+        v[0][c] = s_tables.colorUnquant[colorLevel][color[c*2]];
+        v[1][c] = s_tables.colorUnquant[colorLevel][color[c*2+1]];
+    }
+    if( v[1][0] + v[1][1] + v[1][2] < v[0][0] + v[0][1] + v[0][2] )
+    {
+        // Blue contraction of the swapped endpoints
+        for( int c=0; c<4; c++ )
+        {
+            std::swap( v[0][c], v[1][c] );
+        }
+        for( int j=0; j<2; j++ )
+        {
+            v[j][0] = ( v[j][0] + v[j][2] ) >> 1;
+            v[j][1] = ( v[j][1] + v[j][2] ) >> 1;
+        }
+    }
+
+    const uint64 rev[2] = { Reverse( src[1] ), Reverse( src[0] ) };
+    BitReader wr = { rev, 0 };
+    uint8 weight[MaxWeights];
+    GetSequence( wr, weights, weightLevel, weight );
+    int grid[MaxWeights];
+    for( int j=0; j<weights; j++ )
+    {
+        grid[j] = s_tables.weightUnquant[weightLevel][weight[j]];
+    }
+
+    uint8 idx[MaxTexels][4];
+    uint8 factor[MaxTexels][4];
+    Infill( w, h, gw, gh, idx, factor );
+    for( int i=0; i<n; i++ )
+    {
+        int tw = 8;
+        for( int k=0; k<4; k++ )
+        {
+            tw += grid[idx[i][k]] * factor[i][k];
+        }
+        tw >>= 4;
+        for( int c=0; c<4; c++ )
+        {
+            dst[i*4+c] = Interpolate( v[0][c], v[1][c], tw );
+        }
+    }
+}
@@ -0,0 +1,20 @@
+#ifndef __PROCESSASTC_HPP__
+#define __PROCESSASTC_HPP__
+
+#include "Types.hpp"
+
+// Encodes w by h texels, in RGBA byte order and row by row, as an LDR ASTC block of two words. Footprints of 4x4 and
+// 6x6 texels are supported. Blocks of a single color are written as void-extent blocks, the others with one partition
+// and direct RGB endpoints, or RGBA ones when any texel is not opaque. Each footprint has a few weight grids, the one
+// with the least error is kept. Fast only tries the first grid, without refitting the endpoints to the weights.
+void ProcessAstc( const uint8* src, int w, int h, bool fast, uint64* dst );
+#ifdef __SSE4_1__
+// Same as ProcessAstc, with the kernels of ProcessAstc_AVX2.cpp
+void ProcessAstc_AVX2( const uint8* src, int w, int h, bool fast, uint64* dst );
+#endif
+
+// Decodes an LDR ASTC block of w by h texels to RGBA bytes, row by row. Blocks of other kinds than the encoder writes,
+// with more partitions, two planes of weights or other endpoint modes, are decoded as magenta, like blocks in error.
+void DecodeAstc( const uint64* src, int w, int h, uint8* dst );
+
+#endif
@@ -0,0 +1,125 @@
+#ifdef __SSE4_1__
+
+#include "ProcessAstc_AVX2.hpp"
+#ifdef _MSC_VER
+#  include <intrin.h>
+#  define VS_VECTORCALL _vectorcall
+#else
+#  include <x86intrin.h>
+#  pragma GCC push_options
+#  pragma GCC target ("avx2,fma,bmi2")
+#  define VS_VECTORCALL
+#endif
+
+namespace
+{
+
+// Lanes of the texels i to i+7 which are below n
+__m256i VS_VECTORCALL TexelMask_AVX2( int i, int n )
+{
+    return _mm256_cmpgt_epi32(_mm256_set1_epi32(n - i), _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7));
+}
+
+int VS_VECTORCALL Sum_AVX2( __m256i v )
+{
+    const __m128i s4 = _mm_add_epi32(_mm256_castsi256_si128(v), _mm256_extracti128_si256(v, 1));
+    const __m128i s2 = _mm_add_epi32(s4, _mm_shuffle_epi32(s4, _MM_SHUFFLE(1, 0, 3, 2)));
+    const __m128i s1 = _mm_add_epi32(s2, _mm_shuffle_epi32(s2, _MM_SHUFFLE(2, 3, 0, 1)));
+    return _mm_cvtsi128_si32(s1);
+}
+
+// Channels of eight texels in 32 bit lanes, the texels past n are zero
+void VS_VECTORCALL LoadTexels_AVX2( const uint8* src, int i, int n, __m256i ch[4] )
+{
+    const __m256i px = _mm256_maskload_epi32((const int*)( src + i * 4 ), TexelMask_AVX2( i, n ));
+    const __m256i mask = _mm256_set1_epi32(0xFF);
+    ch[0] = _mm256_and_si256(px, mask);
+    ch[1] = _mm256_and_si256(_mm256_srli_epi32(px, 8), mask);
+    ch[2] = _mm256_and_si256(_mm256_srli_epi32(px, 16), mask);
+    ch[3] = _mm256_srli_epi32(px, 24);
+}
+
+}
+
+void MomentsAstc_AVX2( const uint8* src, int n, int* sum, int* prod )
+{
+    __m256i s[4], p[10];
+    for( int c=0; c<4; c++ ) s[c] = _mm256_setzero_si256();
+    for( int k=0; k<10; k++ ) p[k] = _mm256_setzero_si256();
+
+    for( int i=0; i<n; i+=8 )
+    {
+        __m256i ch[4];
+        LoadTexels_AVX2( src, i, n, ch );
+        int k = 0;
+        for( int c=0; c<4; c++ )
+        {
+            s[c] = _mm256_add_epi32(s[c], ch[c]);
+            for( int d=c; d<4; d++ )
+            {
+                p[k] = _mm256_add_epi32(p[k], _mm256_mullo_epi32(ch[c], ch[d]));
+                k++;
+            }
+        }
+    }
+
+    for( int c=0; c<4; c++ ) sum[c] = Sum_AVX2( s[c] );
+    for( int k=0; k<10; k++ ) prod[k] = Sum_AVX2( p[k] );
+}
+
+void ProjectAstc_AVX2( const uint8* src, int n, const int* v0, const float* d, float scale, float* ideal )
+{
+    __m256 e[4], dir[4];
+    for( int c=0; c<4; c++ )
+    {
+        e[c] = _mm256_set1_ps(float( v0[c] ));
+        dir[c] = _mm256_set1_ps(d[c] * scale);
+    }
+
+    for( int i=0; i<n; i+=8 )
+    {
+        __m256i ch[4];
+        LoadTexels_AVX2( src, i, n, ch );
+        __m256 t = _mm256_setzero_ps();
+        for( int c=0; c<4; c++ )
+        {
+            t = _mm256_fmadd_ps(_mm256_sub_ps(_mm256_cvtepi32_ps(ch[c]), e[c]), dir[c], t);
+        }
+        _mm256_storeu_ps(ideal + i, _mm256_min_ps(_mm256_max_ps(t, _mm256_setzero_ps()), _mm256_set1_ps(64.f)));
+    }
+}
+
+uint32 ErrorAstc_AVX2( const uint8* src, int n, const int* v0, const int* v1, const uint8* texel )
+{
+    // Endpoints expanded to 16 bits, the interpolated value is shifted down by 6 and 8 bits at once
+    __m256i e0[4], e1[4];
+    for( int c=0; c<4; c++ )
+    {
+        e0[c] = _mm256_set1_epi32(v0[c] * 257);
+        e1[c] = _mm256_set1_epi32(v1[c] * 257);
+    }
+
+    __m256i err = _mm256_setzero_si256();
+    for( int i=0; i<n; i+=8 )
+    {
+        __m256i ch[4];
+        LoadTexels_AVX2( src, i, n, ch );
+        const __m256i w1 = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)( texel + i )));
+        const __m256i w0 = _mm256_sub_epi32(_mm256_set1_epi32(64), w1);
+        __m256i e = _mm256_setzero_si256();
+        for( int c=0; c<4; c++ )
+        {
+            const __m256i v = _mm256_add_epi32(_mm256_add_epi32(_mm256_mullo_epi32(e0[c], w0), _mm256_mullo_epi32(e1[c], w1)), _mm256_set1_epi32(32));
+            const __m256i diff = _mm256_sub_epi32(_mm256_srli_epi32(v, 14), ch[c]);
+            e = _mm256_add_epi32(e, _mm256_mullo_epi32(diff, diff));
+        }
+        err = _mm256_add_epi32(err, _mm256_and_si256(e, TexelMask_AVX2( i, n )));
+    }
+    return Sum_AVX2( err );
+}
+
+#ifndef _MSC_VER
+#  pragma GCC pop_options
+#endif
+
+#endif
@@ -0,0 +1,19 @@
+#ifndef __PROCESSASTC_AVX2_HPP__
+#define __PROCESSASTC_AVX2_HPP__
+
+#ifdef __SSE4_1__
+
+#include "Types.hpp"
+
+// Sums of the channels of n RGBA texels to sum, and of their products to prod, in the order rr rg rb ra gg gb ga bb ba aa
+void MomentsAstc_AVX2( const uint8* src, int n, int* sum, int* prod );
+// Positions of n texels along the segment from v0 in direction d, multiplied by scale and clamped to 0-64. The
+// positions are written in groups of eight, ideal has room for n rounded up to a multiple of 8.
+void ProjectAstc_AVX2( const uint8* src, int n, const int* v0, const float* d, float scale, float* ideal );
+// Squared error of n texels decoded from RGBA endpoints v0 and v1 with the given weights, 0-64. Texel weights are read in
+// groups of eight, as for ProjectAstc_AVX2.
+uint32 ErrorAstc_AVX2( const uint8* src, int n, const int* v0, const int* v1, const uint8* texel );
+
+#endif
+
+#endif
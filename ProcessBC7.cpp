@@ -0,0 +1,496 @@
+#include <algorithm>
+#include <limits>
+#include <math.h>
+#include <string.h>
+
+#include "Math.hpp"
+#include "ProcessBC7.hpp"
+#include "ProcessBC7_AVX2.hpp"
+#include "ProcessFit.hpp"
+#include "Tables.hpp"
+
+namespace
+{
+
+// Partitions of two subsets which are encoded, out of the 64, picked by their estimated error
+enum { Mode1Candidates = 4 };
+
+// Mode 6 endpoints: 7 bits per channel and a p-bit each, which is the lowest bit of all its channels
+struct Mode6
+{
+    int q[2][4];
+    int p[2];
+    uint8 idx[16];
+    uint32 err;
+};
+
+// Mode 1 endpoints: 6 bits per channel of the two endpoints of both subsets, and a p-bit per subset. The lowest bit
+// of 7 is the p-bit, which is then expanded to 8.
+struct Mode1
+{
+    int part;
+    int q[2][2][3];
+    int p[2];
+    uint8 idx[16];
+    uint32 err;
+};
+
+inline int Expand7( int v )
+{
+    return ( v << 1 ) | ( v >> 6 );
+}
+
+// Lists the pixels of a subset, without branching on the partition. Returns their number.
+int ListPixels( uint32 mask, uint8 list[16] )
+{
+    int n = 0;
+    for( int i=0; i<16; i++ )
+    {
+        list[n] = i;
+        n += ( mask >> i ) & 1;
+    }
+    return n;
+}
+
+// Copies the listed pixels next to each other
+void Gather( const uint8* src, const uint8* list, int n, uint8* px )
+{
+    for( int j=0; j<n; j++ )
+    {
+        memcpy( px + j*4, src + list[j]*4, 4 );
+    }
+}
+
+// Fits a line to the listed pixels, see FitLine
+void FitSubset( const uint8* src, const uint8* list, int n, float e0[4], float e1[4], float axis[4] )
+{
+    uint8 px[16*4];
+    Gather( src, list, n, px );
+    int sum[4];
+    int prod[10];
+    Moments( px, n, sum, prod );
+    FitLine( px, n, 4, sum, prod, e0, e1, axis );
+}
+
+// Least squares endpoints of the listed pixels for their indices, see Refine
+bool RefineSubset( const uint8* src, const uint8* list, int n, const uint8* idx, const uint8* weights, int channels, float e0[4], float e1[4] )
+{
+    uint8 px[16*4];
+    Gather( src, list, n, px );
+    float weight[16];
+    for( int j=0; j<n; j++ )
+    {
+        weight[j] = weights[idx[list[j]]] / 64.f;
+    }
+    return Refine( px, n, weight, channels, e0, e1 );
+}
+
+// Picks the p-bit with the least error of the endpoint's channels. Opaque blocks keep alpha at 255, with a p-bit of 1.
+void QuantizeMode6( const float e[4], bool opaque, int q[4], int& p )
+{
+    float best = 0;
+    for( int pb=opaque ? 1 : 0; pb<2; pb++ )
+    {
+        int t[4];
+        float err = 0;
+        for( int c=0; c<4; c++ )
+        {
+            t[c] = std::min( 127, std::max( 0, int( ( e[c] - pb ) * 0.5f + 0.5f ) ) );
+            err += sq( t[c] * 2 + pb - e[c] );
+        }
+        if( pb == ( opaque ? 1 : 0 ) || err < best )
+        {
+            best = err;
+            memcpy( q, t, sizeof( t ) );
+            p = pb;
+        }
+    }
+}
+
+// Picks the p-bit with the least error of both endpoints' channels
+void QuantizeMode1( const float e0[4], const float e1[4], int q[2][3], int& p )
+{
+    const float* e[2] = { e0, e1 };
+    float best = 0;
+    for( int pb=0; pb<2; pb++ )
+    {
+        int t[2][3];
+        float err = 0;
+        for( int j=0; j<2; j++ )
+        {
+            for( int c=0; c<3; c++ )
+            {
+                t[j][c] = g_bc7Match6[pb][int( e[j][c] + 0.5f )];
+                err += sq( Expand7( t[j][c] * 2 + pb ) - e[j][c] );
+            }
+        }
+        if( pb == 0 || err < best )
+        {
+            best = err;
+            memcpy( q, t, sizeof( t ) );
+            p = pb;
+        }
+    }
+}
+
+void Palette( const int e0[4], const int e1[4], const uint8* weights, int colors, uint8 pal[16][4] )
+{
+    for( int k=0; k<colors; k++ )
+    {
+        const int w = weights[k];
+        for( int c=0; c<4; c++ )
+        {
+            pal[k][c] = ( ( 64 - w ) * e0[c] + w * e1[c] + 32 ) >> 6;
+        }
+    }
+}
+
+// Finds the closest of the interpolated colors to each pixel
+template<bool Avx2>
+void FindIndices( const uint8* src, const int e0[4], const int e1[4], const uint8* weights, int colors, uint32* err, uint8* idx )
+{
+#ifdef __SSE4_1__
+    if( Avx2 )
+    {
+        FindIndicesBC7_AVX2( src, e0, e1, weights, colors, err, idx );
+        return;
+    }
+#endif
+    uint8 pal[16][4];
+    Palette( e0, e1, weights, colors, pal );
+    for( int i=0; i<16; i++ )
+    {
+        const uint8* px = src + i*4;
+        for( int k=0; k<colors; k++ )
+        {
+            const uint32 e = sq( px[0] - pal[k][0] ) + sq( px[1] - pal[k][1] ) + sq( px[2] - pal[k][2] ) + sq( px[3] - pal[k][3] );
+            if( k == 0 || e < err[i] )
+            {
+                err[i] = e;
+                idx[i] = k;
+            }
+        }
+    }
+}
+
+// Squared error of the line fits of a subset, along its principal axis. The axis is estimated by two power iterations
+// from the given one. N is the number of pixels, s the sums of their r, g, b and rr, gg, bb, rg, rb, gb.
+float LineError( float n, const float s[9], const float axis[3] )
+{
+    const float inv = 1.f / n;
+    const float c00 = s[3] - s[0] * s[0] * inv;
+    const float c11 = s[4] - s[1] * s[1] * inv;
+    const float c22 = s[5] - s[2] * s[2] * inv;
+    const float c01 = s[6] - s[0] * s[1] * inv;
+    const float c02 = s[7] - s[0] * s[2] * inv;
+    const float c12 = s[8] - s[1] * s[2] * inv;
+
+    const float v0 = c00 * axis[0] + c01 * axis[1] + c02 * axis[2];
+    const float v1 = c01 * axis[0] + c11 * axis[1] + c12 * axis[2];
+    const float v2 = c02 * axis[0] + c12 * axis[1] + c22 * axis[2];
+    const float w0 = c00 * v0 + c01 * v1 + c02 * v2;
+    const float w1 = c01 * v0 + c11 * v1 + c12 * v2;
+    const float w2 = c02 * v0 + c12 * v1 + c22 * v2;
+    const float vv = v0 * v0 + v1 * v1 + v2 * v2;
+    const float vw = v0 * w0 + v1 * w1 + v2 * w2;
+
+    // Variance along the axis, by its Rayleigh quotient
+    const float var = vv > 1e-3f ? vw / vv : 0;
+    return c00 + c11 + c22 - var;
+}
+
+template<bool Avx2>
+void EstimatePartitions( const uint8* src, const float axis[3], float est[64] )
+{
+#ifdef __SSE4_1__
+    if( Avx2 )
+    {
+        EstimatePartitionsBC7_AVX2( src, axis, est );
+        return;
+    }
+#endif
+    float m[16][9];
+    float total[9] = {};
+    for( int i=0; i<16; i++ )
+    {
+        const float r = src[i*4];
+        const float g = src[i*4+1];
+        const float b = src[i*4+2];
+        m[i][0] = r;
+        m[i][1] = g;
+        m[i][2] = b;
+        m[i][3] = r * r;
+        m[i][4] = g * g;
+        m[i][5] = b * b;
+        m[i][6] = r * g;
+        m[i][7] = r * b;
+        m[i][8] = g * b;
+        for( int k=0; k<9; k++ )
+        {
+            total[k] += m[i][k];
+        }
+    }
+    for( int p=0; p<64; p++ )
+    {
+        const uint32 mask = g_bc7Partitions2[p];
+        float s1[9] = {};
+        float n1 = 0;
+        for( int i=0; i<16; i++ )
+        {
+            if( !( mask & ( 1 << i ) ) ) continue;
+            for( int k=0; k<9; k++ )
+            {
+                s1[k] += m[i][k];
+            }
+            n1++;
+        }
+        float s0[9];
+        for( int k=0; k<9; k++ )
+        {
+            s0[k] = total[k] - s1[k];
+        }
+        est[p] = LineError( 16 - n1, s0, axis ) + LineError( n1, s1, axis );
+    }
+}
+
+// Decoded endpoints of a mode 6 block
+void Endpoints( const Mode6& m, int e[2][4] )
+{
+    for( int j=0; j<2; j++ )
+    {
+        for( int c=0; c<4; c++ )
+        {
+            e[j][c] = m.q[j][c] * 2 + m.p[j];
+        }
+    }
+}
+
+template<bool Avx2>
+void EncodeMode6( const uint8* src, bool opaque, float axis[4], Mode6& best )
+{
+    int sum[4];
+    int prod[10];
+    Moments( src, 16, sum, prod );
+    float e[2][4];
+    FitLine( src, 16, 4, sum, prod, e[0], e[1], axis );
+
+    best.err = 0xFFFFFFFF;
+    for( int pass=0; pass<2; pass++ )
+    {
+        Mode6 m;
+        QuantizeMode6( e[0], opaque, m.q[0], m.p[0] );
+        QuantizeMode6( e[1], opaque, m.q[1], m.p[1] );
+
+        int v[2][4];
+        Endpoints( m, v );
+        uint32 err[16];
+        FindIndices<Avx2>( src, v[0], v[1], g_bc7Weights4, 16, err, m.idx );
+        m.err = 0;
+        for( int i=0; i<16; i++ )
+        {
+            m.err += err[i];
+        }
+        if( m.err < best.err )
+        {
+            best = m;
+        }
+        if( m.err == 0 ) break;
+        float weight[16];
+        for( int i=0; i<16; i++ )
+        {
+            weight[i] = g_bc7Weights4[m.idx[i]] / 64.f;
+        }
+        if( !Refine( src, 16, weight, 4, e[0], e[1] ) ) break;
+    }
+}
+
+// Decoded endpoints of a subset of a mode 1 block
+void Endpoints( const Mode1& m, int s, int e[2][4] )
+{
+    for( int j=0; j<2; j++ )
+    {
+        for( int c=0; c<3; c++ )
+        {
+            e[j][c] = Expand7( m.q[s][j][c] * 2 + m.p[s] );
+        }
+        e[j][3] = 255;
+    }
+}
+
+// Encodes the subsets of the partition with the given endpoints
+template<bool Avx2>
+void EncodeMode1( const uint8* src, int part, const float e[2][2][4], Mode1& m )
+{
+    m.part = part;
+    uint32 err[2][16];
+    uint8 idx[2][16];
+    for( int s=0; s<2; s++ )
+    {
+        QuantizeMode1( e[s][0], e[s][1], m.q[s], m.p[s] );
+        int v[2][4];
+        Endpoints( m, s, v );
+        FindIndices<Avx2>( src, v[0], v[1], g_bc7Weights3, 8, err[s], idx[s] );
+    }
+    m.err = 0;
+    for( int i=0; i<16; i++ )
+    {
+        const int s = ( g_bc7Partitions2[part] >> i ) & 1;
+        m.err += err[s][i];
+        m.idx[i] = idx[s][i];
+    }
+}
+
+// The index of the first pixel of each subset has its highest bit left out. If it is set, the endpoints are swapped
+// and the indices inverted.
+void PackMode6( Mode6 m, uint64* dst )
+{
+    if( m.idx[0] & 8 )
+    {
+        for( int c=0; c<4; c++ )
+        {
+            std::swap( m.q[0][c], m.q[1][c] );
+        }
+        std::swap( m.p[0], m.p[1] );
+        for( int i=0; i<16; i++ )
+        {
+            m.idx[i] = 15 - m.idx[i];
+        }
+    }
+
+    BitWriter bw;
+    bw.Put( 1 << 6, 7 );
+    for( int c=0; c<4; c++ )
+    {
+        bw.Put( m.q[0][c], 7 );
+        bw.Put( m.q[1][c], 7 );
+    }
+    bw.Put( m.p[0], 1 );
+    bw.Put( m.p[1], 1 );
+    bw.Put( m.idx[0], 3 );
+    for( int i=1; i<16; i++ )
+    {
+        bw.Put( m.idx[i], 4 );
+    }
+    dst[0] = bw.d[0];
+    dst[1] = bw.d[1];
+}
+
+void PackMode1( Mode1 m, uint64* dst )
+{
+    const uint32 mask = g_bc7Partitions2[m.part];
+    const int anchor = g_bc7Anchor2[m.part];
+    for( int s=0; s<2; s++ )
+    {
+        if( !( m.idx[s == 0 ? 0 : anchor] & 4 ) ) continue;
+        for( int c=0; c<3; c++ )
+        {
+            std::swap( m.q[s][0][c], m.q[s][1][c] );
+        }
+        for( int i=0; i<16; i++ )
+        {
+            if( int( ( mask >> i ) & 1 ) == s )
+            {
+                m.idx[i] = 7 - m.idx[i];
+            }
+        }
+    }
+
+    BitWriter bw;
+    bw.Put( 1 << 1, 2 );
+    bw.Put( m.part, 6 );
+    for( int c=0; c<3; c++ )
+    {
+        bw.Put( m.q[0][0][c], 6 );
+        bw.Put( m.q[0][1][c], 6 );
+        bw.Put( m.q[1][0][c], 6 );
+        bw.Put( m.q[1][1][c], 6 );
+    }
+    bw.Put( m.p[0], 1 );
+    bw.Put( m.p[1], 1 );
+    for( int i=0; i<16; i++ )
+    {
+        bw.Put( m.idx[i], i == 0 || i == anchor ? 2 : 3 );
+    }
+    dst[0] = bw.d[0];
+    dst[1] = bw.d[1];
+}
+
+template<bool Avx2>
+void EncodeBC7( const uint8* src, uint64* dst )
+{
+    bool opaque = true;
+    for( int i=0; i<16; i++ )
+    {
+        opaque &= src[i*4+3] == 255;
+    }
+
+    float axis[4];
+    Mode6 m6;
+    EncodeMode6<Avx2>( src, opaque, axis, m6 );
+
+    // Mode 1 has less precise endpoints and indices, it pays off when the colors of the block do not lie on a line
+    if( opaque && m6.err > 16 )
+    {
+        float est[64];
+        EstimatePartitions<Avx2>( src, axis, est );
+
+        // The candidates are compared by the error of the line fits, only the best one is refitted
+        Mode1 m1;
+        m1.err = 0xFFFFFFFF;
+        float e1[2][2][4];
+        for( int k=0; k<Mode1Candidates; k++ )
+        {
+            const int part = int( std::min_element( est, est + 64 ) - est );
+            est[part] = std::numeric_limits<float>::max();
+
+            uint8 list[2][16];
+            const int n0 = ListPixels( ~g_bc7Partitions2[part] & 0xFFFF, list[0] );
+            const int n1 = ListPixels( g_bc7Partitions2[part], list[1] );
+            float e[2][2][4];
+            float sub[4];
+            FitSubset( src, list[0], n0, e[0][0], e[0][1], sub );
+            FitSubset( src, list[1], n1, e[1][0], e[1][1], sub );
+            Mode1 m;
+            EncodeMode1<Avx2>( src, part, e, m );
+            if( m.err < m1.err )
+            {
+                m1 = m;
+                memcpy( e1, e, sizeof( e ) );
+            }
+        }
+        if( m1.err != 0 )
+        {
+            uint8 list[2][16];
+            const int n0 = ListPixels( ~g_bc7Partitions2[m1.part] & 0xFFFF, list[0] );
+            const int n1 = ListPixels( g_bc7Partitions2[m1.part], list[1] );
+            RefineSubset( src, list[0], n0, m1.idx, g_bc7Weights3, 3, e1[0][0], e1[0][1] );
+            RefineSubset( src, list[1], n1, m1.idx, g_bc7Weights3, 3, e1[1][0], e1[1][1] );
+            Mode1 m;
+            EncodeMode1<Avx2>( src, m1.part, e1, m );
+            if( m.err < m1.err )
+            {
+                m1 = m;
+            }
+        }
+        if( m1.err < m6.err )
+        {
+            PackMode1( m1, dst );
+            return;
+        }
+    }
+    PackMode6( m6, dst );
+}
+
+}
+
+void ProcessBC7( const uint8* src, uint64* dst )
+{
+    EncodeBC7<false>( src, dst );
+}
+
+#ifdef __SSE4_1__
+void ProcessBC7_AVX2( const uint8* src, uint64* dst )
+{
+    EncodeBC7<true>( src, dst );
+}
+#endif
@@ -0,0 +1,15 @@
+#ifndef __PROCESSBC7_HPP__
+#define __PROCESSBC7_HPP__
+
+#include "Types.hpp"
+
+// Encodes 16 pixels, in RGBA byte order and row by row, as a BC7 block of two words. Blocks are encoded in mode 6, a
+// single subset with 4 bit indices, and opaque blocks also in mode 1, two subsets with 3 bit indices, in the partitions
+// with the least estimated error. The one with the lower error is kept.
+void ProcessBC7( const uint8* src, uint64* dst );
+#ifdef __SSE4_1__
+// Same as ProcessBC7, with the kernels of ProcessBC7_AVX2.cpp
+void ProcessBC7_AVX2( const uint8* src, uint64* dst );
+#endif
+
+#endif
@@ -0,0 +1,191 @@
+#ifdef __SSE4_1__
+
+#include <string.h>
+
+#include "ProcessBC7_AVX2.hpp"
+#include "Tables.hpp"
+#ifdef _MSC_VER
+#  include <intrin.h>
+#  define VS_VECTORCALL _vectorcall
+#else
+#  include <x86intrin.h>
+#  pragma GCC push_options
+#  pragma GCC target ("avx2,fma,bmi2")
+#  define VS_VECTORCALL
+#endif
+
+namespace
+{
+
+// Squared error of the line fits of 8 subsets, see LineError in ProcessBC7.cpp
+__m256 VS_VECTORCALL LineError_AVX2( __m256 n, const __m256 s[9], const float* axis )
+{
+    const __m256 inv = _mm256_div_ps(_mm256_set1_ps(1.f), n);
+    const __m256 c00 = _mm256_sub_ps(s[3], _mm256_mul_ps(_mm256_mul_ps(s[0], s[0]), inv));
+    const __m256 c11 = _mm256_sub_ps(s[4], _mm256_mul_ps(_mm256_mul_ps(s[1], s[1]), inv));
+    const __m256 c22 = _mm256_sub_ps(s[5], _mm256_mul_ps(_mm256_mul_ps(s[2], s[2]), inv));
+    const __m256 c01 = _mm256_sub_ps(s[6], _mm256_mul_ps(_mm256_mul_ps(s[0], s[1]), inv));
+    const __m256 c02 = _mm256_sub_ps(s[7], _mm256_mul_ps(_mm256_mul_ps(s[0], s[2]), inv));
+    const __m256 c12 = _mm256_sub_ps(s[8], _mm256_mul_ps(_mm256_mul_ps(s[1], s[2]), inv));
+
+    const __m256 a0 = _mm256_set1_ps(axis[0]);
+    const __m256 a1 = _mm256_set1_ps(axis[1]);
+    const __m256 a2 = _mm256_set1_ps(axis[2]);
+    const __m256 v0 = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(c00, a0), _mm256_mul_ps(c01, a1)), _mm256_mul_ps(c02, a2));
+    const __m256 v1 = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(c01, a0), _mm256_mul_ps(c11, a1)), _mm256_mul_ps(c12, a2));
+    const __m256 v2 = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(c02, a0), _mm256_mul_ps(c12, a1)), _mm256_mul_ps(c22, a2));
+    const __m256 w0 = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(c00, v0), _mm256_mul_ps(c01, v1)), _mm256_mul_ps(c02, v2));
+    const __m256 w1 = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(c01, v0), _mm256_mul_ps(c11, v1)), _mm256_mul_ps(c12, v2));
+    const __m256 w2 = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(c02, v0), _mm256_mul_ps(c12, v1)), _mm256_mul_ps(c22, v2));
+    const __m256 vv = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(v0, v0), _mm256_mul_ps(v1, v1)), _mm256_mul_ps(v2, v2));
+    const __m256 vw = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(v0, w0), _mm256_mul_ps(v1, w1)), _mm256_mul_ps(v2, w2));
+
+    const __m256 valid = _mm256_cmp_ps(vv, _mm256_set1_ps(1e-3f), _CMP_GT_OQ);
+    const __m256 var = _mm256_and_ps(_mm256_div_ps(vw, _mm256_max_ps(vv, _mm256_set1_ps(1e-3f))), valid);
+    return _mm256_sub_ps(_mm256_add_ps(_mm256_add_ps(c00, c11), c22), var);
+}
+
+}
+
+void FindIndicesBC7_AVX2( const uint8* src, const int* e0, const int* e1, const uint8* weights, int colors, uint32* err, uint8* idx )
+{
+    // Four pixels of 16 bit channels in each vector
+    const __m256i px0 = _mm256_cvtepu8_epi16(_mm_loadu_si128(((const __m128i*)src) + 0));
+    const __m256i px1 = _mm256_cvtepu8_epi16(_mm_loadu_si128(((const __m128i*)src) + 1));
+    const __m256i px2 = _mm256_cvtepu8_epi16(_mm_loadu_si128(((const __m128i*)src) + 2));
+    const __m256i px3 = _mm256_cvtepu8_epi16(_mm_loadu_si128(((const __m128i*)src) + 3));
+
+    // Palette of four colors in each vector, interpolated with the weights repeated for their channels
+    const __m256i v0 = _mm256_broadcastsi128_si256(_mm_packus_epi32(_mm_loadu_si128((const __m128i*)e0), _mm_loadu_si128((const __m128i*)e0)));
+    const __m256i v1 = _mm256_broadcastsi128_si256(_mm_packus_epi32(_mm_loadu_si128((const __m128i*)e1), _mm_loadu_si128((const __m128i*)e1)));
+    const __m128i w8 = colors == 16 ? _mm_loadu_si128((const __m128i*)weights) : _mm_loadl_epi64((const __m128i*)weights);
+    uint16 pal[16][4];
+    for( int k=0; k<colors; k+=4 )
+    {
+        const __m128i rep = _mm_add_epi8(_mm_setr_epi8(0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3), _mm_set1_epi8(k));
+        const __m256i w = _mm256_cvtepu8_epi16(_mm_shuffle_epi8(w8, rep));
+        const __m256i c = _mm256_add_epi16(_mm256_mullo_epi16(v0, _mm256_sub_epi16(_mm256_set1_epi16(64), w)), _mm256_mullo_epi16(v1, w));
+        _mm256_storeu_si256((__m256i*)pal[k], _mm256_srli_epi16(_mm256_add_epi16(c, _mm256_set1_epi16(32)), 6));
+    }
+
+    // The pixels' errors are in the order 0, 1, 4, 5, 2, 3, 6, 7 of hadd, the same for all colors
+    __m256i best0 = _mm256_set1_epi32(0x7FFFFFFF);
+    __m256i best1 = best0;
+    __m256i bidx0 = _mm256_setzero_si256();
+    __m256i bidx1 = bidx0;
+    for( int k=0; k<colors; k++ )
+    {
+        int64 c;
+        memcpy( &c, pal[k], 8 );
+        const __m256i pc = _mm256_set1_epi64x(c);
+
+        const __m256i d0 = _mm256_sub_epi16(px0, pc);
+        const __m256i d1 = _mm256_sub_epi16(px1, pc);
+        const __m256i d2 = _mm256_sub_epi16(px2, pc);
+        const __m256i d3 = _mm256_sub_epi16(px3, pc);
+        const __m256i e0 = _mm256_hadd_epi32(_mm256_madd_epi16(d0, d0), _mm256_madd_epi16(d1, d1));
+        const __m256i e1 = _mm256_hadd_epi32(_mm256_madd_epi16(d2, d2), _mm256_madd_epi16(d3, d3));
+
+        const __m256i kv = _mm256_set1_epi32(k);
+        const __m256i lt0 = _mm256_cmpgt_epi32(best0, e0);
+        const __m256i lt1 = _mm256_cmpgt_epi32(best1, e1);
+        best0 = _mm256_min_epi32(best0, e0);
+        best1 = _mm256_min_epi32(best1, e1);
+        bidx0 = _mm256_blendv_epi8(bidx0, kv, lt0);
+        bidx1 = _mm256_blendv_epi8(bidx1, kv, lt1);
+    }
+
+    best0 = _mm256_permute4x64_epi64(best0, _MM_SHUFFLE(3, 1, 2, 0));
+    best1 = _mm256_permute4x64_epi64(best1, _MM_SHUFFLE(3, 1, 2, 0));
+    bidx0 = _mm256_permute4x64_epi64(bidx0, _MM_SHUFFLE(3, 1, 2, 0));
+    bidx1 = _mm256_permute4x64_epi64(bidx1, _MM_SHUFFLE(3, 1, 2, 0));
+    _mm256_storeu_si256(((__m256i*)err) + 0, best0);
+    _mm256_storeu_si256(((__m256i*)err) + 1, best1);
+
+    // Indices fit in bytes, the packs keep their order within the lanes
+    const __m256i i16 = _mm256_permute4x64_epi64(_mm256_packus_epi32(bidx0, bidx1), _MM_SHUFFLE(3, 1, 2, 0));
+    const __m128i i8 = _mm_packus_epi16(_mm256_castsi256_si128(i16), _mm256_extracti128_si256(i16, 1));
+    _mm_storeu_si128((__m128i*)idx, i8);
+}
+
+void EstimatePartitionsBC7_AVX2( const uint8* src, const float* axis, float* est )
+{
+    // Moments of the pixels: r, g, b, rr, gg, bb, rg, rb, gb and the count
+    float m[16][10];
+    float total[10] = {};
+    for( int i=0; i<16; i++ )
+    {
+        const float r = src[i*4];
+        const float g = src[i*4+1];
+        const float b = src[i*4+2];
+        m[i][0] = r;
+        m[i][1] = g;
+        m[i][2] = b;
+        m[i][3] = r * r;
+        m[i][4] = g * g;
+        m[i][5] = b * b;
+        m[i][6] = r * g;
+        m[i][7] = r * b;
+        m[i][8] = g * b;
+        m[i][9] = 1;
+        for( int k=0; k<10; k++ )
+        {
+            total[k] += m[i][k];
+        }
+    }
+
+    // Sums of the moments over each of the 16 sets of pixels of a row, in two vectors. The partitions' masks index
+    // them by their 4 bits of the row.
+    const __m256 in0 = _mm256_castsi256_ps(_mm256_setr_epi32(0, -1, 0, -1, 0, -1, 0, -1));
+    const __m256 in1 = _mm256_castsi256_ps(_mm256_setr_epi32(0, 0, -1, -1, 0, 0, -1, -1));
+    const __m256 in2 = _mm256_castsi256_ps(_mm256_setr_epi32(0, 0, 0, 0, -1, -1, -1, -1));
+    __m256 row[4][10][2];
+    for( int r=0; r<4; r++ )
+    {
+        for( int k=0; k<10; k++ )
+        {
+            const __m256 s0 = _mm256_and_ps(in0, _mm256_set1_ps(m[r*4][k]));
+            const __m256 s1 = _mm256_and_ps(in1, _mm256_set1_ps(m[r*4+1][k]));
+            const __m256 s2 = _mm256_and_ps(in2, _mm256_set1_ps(m[r*4+2][k]));
+            row[r][k][0] = _mm256_add_ps(_mm256_add_ps(s0, s1), s2);
+            row[r][k][1] = _mm256_add_ps(row[r][k][0], _mm256_set1_ps(m[r*4+3][k]));
+        }
+    }
+
+    // 8 partitions at once, the second subsets are looked up and the first ones get the rest
+    for( int p=0; p<64; p+=8 )
+    {
+        const __m256i masks = _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i*)( g_bc7Partitions2 + p )));
+        __m256 s1[10];
+        for( int k=0; k<10; k++ )
+        {
+            s1[k] = _mm256_setzero_ps();
+        }
+        for( int r=0; r<4; r++ )
+        {
+            const __m256i idx = _mm256_and_si256(_mm256_srli_epi32(masks, r*4), _mm256_set1_epi32(0xF));
+            // The highest bit of the index picks the vector, by the sign of the blend mask
+            const __m256 hi = _mm256_castsi256_ps(_mm256_slli_epi32(idx, 28));
+            for( int k=0; k<10; k++ )
+            {
+                const __m256 v0 = _mm256_permutevar8x32_ps(row[r][k][0], idx);
+                const __m256 v1 = _mm256_permutevar8x32_ps(row[r][k][1], idx);
+                s1[k] = _mm256_add_ps(s1[k], _mm256_blendv_ps(v0, v1, hi));
+            }
+        }
+
+        __m256 s0[10];
+        for( int k=0; k<10; k++ )
+        {
+            s0[k] = _mm256_sub_ps(_mm256_set1_ps(total[k]), s1[k]);
+        }
+
+        _mm256_storeu_ps(est + p, _mm256_add_ps(LineError_AVX2( s0[9], s0, axis ), LineError_AVX2( s1[9], s1, axis )));
+    }
+}
+
+#ifndef _MSC_VER
+#  pragma GCC pop_options
+#endif
+
+#endif
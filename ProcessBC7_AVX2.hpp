@@ -0,0 +1,17 @@
+#ifndef __PROCESSBC7_AVX2_HPP__
+#define __PROCESSBC7_AVX2_HPP__
+
+#ifdef __SSE4_1__
+
+#include "Types.hpp"
+
+// Finds the closest of the colors interpolated between two RGBA endpoints with the given weights, 8 or 16 of them, to
+// each of the 16 pixels of a BC7 block. The squared error of each pixel goes to err, the index of its color to idx.
+void FindIndicesBC7_AVX2( const uint8* src, const int* e0, const int* e1, const uint8* weights, int colors, uint32* err, uint8* idx );
+// Estimates the error of the 64 two subset partitions of an opaque block. Each subset is fitted with a line along the
+// principal axis of its colors, which is found from the given axis of the block.
+void EstimatePartitionsBC7_AVX2( const uint8* src, const float* axis, float* est );
+
+#endif
+
+#endif
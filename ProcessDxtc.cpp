@@ -0,0 +1,577 @@
+#include <algorithm>
+#include <limits>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "Math.hpp"
+#include "ProcessDxtc.hpp"
+#include "ProcessFit.hpp"
+#include "Tables.hpp"
+#ifdef __SSE4_1__
+#  ifdef _MSC_VER
+#    include <intrin.h>
+#  else
+#    include <x86intrin.h>
+#  endif
+#endif
+
+namespace
+{
+
+// 8 bit value scaled to 0..max, rounded to nearest
+inline int Quantize( int v, int max )
+{
+    const int t = v * max + 128;
+    return ( t + ( t >> 8 ) ) >> 8;
+}
+
+inline uint16 To565( int r, int g, int b )
+{
+    return ( Quantize( r, 31 ) << 11 ) | ( Quantize( g, 63 ) << 5 ) | Quantize( b, 31 );
+}
+
+// Colors of the block in RGB order, as the decoder sees them. The fourth one of the three color mode is transparent
+// and is never picked for opaque pixels.
+void Palette( uint16 c0, uint16 c1, int pal[4][3] )
+{
+    const int e[2][3] = {
+        { ( ( c0 >> 8 ) & 0xF8 ) | ( c0 >> 13 ), ( ( c0 >> 3 ) & 0xFC ) | ( ( c0 >> 9 ) & 0x3 ), ( ( c0 << 3 ) & 0xF8 ) | ( ( c0 >> 2 ) & 0x7 ) },
+        { ( ( c1 >> 8 ) & 0xF8 ) | ( c1 >> 13 ), ( ( c1 >> 3 ) & 0xFC ) | ( ( c1 >> 9 ) & 0x3 ), ( ( c1 << 3 ) & 0xF8 ) | ( ( c1 >> 2 ) & 0x7 ) }
+    };
+    for( int c=0; c<3; c++ )
+    {
+        pal[0][c] = e[0][c];
+        pal[1][c] = e[1][c];
+        if( c0 > c1 )
+        {
+            pal[2][c] = ( 2 * e[0][c] + e[1][c] ) / 3;
+            pal[3][c] = ( e[0][c] + 2 * e[1][c] ) / 3;
+        }
+        else
+        {
+            pal[2][c] = ( e[0][c] + e[1][c] ) / 2;
+            pal[3][c] = 0;
+        }
+    }
+}
+
+// Picks the closest color for each pixel, transparent ones get index 3. Returns the sum of squared errors.
+uint32 FindSelectors( const uint8* src, uint32 transparent, uint16 c0, uint16 c1, uint32& sel )
+{
+    int pal[4][3];
+    Palette( c0, c1, pal );
+    const int colors = c0 > c1 ? 4 : 3;
+
+    uint32 err[16];
+    uint32 idx[16];
+#ifdef __SSE4_1__
+    __m128i pc[4];
+    for( int k=0; k<colors; k++ )
+    {
+        pc[k] = _mm_setr_epi16(pal[k][0], pal[k][1], pal[k][2], 0, pal[k][0], pal[k][1], pal[k][2], 0);
+    }
+    const __m128i mask = _mm_set1_epi32(0x00FFFFFF);
+    for( int i=0; i<4; i++ )
+    {
+        // Alpha is left out of the distance
+        __m128i px = _mm_and_si128(_mm_loadu_si128(((const __m128i*)src) + i), mask);
+        __m128i lo = _mm_unpacklo_epi8(px, _mm_setzero_si128());
+        __m128i hi = _mm_unpackhi_epi8(px, _mm_setzero_si128());
+
+        __m128i best, bidx = _mm_setzero_si128();
+        for( int k=0; k<colors; k++ )
+        {
+            __m128i dl = _mm_sub_epi16(lo, pc[k]);
+            __m128i dh = _mm_sub_epi16(hi, pc[k]);
+            __m128i e = _mm_hadd_epi32(_mm_madd_epi16(dl, dl), _mm_madd_epi16(dh, dh));
+            if( k == 0 )
+            {
+                best = e;
+            }
+            else
+            {
+                __m128i lt = _mm_cmplt_epi32(e, best);
+                best = _mm_min_epi32(e, best);
+                bidx = _mm_blendv_epi8(bidx, _mm_set1_epi32(k), lt);
+            }
+        }
+        _mm_storeu_si128(((__m128i*)err) + i, best);
+        _mm_storeu_si128(((__m128i*)idx) + i, bidx);
+    }
+#else
+    for( int i=0; i<16; i++ )
+    {
+        const uint8* px = src + i*4;
+        for( int k=0; k<colors; k++ )
+        {
+            const uint32 e = sq( px[0] - pal[k][0] ) + sq( px[1] - pal[k][1] ) + sq( px[2] - pal[k][2] );
+            if( k == 0 || e < err[i] )
+            {
+                err[i] = e;
+                idx[i] = k;
+            }
+        }
+    }
+#endif
+
+    uint32 total = 0;
+    sel = 0;
+    for( int i=0; i<16; i++ )
+    {
+        if( transparent & ( 1 << i ) )
+        {
+            sel |= 3u << ( i*2 );
+        }
+        else
+        {
+            total += err[i];
+            sel |= idx[i] << ( i*2 );
+        }
+    }
+    return total;
+}
+
+// Puts the endpoints in the order of the mode: c0 > c1 for four colors, c0 <= c1 for three. Equal endpoints can only
+// be stored in the three color mode, where index 0 still gives their color.
+inline void Order( uint16& c0, uint16& c1, bool three )
+{
+    if( three ? c0 > c1 : c0 < c1 )
+    {
+        std::swap( c0, c1 );
+    }
+}
+
+// Least squares endpoints for the selected indices
+bool Refine( const uint8* src, uint32 transparent, uint32 sel, bool four, uint16& c0, uint16& c1 )
+{
+    // Shares of c0
+    static const float w4[4] = { 1.f, 0.f, 2.f/3, 1.f/3 };
+    static const float w3[4] = { 1.f, 0.f, 0.5f, 0.f };
+    const float* w = four ? w4 : w3;
+
+    uint8 px[16*4];
+    float weight[16];
+    int n = 0;
+    for( int i=0; i<16; i++ )
+    {
+        if( transparent & ( 1 << i ) ) continue;
+        memcpy( px + n*4, src + i*4, 4 );
+        weight[n++] = w[( sel >> ( i*2 ) ) & 0x3];
+    }
+
+    float e[2][4];
+    if( !::Refine( px, n, weight, 3, e[1], e[0] ) ) return false;
+
+    c0 = To565( int( e[0][0] + 0.5f ), int( e[0][1] + 0.5f ), int( e[0][2] + 0.5f ) );
+    c1 = To565( int( e[1][0] + 0.5f ), int( e[1][1] + 0.5f ), int( e[1][2] + 0.5f ) );
+    return true;
+}
+
+// Selects the pixels' colors for the given endpoints, then refits the endpoints once and keeps them if they are better
+uint64 Fit( const uint8* src, uint32 transparent, uint16 c0, uint16 c1 )
+{
+    const bool three = transparent != 0;
+    Order( c0, c1, three );
+    uint32 sel;
+    uint32 err = FindSelectors( src, transparent, c0, c1, sel );
+
+    uint16 r0, r1;
+    if( err != 0 && Refine( src, transparent, sel, c0 > c1, r0, r1 ) )
+    {
+        Order( r0, r1, three );
+        uint32 rsel;
+        const uint32 rerr = FindSelectors( src, transparent, r0, r1, rsel );
+        if( rerr < err )
+        {
+            c0 = r0;
+            c1 = r1;
+            sel = rsel;
+        }
+    }
+
+    return uint64( c0 ) | ( uint64( c1 ) << 16 ) | ( uint64( sel ) << 32 );
+}
+
+uint64 SolidColor( const uint8* px, uint32 transparent )
+{
+    uint16 c0, c1;
+    uint32 sel;
+    if( transparent == 0 )
+    {
+        // Two thirds of the way between the best pair of endpoints
+        c0 = ( g_dxtMatch5[px[0]][0] << 11 ) | ( g_dxtMatch6[px[1]][0] << 5 ) | g_dxtMatch5[px[2]][0];
+        c1 = ( g_dxtMatch5[px[0]][1] << 11 ) | ( g_dxtMatch6[px[1]][1] << 5 ) | g_dxtMatch5[px[2]][1];
+        if( c0 > c1 )
+        {
+            sel = 0xAAAAAAAA;
+        }
+        else if( c0 < c1 )
+        {
+            std::swap( c0, c1 );
+            sel = 0xFFFFFFFF;
+        }
+        else
+        {
+            sel = 0;
+        }
+    }
+    else
+    {
+        c0 = c1 = To565( px[0], px[1], px[2] );
+        sel = 0;
+        for( int i=0; i<16; i++ )
+        {
+            if( transparent & ( 1 << i ) )
+            {
+                sel |= 3u << ( i*2 );
+            }
+        }
+    }
+    return uint64( c0 ) | ( uint64( c1 ) << 16 ) | ( uint64( sel ) << 32 );
+}
+
+
+#ifdef __SSE4_1__
+inline int MinBytes( __m128i v )
+{
+    v = _mm_min_epu8(v, _mm_shuffle_epi32(v, _MM_SHUFFLE(1, 0, 3, 2)));
+    v = _mm_min_epu8(v, _mm_shuffle_epi32(v, _MM_SHUFFLE(2, 3, 0, 1)));
+    v = _mm_min_epu8(v, _mm_srli_epi32(v, 16));
+    v = _mm_min_epu8(v, _mm_srli_epi16(v, 8));
+    return _mm_cvtsi128_si32(v) & 0xFF;
+}
+
+inline int MaxBytes( __m128i v )
+{
+    v = _mm_max_epu8(v, _mm_shuffle_epi32(v, _MM_SHUFFLE(1, 0, 3, 2)));
+    v = _mm_max_epu8(v, _mm_shuffle_epi32(v, _MM_SHUFFLE(2, 3, 0, 1)));
+    v = _mm_max_epu8(v, _mm_srli_epi32(v, 16));
+    v = _mm_max_epu8(v, _mm_srli_epi16(v, 8));
+    return _mm_cvtsi128_si32(v) & 0xFF;
+}
+#endif
+
+// Picks the closest of the eight palette values for each of the 16 values, as packed 3-bit indices. Returns the sum of
+// squared errors.
+uint32 FindBC4Indices( const uint8* src, const uint8 pal[8], uint64& sel )
+{
+#ifdef __SSE4_1__
+    const __m128i v = _mm_loadu_si128((const __m128i*)src);
+    __m128i best = _mm_max_epu8(_mm_subs_epu8(v, _mm_set1_epi8(pal[0])), _mm_subs_epu8(_mm_set1_epi8(pal[0]), v));
+    __m128i idx = _mm_setzero_si128();
+    for( int k=1; k<8; k++ )
+    {
+        const __m128i p = _mm_set1_epi8(pal[k]);
+        const __m128i d = _mm_max_epu8(_mm_subs_epu8(v, p), _mm_subs_epu8(p, v));
+        const __m128i m = _mm_min_epu8(d, best);
+        idx = _mm_blendv_epi8(idx, _mm_set1_epi8(k), _mm_cmpeq_epi8(m, d));
+        best = m;
+    }
+
+    // 3-bit indices packed to 6 bits per pair and 12 bits per four values
+    const __m128i p16 = _mm_maddubs_epi16(idx, _mm_set1_epi16(0x0801));
+    const __m128i p32 = _mm_madd_epi16(p16, _mm_set1_epi32(0x00400001));
+    sel =
+        uint64( _mm_extract_epi32(p32, 0) ) |
+        ( uint64( _mm_extract_epi32(p32, 1) ) << 12 ) |
+        ( uint64( _mm_extract_epi32(p32, 2) ) << 24 ) |
+        ( uint64( _mm_extract_epi32(p32, 3) ) << 36 );
+
+    const __m128i lo = _mm_unpacklo_epi8(best, _mm_setzero_si128());
+    const __m128i hi = _mm_unpackhi_epi8(best, _mm_setzero_si128());
+    __m128i sum = _mm_add_epi32(_mm_madd_epi16(lo, lo), _mm_madd_epi16(hi, hi));
+    sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(1, 0, 3, 2)));
+    sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(2, 3, 0, 1)));
+    return _mm_cvtsi128_si32(sum);
+#else
+    uint32 err = 0;
+    sel = 0;
+    for( int i=0; i<16; i++ )
+    {
+        int best = 256, bidx = 0;
+        for( int k=0; k<8; k++ )
+        {
+            const int d = abs( src[i] - pal[k] );
+            if( d <= best )
+            {
+                best = d;
+                bidx = k;
+            }
+        }
+        err += best * best;
+        sel |= uint64( bidx ) << ( i*3 );
+    }
+    return err;
+#endif
+}
+
+}
+
+uint64 ProcessBC1( const uint8* src )
+{
+    uint32 transparent = 0;
+    for( int i=0; i<16; i++ )
+    {
+        if( src[i*4+3] < 128 )
+        {
+            transparent |= 1 << i;
+        }
+    }
+    if( transparent == 0xFFFF )
+    {
+        // Three color mode with equal endpoints, all pixels transparent
+        return 0xFFFFFFFF00000000ull;
+    }
+
+    int first = 0;
+    while( transparent & ( 1 << first ) ) first++;
+    const uint32 ref = ( src[first*4] ) | ( src[first*4+1] << 8 ) | ( src[first*4+2] << 16 );
+
+    float mean[3] = {};
+    int vmin[3] = { 255, 255, 255 };
+    int vmax[3] = { 0, 0, 0 };
+    int n = 0;
+    bool solid = true;
+    for( int i=0; i<16; i++ )
+    {
+        if( transparent & ( 1 << i ) ) continue;
+        const uint8* px = src + i*4;
+        for( int c=0; c<3; c++ )
+        {
+            mean[c] += px[c];
+            vmin[c] = std::min<int>( vmin[c], px[c] );
+            vmax[c] = std::max<int>( vmax[c], px[c] );
+        }
+        solid &= uint32( px[0] | ( px[1] << 8 ) | ( px[2] << 16 ) ) == ref;
+        n++;
+    }
+    if( solid )
+    {
+        return SolidColor( src + first*4, transparent );
+    }
+
+    for( int c=0; c<3; c++ )
+    {
+        mean[c] /= n;
+    }
+    float cov[6] = {};
+    for( int i=0; i<16; i++ )
+    {
+        if( transparent & ( 1 << i ) ) continue;
+        const float r = src[i*4] - mean[0];
+        const float g = src[i*4+1] - mean[1];
+        const float b = src[i*4+2] - mean[2];
+        cov[0] += r*r;
+        cov[1] += r*g;
+        cov[2] += r*b;
+        cov[3] += g*g;
+        cov[4] += g*b;
+        cov[5] += b*b;
+    }
+
+    // Starts from the diagonal of the bounding box
+    float axis[3] = { float( vmax[0] - vmin[0] ), float( vmax[1] - vmin[1] ), float( vmax[2] - vmin[2] ) };
+    PrincipalAxis<3>( cov, axis );
+
+    // Extreme pixels along the axis
+    int imin = first, imax = first;
+    float dmin = 1e30f, dmax = -1e30f;
+    for( int i=0; i<16; i++ )
+    {
+        if( transparent & ( 1 << i ) ) continue;
+        const float d = src[i*4] * axis[0] + src[i*4+1] * axis[1] + src[i*4+2] * axis[2];
+        if( d < dmin ) { dmin = d; imin = i; }
+        if( d > dmax ) { dmax = d; imax = i; }
+    }
+
+    const uint16 c0 = To565( src[imax*4], src[imax*4+1], src[imax*4+2] );
+    const uint16 c1 = To565( src[imin*4], src[imin*4+1], src[imin*4+2] );
+    return Fit( src, transparent, c0, c1 );
+}
+
+uint64 TranscodeBC1( uint64 etc, const uint8* src, bool refine )
+{
+    const uint64 d =
+        ( ( etc & 0xFF000000FF000000 ) >> 24 ) |
+        ( ( etc & 0x000000FF000000FF ) << 24 ) |
+        ( ( etc & 0x00FF000000FF0000 ) >> 8 ) |
+        ( ( etc & 0x0000FF000000FF00 ) << 8 );
+
+    int base[2][3];
+    if( d & 0x2 )
+    {
+        for( int c=0; c<3; c++ )
+        {
+            const int shift = 27 - c * 8;
+            const int b = ( d >> shift ) & 0x1F;
+            const int delta = int( ( d >> ( shift - 3 ) ) & 0x7 ) - ( ( d >> ( shift - 3 ) ) & 0x4 ? 8 : 0 );
+            if( b + delta < 0 || b + delta > 31 )
+            {
+                // ETC2 T, H or planar block
+                return ProcessBC1( src );
+            }
+            base[0][c] = ( b << 3 ) | ( b >> 2 );
+            base[1][c] = ( ( b + delta ) << 3 ) | ( ( b + delta ) >> 2 );
+        }
+    }
+    else
+    {
+        for( int c=0; c<3; c++ )
+        {
+            const int shift = 28 - c * 8;
+            base[0][c] = ( ( d >> shift ) & 0xF ) * 17;
+            base[1][c] = ( ( d >> ( shift - 4 ) ) & 0xF ) * 17;
+        }
+    }
+    const uint tcw[2] = { uint( d & 0xE0 ) >> 5, uint( d & 0x1C ) >> 2 };
+
+    // Palette of both subblocks, and the entry used by each pixel in row-major order
+    int pal[8][3];
+    for( int s=0; s<2; s++ )
+    {
+        for( int k=0; k<4; k++ )
+        {
+            for( int c=0; c<3; c++ )
+            {
+                pal[s*4+k][c] = clampu8( base[s][c] + g_table[tcw[s]][k] );
+            }
+        }
+    }
+    uint8 entry[16];
+    int count[8] = {};
+    for( int x=0; x<4; x++ )
+    {
+        for( int y=0; y<4; y++ )
+        {
+            const int o = x * 4 + y;
+            const int idx = ( ( d >> ( o + 32 ) ) & 0x1 ) | ( ( d >> ( o + 47 ) ) & 0x2 );
+            const int sub = ( d & 0x1 ) ? ( y >> 1 ) : ( x >> 1 );
+            entry[y*4+x] = sub * 4 + idx;
+            count[sub * 4 + idx]++;
+        }
+    }
+
+    // The farthest pair of used palette colors
+    int used[8];
+    int n = 0;
+    for( int e=0; e<8; e++ )
+    {
+        if( count[e] != 0 ) used[n++] = e;
+    }
+    int best = -1, i0 = used[0], i1 = used[0];
+    for( int i=0; i<n; i++ )
+    {
+        for( int j=i+1; j<n; j++ )
+        {
+            const int dist = sq( pal[used[i]][0] - pal[used[j]][0] ) + sq( pal[used[i]][1] - pal[used[j]][1] ) + sq( pal[used[i]][2] - pal[used[j]][2] );
+            if( dist > best )
+            {
+                best = dist;
+                i0 = used[i];
+                i1 = used[j];
+            }
+        }
+    }
+    if( best <= 0 )
+    {
+        const uint8 px[3] = { uint8( pal[i0][0] ), uint8( pal[i0][1] ), uint8( pal[i0][2] ) };
+        return SolidColor( px, 0 );
+    }
+    const int* e0 = pal[i0];
+    const int* e1 = pal[i1];
+    uint16 c0 = To565( e0[0], e0[1], e0[2] );
+    uint16 c1 = To565( e1[0], e1[1], e1[2] );
+
+    if( refine )
+    {
+        return Fit( src, 0, c0, c1 );
+    }
+
+    // Selectors of the palette entries, which the pixels share
+    Order( c0, c1, false );
+    int bc1[4][3];
+    Palette( c0, c1, bc1 );
+    const int colors = c0 > c1 ? 4 : 3;
+    uint32 map[8];
+    for( int e=0; e<8; e++ )
+    {
+        if( count[e] == 0 ) continue;
+        int best = std::numeric_limits<int>::max();
+        for( int k=0; k<colors; k++ )
+        {
+            const int err = sq( pal[e][0] - bc1[k][0] ) + sq( pal[e][1] - bc1[k][1] ) + sq( pal[e][2] - bc1[k][2] );
+            if( err < best )
+            {
+                best = err;
+                map[e] = k;
+            }
+        }
+    }
+    uint32 sel = 0;
+    for( int i=0; i<16; i++ )
+    {
+        sel |= map[entry[i]] << ( i*2 );
+    }
+    return uint64( c0 ) | ( uint64( c1 ) << 16 ) | ( uint64( sel ) << 32 );
+}
+
+uint64 ProcessBC4( const uint8* src )
+{
+#ifdef __SSE4_1__
+    const __m128i v = _mm_loadu_si128((const __m128i*)src);
+    // Without the values 0 and 255, for the six value mode
+    const __m128i zero = _mm_cmpeq_epi8(v, _mm_setzero_si128());
+    const __m128i full = _mm_cmpeq_epi8(v, _mm_set1_epi8(-1));
+    const int vmin = MinBytes( v );
+    const int vmax = MaxBytes( v );
+    const int inner0 = MinBytes( _mm_or_si128(v, zero) );
+    const int inner1 = MaxBytes( _mm_andnot_si128(full, v) );
+#else
+    int vmin = 255, vmax = 0, inner0 = 255, inner1 = 0;
+    for( int i=0; i<16; i++ )
+    {
+        vmin = std::min<int>( vmin, src[i] );
+        vmax = std::max<int>( vmax, src[i] );
+        if( src[i] != 0 ) inner0 = std::min<int>( inner0, src[i] );
+        if( src[i] != 255 ) inner1 = std::max<int>( inner1, src[i] );
+    }
+#endif
+    if( vmin == vmax )
+    {
+        // Six value mode, all indices 0
+        return vmin | ( vmin << 8 );
+    }
+
+    // Eight value mode: the endpoints, then six values between them from a0 to a1
+    uint8 pal[8];
+    pal[0] = vmax;
+    pal[1] = vmin;
+    for( int k=2; k<8; k++ )
+    {
+        pal[k] = ( ( 8 - k ) * vmax + ( k - 1 ) * vmin ) / 7;
+    }
+    uint64 sel;
+    uint32 err = FindBC4Indices( src, pal, sel );
+    uint64 block = uint64( vmax ) | ( uint64( vmin ) << 8 ) | ( sel << 16 );
+
+    if( err != 0 && ( vmin == 0 || vmax == 255 ) )
+    {
+        // Six value mode: a0 <= a1, four values between them, then 0 and 255
+        const int a0 = inner0 <= inner1 ? inner0 : 0;
+        const int a1 = inner0 <= inner1 ? inner1 : 0;
+        pal[0] = a0;
+        pal[1] = a1;
+        for( int k=2; k<6; k++ )
+        {
+            pal[k] = ( ( 6 - k ) * a0 + ( k - 1 ) * a1 ) / 5;
+        }
+        pal[6] = 0;
+        pal[7] = 255;
+        if( FindBC4Indices( src, pal, sel ) < err )
+        {
+            block = uint64( a0 ) | ( uint64( a1 ) << 8 ) | ( sel << 16 );
+        }
+    }
+    return block;
+}
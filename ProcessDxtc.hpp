@@ -0,0 +1,20 @@
+#ifndef __PROCESSDXTC_HPP__
+#define __PROCESSDXTC_HPP__
+
+#include "Types.hpp"
+
+// Encodes 16 pixels, in RGBA byte order and row by row (the input of squish::Compress), as a BC1 (DXT1) block. Pixels
+// with alpha below 128 are transparent, blocks with any of them use the three color mode.
+uint64 ProcessBC1( const uint8* src );
+
+// Converts an ETC1 block, in the byte order of the encoders' output, to an opaque BC1 block. The endpoints are fitted
+// to the palette colors the block uses. Without refine, the selectors are mapped from the palette entries, otherwise
+// they are searched on the pixels, which then refit the endpoints once. Src holds the pixels as for ProcessBC1: the
+// source of the block, or its decoded colors. ETC2 T, H and planar blocks are encoded from them.
+uint64 TranscodeBC1( uint64 etc, const uint8* src, bool refine );
+
+// Encodes 16 values of a single channel, row by row, as a BC4 block. The alpha blocks of BC3 and both halves of BC5
+// blocks are the same.
+uint64 ProcessBC4( const uint8* src );
+
+#endif
@@ -0,0 +1,191 @@
+#ifndef __PROCESSFIT_HPP__
+#define __PROCESSFIT_HPP__
+
+#include <algorithm>
+#include <math.h>
+#include <string.h>
+
+#include "Types.hpp"
+
+// Writes the fields of a 128-bit block, lowest bits first
+struct BitWriter
+{
+    uint64 d[2];
+    int pos;
+
+    BitWriter() : pos( 0 ) { d[0] = d[1] = 0; }
+
+    void Put( uint32 v, int bits )
+    {
+        if( pos < 64 )
+        {
+            d[0] |= uint64( v ) << pos;
+            if( pos + bits > 64 )
+            {
+                d[1] |= uint64( v ) >> ( 64 - pos );
+            }
+        }
+        else
+        {
+            d[1] |= uint64( v ) << ( pos - 64 );
+        }
+        pos += bits;
+    }
+};
+
+// Index of a pair of channels in a covariance of N channels stored as its upper triangle, row by row
+template<int N>
+static inline int TriangleIndex( int c, int d )
+{
+    if( c > d ) std::swap( c, d );
+    return c * N - c * ( c - 1 ) / 2 + d - c;
+}
+
+// Refines the principal axis of the covariance of N channels by power iteration
+template<int N>
+static inline void PrincipalAxis( const float* cov, float* axis )
+{
+    for( int k=0; k<4; k++ )
+    {
+        float v[N] = {};
+        float m = 0;
+        for( int c=0; c<N; c++ )
+        {
+            for( int d=0; d<N; d++ )
+            {
+                v[c] += cov[TriangleIndex<N>( c, d )] * axis[d];
+            }
+            m = std::max( m, fabs( v[c] ) );
+        }
+        if( m == 0 ) break;
+        const float inv = 1.f / m;
+        for( int c=0; c<N; c++ )
+        {
+            axis[c] = v[c] * inv;
+        }
+    }
+}
+
+// Sums of the channels of RGBA pixels and of their products, in the order rr rg rb ra gg gb ga bb ba aa
+static inline void Moments( const uint8* src, int n, int sum[4], int prod[10] )
+{
+    memset( sum, 0, 4 * sizeof( int ) );
+    memset( prod, 0, 10 * sizeof( int ) );
+    for( int i=0; i<n; i++ )
+    {
+        const int r = src[i*4];
+        const int g = src[i*4+1];
+        const int b = src[i*4+2];
+        const int a = src[i*4+3];
+        sum[0] += r;
+        sum[1] += g;
+        sum[2] += b;
+        sum[3] += a;
+        prod[0] += r * r;
+        prod[1] += r * g;
+        prod[2] += r * b;
+        prod[3] += r * a;
+        prod[4] += g * g;
+        prod[5] += g * b;
+        prod[6] += g * a;
+        prod[7] += b * b;
+        prod[8] += b * a;
+        prod[9] += a * a;
+    }
+}
+
+// Fits a line to the first channels of the pixels along their principal axis, which goes to axis. The endpoints are
+// the projections of the extreme pixels. Takes the moments of the pixels.
+static inline void FitLine( const uint8* src, int n, int channels, const int sum[4], const int prod[10], float e0[4], float e1[4], float axis[4] )
+{
+    const float inv = 1.f / n;
+    float mean[4];
+    for( int c=0; c<4; c++ )
+    {
+        mean[c] = sum[c] * inv;
+    }
+    float cov[10];
+    for( int c=0; c<4; c++ )
+    {
+        for( int d=c; d<4; d++ )
+        {
+            cov[TriangleIndex<4>( c, d )] = prod[TriangleIndex<4>( c, d )] - sum[c] * mean[d];
+        }
+    }
+
+    // Starts from the covariance of the channel with the largest variance
+    const float var[4] = { cov[0], cov[4], cov[7], cov[9] };
+    const int k = int( std::max_element( var, var + channels ) - var );
+    for( int c=0; c<4; c++ )
+    {
+        axis[c] = c < channels ? cov[TriangleIndex<4>( k, c )] : 0;
+    }
+    if( channels == 4 )
+    {
+        PrincipalAxis<4>( cov, axis );
+    }
+    else
+    {
+        const float rgb[6] = { cov[0], cov[1], cov[2], cov[4], cov[5], cov[7] };
+        PrincipalAxis<3>( rgb, axis );
+    }
+
+    const float len = sqrt( axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2] + axis[3] * axis[3] );
+    float tmin = 0, tmax = 0;
+    if( len > 0 )
+    {
+        for( int c=0; c<4; c++ )
+        {
+            axis[c] /= len;
+        }
+        for( int i=0; i<n; i++ )
+        {
+            float t = 0;
+            for( int c=0; c<channels; c++ )
+            {
+                t += ( src[i*4+c] - mean[c] ) * axis[c];
+            }
+            tmin = std::min( tmin, t );
+            tmax = std::max( tmax, t );
+        }
+    }
+    for( int c=0; c<4; c++ )
+    {
+        e0[c] = std::min( 255.f, std::max( 0.f, mean[c] + axis[c] * tmin ) );
+        e1[c] = std::min( 255.f, std::max( 0.f, mean[c] + axis[c] * tmax ) );
+    }
+}
+
+// Least squares endpoints of the pixels, where weight is the share of e1 in each of them. Fails when all of the
+// weights are the same.
+static inline bool Refine( const uint8* src, int n, const float* weight, int channels, float e0[4], float e1[4] )
+{
+    float aa = 0, bb = 0, ab = 0;
+    float ax[4] = {}, bx[4] = {};
+    for( int i=0; i<n; i++ )
+    {
+        const float a = weight[i];
+        const float b = 1 - a;
+        aa += a * a;
+        bb += b * b;
+        ab += a * b;
+        for( int c=0; c<channels; c++ )
+        {
+            ax[c] += a * src[i*4+c];
+            bx[c] += b * src[i*4+c];
+        }
+    }
+
+    const float det = aa * bb - ab * ab;
+    if( fabs( det ) < 1e-6f ) return false;
+    const float inv = 1.f / det;
+
+    for( int c=0; c<channels; c++ )
+    {
+        e0[c] = std::min( 255.f, std::max( 0.f, ( bx[c] * aa - ax[c] * ab ) * inv ) );
+        e1[c] = std::min( 255.f, std::max( 0.f, ( ax[c] * bb - bx[c] * ab ) * inv ) );
+    }
+    return true;
+}
+
+#endif
@@ -1,9 +1,11 @@
 #include <array>
+#include <limits>
 #include <string.h>
 
 #include "Math.hpp"
 #include "ProcessCommon.hpp"
 #include "ProcessRGB.hpp"
+#include "ProcessTH.hpp"
 #include "Tables.hpp"
 #include "Types.hpp"
 #include "Vector.hpp"
@@ -483,6 +485,76 @@ void FindBestFit( uint32 terr[2][8], uint16 tsel[16][8], v4i a[8], const uint32*
 }
 #endif
 
+// Selects, for each pixel and table, the modifier with the least squared color error of the decoded pixel. Unlike
+// FindBestFit, all four modifiers are tried and the clamping of the decoded values is taken into account.
+void FindBestFitExact( uint32 terr[2][8], uint16 tsel[16][8], const v4i a[8], const uint32* id, const uint8* data )
+{
+#ifdef __SSE4_1__
+    __m128i mod[2][4];
+    for( int k=0; k<4; k++ )
+    {
+        mod[0][k] = _mm_setr_epi32(g_table[0][k], g_table[1][k], g_table[2][k], g_table[3][k]);
+        mod[1][k] = _mm_setr_epi32(g_table[4][k], g_table[5][k], g_table[6][k], g_table[7][k]);
+    }
+#endif
+
+    for( size_t i=0; i<16; i++ )
+    {
+        uint16* sel = tsel[i];
+        uint bid = id[i];
+        uint32* ter = terr[bid%2];
+
+        const int b = *data++;
+        const int g = *data++;
+        const int r = *data++;
+        data++;
+
+#ifdef __SSE4_1__
+        const __m128i cr = _mm_set1_epi32(a[bid][0]);
+        const __m128i cg = _mm_set1_epi32(a[bid][1]);
+        const __m128i cb = _mm_set1_epi32(a[bid][2]);
+
+        for( int h=0; h<2; h++ )
+        {
+            __m128i best = _mm_set1_epi32(0x7FFFFFFF);
+            __m128i bestIdx = _mm_setzero_si128();
+            for( int k=0; k<4; k++ )
+            {
+                __m128i dr = _mm_sub_epi32(_mm_min_epi32(_mm_max_epi32(_mm_add_epi32(cr, mod[h][k]), _mm_setzero_si128()), _mm_set1_epi32(255)), _mm_set1_epi32(r));
+                __m128i dg = _mm_sub_epi32(_mm_min_epi32(_mm_max_epi32(_mm_add_epi32(cg, mod[h][k]), _mm_setzero_si128()), _mm_set1_epi32(255)), _mm_set1_epi32(g));
+                __m128i db = _mm_sub_epi32(_mm_min_epi32(_mm_max_epi32(_mm_add_epi32(cb, mod[h][k]), _mm_setzero_si128()), _mm_set1_epi32(255)), _mm_set1_epi32(b));
+                __m128i err = _mm_add_epi32(_mm_add_epi32(_mm_mullo_epi32(dr, dr), _mm_mullo_epi32(dg, dg)), _mm_mullo_epi32(db, db));
+
+                __m128i lt = _mm_cmplt_epi32(err, best);
+                best = _mm_min_epi32(best, err);
+                bestIdx = _mm_blendv_epi8(bestIdx, _mm_set1_epi32(k), lt);
+            }
+
+            _mm_storeu_si128(((__m128i*)ter) + h, _mm_add_epi32(_mm_loadu_si128(((__m128i*)ter) + h), best));
+            _mm_storel_epi64((__m128i*)( sel + h * 4 ), _mm_packus_epi32(bestIdx, bestIdx));
+        }
+#else
+        for( int t=0; t<8; t++ )
+        {
+            uint32 best = std::numeric_limits<uint32>::max();
+            for( int k=0; k<4; k++ )
+            {
+                const int dr = std::min( std::max( a[bid][0] + g_table[t][k], 0 ), 255 ) - r;
+                const int dg = std::min( std::max( a[bid][1] + g_table[t][k], 0 ), 255 ) - g;
+                const int db = std::min( std::max( a[bid][2] + g_table[t][k], 0 ), 255 ) - b;
+                const uint32 err = sq( dr ) + sq( dg ) + sq( db );
+                if( err < best )
+                {
+                    best = err;
+                    sel[t] = k;
+                }
+            }
+            ter[t] += best;
+        }
+#endif
+    }
+}
+
 uint8_t convert6(float f)
 {
     int i = (std::min(std::max(static_cast<int>(f), 0), 1023) - 15) >> 1;
@@ -660,6 +732,81 @@ uint64 EncodeSelectors( uint64 d, const T terr[2][8], const S tsel[16][8], const
 
     return FixByteOrder(d);
 }
+
+// Punch-through blocks have no individual mode, its bit marks opaque blocks instead
+template<bool PunchThrough>
+uint64 EncodeETC2( const uint8* src )
+{
+    auto result = Planar( src );
+
+    uint64 d = 0;
+
+    v4i a[8];
+    uint err[4] = {};
+    PrepareAverages( a, src, err );
+    size_t idx = PunchThrough ? 2 + GetLeastError( err + 2, 2 ) : GetLeastError( err, 4 );
+    EncodeAverages( d, a, idx );
+
+    uint32 terr[2][8] = {};
+    uint16 tsel[16][8];
+    auto id = g_id[idx];
+    FindBestFit( terr, tsel, a, id, src );
+
+    const uint64 block = EncodeSelectors( d, terr, tsel, id, result.first, result.second );
+#ifdef __SSE4_1__
+    return ProcessTH_SSE41( src, block );
+#else
+    return block;
+#endif
+}
+
+// Bit i is set if pixel i has alpha of at least 128
+uint OpaqueMask( const uint8* src )
+{
+#ifdef __SSE4_1__
+    __m128i d0 = _mm_loadu_si128(((__m128i*)src) + 0);
+    __m128i d1 = _mm_loadu_si128(((__m128i*)src) + 1);
+    __m128i d2 = _mm_loadu_si128(((__m128i*)src) + 2);
+    __m128i d3 = _mm_loadu_si128(((__m128i*)src) + 3);
+
+    return _mm_movemask_ps(_mm_castsi128_ps(d0)) |
+        (_mm_movemask_ps(_mm_castsi128_ps(d1)) << 4) |
+        (_mm_movemask_ps(_mm_castsi128_ps(d2)) << 8) |
+        (_mm_movemask_ps(_mm_castsi128_ps(d3)) << 12);
+#else
+    uint mask = 0;
+    for( int i=0; i<16; i++ )
+    {
+        if( src[i*4+3] >= 128 )
+        {
+            mask |= 1 << i;
+        }
+    }
+    return mask;
+#endif
+}
+
+// Error of an opaque pixel painted with the base color, or with the base color moved by the larger modifier of the table
+uint64 PunchThroughError( const uint8* px, const int color[3], int table, uint& sel )
+{
+    const int64 pix = ( color[0] - px[2] ) * 77 + ( color[1] - px[1] ) * 151 + ( color[2] - px[0] ) * 28;
+
+    uint64 err = sq( pix );
+    sel = 0;
+    const uint64 err1 = sq( pix + g_table256[table][1] );
+    if( err1 < err )
+    {
+        err = err1;
+        sel = 1;
+    }
+    const uint64 err3 = sq( pix + g_table256[table][3] );
+    if( err3 < err )
+    {
+        err = err3;
+        sel = 3;
+    }
+    return err;
+}
 }
 
 uint64 ProcessRGB( const uint8* src )
@@ -685,23 +832,168 @@ uint64 ProcessRGB( const uint8* src )
     return FixByteOrder( EncodeSelectors( d, terr, tsel, id ) );
 }
 
-uint64 ProcessRGB_ETC2( const uint8* src )
+uint64 ProcessRGB_Best( const uint8* src )
 {
-    auto result = Planar( src );
-
-    uint64 d = 0;
+    uint64 d = CheckSolid( src );
+    if( d != 0 ) return d;
 
     v4i a[8];
     uint err[4] = {};
     PrepareAverages( a, src, err );
-    size_t idx = GetLeastError( err, 4 );
-    EncodeAverages( d, a, idx );
 
-    uint32 terr[2][8] = {};
-    uint16 tsel[16][8];
-    auto id = g_id[idx];
-    FindBestFit( terr, tsel, a, id, src );
+    uint64 best = 0;
+    uint32 bestErr = std::numeric_limits<uint32>::max();
+    for( size_t idx=0; idx<4; idx++ )
+    {
+        uint64 c = 0;
+        EncodeAverages( c, a, idx );
+
+        uint32 terr[2][8] = {};
+        uint16 tsel[16][8];
+        auto id = g_id[idx];
+        FindBestFitExact( terr, tsel, a, id, src );
+
+        const uint32 e = terr[0][GetLeastError( terr[0], 8 )] + terr[1][GetLeastError( terr[1], 8 )];
+        if( e < bestErr )
+        {
+            bestErr = e;
+            best = EncodeSelectors( c, terr, tsel, id );
+        }
+    }
 
-    return EncodeSelectors( d, terr, tsel, id, result.first, result.second );
+    return FixByteOrder( best );
 }
 
+uint64 ProcessRGB_ETC2( const uint8* src )
+{
+    return EncodeETC2<false>( src );
+}
+
+uint64 ProcessRGB_ETC2_A1( const uint8* src )
+{
+    const uint opaque = OpaqueMask( src );
+    if( opaque == 0xFFFF )
+    {
+        return EncodeETC2<true>( src );
+    }
+    return ProcessPunchThrough( src, opaque );
+}
+
+uint64 ProcessPunchThrough( const uint8* src, uint opaque )
+{
+    // Transparent everywhere
+    if( opaque == 0 )
+    {
+        return FixByteOrder( 0xFFFF000000000000 );
+    }
+
+    uint64 best = 0;
+    uint64 bestErr = std::numeric_limits<uint64>::max();
+
+    for( int flip=0; flip<2; flip++ )
+    {
+        const uint32* id = g_id[2+flip];
+
+        // Averages of the opaque pixels of both halves. Half 1 holds the base color.
+        uint sum[2][3] = {};
+        uint cnt[2] = {};
+        for( int i=0; i<16; i++ )
+        {
+            if( opaque & ( 1 << i ) )
+            {
+                const uint h = id[i] % 2;
+                sum[h][0] += src[i*4+2];
+                sum[h][1] += src[i*4+1];
+                sum[h][2] += src[i*4+0];
+                cnt[h]++;
+            }
+        }
+
+        // A half without opaque pixels takes the color of the other one. The second color is stored as a 3-bit
+        // difference to the base color.
+        const uint n1 = cnt[1] != 0 ? 1 : 0;
+        const uint n0 = cnt[0] != 0 ? 0 : 1;
+
+        uint64 d = flip << 24;
+        int color[2][3];
+        for( int i=0; i<3; i++ )
+        {
+            const int c1 = mul8bit( ( sum[n1][i] + cnt[n1] / 2 ) / cnt[n1], 31 );
+            const int c0 = mul8bit( ( sum[n0][i] + cnt[n0] / 2 ) / cnt[n0], 31 );
+            const int diff = std::min( std::max( c0 - c1, -4 ), 3 );
+
+            d |= uint64( ( c1 << 3 ) | ( diff & 0x7 ) ) << ( i * 8 );
+            color[1][i] = ( c1 << 3 ) | ( c1 >> 2 );
+            color[0][i] = ( ( c1 + diff ) << 3 ) | ( ( c1 + diff ) >> 2 );
+        }
+
+        uint64 err = 0;
+        int tidx[2];
+        for( uint h=0; h<2; h++ )
+        {
+            uint64 halfErr = std::numeric_limits<uint64>::max();
+            for( int t=0; t<8; t++ )
+            {
+                uint64 tableErr = 0;
+                for( int i=0; i<16; i++ )
+                {
+                    if( ( opaque & ( 1 << i ) ) && id[i] % 2 == h )
+                    {
+                        uint sel;
+                        tableErr += PunchThroughError( src + i*4, color[h], t, sel );
+                    }
+                }
+                if( tableErr < halfErr )
+                {
+                    halfErr = tableErr;
+                    tidx[h] = t;
+                }
+            }
+            err += halfErr;
+        }
+
+        if( err < bestErr )
+        {
+            d |= uint64( tidx[0] ) << 26;
+            d |= uint64( tidx[1] ) << 29;
+            for( int i=0; i<16; i++ )
+            {
+                uint sel = 2;
+                if( opaque & ( 1 << i ) )
+                {
+                    const uint h = id[i] % 2;
+                    PunchThroughError( src + i*4, color[h], tidx[h], sel );
+                }
+                d |= uint64( sel & 0x1 ) << ( i + 32 );
+                d |= uint64( sel & 0x2 ) << ( i + 47 );
+            }
+            best = d;
+            bestErr = err;
+        }
+    }
+
+    return FixByteOrder( best );
+}
+
+bool IsAlphaBinary( const uint8* src )
+{
+#ifdef __SSE4_1__
+    // Alpha of 0 or 255 shifted down with sign extension is all sign bits
+    __m128i m = _mm_set1_epi32(-1);
+    for( int i=0; i<4; i++ )
+    {
+        __m128i d = _mm_loadu_si128(((__m128i*)src) + i);
+        m = _mm_and_si128(m, _mm_cmpeq_epi32(_mm_srai_epi32(d, 24), _mm_srai_epi32(d, 31)));
+    }
+    return _mm_testc_si128(m, _mm_set1_epi32(-1));
+#else
+    for( int i=0; i<16; i++ )
+    {
+        if( src[i*4+3] != 0 && src[i*4+3] != 255 )
+        {
+            return false;
+        }
+    }
+    return true;
+#endif
+}
@@ -4,6 +4,16 @@
 #include "Types.hpp"
 
 uint64 ProcessRGB( const uint8* src );
+// Searches every modifier of every table for each of the four subdivisions (both orientations, in the individual and the
+// differential mode), and keeps the encoding with the least color error. Much slower than ProcessRGB.
+uint64 ProcessRGB_Best( const uint8* src );
 uint64 ProcessRGB_ETC2( const uint8* src );
 
+// ETC2 RGB8A1 blocks, where pixels with alpha below 128 are transparent
+uint64 ProcessRGB_ETC2_A1( const uint8* src );
+// Encodes a block with transparent pixels, which are the cleared bits of the opaque mask
+uint64 ProcessPunchThrough( const uint8* src, uint opaque );
+// True if all pixels of the block are either fully opaque or fully transparent
+bool IsAlphaBinary( const uint8* src );
+
 #endif
@@ -1,11 +1,14 @@
 #ifdef __SSE4_1__
 
 #include <array>
+#include <stdlib.h>
 #include <string.h>
 
 #include "Math.hpp"
 #include "ProcessCommon.hpp"
+#include "ProcessRGB.hpp"
 #include "ProcessRGB_AVX2.hpp"
+#include "ProcessTH.hpp"
 #include "Tables.hpp"
 #include "Types.hpp"
 #include "Vector.hpp"
@@ -850,6 +853,210 @@ uint64 VS_VECTORCALL EncodeSelectors_AVX2( uint64 d, const uint32 terr[2][8], co
     return d | static_cast<uint64>(_bswap(t2)) << 32;
 }
 
+// Transposes one pixel row of 8 consecutive blocks, so that each output vector holds the same pixel of all eight blocks.
+// Output is stored in the same column-major order the single block functions use (pixel index is x * 4 + y).
+void VS_VECTORCALL Transpose_x8_AVX2( const uint8* src, __m256i* px ) noexcept
+{
+    __m256i d0 = _mm256_loadu_si256(((__m256i*)src) + 0);   // blocks 0, 1
+    __m256i d1 = _mm256_loadu_si256(((__m256i*)src) + 1);   // blocks 2, 3
+    __m256i d2 = _mm256_loadu_si256(((__m256i*)src) + 2);   // blocks 4, 5
+    __m256i d3 = _mm256_loadu_si256(((__m256i*)src) + 3);   // blocks 6, 7
+
+    __m256i b04 = _mm256_permute2x128_si256(d0, d2, (0) | (2 << 4));
+    __m256i b15 = _mm256_permute2x128_si256(d0, d2, (1) | (3 << 4));
+    __m256i b26 = _mm256_permute2x128_si256(d1, d3, (0) | (2 << 4));
+    __m256i b37 = _mm256_permute2x128_si256(d1, d3, (1) | (3 << 4));
+
+    __m256i t0 = _mm256_unpacklo_epi32(b04, b15);
+    __m256i t1 = _mm256_unpacklo_epi32(b26, b37);
+    __m256i t2 = _mm256_unpackhi_epi32(b04, b15);
+    __m256i t3 = _mm256_unpackhi_epi32(b26, b37);
+
+    px[0]  = _mm256_unpacklo_epi64(t0, t1);
+    px[4]  = _mm256_unpackhi_epi64(t0, t1);
+    px[8]  = _mm256_unpacklo_epi64(t2, t3);
+    px[12] = _mm256_unpackhi_epi64(t2, t3);
+}
+
+// Same as Transpose_x8_AVX2, for 8 consecutive blocks of a tiled bitmap. Every block is already in pixel order, so this
+// is a transpose of a 8x16 matrix.
+void VS_VECTORCALL TransposeTiled_x8_AVX2( const uint8* src, __m256i* px ) noexcept
+{
+    for( int h=0; h<2; h++ )
+    {
+        __m256i r[8];
+        for( int b=0; b<8; b++ )
+        {
+            r[b] = _mm256_loadu_si256(((__m256i*)src) + b * 2 + h);
+        }
+
+        __m256i t0 = _mm256_unpacklo_epi32(r[0], r[1]);
+        __m256i t1 = _mm256_unpackhi_epi32(r[0], r[1]);
+        __m256i t2 = _mm256_unpacklo_epi32(r[2], r[3]);
+        __m256i t3 = _mm256_unpackhi_epi32(r[2], r[3]);
+        __m256i t4 = _mm256_unpacklo_epi32(r[4], r[5]);
+        __m256i t5 = _mm256_unpackhi_epi32(r[4], r[5]);
+        __m256i t6 = _mm256_unpacklo_epi32(r[6], r[7]);
+        __m256i t7 = _mm256_unpackhi_epi32(r[6], r[7]);
+
+        __m256i u0 = _mm256_unpacklo_epi64(t0, t2);     // 0, 4
+        __m256i u1 = _mm256_unpackhi_epi64(t0, t2);     // 1, 5
+        __m256i u2 = _mm256_unpacklo_epi64(t1, t3);     // 2, 6
+        __m256i u3 = _mm256_unpackhi_epi64(t1, t3);     // 3, 7
+        __m256i u4 = _mm256_unpacklo_epi64(t4, t6);
+        __m256i u5 = _mm256_unpackhi_epi64(t4, t6);
+        __m256i u6 = _mm256_unpacklo_epi64(t5, t7);
+        __m256i u7 = _mm256_unpackhi_epi64(t5, t7);
+
+        __m256i* out = px + h * 8;
+        out[0] = _mm256_permute2x128_si256(u0, u4, (0) | (2 << 4));
+        out[1] = _mm256_permute2x128_si256(u1, u5, (0) | (2 << 4));
+        out[2] = _mm256_permute2x128_si256(u2, u6, (0) | (2 << 4));
+        out[3] = _mm256_permute2x128_si256(u3, u7, (0) | (2 << 4));
+        out[4] = _mm256_permute2x128_si256(u0, u4, (1) | (3 << 4));
+        out[5] = _mm256_permute2x128_si256(u1, u5, (1) | (3 << 4));
+        out[6] = _mm256_permute2x128_si256(u2, u6, (1) | (3 << 4));
+        out[7] = _mm256_permute2x128_si256(u3, u7, (1) | (3 << 4));
+    }
+}
+
+// Multiplies 32 bit lanes holding values that fit in int16. Faster than _mm256_mullo_epi32.
+__m256i VS_VECTORCALL Mul16_x8_AVX2( const __m256i a, const __m256i b ) noexcept
+{
+    return _mm256_madd_epi16(a, _mm256_and_si256(b, _mm256_set1_epi32(0xFFFF)));
+}
+
+__m256i VS_VECTORCALL MulBit_x8_AVX2( const __m256i a, const int b ) noexcept
+{
+    __m256i t = _mm256_add_epi32(Mul16_x8_AVX2(a, _mm256_set1_epi32(b)), _mm256_set1_epi32(128));
+    return _mm256_srli_epi32(_mm256_add_epi32(t, _mm256_srli_epi32(t, 8)), 8);
+}
+
+__m256i VS_VECTORCALL Expand5_x8_AVX2( const __m256i c ) noexcept
+{
+    return _mm256_or_si256(_mm256_slli_epi32(c, 3), _mm256_srli_epi32(c, 2));
+}
+
+__m256i VS_VECTORCALL CmpLtU32_x8_AVX2( const __m256i a, const __m256i b ) noexcept
+{
+    const __m256i sign = _mm256_set1_epi32(0x80000000);
+    return _mm256_cmpgt_epi32(_mm256_xor_si256(b, sign), _mm256_xor_si256(a, sign));
+}
+
+// Same as CalcErrorBlock_AVX2, for one half block of eight blocks at once
+__m256i VS_VECTORCALL CalcError_x8_AVX2( const __m256i a[3], const __m256i s[3] ) noexcept
+{
+    __m256i sq = _mm256_add_epi32(_mm256_add_epi32(Mul16_x8_AVX2(a[0], a[0]), Mul16_x8_AVX2(a[1], a[1])), Mul16_x8_AVX2(a[2], a[2]));
+    __m256i dot = _mm256_add_epi32(_mm256_add_epi32(Mul16_x8_AVX2(a[0], s[0]), Mul16_x8_AVX2(a[1], s[1])), Mul16_x8_AVX2(a[2], s[2]));
+
+    __m256i err = _mm256_add_epi32(_mm256_slli_epi32(sq, 3), _mm256_set1_epi32(0x3FFFFFFF));
+    return _mm256_sub_epi32(err, _mm256_slli_epi32(dot, 1));
+}
+
+// Selects the first table with least error, in the same way EncodeSelectors_AVX2 does
+__m256i VS_VECTORCALL SelectTable_x8_AVX2( const __m256i terr[8], const __m256i tsel[8], __m256i& tidx ) noexcept
+{
+    __m256i best = terr[0];
+    __m256i sel = tsel[0];
+    tidx = _mm256_setzero_si256();
+    for( int t=1; t<8; t++ )
+    {
+        __m256i lt = CmpLtU32_x8_AVX2(terr[t], best);
+        best = _mm256_min_epu32(best, terr[t]);
+        sel = _mm256_blendv_epi8(sel, tsel[t], lt);
+        tidx = _mm256_blendv_epi8(tidx, _mm256_set1_epi32(t), lt);
+    }
+    return sel;
+}
+
+// Distance of a pixel to the color of its half block, with the same weights as in FindBestFit_AVX2, scaled by 128
+__m256i VS_VECTORCALL WeightedDistance_x8_AVX2( const __m256i color[3], const __m256i px ) noexcept
+{
+    __m256i p0 = _mm256_and_si256(px, _mm256_set1_epi32(0xFF));
+    __m256i p1 = _mm256_and_si256(_mm256_srli_epi32(px, 8), _mm256_set1_epi32(0xFF));
+    __m256i p2 = _mm256_and_si256(_mm256_srli_epi32(px, 16), _mm256_set1_epi32(0xFF));
+
+    __m256i w0 = Mul16_x8_AVX2(_mm256_sub_epi32(color[0], p0), _mm256_set1_epi32(14));
+    __m256i w1 = Mul16_x8_AVX2(_mm256_sub_epi32(color[1], p1), _mm256_set1_epi32(76));
+    __m256i w2 = Mul16_x8_AVX2(_mm256_sub_epi32(color[2], p2), _mm256_set1_epi32(38));
+    return _mm256_add_epi32(_mm256_add_epi32(w0, w1), w2);
+}
+
+// Midpoints between the entry averages of consecutive tables
+static const int g_tableThreshold[7] = { 8, 15, 23, 33, 45, 61, 92 };
+
+// First of the four consecutive tables the fast encoders search for a half block, from the sum of the weighted distances
+// of its eight pixels to the base color. The window is placed around the table whose entries average to the mean
+// distance.
+__m256i VS_VECTORCALL TableWindow_x8_AVX2( const __m256i sum ) noexcept
+{
+    __m256i t = _mm256_set1_epi32(-1);
+    for( int i=0; i<7; i++ )
+    {
+        t = _mm256_sub_epi32(t, _mm256_cmpgt_epi32(sum, _mm256_set1_epi32(g_tableThreshold[i] * 8 * 128)));
+    }
+    return _mm256_min_epi32(_mm256_max_epi32(t, _mm256_setzero_si256()), _mm256_set1_epi32(4));
+}
+
+// Same as TableWindow_x8_AVX2, for a single half block
+int TableWindow_AVX2( uint32 sum ) noexcept
+{
+    int t = -1;
+    for( int i=0; i<7; i++ )
+    {
+        t += sum > uint32( g_tableThreshold[i] * 8 * 128 );
+    }
+    return std::min( std::max( t, 0 ), 4 );
+}
+
+// Punch-through blocks have no individual mode, its bit marks opaque blocks instead
+template<bool PunchThrough>
+uint64 VS_VECTORCALL EncodeETC2_AVX2( const uint8* src ) noexcept
+{
+    auto plane = Planar_AVX2( src );
+
+    alignas(32) v4i a[8];
+
+    __m128i err0 = PrepareAverages_AVX2( a, plane.sum4 );
+
+    size_t idx;
+    if( PunchThrough )
+    {
+        idx = _mm_extract_epi32(err0, 3) < _mm_extract_epi32(err0, 2) ? 3 : 2;
+    }
+    else
+    {
+        // Get index of minimum error (err0)
+        __m128i err1 = _mm_shuffle_epi32(err0, _MM_SHUFFLE(2, 3, 0, 1));
+        __m128i errMin0 = _mm_min_epu32(err0, err1);
+
+        __m128i errMin1 = _mm_shuffle_epi32(errMin0, _MM_SHUFFLE(1, 0, 3, 2));
+        __m128i errMin2 = _mm_min_epu32(errMin1, errMin0);
+
+        __m128i errMask = _mm_cmpeq_epi32(errMin2, err0);
+
+        uint32 mask = _mm_movemask_epi8(errMask);
+
+        idx = _bit_scan_forward(mask) >> 2;
+    }
+
+    uint64 d = EncodeAverages_AVX2( a, idx );
+
+    alignas(32) uint32 terr[2][8] = {};
+    alignas(32) uint32 tsel[8];
+
+    if ((idx == 0) || (idx == 2))
+    {
+        FindBestFit_4x2_AVX2( terr, tsel, a, idx * 2, src );
+    }
+    else
+    {
+        FindBestFit_2x4_AVX2( terr, tsel, a, idx * 2, src );
+    }
+
+    return ProcessTH_SSE41( src, EncodeSelectors_AVX2( d, terr, tsel, (idx % 2) == 1, plane.plane, plane.error ) );
+}
+
 }
 
 uint64 ProcessRGB_AVX2( const uint8* src )
@@ -933,42 +1140,617 @@ uint64 ProcessRGB_2x4_AVX2( const uint8* src )
     return EncodeSelectors_AVX2( d, terr, tsel, true);
 }
 
-uint64 ProcessRGB_ETC2_AVX2( const uint8* src )
+uint64 ProcessRGB_Fast_AVX2( const uint8* src )
 {
-    auto plane = Planar_AVX2( src );
+    uint64 d = CheckSolid_AVX2( src );
+    if( d != 0 ) return d;
+
+    // The error left within two half blocks falls by the squared distance of their averages, so the orientation with
+    // the more distant half block averages is picked. Lanes hold right, left, bottom and top sums, see Sum4_AVX2.
+    __m256i sum4 = Sum4_AVX2( src );
+    __m256i diff = _mm256_sub_epi16(sum4, _mm256_shuffle_epi32(sum4, _MM_SHUFFLE(1, 0, 3, 2)));
+    __m256i sq = _mm256_madd_epi16(diff, diff);
+
+    const uint32 lr = _mm256_extract_epi32(sq, 0) + _mm256_extract_epi32(sq, 1);
+    const uint32 tb = _mm256_extract_epi32(sq, 4) + _mm256_extract_epi32(sq, 5);
+    const bool flip = tb > lr;
 
     alignas(32) v4i a[8];
+    PrepareAverages_AVX2( a, sum4 );
 
-    __m128i err0 = PrepareAverages_AVX2( a, plane.sum4 );
+    // Differential mode is taken whenever the 5 bit colors of the half blocks differ by no more than it can hold, the
+    // same way ProcessAverages_AVX2 computes them
+    __m256i t0 = _mm256_add_epi16(_mm256_mullo_epi16(Average_AVX2( sum4 ), _mm256_set1_epi16(31)), _mm256_set1_epi16(128));
+    __m256i c5 = _mm256_srli_epi16(_mm256_add_epi16(t0, _mm256_srli_epi16(t0, 8)), 8);
+    __m256i d5 = _mm256_sub_epi16(c5, _mm256_shuffle_epi32(c5, _MM_SHUFFLE(3, 2, 3, 2)));
+    __m256i fits = _mm256_cmpeq_epi16(d5, _mm256_min_epi16(_mm256_max_epi16(d5, _mm256_set1_epi16(-4)), _mm256_set1_epi16(3)));
+    const uint32 rgb = flip ? 0x3F0000 : 0x3F;
+    const uint32 idx = ( flip ? 1 : 0 ) | ( ( _mm256_movemask_epi8(fits) & rgb ) == rgb ? 2 : 0 );
 
-    // Get index of minimum error (err0)
-    __m128i err1 = _mm_shuffle_epi32(err0, _MM_SHUFFLE(2, 3, 0, 1));
-    __m128i errMin0 = _mm_min_epu32(err0, err1);
+    d |= EncodeAverages_AVX2( a, idx );
 
-    __m128i errMin1 = _mm_shuffle_epi32(errMin0, _MM_SHUFFLE(1, 0, 3, 2));
-    __m128i errMin2 = _mm_min_epu32(errMin1, errMin0);
+    alignas(32) uint32 terr[2][8] = {};
+    alignas(32) uint32 tsel[8];
 
-    __m128i errMask = _mm_cmpeq_epi32(errMin2, err0);
+    if( flip )
+    {
+        FindBestFit_2x4_AVX2( terr, tsel, a, idx * 2, src );
+    }
+    else
+    {
+        FindBestFit_4x2_AVX2( terr, tsel, a, idx * 2, src );
+    }
 
-    uint32 mask = _mm_movemask_epi8(errMask);
+    // Only four tables are searched for each half block, the rest are never selected. The half block of terr[1] has
+    // the color a[idx * 2 + 1].
+    uint32 sum[2] = {};
+    for( int i=0; i<16; i++ )
+    {
+        const int h = flip ? ( i & 3 ) < 2 : i < 8;
+        const v4i& color = a[idx * 2 + h];
+        sum[h] += abs( ( color[0] - src[i*4] ) * 14 + ( color[1] - src[i*4+1] ) * 76 + ( color[2] - src[i*4+2] ) * 38 );
+    }
+    for( int h=0; h<2; h++ )
+    {
+        const int start = TableWindow_AVX2( sum[h] );
+        for( int t=0; t<8; t++ )
+        {
+            if( t < start || t >= start + 4 )
+            {
+                terr[h][t] = 0xFFFFFFFF;
+            }
+        }
+    }
 
-    size_t idx = _bit_scan_forward(mask) >> 2;
+    return EncodeSelectors_AVX2( d, terr, tsel, flip );
+}
 
-    uint64 d = EncodeAverages_AVX2( a, idx );
+uint64 ProcessRGB_ETC2_AVX2( const uint8* src )
+{
+    return EncodeETC2_AVX2<false>( src );
+}
 
-    alignas(32) uint32 terr[2][8] = {};
-    alignas(32) uint32 tsel[8];
+uint64 ProcessRGB_ETC2_A1_AVX2( const uint8* src )
+{
+    __m256i d0 = _mm256_loadu_si256(((__m256i*)src) + 0);
+    __m256i d1 = _mm256_loadu_si256(((__m256i*)src) + 1);
 
-    if ((idx == 0) || (idx == 2))
+    // Alpha of at least 128 sets the sign bit of the pixel
+    uint opaque = _mm256_movemask_ps(_mm256_castsi256_ps(d0)) | (_mm256_movemask_ps(_mm256_castsi256_ps(d1)) << 8);
+    if( opaque == 0xFFFF )
     {
-        FindBestFit_4x2_AVX2( terr, tsel, a, idx * 2, src );
+        return EncodeETC2_AVX2<true>( src );
+    }
+    return ProcessPunchThrough( src, opaque );
+}
+
+namespace
+{
+
+// Processes 8 blocks at once. Each block is held in a single 32 bit lane of the vectors (structure of arrays), so no
+// horizontal operations are needed. Produces the same results as ProcessRGB_AVX2.
+// The fast variant picks the subdivision without estimating the error of each one, and searches only four consecutive
+// tables for each half block, around the one matching the mean distance of its pixels to the base color. It produces the
+// same results as ProcessRGB_Fast_AVX2.
+template<bool Fast>
+void VS_VECTORCALL ProcessRGB_x8_AVX2( const __m256i px[16], uint64* dst ) noexcept
+{
+    __m256i solid = _mm256_cmpeq_epi32(px[0], px[1]);
+    for( int i=2; i<16; i++ )
+    {
+        solid = _mm256_and_si256(solid, _mm256_cmpeq_epi32(px[0], px[i]));
+    }
+
+    // Sums of quadrants, first and third channel in lo, second channel in mid. Index is x / 2 * 2 + y / 2.
+    __m256i qlo[4], qmid[4];
+    for( int q=0; q<4; q++ )
+    {
+        const int i = ( q >> 1 ) * 8 + ( q & 1 ) * 2;
+        __m256i lo = _mm256_setzero_si256();
+        __m256i mid = _mm256_setzero_si256();
+        for( int j=0; j<4; j++ )
+        {
+            __m256i p = px[i + ( j >> 1 ) * 4 + ( j & 1 )];
+            lo = _mm256_add_epi32(lo, _mm256_and_si256(p, _mm256_set1_epi32(0x00FF00FF)));
+            mid = _mm256_add_epi32(mid, _mm256_and_si256(_mm256_srli_epi32(p, 8), _mm256_set1_epi32(0x000000FF)));
+        }
+        qlo[q] = lo;
+        qmid[q] = mid;
+    }
+
+    // Half blocks in the same order as in ProcessRGB_AVX2: right, left, bottom, top
+    __m256i s[4][3];
+    {
+        const int quad[4][2] = { { 2, 3 }, { 0, 1 }, { 1, 3 }, { 0, 2 } };
+        for( int h=0; h<4; h++ )
+        {
+            __m256i lo = _mm256_add_epi32(qlo[quad[h][0]], qlo[quad[h][1]]);
+            s[h][0] = _mm256_and_si256(lo, _mm256_set1_epi32(0xFFFF));
+            s[h][1] = _mm256_add_epi32(qmid[quad[h][0]], qmid[quad[h][1]]);
+            s[h][2] = _mm256_srli_epi32(lo, 16);
+        }
+    }
+
+    __m256i a[8][3];
+    // Differential mode is possible without clamping the color difference
+    __m256i fits[2] = { _mm256_set1_epi32(-1), _mm256_set1_epi32(-1) };
+    for( int c=0; c<3; c++ )
+    {
+        __m256i c5[4];
+        for( int h=0; h<4; h++ )
+        {
+            __m256i avg = _mm256_srli_epi32(_mm256_add_epi32(s[h][c], _mm256_set1_epi32(4)), 3);
+
+            __m256i c4 = MulBit_x8_AVX2(avg, 15);
+            a[h][c] = _mm256_or_si256(c4, _mm256_slli_epi32(c4, 4));
+
+            c5[h] = MulBit_x8_AVX2(avg, 31);
+        }
+        for( int h=0; h<4; h+=2 )
+        {
+            __m256i diff0 = _mm256_sub_epi32(c5[h], c5[h+1]);
+            __m256i diff = _mm256_max_epi32(diff0, _mm256_set1_epi32(-4));
+            diff = _mm256_min_epi32(diff, _mm256_set1_epi32(3));
+            if( Fast )
+            {
+                fits[h/2] = _mm256_and_si256(fits[h/2], _mm256_cmpeq_epi32(diff, diff0));
+            }
+
+            a[4+h][c] = Expand5_x8_AVX2(_mm256_add_epi32(c5[h+1], diff));
+            a[5+h][c] = Expand5_x8_AVX2(c5[h+1]);
+        }
+    }
+
+    __m256i idx = _mm256_setzero_si256();
+    if( Fast )
+    {
+        // Same orientation choice as in ProcessRGB_Fast_AVX2
+        __m256i lr = _mm256_setzero_si256();
+        __m256i tb = _mm256_setzero_si256();
+        for( int c=0; c<3; c++ )
+        {
+            __m256i dlr = _mm256_sub_epi32(s[0][c], s[1][c]);
+            __m256i dtb = _mm256_sub_epi32(s[2][c], s[3][c]);
+            lr = _mm256_add_epi32(lr, Mul16_x8_AVX2(dlr, dlr));
+            tb = _mm256_add_epi32(tb, Mul16_x8_AVX2(dtb, dtb));
+        }
+        __m256i flip = _mm256_cmpgt_epi32(tb, lr);
+        __m256i diff = _mm256_blendv_epi8(fits[0], fits[1], flip);
+        idx = _mm256_or_si256(_mm256_and_si256(flip, _mm256_set1_epi32(1)), _mm256_and_si256(diff, _mm256_set1_epi32(2)));
     }
     else
     {
-        FindBestFit_2x4_AVX2( terr, tsel, a, idx * 2, src );
+        __m256i err[4];
+        for( int i=0; i<4; i++ )
+        {
+            const int h = ( i & 1 ) * 2;
+            err[i] = _mm256_add_epi32(CalcError_x8_AVX2(a[i*2], s[h]), CalcError_x8_AVX2(a[i*2+1], s[h+1]));
+        }
+
+        __m256i errMin = err[0];
+        for( int i=1; i<4; i++ )
+        {
+            __m256i lt = CmpLtU32_x8_AVX2(err[i], errMin);
+            errMin = _mm256_min_epu32(errMin, err[i]);
+            idx = _mm256_blendv_epi8(idx, _mm256_set1_epi32(i), lt);
+        }
+    }
+
+    __m256i flip = _mm256_cmpeq_epi32(_mm256_and_si256(idx, _mm256_set1_epi32(1)), _mm256_set1_epi32(1));
+    __m256i diff = _mm256_cmpeq_epi32(_mm256_and_si256(idx, _mm256_set1_epi32(2)), _mm256_set1_epi32(2));
+
+    // Colors of the first and second half block, and of each quadrant
+    __m256i first[3], second[3], quad[4][3];
+    __m256i d = _mm256_slli_epi32(idx, 24);
+    for( int c=0; c<3; c++ )
+    {
+        __m256i right = _mm256_blendv_epi8(a[0][c], a[4][c], diff);
+        __m256i left = _mm256_blendv_epi8(a[1][c], a[5][c], diff);
+        __m256i bottom = _mm256_blendv_epi8(a[2][c], a[6][c], diff);
+        __m256i top = _mm256_blendv_epi8(a[3][c], a[7][c], diff);
+
+        first[c] = _mm256_blendv_epi8(left, top, flip);
+        second[c] = _mm256_blendv_epi8(right, bottom, flip);
+
+        quad[0][c] = first[c];
+        quad[1][c] = _mm256_blendv_epi8(left, bottom, flip);
+        quad[2][c] = _mm256_blendv_epi8(right, top, flip);
+        quad[3][c] = second[c];
+
+        __m256i v4 = _mm256_or_si256(_mm256_and_si256(first[c], _mm256_set1_epi32(0xF0)), _mm256_srli_epi32(second[c], 4));
+
+        __m256i f5 = _mm256_and_si256(first[c], _mm256_set1_epi32(0xF8));
+        __m256i s5 = _mm256_and_si256(second[c], _mm256_set1_epi32(0xF8));
+        __m256i d5 = _mm256_and_si256(_mm256_srai_epi32(_mm256_sub_epi32(s5, f5), 3), _mm256_set1_epi32(0x07));
+        __m256i v5 = _mm256_or_si256(f5, d5);
+
+        __m256i v = _mm256_blendv_epi8(v4, v5, diff);
+        d = _mm256_or_si256(d, _mm256_slli_epi32(v, ( 2 - c ) * 8));
+    }
+
+    // Quadrants 0 and 3 always belong to the first and second half block, quadrants 1 and 2 depend on flip
+    const __m256i inFirst[4] = { _mm256_set1_epi32(-1), _mm256_andnot_si256(flip, _mm256_set1_epi32(-1)), flip, _mm256_setzero_si256() };
+
+    __m256i terr[2][8], tsel[8];
+    for( int t=0; t<8; t++ )
+    {
+        terr[0][t] = _mm256_setzero_si256();
+        terr[1][t] = _mm256_setzero_si256();
+        tsel[t] = _mm256_setzero_si256();
+    }
+    __m256i msb = _mm256_setzero_si256();
+
+    // The fast variant needs the distances of all pixels up front, to place the table windows
+    __m256i pixels[16], tstart[4], start0, start1;
+    if( Fast )
+    {
+        __m256i sum0 = _mm256_setzero_si256();
+        __m256i sum1 = _mm256_setzero_si256();
+        for( int q=0; q<4; q++ )
+        {
+            __m256i qsum = _mm256_setzero_si256();
+            const int base = ( q >> 1 ) * 8 + ( q & 1 ) * 2;
+            for( int j=0; j<4; j++ )
+            {
+                const int i = base + ( j >> 1 ) * 4 + ( j & 1 );
+                pixels[i] = WeightedDistance_x8_AVX2( quad[q], px[i] );
+                qsum = _mm256_add_epi32(qsum, _mm256_abs_epi32(pixels[i]));
+            }
+            sum1 = _mm256_add_epi32(sum1, _mm256_and_si256(qsum, inFirst[q]));
+            sum0 = _mm256_add_epi32(sum0, _mm256_andnot_si256(inFirst[q], qsum));
+        }
+        start0 = TableWindow_x8_AVX2( sum0 );
+        start1 = TableWindow_x8_AVX2( sum1 );
+        for( int q=0; q<4; q++ )
+        {
+            tstart[q] = _mm256_blendv_epi8(start0, start1, inFirst[q]);
+        }
+    }
+
+    const int tables = Fast ? 4 : 8;
+    const __m256i table0 = _mm256_setr_epi32(g_table[0][0] * 128, g_table[1][0] * 128, g_table[2][0] * 128, g_table[3][0] * 128, g_table[4][0] * 128, g_table[5][0] * 128, g_table[6][0] * 128, g_table[7][0] * 128);
+    const __m256i table1 = _mm256_setr_epi32(g_table[0][1] * 128, g_table[1][1] * 128, g_table[2][1] * 128, g_table[3][1] * 128, g_table[4][1] * 128, g_table[5][1] * 128, g_table[6][1] * 128, g_table[7][1] * 128);
+
+    for( int q=0; q<4; q++ )
+    {
+        __m256i qerr[8];
+        for( int t=0; t<tables; t++ )
+        {
+            qerr[t] = _mm256_setzero_si256();
+        }
+
+        const int base = ( q >> 1 ) * 8 + ( q & 1 ) * 2;
+        for( int j=0; j<4; j++ )
+        {
+            const int i = base + ( j >> 1 ) * 4 + ( j & 1 );
+            const __m256i bit = _mm256_set1_epi32(1 << i);
+
+            __m256i pixel = Fast ? pixels[i] : WeightedDistance_x8_AVX2( quad[q], px[i] );
+            __m256i pix = _mm256_abs_epi32(pixel);
+
+            // Exploiting symmetry of the selector table and use the sign bit, already flipped
+            msb = _mm256_or_si256(msb, _mm256_andnot_si256(_mm256_srai_epi32(pixel, 31), bit));
+
+            for( int t=0; t<tables; t++ )
+            {
+                __m256i t0, t1;
+                if( Fast )
+                {
+                    __m256i ti = _mm256_add_epi32(tstart[q], _mm256_set1_epi32(t));
+                    t0 = _mm256_permutevar8x32_epi32(table0, ti);
+                    t1 = _mm256_permutevar8x32_epi32(table1, ti);
+                }
+                else
+                {
+                    t0 = _mm256_set1_epi32(g_table[t][0] * 128);
+                    t1 = _mm256_set1_epi32(g_table[t][1] * 128);
+                }
+                __m256i error0 = _mm256_abs_epi32(_mm256_sub_epi32(pix, t0));
+                __m256i error1 = _mm256_abs_epi32(_mm256_sub_epi32(pix, t1));
+
+                __m256i minIndex = _mm256_cmpgt_epi32(error0, error1);
+                __m256i minError = _mm256_min_epi32(error0, error1);
+
+                qerr[t] = _mm256_add_epi32(qerr[t], _mm256_madd_epi16(minError, minError));
+                tsel[t] = _mm256_or_si256(tsel[t], _mm256_and_si256(minIndex, bit));
+            }
+        }
+
+        for( int t=0; t<tables; t++ )
+        {
+            terr[1][t] = _mm256_add_epi32(terr[1][t], _mm256_and_si256(qerr[t], inFirst[q]));
+            terr[0][t] = _mm256_add_epi32(terr[0][t], _mm256_andnot_si256(inFirst[q], qerr[t]));
+        }
+    }
+
+    // Window positions past the searched ones are never selected
+    for( int t=tables; t<8; t++ )
+    {
+        terr[0][t] = _mm256_set1_epi32(-1);
+        terr[1][t] = _mm256_set1_epi32(-1);
+    }
+
+    __m256i tidx0, tidx1;
+    __m256i sel0 = SelectTable_x8_AVX2(terr[0], tsel, tidx0);
+    __m256i sel1 = SelectTable_x8_AVX2(terr[1], tsel, tidx1);
+    if( Fast )
+    {
+        tidx0 = _mm256_add_epi32(tidx0, start0);
+        tidx1 = _mm256_add_epi32(tidx1, start1);
+    }
+
+    d = _mm256_or_si256(d, _mm256_slli_epi32(tidx0, 26));
+    d = _mm256_or_si256(d, _mm256_slli_epi32(tidx1, 29));
+
+    __m256i mask1 = _mm256_blendv_epi8(_mm256_set1_epi32(0x00FF), _mm256_set1_epi32(0x3333), flip);
+    __m256i lsb = _mm256_or_si256(_mm256_and_si256(sel1, mask1), _mm256_andnot_si256(mask1, _mm256_and_si256(sel0, _mm256_set1_epi32(0xFFFF))));
+    __m256i t2 = _mm256_or_si256(lsb, _mm256_slli_epi32(msb, 16));
+
+    __m256i solidColor = _mm256_and_si256(px[0], _mm256_set1_epi32(0xF8F8F8));
+    __m256i solidColorSwap = _mm256_shuffle_epi8(solidColor, _mm256_setr_epi8(2, 1, 0, -1, 6, 5, 4, -1, 10, 9, 8, -1, 14, 13, 12, -1, 2, 1, 0, -1, 6, 5, 4, -1, 10, 9, 8, -1, 14, 13, 12, -1));
+    __m256i solidD = _mm256_or_si256(solidColorSwap, _mm256_set1_epi32(0x02000000));
+
+    d = _mm256_blendv_epi8(d, solidD, solid);
+    t2 = _mm256_andnot_si256(solid, t2);
+
+    __m256i t3 = _mm256_shuffle_epi8(t2, _mm256_setr_epi8(3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12, 3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12));
+
+    __m256i r0 = _mm256_unpacklo_epi32(d, t3);  // 0, 1, 4, 5
+    __m256i r1 = _mm256_unpackhi_epi32(d, t3);  // 2, 3, 6, 7
+
+    _mm256_storeu_si256(((__m256i*)dst) + 0, _mm256_permute2x128_si256(r0, r1, (0) | (2 << 4)));
+    _mm256_storeu_si256(((__m256i*)dst) + 1, _mm256_permute2x128_si256(r0, r1, (1) | (3 << 4)));
+}
+
+// Single channel version of ProcessRGB_x8_AVX2, the values are in the low byte of each lane. The blocks are encoded with
+// gray colors. Produces the same results as ProcessAlpha.
+void VS_VECTORCALL ProcessChannel_x8_AVX2( const __m256i p[16], uint64* dst ) noexcept
+{
+    __m256i solid = _mm256_cmpeq_epi32(p[0], p[1]);
+    for( int i=2; i<16; i++ )
+    {
+        solid = _mm256_and_si256(solid, _mm256_cmpeq_epi32(p[0], p[i]));
+    }
+
+    // Sums of quadrants. Index is x / 2 * 2 + y / 2.
+    __m256i q[4];
+    for( int k=0; k<4; k++ )
+    {
+        const int i = ( k >> 1 ) * 8 + ( k & 1 ) * 2;
+        q[k] = _mm256_add_epi32(_mm256_add_epi32(p[i], p[i+1]), _mm256_add_epi32(p[i+4], p[i+5]));
+    }
+
+    // Half blocks in the same order as in ProcessAlpha: right, left, bottom, top
+    const int quad[4][2] = { { 2, 3 }, { 0, 1 }, { 1, 3 }, { 0, 2 } };
+    __m256i s[4], a[8], c5[4];
+    for( int h=0; h<4; h++ )
+    {
+        s[h] = _mm256_add_epi32(q[quad[h][0]], q[quad[h][1]]);
+        __m256i avg = _mm256_srli_epi32(_mm256_add_epi32(s[h], _mm256_set1_epi32(4)), 3);
+
+        __m256i c4 = MulBit_x8_AVX2(avg, 15);
+        a[h] = _mm256_or_si256(c4, _mm256_slli_epi32(c4, 4));
+
+        c5[h] = MulBit_x8_AVX2(avg, 31);
+    }
+    for( int h=0; h<4; h+=2 )
+    {
+        __m256i diff = _mm256_sub_epi32(c5[h], c5[h+1]);
+        diff = _mm256_max_epi32(diff, _mm256_set1_epi32(-4));
+        diff = _mm256_min_epi32(diff, _mm256_set1_epi32(3));
+
+        a[4+h] = Expand5_x8_AVX2(_mm256_add_epi32(c5[h+1], diff));
+        a[5+h] = Expand5_x8_AVX2(c5[h+1]);
+    }
+
+    // Sum of squares is the same for all choices and left out, like in CalcError_x8_AVX2
+    __m256i err[4];
+    for( int i=0; i<4; i++ )
+    {
+        const int h = ( i & 1 ) * 2;
+        __m256i e = _mm256_set1_epi32(0x3FFFFFFF);
+        for( int j=0; j<2; j++ )
+        {
+            __m256i v = a[i*2+j];
+            e = _mm256_add_epi32(e, _mm256_slli_epi32(Mul16_x8_AVX2(v, v), 3));
+            e = _mm256_sub_epi32(e, _mm256_slli_epi32(Mul16_x8_AVX2(v, s[h+j]), 1));
+        }
+        err[i] = e;
     }
 
-    return EncodeSelectors_AVX2( d, terr, tsel, (idx % 2) == 1, plane.plane, plane.error );
+    __m256i idx = _mm256_setzero_si256();
+    __m256i errMin = err[0];
+    for( int i=1; i<4; i++ )
+    {
+        __m256i lt = CmpLtU32_x8_AVX2(err[i], errMin);
+        errMin = _mm256_min_epu32(errMin, err[i]);
+        idx = _mm256_blendv_epi8(idx, _mm256_set1_epi32(i), lt);
+    }
+
+    __m256i flip = _mm256_cmpeq_epi32(_mm256_and_si256(idx, _mm256_set1_epi32(1)), _mm256_set1_epi32(1));
+    __m256i diff = _mm256_cmpeq_epi32(_mm256_and_si256(idx, _mm256_set1_epi32(2)), _mm256_set1_epi32(2));
+
+    __m256i right = _mm256_blendv_epi8(a[0], a[4], diff);
+    __m256i left = _mm256_blendv_epi8(a[1], a[5], diff);
+    __m256i bottom = _mm256_blendv_epi8(a[2], a[6], diff);
+    __m256i top = _mm256_blendv_epi8(a[3], a[7], diff);
+
+    __m256i first = _mm256_blendv_epi8(left, top, flip);
+    __m256i second = _mm256_blendv_epi8(right, bottom, flip);
+    const __m256i qv[4] = { first, _mm256_blendv_epi8(left, bottom, flip), _mm256_blendv_epi8(right, top, flip), second };
+
+    __m256i v4 = _mm256_or_si256(_mm256_and_si256(first, _mm256_set1_epi32(0xF0)), _mm256_srli_epi32(second, 4));
+    __m256i f5 = _mm256_and_si256(first, _mm256_set1_epi32(0xF8));
+    __m256i s5 = _mm256_and_si256(second, _mm256_set1_epi32(0xF8));
+    __m256i d5 = _mm256_and_si256(_mm256_srai_epi32(_mm256_sub_epi32(s5, f5), 3), _mm256_set1_epi32(0x07));
+    __m256i v = _mm256_blendv_epi8(v4, _mm256_or_si256(f5, d5), diff);
+
+    // Gray, the same value in all three channels
+    __m256i d = _mm256_or_si256(_mm256_slli_epi32(idx, 24), Mul16_x8_AVX2(v, _mm256_set1_epi32(0x0101)));
+    d = _mm256_or_si256(d, _mm256_slli_epi32(v, 16));
+
+    const __m256i inFirst[4] = { _mm256_set1_epi32(-1), _mm256_andnot_si256(flip, _mm256_set1_epi32(-1)), flip, _mm256_setzero_si256() };
+
+    __m256i terr[2][8], tsel[8];
+    for( int t=0; t<8; t++ )
+    {
+        terr[0][t] = _mm256_setzero_si256();
+        terr[1][t] = _mm256_setzero_si256();
+        tsel[t] = _mm256_setzero_si256();
+    }
+    __m256i msb = _mm256_setzero_si256();
+
+    for( int k=0; k<4; k++ )
+    {
+        __m256i qerr[8];
+        for( int t=0; t<8; t++ )
+        {
+            qerr[t] = _mm256_setzero_si256();
+        }
+
+        const int base = ( k >> 1 ) * 8 + ( k & 1 ) * 2;
+        for( int j=0; j<4; j++ )
+        {
+            const int i = base + ( j >> 1 ) * 4 + ( j & 1 );
+            const __m256i bit = _mm256_set1_epi32(1 << i);
+
+            __m256i pixel = _mm256_sub_epi32(qv[k], p[i]);
+            __m256i pix = _mm256_abs_epi32(pixel);
+
+            // ProcessAlpha prefers the positive modifiers when the value equals the base
+            msb = _mm256_or_si256(msb, _mm256_and_si256(_mm256_cmpgt_epi32(pixel, _mm256_setzero_si256()), bit));
+
+            for( int t=0; t<8; t++ )
+            {
+                __m256i error0 = _mm256_abs_epi32(_mm256_sub_epi32(pix, _mm256_set1_epi32(g_table[t][0])));
+                __m256i error1 = _mm256_abs_epi32(_mm256_sub_epi32(pix, _mm256_set1_epi32(g_table[t][1])));
+
+                __m256i minIndex = _mm256_cmpgt_epi32(error0, error1);
+                __m256i minError = _mm256_min_epi32(error0, error1);
+
+                qerr[t] = _mm256_add_epi32(qerr[t], _mm256_madd_epi16(minError, minError));
+                tsel[t] = _mm256_or_si256(tsel[t], _mm256_and_si256(minIndex, bit));
+            }
+        }
+
+        for( int t=0; t<8; t++ )
+        {
+            terr[1][t] = _mm256_add_epi32(terr[1][t], _mm256_and_si256(qerr[t], inFirst[k]));
+            terr[0][t] = _mm256_add_epi32(terr[0][t], _mm256_andnot_si256(inFirst[k], qerr[t]));
+        }
+    }
+
+    __m256i tidx0, tidx1;
+    __m256i sel0 = SelectTable_x8_AVX2(terr[0], tsel, tidx0);
+    __m256i sel1 = SelectTable_x8_AVX2(terr[1], tsel, tidx1);
+
+    d = _mm256_or_si256(d, _mm256_slli_epi32(tidx0, 26));
+    d = _mm256_or_si256(d, _mm256_slli_epi32(tidx1, 29));
+
+    __m256i mask1 = _mm256_blendv_epi8(_mm256_set1_epi32(0x00FF), _mm256_set1_epi32(0x3333), flip);
+    __m256i lsb = _mm256_or_si256(_mm256_and_si256(sel1, mask1), _mm256_andnot_si256(mask1, _mm256_and_si256(sel0, _mm256_set1_epi32(0xFFFF))));
+    __m256i t2 = _mm256_or_si256(lsb, _mm256_slli_epi32(msb, 16));
+
+    __m256i solidValue = _mm256_and_si256(p[0], _mm256_set1_epi32(0xF8));
+    __m256i solidD = _mm256_or_si256(Mul16_x8_AVX2(solidValue, _mm256_set1_epi32(0x0101)), _mm256_slli_epi32(solidValue, 16));
+    solidD = _mm256_or_si256(solidD, _mm256_set1_epi32(0x02000000));
+
+    d = _mm256_blendv_epi8(d, solidD, solid);
+    t2 = _mm256_andnot_si256(solid, t2);
+
+    __m256i t3 = _mm256_shuffle_epi8(t2, _mm256_setr_epi8(3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12, 3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12));
+
+    __m256i r0 = _mm256_unpacklo_epi32(d, t3);  // 0, 1, 4, 5
+    __m256i r1 = _mm256_unpackhi_epi32(d, t3);  // 2, 3, 6, 7
+
+    _mm256_storeu_si256(((__m256i*)dst) + 0, _mm256_permute2x128_si256(r0, r1, (0) | (2 << 4)));
+    _mm256_storeu_si256(((__m256i*)dst) + 1, _mm256_permute2x128_si256(r0, r1, (1) | (3 << 4)));
+}
+
+}
+
+void ProcessRGB_AVX2_x8( const uint8* src, size_t pitch, uint64* dst )
+{
+    __m256i px[16];
+    for( int y=0; y<4; y++ )
+    {
+        Transpose_x8_AVX2( src + y * pitch, px + y );
+    }
+    ProcessRGB_x8_AVX2<false>( px, dst );
+}
+
+void ProcessRGB_AVX2_x8_Tiled( const uint8* src, uint64* dst )
+{
+    __m256i px[16];
+    TransposeTiled_x8_AVX2( src, px );
+    ProcessRGB_x8_AVX2<false>( px, dst );
+}
+
+void ProcessRGB_Fast_AVX2_x8( const uint8* src, size_t pitch, uint64* dst )
+{
+    __m256i px[16];
+    for( int y=0; y<4; y++ )
+    {
+        Transpose_x8_AVX2( src + y * pitch, px + y );
+    }
+    ProcessRGB_x8_AVX2<true>( px, dst );
+}
+
+void ProcessRGB_Fast_AVX2_x8_Tiled( const uint8* src, uint64* dst )
+{
+    __m256i px[16];
+    TransposeTiled_x8_AVX2( src, px );
+    ProcessRGB_x8_AVX2<true>( px, dst );
+}
+
+void ProcessAlpha_AVX2_x8( const uint8* src, size_t pitch, uint64* dst )
+{
+    __m256i px[16];
+    for( int y=0; y<4; y++ )
+    {
+        Transpose_x8_AVX2( src + y * pitch, px + y );
+    }
+    for( int i=0; i<16; i++ )
+    {
+        px[i] = _mm256_srli_epi32(px[i], 24);
+    }
+    ProcessChannel_x8_AVX2( px, dst );
+}
+
+void ProcessAlpha_AVX2_x8_Tiled( const uint8* src, uint64* dst )
+{
+    __m256i px[16];
+    TransposeTiled_x8_AVX2( src, px );
+    for( int i=0; i<16; i++ )
+    {
+        px[i] = _mm256_srli_epi32(px[i], 24);
+    }
+    ProcessChannel_x8_AVX2( px, dst );
+}
+
+void ProcessGray_AVX2_x8( const uint8* src, size_t pitch, uint64* dst )
+{
+    __m256i px[16];
+    for( int y=0; y<4; y++ )
+    {
+        Transpose_x8_AVX2( src + y * pitch, px + y );
+    }
+    for( int i=0; i<16; i++ )
+    {
+        px[i] = _mm256_and_si256(px[i], _mm256_set1_epi32(0xFF));
+    }
+    ProcessChannel_x8_AVX2( px, dst );
+}
+
+void ProcessGray_AVX2_x8_Tiled( const uint8* src, uint64* dst )
+{
+    __m256i px[16];
+    TransposeTiled_x8_AVX2( src, px );
+    for( int i=0; i<16; i++ )
+    {
+        px[i] = _mm256_and_si256(px[i], _mm256_set1_epi32(0xFF));
+    }
+    ProcessChannel_x8_AVX2( px, dst );
 }
 
 #ifndef _MSC_VER
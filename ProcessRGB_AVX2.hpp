@@ -3,12 +3,31 @@
 
 #ifdef __SSE4_1__
 
+#include <stddef.h>
+
 #include "Types.hpp"
 
 uint64 ProcessRGB_AVX2( const uint8* src );
 uint64 ProcessRGB_4x2_AVX2( const uint8* src );
 uint64 ProcessRGB_2x4_AVX2( const uint8* src );
+// Picks the orientation from the half block averages and only encodes that one. Takes the differential mode whenever
+// it fits and searches four of the tables. Produces the same results as ProcessRGB_Fast_AVX2_x8.
+uint64 ProcessRGB_Fast_AVX2( const uint8* src );
 uint64 ProcessRGB_ETC2_AVX2( const uint8* src );
+uint64 ProcessRGB_ETC2_A1_AVX2( const uint8* src );
+
+void ProcessRGB_AVX2_x8( const uint8* src, size_t pitch, uint64* dst );
+void ProcessRGB_AVX2_x8_Tiled( const uint8* src, uint64* dst );
+// Faster and less accurate versions of the above, which leave out the error estimate of the subdivisions and search
+// only half of the tables
+void ProcessRGB_Fast_AVX2_x8( const uint8* src, size_t pitch, uint64* dst );
+void ProcessRGB_Fast_AVX2_x8_Tiled( const uint8* src, uint64* dst );
+// Encode the alpha channel of 8 consecutive blocks of pixels as gray ETC1 blocks, like ProcessAlpha
+void ProcessAlpha_AVX2_x8( const uint8* src, size_t pitch, uint64* dst );
+void ProcessAlpha_AVX2_x8_Tiled( const uint8* src, uint64* dst );
+// Encode 8 consecutive blocks of gray pixels (equal red, green and blue) as gray ETC1 blocks
+void ProcessGray_AVX2_x8( const uint8* src, size_t pitch, uint64* dst );
+void ProcessGray_AVX2_x8_Tiled( const uint8* src, uint64* dst );
 
 #endif
 
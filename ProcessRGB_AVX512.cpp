@@ -0,0 +1,887 @@
+#ifdef __SSE4_1__
+
+#include <string.h>
+
+#include "ProcessRGB_AVX512.hpp"
+#include "Tables.hpp"
+#include "Types.hpp"
+#ifdef _MSC_VER
+#  include <intrin.h>
+#  include <Windows.h>
+#  define _bswap(x) _byteswap_ulong(x)
+#  define VS_VECTORCALL _vectorcall
+#else
+#  include <x86intrin.h>
+#  pragma GCC push_options
+#  pragma GCC target ("avx512f,avx512bw,avx512vl,avx2,fma,bmi2")
+#  define VS_VECTORCALL
+#endif
+
+#define noexcept
+#define alignas(n) __declspec(align(n))
+
+namespace
+{
+
+#ifdef _MSC_VER
+    inline unsigned long _bit_scan_forward( unsigned long mask )
+    {
+        unsigned long ret;
+        _BitScanForward( &ret, mask );
+        return ret;
+    }
+#endif
+
+// Transposes 16 consecutive blocks, so that each output vector holds the same pixel of all sixteen blocks.
+// Output is stored in the same column-major order the single block functions use (pixel index is x * 4 + y).
+void VS_VECTORCALL Transpose_x16_AVX512( const uint8* src, size_t pitch, __m512i px[16] ) noexcept
+{
+    const __m512i idx01 = _mm512_setr_epi32(0, 4, 8, 12, 16, 20, 24, 28, 1, 5, 9, 13, 17, 21, 25, 29);
+    const __m512i idx23 = _mm512_setr_epi32(2, 6, 10, 14, 18, 22, 26, 30, 3, 7, 11, 15, 19, 23, 27, 31);
+    const __m512i idxLo = _mm512_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7, 16, 17, 18, 19, 20, 21, 22, 23);
+    const __m512i idxHi = _mm512_setr_epi32(8, 9, 10, 11, 12, 13, 14, 15, 24, 25, 26, 27, 28, 29, 30, 31);
+
+    for( int y=0; y<4; y++ )
+    {
+        const uint8* row = src + y * pitch;
+
+        __m512i d0 = _mm512_loadu_si512(((__m512i*)row) + 0);   // blocks 0 - 3
+        __m512i d1 = _mm512_loadu_si512(((__m512i*)row) + 1);   // blocks 4 - 7
+        __m512i d2 = _mm512_loadu_si512(((__m512i*)row) + 2);   // blocks 8 - 11
+        __m512i d3 = _mm512_loadu_si512(((__m512i*)row) + 3);   // blocks 12 - 15
+
+        // First two columns of blocks 0 - 7 and 8 - 15, then the last two
+        __m512i a01 = _mm512_permutex2var_epi32(d0, idx01, d1);
+        __m512i b01 = _mm512_permutex2var_epi32(d2, idx01, d3);
+        __m512i a23 = _mm512_permutex2var_epi32(d0, idx23, d1);
+        __m512i b23 = _mm512_permutex2var_epi32(d2, idx23, d3);
+
+        px[y]      = _mm512_permutex2var_epi32(a01, idxLo, b01);
+        px[y + 4]  = _mm512_permutex2var_epi32(a01, idxHi, b01);
+        px[y + 8]  = _mm512_permutex2var_epi32(a23, idxLo, b23);
+        px[y + 12] = _mm512_permutex2var_epi32(a23, idxHi, b23);
+    }
+}
+
+// Same as Transpose_x16_AVX512, for 16 consecutive blocks of a tiled bitmap. Each block is loaded as one vector, so this
+// is a transpose of a 16x16 matrix.
+void VS_VECTORCALL TransposeTiled_x16_AVX512( const uint8* src, __m512i px[16] ) noexcept
+{
+    __m512i u[4][4];
+    for( int g=0; g<4; g++ )
+    {
+        __m512i r0 = _mm512_loadu_si512(((__m512i*)src) + g * 4 + 0);
+        __m512i r1 = _mm512_loadu_si512(((__m512i*)src) + g * 4 + 1);
+        __m512i r2 = _mm512_loadu_si512(((__m512i*)src) + g * 4 + 2);
+        __m512i r3 = _mm512_loadu_si512(((__m512i*)src) + g * 4 + 3);
+
+        __m512i t0 = _mm512_unpacklo_epi32(r0, r1);
+        __m512i t1 = _mm512_unpackhi_epi32(r0, r1);
+        __m512i t2 = _mm512_unpacklo_epi32(r2, r3);
+        __m512i t3 = _mm512_unpackhi_epi32(r2, r3);
+
+        // Pixel j of each 128 bit lane of four blocks
+        u[g][0] = _mm512_unpacklo_epi64(t0, t2);
+        u[g][1] = _mm512_unpackhi_epi64(t0, t2);
+        u[g][2] = _mm512_unpacklo_epi64(t1, t3);
+        u[g][3] = _mm512_unpackhi_epi64(t1, t3);
+    }
+
+    for( int j=0; j<4; j++ )
+    {
+        __m512i a0 = _mm512_shuffle_i32x4(u[0][j], u[1][j], _MM_SHUFFLE(2, 0, 2, 0));
+        __m512i a1 = _mm512_shuffle_i32x4(u[0][j], u[1][j], _MM_SHUFFLE(3, 1, 3, 1));
+        __m512i b0 = _mm512_shuffle_i32x4(u[2][j], u[3][j], _MM_SHUFFLE(2, 0, 2, 0));
+        __m512i b1 = _mm512_shuffle_i32x4(u[2][j], u[3][j], _MM_SHUFFLE(3, 1, 3, 1));
+
+        px[j]      = _mm512_shuffle_i32x4(a0, b0, _MM_SHUFFLE(2, 0, 2, 0));
+        px[j + 4]  = _mm512_shuffle_i32x4(a1, b1, _MM_SHUFFLE(2, 0, 2, 0));
+        px[j + 8]  = _mm512_shuffle_i32x4(a0, b0, _MM_SHUFFLE(3, 1, 3, 1));
+        px[j + 12] = _mm512_shuffle_i32x4(a1, b1, _MM_SHUFFLE(3, 1, 3, 1));
+    }
+}
+
+// Multiplies 32 bit lanes holding values that fit in int16
+__m512i VS_VECTORCALL Mul16_x16_AVX512( const __m512i a, const __m512i b ) noexcept
+{
+    return _mm512_madd_epi16(a, _mm512_and_si512(b, _mm512_set1_epi32(0xFFFF)));
+}
+
+__m512i VS_VECTORCALL MulBit_x16_AVX512( const __m512i a, const int b ) noexcept
+{
+    __m512i t = _mm512_add_epi32(Mul16_x16_AVX512(a, _mm512_set1_epi32(b)), _mm512_set1_epi32(128));
+    return _mm512_srli_epi32(_mm512_add_epi32(t, _mm512_srli_epi32(t, 8)), 8);
+}
+
+__m512i VS_VECTORCALL Expand5_x16_AVX512( const __m512i c ) noexcept
+{
+    return _mm512_or_si512(_mm512_slli_epi32(c, 3), _mm512_srli_epi32(c, 2));
+}
+
+__m512i VS_VECTORCALL Channel_x16_AVX512( const __m512i p, const int c ) noexcept
+{
+    return _mm512_and_si512(_mm512_srli_epi32(p, c * 8), _mm512_set1_epi32(0xFF));
+}
+
+// Same as CalcErrorBlock_AVX2, for one half block of sixteen blocks at once
+__m512i VS_VECTORCALL CalcError_x16_AVX512( const __m512i a[3], const __m512i s[3] ) noexcept
+{
+    __m512i sq = _mm512_add_epi32(_mm512_add_epi32(Mul16_x16_AVX512(a[0], a[0]), Mul16_x16_AVX512(a[1], a[1])), Mul16_x16_AVX512(a[2], a[2]));
+    __m512i dot = _mm512_add_epi32(_mm512_add_epi32(Mul16_x16_AVX512(a[0], s[0]), Mul16_x16_AVX512(a[1], s[1])), Mul16_x16_AVX512(a[2], s[2]));
+
+    __m512i err = _mm512_add_epi32(_mm512_slli_epi32(sq, 3), _mm512_set1_epi32(0x3FFFFFFF));
+    return _mm512_sub_epi32(err, _mm512_slli_epi32(dot, 1));
+}
+
+// Selects the first table with least error, in the same way EncodeSelectors_AVX2 does
+__m512i VS_VECTORCALL SelectTable_x16_AVX512( const __m512i terr[8], const __m512i tsel[8], __m512i& tidx, __m512i& error ) noexcept
+{
+    __m512i best = terr[0];
+    __m512i sel = tsel[0];
+    tidx = _mm512_setzero_si512();
+    for( int t=1; t<8; t++ )
+    {
+        __mmask16 lt = _mm512_cmplt_epu32_mask(terr[t], best);
+        best = _mm512_mask_mov_epi32(best, lt, terr[t]);
+        sel = _mm512_mask_mov_epi32(sel, lt, tsel[t]);
+        tidx = _mm512_mask_mov_epi32(tidx, lt, _mm512_set1_epi32(t));
+    }
+    error = best;
+    return sel;
+}
+
+// Distance of a pixel to the color of its half block, with the same weights as in FindBestFit_AVX2, scaled by 128
+__m512i VS_VECTORCALL WeightedDistance_x16_AVX512( const __m512i color[3], const __m512i px ) noexcept
+{
+    __m512i w0 = Mul16_x16_AVX512(_mm512_sub_epi32(color[0], Channel_x16_AVX512(px, 0)), _mm512_set1_epi32(14));
+    __m512i w1 = Mul16_x16_AVX512(_mm512_sub_epi32(color[1], Channel_x16_AVX512(px, 1)), _mm512_set1_epi32(76));
+    __m512i w2 = Mul16_x16_AVX512(_mm512_sub_epi32(color[2], Channel_x16_AVX512(px, 2)), _mm512_set1_epi32(38));
+    return _mm512_add_epi32(_mm512_add_epi32(w0, w1), w2);
+}
+
+// Same as TableWindow_x8_AVX2
+__m512i VS_VECTORCALL TableWindow_x16_AVX512( const __m512i sum ) noexcept
+{
+    const int threshold[7] = { 8, 15, 23, 33, 45, 61, 92 };
+
+    __m512i t = _mm512_set1_epi32(-1);
+    for( int i=0; i<7; i++ )
+    {
+        t = _mm512_mask_add_epi32(t, _mm512_cmpgt_epi32_mask(sum, _mm512_set1_epi32(threshold[i] * 8 * 128)), t, _mm512_set1_epi32(1));
+    }
+    return _mm512_min_epi32(_mm512_max_epi32(t, _mm512_setzero_si512()), _mm512_set1_epi32(4));
+}
+
+// Computes the ETC1 encoding of sixteen blocks. Returns the first half of the encoded blocks, the selectors (not byte
+// swapped) are returned in t2. The error of the selected tables is used for the ETC2 mode decision.
+// The fast variant is the one of ProcessRGB_x8_AVX2.
+template<bool Fast>
+__m512i VS_VECTORCALL EncodeEtc1_x16_AVX512( const __m512i px[16], __m512i& t2, __m512i& error ) noexcept
+{
+    // Sums of quadrants, first and third channel in lo, second channel in mid. Index is x / 2 * 2 + y / 2.
+    __m512i qlo[4], qmid[4];
+    for( int q=0; q<4; q++ )
+    {
+        const int i = ( q >> 1 ) * 8 + ( q & 1 ) * 2;
+        __m512i lo = _mm512_setzero_si512();
+        __m512i mid = _mm512_setzero_si512();
+        for( int j=0; j<4; j++ )
+        {
+            __m512i p = px[i + ( j >> 1 ) * 4 + ( j & 1 )];
+            lo = _mm512_add_epi32(lo, _mm512_and_si512(p, _mm512_set1_epi32(0x00FF00FF)));
+            mid = _mm512_add_epi32(mid, Channel_x16_AVX512(p, 1));
+        }
+        qlo[q] = lo;
+        qmid[q] = mid;
+    }
+
+    // Half blocks in the same order as in ProcessRGB_AVX2: right, left, bottom, top
+    __m512i s[4][3];
+    {
+        const int quad[4][2] = { { 2, 3 }, { 0, 1 }, { 1, 3 }, { 0, 2 } };
+        for( int h=0; h<4; h++ )
+        {
+            __m512i lo = _mm512_add_epi32(qlo[quad[h][0]], qlo[quad[h][1]]);
+            s[h][0] = _mm512_and_si512(lo, _mm512_set1_epi32(0xFFFF));
+            s[h][1] = _mm512_add_epi32(qmid[quad[h][0]], qmid[quad[h][1]]);
+            s[h][2] = _mm512_srli_epi32(lo, 16);
+        }
+    }
+
+    __m512i a[8][3];
+    // Differential mode is possible without clamping the color difference
+    __mmask16 fits[2] = { 0xFFFF, 0xFFFF };
+    for( int c=0; c<3; c++ )
+    {
+        __m512i c5[4];
+        for( int h=0; h<4; h++ )
+        {
+            __m512i avg = _mm512_srli_epi32(_mm512_add_epi32(s[h][c], _mm512_set1_epi32(4)), 3);
+
+            __m512i c4 = MulBit_x16_AVX512(avg, 15);
+            a[h][c] = _mm512_or_si512(c4, _mm512_slli_epi32(c4, 4));
+
+            c5[h] = MulBit_x16_AVX512(avg, 31);
+        }
+        for( int h=0; h<4; h+=2 )
+        {
+            __m512i diff0 = _mm512_sub_epi32(c5[h], c5[h+1]);
+            __m512i diff = _mm512_max_epi32(diff0, _mm512_set1_epi32(-4));
+            diff = _mm512_min_epi32(diff, _mm512_set1_epi32(3));
+            if( Fast )
+            {
+                fits[h/2] = _mm512_mask_cmpeq_epi32_mask(fits[h/2], diff, diff0);
+            }
+
+            a[4+h][c] = Expand5_x16_AVX512(_mm512_add_epi32(c5[h+1], diff));
+            a[5+h][c] = Expand5_x16_AVX512(c5[h+1]);
+        }
+    }
+
+    __m512i idx = _mm512_setzero_si512();
+    if( Fast )
+    {
+        __m512i lr = _mm512_setzero_si512();
+        __m512i tb = _mm512_setzero_si512();
+        for( int c=0; c<3; c++ )
+        {
+            __m512i dlr = _mm512_sub_epi32(s[0][c], s[1][c]);
+            __m512i dtb = _mm512_sub_epi32(s[2][c], s[3][c]);
+            lr = _mm512_add_epi32(lr, Mul16_x16_AVX512(dlr, dlr));
+            tb = _mm512_add_epi32(tb, Mul16_x16_AVX512(dtb, dtb));
+        }
+        const __mmask16 flip = _mm512_cmpgt_epi32_mask(tb, lr);
+        const __mmask16 diff = ( fits[0] & ~flip ) | ( fits[1] & flip );
+        idx = _mm512_mask_mov_epi32(idx, flip, _mm512_set1_epi32(1));
+        idx = _mm512_mask_add_epi32(idx, diff, idx, _mm512_set1_epi32(2));
+    }
+    else
+    {
+        __m512i errMin = _mm512_add_epi32(CalcError_x16_AVX512(a[0], s[0]), CalcError_x16_AVX512(a[1], s[1]));
+        for( int i=1; i<4; i++ )
+        {
+            const int h = ( i & 1 ) * 2;
+            __m512i err = _mm512_add_epi32(CalcError_x16_AVX512(a[i*2], s[h]), CalcError_x16_AVX512(a[i*2+1], s[h+1]));
+
+            __mmask16 lt = _mm512_cmplt_epu32_mask(err, errMin);
+            errMin = _mm512_mask_mov_epi32(errMin, lt, err);
+            idx = _mm512_mask_mov_epi32(idx, lt, _mm512_set1_epi32(i));
+        }
+    }
+
+    const __mmask16 flip = _mm512_test_epi32_mask(idx, _mm512_set1_epi32(1));
+    const __mmask16 diff = _mm512_test_epi32_mask(idx, _mm512_set1_epi32(2));
+
+    // Colors of each quadrant, the first half block is in quadrant 0, the second in quadrant 3
+    __m512i quad[4][3];
+    __m512i d = _mm512_slli_epi32(idx, 24);
+    for( int c=0; c<3; c++ )
+    {
+        __m512i right = _mm512_mask_mov_epi32(a[0][c], diff, a[4][c]);
+        __m512i left = _mm512_mask_mov_epi32(a[1][c], diff, a[5][c]);
+        __m512i bottom = _mm512_mask_mov_epi32(a[2][c], diff, a[6][c]);
+        __m512i top = _mm512_mask_mov_epi32(a[3][c], diff, a[7][c]);
+
+        quad[0][c] = _mm512_mask_mov_epi32(left, flip, top);
+        quad[1][c] = _mm512_mask_mov_epi32(left, flip, bottom);
+        quad[2][c] = _mm512_mask_mov_epi32(right, flip, top);
+        quad[3][c] = _mm512_mask_mov_epi32(right, flip, bottom);
+
+        const __m512i first = quad[0][c];
+        const __m512i second = quad[3][c];
+
+        __m512i v4 = _mm512_or_si512(_mm512_and_si512(first, _mm512_set1_epi32(0xF0)), _mm512_srli_epi32(second, 4));
+
+        __m512i f5 = _mm512_and_si512(first, _mm512_set1_epi32(0xF8));
+        __m512i s5 = _mm512_and_si512(second, _mm512_set1_epi32(0xF8));
+        __m512i d5 = _mm512_and_si512(_mm512_srai_epi32(_mm512_sub_epi32(s5, f5), 3), _mm512_set1_epi32(0x07));
+
+        __m512i v = _mm512_mask_mov_epi32(v4, diff, _mm512_or_si512(f5, d5));
+        d = _mm512_or_si512(d, _mm512_slli_epi32(v, ( 2 - c ) * 8));
+    }
+
+    // Quadrants 0 and 3 always belong to the first and second half block, quadrants 1 and 2 depend on flip
+    const __mmask16 inFirst[4] = { 0xFFFF, (__mmask16)~flip, flip, 0 };
+
+    __m512i terr[2][8], tsel[8];
+    for( int t=0; t<8; t++ )
+    {
+        terr[0][t] = _mm512_setzero_si512();
+        terr[1][t] = _mm512_setzero_si512();
+        tsel[t] = _mm512_setzero_si512();
+    }
+    __m512i msb = _mm512_setzero_si512();
+
+    // The fast variant needs the distances of all pixels up front, to place the table windows
+    __m512i pixels[16], tstart[4], start0, start1;
+    if( Fast )
+    {
+        __m512i sum0 = _mm512_setzero_si512();
+        __m512i sum1 = _mm512_setzero_si512();
+        for( int q=0; q<4; q++ )
+        {
+            __m512i qsum = _mm512_setzero_si512();
+            const int base = ( q >> 1 ) * 8 + ( q & 1 ) * 2;
+            for( int j=0; j<4; j++ )
+            {
+                const int i = base + ( j >> 1 ) * 4 + ( j & 1 );
+                pixels[i] = WeightedDistance_x16_AVX512( quad[q], px[i] );
+                qsum = _mm512_add_epi32(qsum, _mm512_abs_epi32(pixels[i]));
+            }
+            sum1 = _mm512_mask_add_epi32(sum1, inFirst[q], sum1, qsum);
+            sum0 = _mm512_mask_add_epi32(sum0, (__mmask16)~inFirst[q], sum0, qsum);
+        }
+        start0 = TableWindow_x16_AVX512( sum0 );
+        start1 = TableWindow_x16_AVX512( sum1 );
+        for( int q=0; q<4; q++ )
+        {
+            tstart[q] = _mm512_mask_mov_epi32(start0, inFirst[q], start1);
+        }
+    }
+
+    const int tables = Fast ? 4 : 8;
+    const __m512i table0 = _mm512_setr_epi32(g_table[0][0] * 128, g_table[1][0] * 128, g_table[2][0] * 128, g_table[3][0] * 128, g_table[4][0] * 128, g_table[5][0] * 128, g_table[6][0] * 128, g_table[7][0] * 128, 0, 0, 0, 0, 0, 0, 0, 0);
+    const __m512i table1 = _mm512_setr_epi32(g_table[0][1] * 128, g_table[1][1] * 128, g_table[2][1] * 128, g_table[3][1] * 128, g_table[4][1] * 128, g_table[5][1] * 128, g_table[6][1] * 128, g_table[7][1] * 128, 0, 0, 0, 0, 0, 0, 0, 0);
+
+    for( int q=0; q<4; q++ )
+    {
+        __m512i qerr[8];
+        for( int t=0; t<tables; t++ )
+        {
+            qerr[t] = _mm512_setzero_si512();
+        }
+
+        const int base = ( q >> 1 ) * 8 + ( q & 1 ) * 2;
+        for( int j=0; j<4; j++ )
+        {
+            const int i = base + ( j >> 1 ) * 4 + ( j & 1 );
+            const __m512i bit = _mm512_set1_epi32(1 << i);
+
+            __m512i pixel = Fast ? pixels[i] : WeightedDistance_x16_AVX512( quad[q], px[i] );
+            __m512i pix = _mm512_abs_epi32(pixel);
+
+            // Exploiting symmetry of the selector table and use the sign bit, already flipped
+            msb = _mm512_mask_or_epi32(msb, _mm512_cmpge_epi32_mask(pixel, _mm512_setzero_si512()), msb, bit);
+
+            // All sixteen blocks are searched for the best table entry at once
+            for( int t=0; t<tables; t++ )
+            {
+                __m512i t0, t1;
+                if( Fast )
+                {
+                    __m512i ti = _mm512_add_epi32(tstart[q], _mm512_set1_epi32(t));
+                    t0 = _mm512_permutexvar_epi32(ti, table0);
+                    t1 = _mm512_permutexvar_epi32(ti, table1);
+                }
+                else
+                {
+                    t0 = _mm512_set1_epi32(g_table[t][0] * 128);
+                    t1 = _mm512_set1_epi32(g_table[t][1] * 128);
+                }
+                __m512i error0 = _mm512_abs_epi32(_mm512_sub_epi32(pix, t0));
+                __m512i error1 = _mm512_abs_epi32(_mm512_sub_epi32(pix, t1));
+
+                __mmask16 minIndex = _mm512_cmpgt_epi32_mask(error0, error1);
+                __m512i minError = _mm512_min_epi32(error0, error1);
+
+                qerr[t] = _mm512_add_epi32(qerr[t], _mm512_madd_epi16(minError, minError));
+                tsel[t] = _mm512_mask_or_epi32(tsel[t], minIndex, tsel[t], bit);
+            }
+        }
+
+        for( int t=0; t<tables; t++ )
+        {
+            terr[1][t] = _mm512_mask_add_epi32(terr[1][t], inFirst[q], terr[1][t], qerr[t]);
+            terr[0][t] = _mm512_mask_add_epi32(terr[0][t], (__mmask16)~inFirst[q], terr[0][t], qerr[t]);
+        }
+    }
+
+    // Window positions past the searched ones are never selected
+    for( int t=tables; t<8; t++ )
+    {
+        terr[0][t] = _mm512_set1_epi32(-1);
+        terr[1][t] = _mm512_set1_epi32(-1);
+    }
+
+    __m512i tidx0, tidx1, error0, error1;
+    __m512i sel0 = SelectTable_x16_AVX512(terr[0], tsel, tidx0, error0);
+    __m512i sel1 = SelectTable_x16_AVX512(terr[1], tsel, tidx1, error1);
+    if( Fast )
+    {
+        tidx0 = _mm512_add_epi32(tidx0, start0);
+        tidx1 = _mm512_add_epi32(tidx1, start1);
+    }
+
+    d = _mm512_or_si512(d, _mm512_slli_epi32(tidx0, 26));
+    d = _mm512_or_si512(d, _mm512_slli_epi32(tidx1, 29));
+
+    __m512i mask1 = _mm512_mask_mov_epi32(_mm512_set1_epi32(0x00FF), flip, _mm512_set1_epi32(0x3333));
+    __m512i lsb = _mm512_ternarylogic_epi32(mask1, sel1, _mm512_and_si512(sel0, _mm512_set1_epi32(0xFFFF)), 0xCA);
+    t2 = _mm512_or_si512(lsb, _mm512_slli_epi32(msb, 16));
+
+    error = _mm512_add_epi32(error0, error1);
+    return d;
+}
+
+__mmask16 VS_VECTORCALL CheckSolid_x16_AVX512( const __m512i px[16] ) noexcept
+{
+    __mmask16 solid = _mm512_cmpeq_epi32_mask(px[0], px[1]);
+    for( int i=2; i<16; i++ )
+    {
+        solid = _mm512_mask_cmpeq_epi32_mask(solid, px[0], px[i]);
+    }
+    return solid;
+}
+
+// Interleaves both halves of the encoded blocks and stores them in block order
+void VS_VECTORCALL Store_x16_AVX512( const __m512i d, const __m512i t2, uint64* dst ) noexcept
+{
+    const __m512i swap = _mm512_set4_epi32(0x0C0D0E0F, 0x08090A0B, 0x04050607, 0x00010203);
+    __m512i t3 = _mm512_shuffle_epi8(t2, swap);
+
+    __m512i r0 = _mm512_unpacklo_epi32(d, t3);  // 0, 1, 4, 5, 8, 9, 12, 13
+    __m512i r1 = _mm512_unpackhi_epi32(d, t3);  // 2, 3, 6, 7, 10, 11, 14, 15
+
+    _mm512_storeu_si512(((__m512i*)dst) + 0, _mm512_permutex2var_epi64(r0, _mm512_setr_epi64(0, 1, 8, 9, 2, 3, 10, 11), r1));
+    _mm512_storeu_si512(((__m512i*)dst) + 1, _mm512_permutex2var_epi64(r0, _mm512_setr_epi64(4, 5, 12, 13, 6, 7, 14, 15), r1));
+}
+
+// Same as the conversion in r6g7b6_AVX2, for one channel. Red and blue use 6 bits, green uses 7 bits.
+__m512i VS_VECTORCALL Quantize_x16_AVX512( const __m512 cf, const bool green ) noexcept
+{
+    __m512i c0 = _mm512_cvttps_epi32(cf);
+    __m512i c1 = _mm512_min_epi32(_mm512_max_epi32(c0, _mm512_setzero_si512()), _mm512_set1_epi32(1023));
+    __m512i c2 = _mm512_srai_epi32(_mm512_sub_epi32(c1, _mm512_set1_epi32(15)), 1);
+
+    __m512i c3, c4;
+    if( green )
+    {
+        __m512i g0 = _mm512_add_epi32(c2, _mm512_set1_epi32(9));
+        __m512i g1 = _mm512_add_epi32(c2, _mm512_set1_epi32(6));
+        c3 = _mm512_sub_epi32(_mm512_sub_epi32(g0, _mm512_srai_epi32(g0, 8)), _mm512_srai_epi32(g1, 8));
+        c4 = _mm512_srai_epi32(c3, 2);
+    }
+    else
+    {
+        __m512i rb0 = _mm512_add_epi32(c2, _mm512_set1_epi32(11));
+        __m512i rb1 = _mm512_add_epi32(c2, _mm512_set1_epi32(4));
+        c3 = _mm512_sub_epi32(_mm512_sub_epi32(rb0, _mm512_srai_epi32(rb0, 7)), _mm512_srai_epi32(rb1, 7));
+        c4 = _mm512_srai_epi32(c3, 3);
+    }
+
+    return _mm512_min_epi32(_mm512_max_epi32(c4, _mm512_setzero_si512()), _mm512_set1_epi32(255));
+}
+
+__m512i VS_VECTORCALL Expand6_x16_AVX512( const __m512i c ) noexcept
+{
+    return _mm512_or_si512(_mm512_srli_epi32(c, 4), _mm512_slli_epi32(c, 2));
+}
+
+__m512i VS_VECTORCALL Expand7_x16_AVX512( const __m512i c ) noexcept
+{
+    return _mm512_or_si512(_mm512_srli_epi32(c, 6), _mm512_slli_epi32(c, 1));
+}
+
+uint64 EncodePlanar( const uint32 rgbo, const uint32 rgbh, const uint32 rgbv0 ) noexcept
+{
+    uint64 rgbho = ( uint64( rgbo ) << 32 ) | rgbh;
+
+    uint32 rgbv = _pext_u32(rgbv0, 0x3F7F3F);
+    uint64 rgbho0 = _pext_u64(rgbho, 0x3F7F3F003F7F3F);
+
+    uint32 hi = rgbv | ((rgbho0 & 0x1FFF) << 19);
+    uint32 lo = _pdep_u32(rgbho0 >> 13, 0x7F7F1BFD);
+
+    uint32 idx = _pext_u64(rgbho, 0x20201E00000000);
+    lo |= _pdep_u32(g_flags_AVX2[idx], 0x8080E402);
+    uint64 result = static_cast<uint32>(_bswap(lo));
+    result |= static_cast<uint64>(static_cast<uint32>(_bswap(hi))) << 32;
+
+    return result;
+}
+
+// Planar mode of sixteen blocks, computed in the same way as Planar_AVX2. The quantized colors are returned as
+// 0x00RRGGBB, to be encoded only for the blocks which use planar mode.
+__m512i VS_VECTORCALL Planar_x16_AVX512( const __m512i px[16], __m512i& rgbo, __m512i& rgbh, __m512i& rgbv ) noexcept
+{
+    const float value = (255 * 255 * 8.0f + 85 * 85 * 8.0f) * 16.0f;
+    const int weights[4] = { -255, -85, 85, 255 };
+
+    __m512i co[3], ch[3], cv[3];
+    for( int c=0; c<3; c++ )
+    {
+        const int channel = 2 - c;
+
+        __m512i sum = _mm512_setzero_si512();
+        __m512i xz = _mm512_setzero_si512();
+        __m512i yz = _mm512_setzero_si512();
+        for( int i=0; i<16; i++ )
+        {
+            __m512i v = Channel_x16_AVX512(px[i], channel);
+            sum = _mm512_add_epi32(sum, v);
+            xz = _mm512_add_epi32(xz, Mul16_x16_AVX512(v, _mm512_set1_epi32(weights[i / 4])));
+            yz = _mm512_add_epi32(yz, Mul16_x16_AVX512(v, _mm512_set1_epi32(weights[i % 4])));
+        }
+        // Planar_AVX2 weights 16 * value - sum, the sum part cancels out as the weights add up to zero
+        xz = _mm512_slli_epi32(xz, 4);
+        yz = _mm512_slli_epi32(yz, 4);
+
+        __m512 scale = _mm512_set1_ps(-4.0f / value);
+
+        __m512 af = _mm512_mul_ps(_mm512_cvtepi32_ps(xz), scale);
+        __m512 bf = _mm512_mul_ps(_mm512_cvtepi32_ps(yz), scale);
+
+        __m512 df = _mm512_mul_ps(_mm512_cvtepi32_ps(sum), _mm512_set1_ps(4.0f / 16.0f));
+
+        // calculating the three colors RGBO, RGBH, and RGBV.  RGB = df - af * x - bf * y;
+        __m512 cof0 = _mm512_fnmadd_ps(af, _mm512_set1_ps(-255.0f), _mm512_fnmadd_ps(bf, _mm512_set1_ps(-255.0f), df));
+        __m512 chf0 = _mm512_fnmadd_ps(af, _mm512_set1_ps( 425.0f), _mm512_fnmadd_ps(bf, _mm512_set1_ps(-255.0f), df));
+        __m512 cvf0 = _mm512_fnmadd_ps(af, _mm512_set1_ps(-255.0f), _mm512_fnmadd_ps(bf, _mm512_set1_ps( 425.0f), df));
+
+        co[c] = Quantize_x16_AVX512(cof0, c == 1);
+        ch[c] = Quantize_x16_AVX512(chf0, c == 1);
+        cv[c] = Quantize_x16_AVX512(cvf0, c == 1);
+    }
+
+    rgbo = _mm512_or_si512(_mm512_or_si512(_mm512_slli_epi32(co[0], 16), _mm512_slli_epi32(co[1], 8)), co[2]);
+    rgbh = _mm512_or_si512(_mm512_or_si512(_mm512_slli_epi32(ch[0], 16), _mm512_slli_epi32(ch[1], 8)), ch[2]);
+    rgbv = _mm512_or_si512(_mm512_or_si512(_mm512_slli_epi32(cv[0], 16), _mm512_slli_epi32(cv[1], 8)), cv[2]);
+
+    // Error calculation
+    __m512i o2[3], h2[3], v2[3];
+    for( int c=0; c<3; c++ )
+    {
+        __m512i o1 = c == 1 ? Expand7_x16_AVX512(co[c]) : Expand6_x16_AVX512(co[c]);
+        __m512i h1 = c == 1 ? Expand7_x16_AVX512(ch[c]) : Expand6_x16_AVX512(ch[c]);
+        __m512i v1 = c == 1 ? Expand7_x16_AVX512(cv[c]) : Expand6_x16_AVX512(cv[c]);
+
+        o2[c] = _mm512_add_epi32(_mm512_slli_epi32(o1, 2), _mm512_set1_epi32(2));
+        h2[c] = _mm512_sub_epi32(h1, o1);
+        v2[c] = _mm512_sub_epi32(v1, o1);
+    }
+
+    const int errWeights[3] = { 38, 76, 14 };
+
+    __m512i error = _mm512_setzero_si512();
+    for( int i=0; i<16; i++ )
+    {
+        const int x = i / 4;
+        const int y = i % 4;
+
+        __m512i sum = _mm512_setzero_si512();
+        for( int c=0; c<3; c++ )
+        {
+            __m512i p0 = _mm512_add_epi32(_mm512_add_epi32(Mul16_x16_AVX512(h2[c], _mm512_set1_epi32(x)), Mul16_x16_AVX512(v2[c], _mm512_set1_epi32(y))), o2[c]);
+            __m512i p1 = _mm512_srai_epi32(p0, 2);
+            __m512i p2 = _mm512_min_epi32(_mm512_max_epi32(p1, _mm512_setzero_si512()), _mm512_set1_epi32(255));
+
+            __m512i dif = _mm512_sub_epi32(Channel_x16_AVX512(px[i], 2 - c), p2);
+            sum = _mm512_add_epi32(sum, Mul16_x16_AVX512(dif, _mm512_set1_epi32(errWeights[c])));
+        }
+        error = _mm512_add_epi32(error, Mul16_x16_AVX512(sum, sum));
+    }
+
+    return error;
+}
+
+template<bool Fast>
+void VS_VECTORCALL ProcessRGB_x16_AVX512( const __m512i px[16], uint64* dst ) noexcept
+{
+    __m512i t2, error;
+    __m512i d = EncodeEtc1_x16_AVX512<Fast>( px, t2, error );
+
+    __mmask16 solid = CheckSolid_x16_AVX512( px );
+    if( solid != 0 )
+    {
+        __m512i solidColor = _mm512_and_si512(px[0], _mm512_set1_epi32(0xF8F8F8));
+        __m512i solidColorSwap = _mm512_shuffle_epi8(solidColor, _mm512_set4_epi32(0xFF0C0D0E, 0xFF08090A, 0xFF040506, 0xFF000102));
+
+        d = _mm512_mask_mov_epi32(d, solid, _mm512_or_si512(solidColorSwap, _mm512_set1_epi32(0x02000000)));
+        t2 = _mm512_mask_mov_epi32(t2, solid, _mm512_setzero_si512());
+    }
+
+    Store_x16_AVX512( d, t2, dst );
+}
+
+// Single channel version of ProcessRGB_x16_AVX512, the values are in the low byte of each lane. The blocks are encoded
+// with gray colors. Produces the same results as ProcessAlpha.
+void VS_VECTORCALL ProcessChannel_x16_AVX512( const __m512i p[16], uint64* dst ) noexcept
+{
+    // Sums of quadrants. Index is x / 2 * 2 + y / 2.
+    __m512i q[4];
+    for( int k=0; k<4; k++ )
+    {
+        const int i = ( k >> 1 ) * 8 + ( k & 1 ) * 2;
+        q[k] = _mm512_add_epi32(_mm512_add_epi32(p[i], p[i+1]), _mm512_add_epi32(p[i+4], p[i+5]));
+    }
+
+    // Half blocks in the same order as in ProcessAlpha: right, left, bottom, top
+    const int quad[4][2] = { { 2, 3 }, { 0, 1 }, { 1, 3 }, { 0, 2 } };
+    __m512i s[4], a[8], c5[4];
+    for( int h=0; h<4; h++ )
+    {
+        s[h] = _mm512_add_epi32(q[quad[h][0]], q[quad[h][1]]);
+        __m512i avg = _mm512_srli_epi32(_mm512_add_epi32(s[h], _mm512_set1_epi32(4)), 3);
+
+        __m512i c4 = MulBit_x16_AVX512(avg, 15);
+        a[h] = _mm512_or_si512(c4, _mm512_slli_epi32(c4, 4));
+
+        c5[h] = MulBit_x16_AVX512(avg, 31);
+    }
+    for( int h=0; h<4; h+=2 )
+    {
+        __m512i diff = _mm512_sub_epi32(c5[h], c5[h+1]);
+        diff = _mm512_max_epi32(diff, _mm512_set1_epi32(-4));
+        diff = _mm512_min_epi32(diff, _mm512_set1_epi32(3));
+
+        a[4+h] = Expand5_x16_AVX512(_mm512_add_epi32(c5[h+1], diff));
+        a[5+h] = Expand5_x16_AVX512(c5[h+1]);
+    }
+
+    // Sum of squares is the same for all choices and left out, like in CalcError_x16_AVX512
+    __m512i idx = _mm512_setzero_si512();
+    __m512i errMin;
+    for( int i=0; i<4; i++ )
+    {
+        const int h = ( i & 1 ) * 2;
+        __m512i err = _mm512_set1_epi32(0x3FFFFFFF);
+        for( int j=0; j<2; j++ )
+        {
+            __m512i v = a[i*2+j];
+            err = _mm512_add_epi32(err, _mm512_slli_epi32(Mul16_x16_AVX512(v, v), 3));
+            err = _mm512_sub_epi32(err, _mm512_slli_epi32(Mul16_x16_AVX512(v, s[h+j]), 1));
+        }
+
+        if( i == 0 )
+        {
+            errMin = err;
+        }
+        else
+        {
+            __mmask16 lt = _mm512_cmplt_epu32_mask(err, errMin);
+            errMin = _mm512_mask_mov_epi32(errMin, lt, err);
+            idx = _mm512_mask_mov_epi32(idx, lt, _mm512_set1_epi32(i));
+        }
+    }
+
+    const __mmask16 flip = _mm512_test_epi32_mask(idx, _mm512_set1_epi32(1));
+    const __mmask16 diff = _mm512_test_epi32_mask(idx, _mm512_set1_epi32(2));
+
+    __m512i right = _mm512_mask_mov_epi32(a[0], diff, a[4]);
+    __m512i left = _mm512_mask_mov_epi32(a[1], diff, a[5]);
+    __m512i bottom = _mm512_mask_mov_epi32(a[2], diff, a[6]);
+    __m512i top = _mm512_mask_mov_epi32(a[3], diff, a[7]);
+
+    // Colors of each quadrant, the first half block is in quadrant 0, the second in quadrant 3
+    __m512i qv[4];
+    qv[0] = _mm512_mask_mov_epi32(left, flip, top);
+    qv[1] = _mm512_mask_mov_epi32(left, flip, bottom);
+    qv[2] = _mm512_mask_mov_epi32(right, flip, top);
+    qv[3] = _mm512_mask_mov_epi32(right, flip, bottom);
+
+    __m512i v4 = _mm512_or_si512(_mm512_and_si512(qv[0], _mm512_set1_epi32(0xF0)), _mm512_srli_epi32(qv[3], 4));
+    __m512i f5 = _mm512_and_si512(qv[0], _mm512_set1_epi32(0xF8));
+    __m512i s5 = _mm512_and_si512(qv[3], _mm512_set1_epi32(0xF8));
+    __m512i d5 = _mm512_and_si512(_mm512_srai_epi32(_mm512_sub_epi32(s5, f5), 3), _mm512_set1_epi32(0x07));
+    __m512i v = _mm512_mask_mov_epi32(v4, diff, _mm512_or_si512(f5, d5));
+
+    // Gray, the same value in all three channels
+    __m512i d = _mm512_or_si512(_mm512_slli_epi32(idx, 24), _mm512_mullo_epi32(v, _mm512_set1_epi32(0x010101)));
+
+    const __mmask16 inFirst[4] = { 0xFFFF, (__mmask16)~flip, flip, 0 };
+
+    __m512i terr[2][8], tsel[8];
+    for( int t=0; t<8; t++ )
+    {
+        terr[0][t] = _mm512_setzero_si512();
+        terr[1][t] = _mm512_setzero_si512();
+        tsel[t] = _mm512_setzero_si512();
+    }
+    __m512i msb = _mm512_setzero_si512();
+
+    for( int k=0; k<4; k++ )
+    {
+        __m512i qerr[8];
+        for( int t=0; t<8; t++ )
+        {
+            qerr[t] = _mm512_setzero_si512();
+        }
+
+        const int base = ( k >> 1 ) * 8 + ( k & 1 ) * 2;
+        for( int j=0; j<4; j++ )
+        {
+            const int i = base + ( j >> 1 ) * 4 + ( j & 1 );
+            const __m512i bit = _mm512_set1_epi32(1 << i);
+
+            __m512i pixel = _mm512_sub_epi32(qv[k], p[i]);
+            __m512i pix = _mm512_abs_epi32(pixel);
+
+            // ProcessAlpha prefers the positive modifiers when the value equals the base
+            msb = _mm512_mask_or_epi32(msb, _mm512_cmpgt_epi32_mask(pixel, _mm512_setzero_si512()), msb, bit);
+
+            for( int t=0; t<8; t++ )
+            {
+                __m512i error0 = _mm512_abs_epi32(_mm512_sub_epi32(pix, _mm512_set1_epi32(g_table[t][0])));
+                __m512i error1 = _mm512_abs_epi32(_mm512_sub_epi32(pix, _mm512_set1_epi32(g_table[t][1])));
+
+                __mmask16 minIndex = _mm512_cmpgt_epi32_mask(error0, error1);
+                __m512i minError = _mm512_min_epi32(error0, error1);
+
+                qerr[t] = _mm512_add_epi32(qerr[t], _mm512_madd_epi16(minError, minError));
+                tsel[t] = _mm512_mask_or_epi32(tsel[t], minIndex, tsel[t], bit);
+            }
+        }
+
+        for( int t=0; t<8; t++ )
+        {
+            terr[1][t] = _mm512_mask_add_epi32(terr[1][t], inFirst[k], terr[1][t], qerr[t]);
+            terr[0][t] = _mm512_mask_add_epi32(terr[0][t], (__mmask16)~inFirst[k], terr[0][t], qerr[t]);
+        }
+    }
+
+    __m512i tidx0, tidx1, error0, error1;
+    __m512i sel0 = SelectTable_x16_AVX512(terr[0], tsel, tidx0, error0);
+    __m512i sel1 = SelectTable_x16_AVX512(terr[1], tsel, tidx1, error1);
+
+    d = _mm512_or_si512(d, _mm512_slli_epi32(tidx0, 26));
+    d = _mm512_or_si512(d, _mm512_slli_epi32(tidx1, 29));
+
+    __m512i mask1 = _mm512_mask_mov_epi32(_mm512_set1_epi32(0x00FF), flip, _mm512_set1_epi32(0x3333));
+    __m512i lsb = _mm512_ternarylogic_epi32(mask1, sel1, _mm512_and_si512(sel0, _mm512_set1_epi32(0xFFFF)), 0xCA);
+    __m512i t2 = _mm512_or_si512(lsb, _mm512_slli_epi32(msb, 16));
+
+    __mmask16 solid = CheckSolid_x16_AVX512( p );
+    if( solid != 0 )
+    {
+        __m512i value = _mm512_and_si512(p[0], _mm512_set1_epi32(0xF8));
+        __m512i solidD = _mm512_or_si512(_mm512_mullo_epi32(value, _mm512_set1_epi32(0x010101)), _mm512_set1_epi32(0x02000000));
+
+        d = _mm512_mask_mov_epi32(d, solid, solidD);
+        t2 = _mm512_mask_mov_epi32(t2, solid, _mm512_setzero_si512());
+    }
+
+    Store_x16_AVX512( d, t2, dst );
+}
+
+void VS_VECTORCALL ProcessRGB_ETC2_x16_AVX512( const __m512i px[16], uint64* dst ) noexcept
+{
+    __m512i rgbo, rgbh, rgbv;
+    __m512i planeError = Planar_x16_AVX512( px, rgbo, rgbh, rgbv );
+
+    __m512i t2, error;
+    __m512i d = EncodeEtc1_x16_AVX512<false>( px, t2, error );
+
+    Store_x16_AVX512( d, t2, dst );
+
+    // Planar mode is only encoded for the blocks which use it
+    uint32 planar = _mm512_cmpge_epu32_mask(error, planeError);
+    if( planar != 0 )
+    {
+        alignas(64) uint32 o[16], h[16], v[16];
+        _mm512_store_si512((__m512i*)o, rgbo);
+        _mm512_store_si512((__m512i*)h, rgbh);
+        _mm512_store_si512((__m512i*)v, rgbv);
+
+        do
+        {
+            const uint32 i = _bit_scan_forward(planar);
+            dst[i] = EncodePlanar( o[i], h[i], v[i] );
+            planar &= planar - 1;
+        }
+        while( planar != 0 );
+    }
+}
+
+}
+
+void ProcessRGB_AVX512_x16( const uint8* src, size_t pitch, uint64* dst )
+{
+    __m512i px[16];
+    Transpose_x16_AVX512( src, pitch, px );
+    ProcessRGB_x16_AVX512<false>( px, dst );
+}
+
+void ProcessRGB_AVX512_x16_Tiled( const uint8* src, uint64* dst )
+{
+    __m512i px[16];
+    TransposeTiled_x16_AVX512( src, px );
+    ProcessRGB_x16_AVX512<false>( px, dst );
+}
+
+void ProcessRGB_Fast_AVX512_x16( const uint8* src, size_t pitch, uint64* dst )
+{
+    __m512i px[16];
+    Transpose_x16_AVX512( src, pitch, px );
+    ProcessRGB_x16_AVX512<true>( px, dst );
+}
+
+void ProcessRGB_Fast_AVX512_x16_Tiled( const uint8* src, uint64* dst )
+{
+    __m512i px[16];
+    TransposeTiled_x16_AVX512( src, px );
+    ProcessRGB_x16_AVX512<true>( px, dst );
+}
+
+void ProcessAlpha_AVX512_x16( const uint8* src, size_t pitch, uint64* dst )
+{
+    __m512i px[16];
+    Transpose_x16_AVX512( src, pitch, px );
+    for( int i=0; i<16; i++ )
+    {
+        px[i] = _mm512_srli_epi32(px[i], 24);
+    }
+    ProcessChannel_x16_AVX512( px, dst );
+}
+
+void ProcessAlpha_AVX512_x16_Tiled( const uint8* src, uint64* dst )
+{
+    __m512i px[16];
+    TransposeTiled_x16_AVX512( src, px );
+    for( int i=0; i<16; i++ )
+    {
+        px[i] = _mm512_srli_epi32(px[i], 24);
+    }
+    ProcessChannel_x16_AVX512( px, dst );
+}
+
+void ProcessGray_AVX512_x16( const uint8* src, size_t pitch, uint64* dst )
+{
+    __m512i px[16];
+    Transpose_x16_AVX512( src, pitch, px );
+    for( int i=0; i<16; i++ )
+    {
+        px[i] = Channel_x16_AVX512(px[i], 0);
+    }
+    ProcessChannel_x16_AVX512( px, dst );
+}
+
+void ProcessGray_AVX512_x16_Tiled( const uint8* src, uint64* dst )
+{
+    __m512i px[16];
+    TransposeTiled_x16_AVX512( src, px );
+    for( int i=0; i<16; i++ )
+    {
+        px[i] = Channel_x16_AVX512(px[i], 0);
+    }
+    ProcessChannel_x16_AVX512( px, dst );
+}
+
+void ProcessRGB_ETC2_AVX512_x16( const uint8* src, size_t pitch, uint64* dst )
+{
+    __m512i px[16];
+    Transpose_x16_AVX512( src, pitch, px );
+    ProcessRGB_ETC2_x16_AVX512( px, dst );
+}
+
+void ProcessRGB_ETC2_AVX512_x16_Tiled( const uint8* src, uint64* dst )
+{
+    __m512i px[16];
+    TransposeTiled_x16_AVX512( src, px );
+    ProcessRGB_ETC2_x16_AVX512( px, dst );
+}
+
+#ifndef _MSC_VER
+#  pragma GCC pop_options
+#endif
+
+#endif
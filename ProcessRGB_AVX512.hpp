@@ -0,0 +1,25 @@
+#ifndef __PROCESSRGB_AVX512_HPP__
+#define __PROCESSRGB_AVX512_HPP__
+
+#ifdef __SSE4_1__
+
+#include <stddef.h>
+
+#include "Types.hpp"
+
+void ProcessRGB_AVX512_x16( const uint8* src, size_t pitch, uint64* dst );
+void ProcessRGB_AVX512_x16_Tiled( const uint8* src, uint64* dst );
+// Same as ProcessRGB_Fast_AVX2_x8
+void ProcessRGB_Fast_AVX512_x16( const uint8* src, size_t pitch, uint64* dst );
+void ProcessRGB_Fast_AVX512_x16_Tiled( const uint8* src, uint64* dst );
+void ProcessRGB_ETC2_AVX512_x16( const uint8* src, size_t pitch, uint64* dst );
+void ProcessRGB_ETC2_AVX512_x16_Tiled( const uint8* src, uint64* dst );
+// Single channel encoders, for alpha and for gray pixels (equal red, green and blue). Produce gray ETC1 blocks.
+void ProcessAlpha_AVX512_x16( const uint8* src, size_t pitch, uint64* dst );
+void ProcessAlpha_AVX512_x16_Tiled( const uint8* src, uint64* dst );
+void ProcessGray_AVX512_x16( const uint8* src, size_t pitch, uint64* dst );
+void ProcessGray_AVX512_x16_Tiled( const uint8* src, uint64* dst );
+
+#endif
+
+#endif
@@ -0,0 +1,505 @@
+#ifdef __SSE4_1__
+
+#include "DecodeRGB.hpp"
+#include "Math.hpp"
+#include "ProcessTH.hpp"
+#include "Tables.hpp"
+#ifdef _MSC_VER
+#  include <intrin.h>
+#  define _bswap(x) _byteswap_ulong(x)
+#else
+#  include <x86intrin.h>
+#endif
+
+namespace
+{
+
+#ifdef _MSC_VER
+inline unsigned long _bit_scan_forward( unsigned long mask )
+{
+    unsigned long ret;
+    _BitScanForward( &ret, mask );
+    return ret;
+}
+#endif
+
+// Blocks in which no color channel spans a larger range are left to the other modes.
+enum { RangeThreshold = 48 };
+// Blocks encoded with a smaller error are left as they are. Channel errors are weighted to 83 per pixel, see below,
+// so this is a mean squared error of 16 per channel.
+enum { ErrorThreshold = 16 * 16 * 83 };
+// Raising either threshold saves little time. Blocks of noisy images pass both by a wide margin, and these are the
+// blocks that gain the most from the T and H modes.
+
+// Pixels are split into vectors of red and green pairs and of blue, four pixels each. Channels are 16-bit and scaled
+// by 5, 7 and 3, so that a single multiply-add of a difference with itself yields the squared error of a pixel,
+// weighted approximately by the contribution of the channels to luminance.
+struct Block
+{
+    __m128i rg[4];
+    __m128i b[4];
+};
+
+struct Color
+{
+    __m128i rg;
+    __m128i b;
+};
+
+inline uint32 HorizontalSum( __m128i v )
+{
+    v = _mm_add_epi32( v, _mm_shuffle_epi32( v, _MM_SHUFFLE( 1, 0, 3, 2 ) ) );
+    v = _mm_add_epi32( v, _mm_shuffle_epi32( v, _MM_SHUFFLE( 2, 3, 0, 1 ) ) );
+    return _mm_cvtsi128_si32( v );
+}
+
+// Loads four vectors of four 32-bit pixels, selecting the channels with the shuffles
+void LoadBlock( const __m128i* src, __m128i shuffleRG, __m128i shuffleB, Block& block )
+{
+    const __m128i scaleRG = _mm_setr_epi16( 5, 7, 5, 7, 5, 7, 5, 7 );
+    const __m128i scaleB = _mm_set1_epi32( 3 );
+    for( int i=0; i<4; i++ )
+    {
+        const __m128i d = _mm_loadu_si128( src + i );
+        block.rg[i] = _mm_mullo_epi16( _mm_shuffle_epi8( d, shuffleRG ), scaleRG );
+        block.b[i] = _mm_mullo_epi16( _mm_shuffle_epi8( d, shuffleB ), scaleB );
+    }
+}
+
+// Source pixels are stored as b, g, r, a bytes
+void LoadBlock( const uint8* src, Block& block )
+{
+    LoadBlock( (const __m128i*)src,
+        _mm_setr_epi8( 2, -1, 1, -1, 6, -1, 5, -1, 10, -1, 9, -1, 14, -1, 13, -1 ),
+        _mm_setr_epi8( 0, -1, -1, -1, 4, -1, -1, -1, 8, -1, -1, -1, 12, -1, -1, -1 ),
+        block );
+}
+
+// Colors are given as 16-bit [r, g, b, 0] in the low half of a vector
+Color MakeColor( __m128i c )
+{
+    Color color;
+    color.rg = _mm_mullo_epi16( _mm_shuffle_epi32( c, _MM_SHUFFLE( 0, 0, 0, 0 ) ), _mm_setr_epi16( 5, 7, 5, 7, 5, 7, 5, 7 ) );
+    color.b = _mm_mullo_epi16( _mm_shuffle_epi32( c, _MM_SHUFFLE( 1, 1, 1, 1 ) ), _mm_set1_epi32( 3 ) );
+    return color;
+}
+
+inline __m128i Clamp( __m128i c )
+{
+    return _mm_min_epi16( _mm_max_epi16( c, _mm_setzero_si128() ), _mm_set1_epi16( 255 ) );
+}
+
+// Largest range of values of any color channel in the block
+uint32 ChannelRange( const uint8* src )
+{
+    const __m128i mask = _mm_set1_epi32( 0x00FFFFFF );
+    const __m128i d0 = _mm_and_si128( _mm_loadu_si128( ((const __m128i*)src) + 0 ), mask );
+    const __m128i d1 = _mm_and_si128( _mm_loadu_si128( ((const __m128i*)src) + 1 ), mask );
+    const __m128i d2 = _mm_and_si128( _mm_loadu_si128( ((const __m128i*)src) + 2 ), mask );
+    const __m128i d3 = _mm_and_si128( _mm_loadu_si128( ((const __m128i*)src) + 3 ), mask );
+
+    __m128i mn = _mm_min_epu8( _mm_min_epu8( d0, d1 ), _mm_min_epu8( d2, d3 ) );
+    __m128i mx = _mm_max_epu8( _mm_max_epu8( d0, d1 ), _mm_max_epu8( d2, d3 ) );
+    mn = _mm_min_epu8( mn, _mm_shuffle_epi32( mn, _MM_SHUFFLE( 1, 0, 3, 2 ) ) );
+    mx = _mm_max_epu8( mx, _mm_shuffle_epi32( mx, _MM_SHUFFLE( 1, 0, 3, 2 ) ) );
+    mn = _mm_min_epu8( mn, _mm_shuffle_epi32( mn, _MM_SHUFFLE( 2, 3, 0, 1 ) ) );
+    mx = _mm_max_epu8( mx, _mm_shuffle_epi32( mx, _MM_SHUFFLE( 2, 3, 0, 1 ) ) );
+
+    const uint32 range = _mm_cvtsi128_si32( _mm_sub_epi8( mx, mn ) );
+    return std::max( std::max( range & 0xFF, ( range >> 8 ) & 0xFF ), range >> 16 );
+}
+
+// Squared error of each pixel to the color, pixels 4i to 4i+3 in err[i]
+void PixelError( const Block& block, const Color& c, __m128i err[4] )
+{
+    for( int i=0; i<4; i++ )
+    {
+        const __m128i rg = _mm_sub_epi16( block.rg[i], c.rg );
+        const __m128i b = _mm_sub_epi16( block.b[i], c.b );
+        err[i] = _mm_add_epi32( _mm_madd_epi16( rg, rg ), _mm_madd_epi16( b, b ) );
+    }
+}
+
+// Errors of each pixel to the paint colors c0 + dist, c0 - dist, c1 + dist and c1 - dist, for a distance index
+void PaintErrors( const Block& block, __m128i c0, __m128i c1, int idx, __m128i p0[4], __m128i m0[4], __m128i p1[4], __m128i m1[4] )
+{
+    const int16 d = g_tableTH[idx];
+    const __m128i dist = _mm_setr_epi16( d, d, d, 0, 0, 0, 0, 0 );
+    PixelError( block, MakeColor( Clamp( _mm_add_epi16( c0, dist ) ) ), p0 );
+    PixelError( block, MakeColor( Clamp( _mm_sub_epi16( c0, dist ) ) ), m0 );
+    PixelError( block, MakeColor( Clamp( _mm_add_epi16( c1, dist ) ) ), p1 );
+    PixelError( block, MakeColor( Clamp( _mm_sub_epi16( c1, dist ) ) ), m1 );
+}
+
+inline void MinError( const __m128i* a, const __m128i* b, __m128i* out )
+{
+    for( int i=0; i<4; i++ )
+    {
+        out[i] = _mm_min_epi32( a[i], b[i] );
+    }
+}
+
+inline uint32 SumError( const __m128i* e )
+{
+    return HorizontalSum( _mm_add_epi32( _mm_add_epi32( e[0], e[1] ), _mm_add_epi32( e[2], e[3] ) ) );
+}
+
+uint32 BlockError( const Block& a, const Block& b )
+{
+    __m128i sum = _mm_setzero_si128();
+    for( int i=0; i<4; i++ )
+    {
+        const __m128i rg = _mm_sub_epi16( a.rg[i], b.rg[i] );
+        const __m128i bb = _mm_sub_epi16( a.b[i], b.b[i] );
+        sum = _mm_add_epi32( sum, _mm_add_epi32( _mm_madd_epi16( rg, rg ), _mm_madd_epi16( bb, bb ) ) );
+    }
+    return HorizontalSum( sum );
+}
+
+// Decodes a block encoded in individual, differential or planar mode
+void DecodeBlock( uint64 data, Block& block )
+{
+    const uint64 d = ( ( data & 0xFF000000FF000000 ) >> 24 ) |
+                     ( ( data & 0x000000FF000000FF ) << 24 ) |
+                     ( ( data & 0x00FF000000FF0000 ) >> 8 ) |
+                     ( ( data & 0x0000FF000000FF00 ) << 8 );
+
+    alignas( 16 ) uint32 buf[16];
+    if( d & 0x2 )
+    {
+        const int32 r1 = ( d >> 27 ) & 0x1F;
+        const int32 g1 = ( d >> 19 ) & 0x1F;
+        const int32 b1 = ( d >> 11 ) & 0x1F;
+        const int32 r2 = r1 + ( int32( ( d >> 24 ) & 0x7 ) ^ 0x4 ) - 0x4;
+        const int32 g2 = g1 + ( int32( ( d >> 16 ) & 0x7 ) ^ 0x4 ) - 0x4;
+        const int32 b2 = b1 + ( int32( ( d >> 8 ) & 0x7 ) ^ 0x4 ) - 0x4;
+
+        // Blocks of the other modes never reach here, only planar mode overflows blue
+        if( b2 < 0 || b2 > 31 )
+        {
+            DecodePlanar_SSE41( d, buf, 4 );
+        }
+        else
+        {
+            const uint32 c1 = ( ( r1 << 3 ) | ( r1 >> 2 ) ) | ( ( ( g1 << 3 ) | ( g1 >> 2 ) ) << 8 ) | ( ( ( b1 << 3 ) | ( b1 >> 2 ) ) << 16 ) | 0xFF000000;
+            const uint32 c2 = ( ( r2 << 3 ) | ( r2 >> 2 ) ) | ( ( ( g2 << 3 ) | ( g2 >> 2 ) ) << 8 ) | ( ( ( b2 << 3 ) | ( b2 >> 2 ) ) << 16 ) | 0xFF000000;
+            DecodeRGB_SSE41( d, c1, c2, buf, 4 );
+        }
+    }
+    else
+    {
+        const uint32 c1 = ( ( ( d >> 28 ) & 0xF ) | ( ( ( d >> 20 ) & 0xF ) << 8 ) | ( ( ( d >> 12 ) & 0xF ) << 16 ) ) * 17 | 0xFF000000;
+        const uint32 c2 = ( ( ( d >> 24 ) & 0xF ) | ( ( ( d >> 16 ) & 0xF ) << 8 ) | ( ( ( d >> 8 ) & 0xF ) << 16 ) ) * 17 | 0xFF000000;
+        DecodeRGB_SSE41( d, c1, c2, buf, 4 );
+    }
+
+    // Rows of 0xFFBBGGRR pixels to columns
+    const __m128i r0 = _mm_load_si128( (const __m128i*)buf + 0 );
+    const __m128i r1 = _mm_load_si128( (const __m128i*)buf + 1 );
+    const __m128i r2 = _mm_load_si128( (const __m128i*)buf + 2 );
+    const __m128i r3 = _mm_load_si128( (const __m128i*)buf + 3 );
+    const __m128i t0 = _mm_unpacklo_epi32( r0, r1 );
+    const __m128i t1 = _mm_unpacklo_epi32( r2, r3 );
+    const __m128i t2 = _mm_unpackhi_epi32( r0, r1 );
+    const __m128i t3 = _mm_unpackhi_epi32( r2, r3 );
+
+    __m128i col[4];
+    col[0] = _mm_unpacklo_epi64( t0, t1 );
+    col[1] = _mm_unpackhi_epi64( t0, t1 );
+    col[2] = _mm_unpacklo_epi64( t2, t3 );
+    col[3] = _mm_unpackhi_epi64( t2, t3 );
+
+    LoadBlock( col,
+        _mm_setr_epi8( 0, -1, 1, -1, 4, -1, 5, -1, 8, -1, 9, -1, 12, -1, 13, -1 ),
+        _mm_setr_epi8( 2, -1, -1, -1, 6, -1, -1, -1, 10, -1, -1, -1, 14, -1, -1, -1 ),
+        block );
+}
+
+// Color of a pixel
+Color Pixel( const Block& block, int idx )
+{
+    alignas( 16 ) uint32 rg[4], b[4];
+    _mm_store_si128( (__m128i*)rg, block.rg[idx >> 2] );
+    _mm_store_si128( (__m128i*)b, block.b[idx >> 2] );
+
+    Color c;
+    c.rg = _mm_set1_epi32( rg[idx & 3] );
+    c.b = _mm_set1_epi32( b[idx & 3] );
+    return c;
+}
+
+// Rounded mean color from the scaled channel sums of n pixels, as 16-bit [r, g, b, 0]
+__m128i Mean( __m128i rg, __m128i b, int n )
+{
+    rg = _mm_add_epi16( rg, _mm_shuffle_epi32( rg, _MM_SHUFFLE( 1, 0, 3, 2 ) ) );
+    rg = _mm_add_epi16( rg, _mm_shuffle_epi32( rg, _MM_SHUFFLE( 2, 3, 0, 1 ) ) );
+    b = _mm_add_epi16( b, _mm_shuffle_epi32( b, _MM_SHUFFLE( 1, 0, 3, 2 ) ) );
+    b = _mm_add_epi16( b, _mm_shuffle_epi32( b, _MM_SHUFFLE( 2, 3, 0, 1 ) ) );
+
+    const __m128 sum = _mm_cvtepi32_ps( _mm_cvtepu16_epi32( _mm_unpacklo_epi32( rg, b ) ) );
+    const __m128 c = _mm_mul_ps( sum, _mm_setr_ps( 1.f / ( 5 * n ), 1.f / ( 7 * n ), 1.f / ( 3 * n ), 0 ) );
+    return _mm_packs_epi32( _mm_cvtps_epi32( c ), _mm_setzero_si128() );
+}
+
+Color Mean( const Block& block )
+{
+    const __m128i rg = _mm_add_epi16( _mm_add_epi16( block.rg[0], block.rg[1] ), _mm_add_epi16( block.rg[2], block.rg[3] ) );
+    const __m128i b = _mm_add_epi16( _mm_add_epi16( block.b[0], block.b[1] ), _mm_add_epi16( block.b[2], block.b[3] ) );
+    return MakeColor( Mean( rg, b, 16 ) );
+}
+
+int FarthestPixel( const Block& block, const Color& c )
+{
+    __m128i err[4];
+    PixelError( block, c, err );
+
+    __m128i m = _mm_max_epi32( _mm_max_epi32( err[0], err[1] ), _mm_max_epi32( err[2], err[3] ) );
+    m = _mm_max_epi32( m, _mm_shuffle_epi32( m, _MM_SHUFFLE( 1, 0, 3, 2 ) ) );
+    m = _mm_max_epi32( m, _mm_shuffle_epi32( m, _MM_SHUFFLE( 2, 3, 0, 1 ) ) );
+
+    uint32 mask = 0;
+    for( int i=0; i<4; i++ )
+    {
+        mask |= _mm_movemask_ps( _mm_castsi128_ps( _mm_cmpeq_epi32( err[i], m ) ) ) << ( i * 4 );
+    }
+    return _bit_scan_forward( mask );
+}
+
+// Assigns each pixel to the nearer of the two colors and returns the means of both groups. Returns false if all
+// pixels end up in one group.
+bool Cluster( const Block& block, const Color& s0, const Color& s1, __m128i& c0, __m128i& c1 )
+{
+    __m128i e0[4], e1[4];
+    PixelError( block, s0, e0 );
+    PixelError( block, s1, e1 );
+
+    __m128i rg = _mm_setzero_si128();
+    __m128i b = _mm_setzero_si128();
+    __m128i rg1 = _mm_setzero_si128();
+    __m128i b1 = _mm_setzero_si128();
+    uint32 mask = 0;
+    for( int i=0; i<4; i++ )
+    {
+        const __m128i m = _mm_cmplt_epi32( e1[i], e0[i] );
+        mask |= _mm_movemask_ps( _mm_castsi128_ps( m ) ) << ( i * 4 );
+
+        rg = _mm_add_epi16( rg, block.rg[i] );
+        b = _mm_add_epi16( b, block.b[i] );
+        rg1 = _mm_add_epi16( rg1, _mm_and_si128( block.rg[i], m ) );
+        b1 = _mm_add_epi16( b1, _mm_and_si128( block.b[i], m ) );
+    }
+
+    const int n1 = CountSetBits( mask );
+    if( n1 == 0 || n1 == 16 ) return false;
+
+    c0 = Mean( _mm_sub_epi16( rg, rg1 ), _mm_sub_epi16( b, b1 ), 16 - n1 );
+    c1 = Mean( rg1, b1, n1 );
+    return true;
+}
+
+// Picks the paint color of least error for each pixel, given the errors to the four paint colors. Stores the
+// selectors with the lsb of the pixels in bits 0-15 and the msb in bits 16-31.
+uint32 SelectPaint( const __m128i* e0, const __m128i* e1, const __m128i* e2, const __m128i* e3 )
+{
+    __m128i idx[4];
+    for( int i=0; i<4; i++ )
+    {
+        __m128i err = e0[i];
+        __m128i id = _mm_setzero_si128();
+
+        __m128i lt = _mm_cmplt_epi32( e1[i], err );
+        err = _mm_min_epi32( err, e1[i] );
+        id = _mm_blendv_epi8( id, _mm_set1_epi32( 1 ), lt );
+
+        lt = _mm_cmplt_epi32( e2[i], err );
+        err = _mm_min_epi32( err, e2[i] );
+        id = _mm_blendv_epi8( id, _mm_set1_epi32( 2 ), lt );
+
+        lt = _mm_cmplt_epi32( e3[i], err );
+        idx[i] = _mm_blendv_epi8( id, _mm_set1_epi32( 3 ), lt );
+    }
+
+    const __m128i id8 = _mm_packs_epi16( _mm_packs_epi32( idx[0], idx[1] ), _mm_packs_epi32( idx[2], idx[3] ) );
+    return _mm_movemask_epi8( _mm_slli_epi16( id8, 7 ) ) | ( _mm_movemask_epi8( _mm_slli_epi16( id8, 6 ) ) << 16 );
+}
+
+// Colors are 4-bit { r, g, b }. The block word is built in the bit order of the specification; red, or green in H
+// mode, has to overflow when the block is read as a differential one.
+uint32 EncodeT( const uint32 c0[3], const uint32 c1[3], uint32 dist )
+{
+    const uint32 r1a = c0[0] >> 2;
+    const uint32 r1b = c0[0] & 0x3;
+
+    uint32 hi = ( r1a << 27 ) | ( r1b << 24 ) | ( c0[1] << 20 ) | ( c0[2] << 16 ) |
+        ( c1[0] << 12 ) | ( c1[1] << 8 ) | ( c1[2] << 4 ) | ( ( dist >> 1 ) << 2 ) | 0x2 | ( dist & 0x1 );
+
+    // Base red in bits 27-31, signed delta in bits 24-26
+    if( r1a + r1b >= 4 )
+    {
+        hi |= 0x7 << 29;
+    }
+    else
+    {
+        hi |= 0x1 << 26;
+    }
+    return hi;
+}
+
+// The lowest bit of the distance index is implied by the order of the colors
+uint32 EncodeH( const uint32 c0[3], const uint32 c1[3], uint32 dist )
+{
+    uint32 hi = ( c0[0] << 27 ) | ( ( c0[1] >> 1 ) << 24 ) | ( ( c0[1] & 0x1 ) << 20 ) | ( ( c0[2] >> 3 ) << 19 ) | ( ( c0[2] & 0x7 ) << 15 ) |
+        ( c1[0] << 11 ) | ( c1[1] << 7 ) | ( c1[2] << 3 ) | ( ( dist >> 2 ) << 2 ) | 0x2 | ( ( dist >> 1 ) & 0x1 );
+
+    // Base green in bits 19-23, signed delta in bits 16-18
+    const uint32 g = ( ( c0[1] & 0x1 ) << 1 ) | ( c0[2] >> 3 );
+    const uint32 dg = ( c0[2] & 0x7 ) >> 1;
+    if( g + dg >= 4 )
+    {
+        hi |= 0x7 << 21;
+    }
+    else
+    {
+        hi |= 0x1 << 18;
+    }
+    // Red, with the delta in bits 24-26, must stay in range
+    if( ( c0[1] >> 1 ) >= 4 )
+    {
+        hi |= 0x1u << 31;
+    }
+    return hi;
+}
+
+inline uint32 PackedColor( const uint32 c[3] )
+{
+    return ( c[0] << 8 ) | ( c[1] << 4 ) | c[2];
+}
+
+enum class Mode
+{
+    none,
+    t0,
+    t1,
+    h
+};
+
+}
+
+uint64 ProcessTH_SSE41( const uint8* src, uint64 data )
+{
+    if( ChannelRange( src ) < RangeThreshold ) return data;
+
+    Block block;
+    LoadBlock( src, block );
+
+    Block dec;
+    DecodeBlock( data, dec );
+    const uint32 error = BlockError( block, dec );
+    if( error < ErrorThreshold ) return data;
+
+    // Two groups of pixels, seeded with the pixel farthest from the mean and the pixel farthest from that one
+    const int s0 = FarthestPixel( block, Mean( block ) );
+    const int s1 = FarthestPixel( block, Pixel( block, s0 ) );
+    __m128i c0, c1;
+    if( !Cluster( block, Pixel( block, s0 ), Pixel( block, s1 ), c0, c1 ) ) return data;
+    if( !Cluster( block, MakeColor( c0 ), MakeColor( c1 ), c0, c1 ) ) return data;
+
+    // Both modes store 4-bit colors
+    const __m128i q0 = _mm_srli_epi16( _mm_add_epi16( _mm_mullo_epi16( c0, _mm_set1_epi16( 15 ) ), _mm_set1_epi16( 135 ) ), 8 );
+    const __m128i q1 = _mm_srli_epi16( _mm_add_epi16( _mm_mullo_epi16( c1, _mm_set1_epi16( 15 ) ), _mm_set1_epi16( 135 ) ), 8 );
+    c0 = _mm_mullo_epi16( q0, _mm_set1_epi16( 17 ) );
+    c1 = _mm_mullo_epi16( q1, _mm_set1_epi16( 17 ) );
+
+    uint32 color[2][3];
+    color[0][0] = _mm_extract_epi16( q0, 0 );
+    color[0][1] = _mm_extract_epi16( q0, 1 );
+    color[0][2] = _mm_extract_epi16( q0, 2 );
+    color[1][0] = _mm_extract_epi16( q1, 0 );
+    color[1][1] = _mm_extract_epi16( q1, 1 );
+    color[1][2] = _mm_extract_epi16( q1, 2 );
+    // H mode can not encode even distances with equal colors
+    const bool equal = PackedColor( color[0] ) == PackedColor( color[1] );
+
+    __m128i e0[4], e1[4], e01[4];
+    PixelError( block, MakeColor( c0 ), e0 );
+    PixelError( block, MakeColor( c1 ), e1 );
+    MinError( e0, e1, e01 );
+
+    // T mode paints one color, and the other one moved up and down by the distance. Either group may be the
+    // single color. H mode paints both colors moved up and down. Only error sums are compared here, the
+    // selectors are found for the best encoding afterwards.
+    Mode mode = Mode::none;
+    uint32 best = error;
+    uint32 bestDist = 0;
+    for( int i=0; i<8; i++ )
+    {
+        __m128i p0[4], m0[4], p1[4], m1[4];
+        PaintErrors( block, c0, c1, i, p0, m0, p1, m1 );
+
+        __m128i a0[4], a1[4], t[4];
+        MinError( p0, m0, a0 );
+        MinError( p1, m1, a1 );
+
+        MinError( e01, a1, t );
+        uint32 err = SumError( t );
+        if( err < best )
+        {
+            mode = Mode::t0;
+            best = err;
+            bestDist = i;
+        }
+        MinError( e01, a0, t );
+        err = SumError( t );
+        if( err < best )
+        {
+            mode = Mode::t1;
+            best = err;
+            bestDist = i;
+        }
+        if( !equal || ( i & 1 ) )
+        {
+            MinError( a0, a1, t );
+            err = SumError( t );
+            if( err < best )
+            {
+                mode = Mode::h;
+                best = err;
+                bestDist = i;
+            }
+        }
+    }
+    if( mode == Mode::none ) return data;
+
+    __m128i p0[4], m0[4], p1[4], m1[4];
+    PaintErrors( block, c0, c1, bestDist, p0, m0, p1, m1 );
+
+    uint32 hi, sel;
+    switch( mode )
+    {
+    case Mode::t0:
+        sel = SelectPaint( e0, p1, e1, m1 );
+        hi = EncodeT( color[0], color[1], bestDist );
+        break;
+    case Mode::t1:
+        sel = SelectPaint( e1, p0, e0, m0 );
+        hi = EncodeT( color[1], color[0], bestDist );
+        break;
+    default:
+        sel = SelectPaint( p0, m0, p1, m1 );
+        if( ( PackedColor( color[0] ) >= PackedColor( color[1] ) ) == ( ( bestDist & 0x1 ) != 0 ) )
+        {
+            hi = EncodeH( color[0], color[1], bestDist );
+        }
+        else
+        {
+            // Swapping the colors exchanges paint colors 0, 1 with 2, 3
+            hi = EncodeH( color[1], color[0], bestDist );
+            sel ^= 0xFFFF0000;
+        }
+        break;
+    }
+
+    return uint64( uint32( _bswap( hi ) ) ) | ( uint64( uint32( _bswap( sel ) ) ) << 32 );
+}
+
+#endif
@@ -0,0 +1,14 @@
+#ifndef __PROCESSTH_HPP__
+#define __PROCESSTH_HPP__
+
+#ifdef __SSE4_1__
+
+#include "Types.hpp"
+
+// Tries the ETC2 T and H modes on a block that has already been encoded in one of the other modes. The block is
+// returned unchanged, unless it has high contrast, is encoded poorly and one of the T or H encodings does better.
+uint64 ProcessTH_SSE41( const uint8* src, uint64 block );
+
+#endif
+
+#endif
@@ -22,6 +22,34 @@ const int64 g_table256[8][4] = {
     { 47*256, 183*256, -47*256, -183*256 }
 };
 
+// Distances of the ETC2 T and H modes
+const int32 g_tableTH[8] = { 3, 6, 11, 16, 23, 32, 41, 64 };
+
+// Modifier tables of the ETC2 EAC alpha blocks
+const int32 g_alpha[16][8] = {
+    {  -3,  -6,  -9, -15,   2,   5,   8,  14 },
+    {  -3,  -7, -10, -13,   2,   6,   9,  12 },
+    {  -2,  -5,  -8, -13,   1,   4,   7,  12 },
+    {  -2,  -4,  -6, -13,   1,   3,   5,  12 },
+    {  -3,  -6,  -8, -12,   2,   5,   7,  11 },
+    {  -3,  -7,  -9, -11,   2,   6,   8,  10 },
+    {  -4,  -7,  -8, -11,   3,   6,   7,  10 },
+    {  -3,  -5,  -8, -11,   2,   4,   7,  10 },
+    {  -2,  -6,  -8, -10,   1,   5,   7,   9 },
+    {  -2,  -5,  -8, -10,   1,   4,   7,   9 },
+    {  -2,  -4,  -8, -10,   1,   3,   7,   9 },
+    {  -2,  -5,  -7, -10,   1,   4,   6,   9 },
+    {  -3,  -4,  -7, -10,   2,   3,   6,   9 },
+    {  -1,  -2,  -3, -10,   0,   1,   2,   9 },
+    {  -4,  -6,  -8,  -9,   3,   5,   7,   8 },
+    {  -3,  -5,  -7,  -9,   2,   4,   6,   8 }
+};
+
+// Span of each alpha modifier table
+const int32 g_alphaRange[16] = {
+    29, 25, 25, 25, 23, 21, 21, 21, 19, 19, 19, 19, 19, 19, 17, 17
+};
+
 const uint32 g_id[4][16] = {
     { 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0, 0, 0, 0 },
     { 3, 3, 2, 2, 3, 3, 2, 2, 3, 3, 2, 2, 3, 3, 2, 2 },
@@ -67,6 +95,173 @@ const uint32 g_flags[64] = {
     0x00000402, 0x0000E002, 0x0000E002, 0x0000E002
 };
 
+// BC1 endpoints, 5 and 6 bit, whose 2/3 interpolation is closest to each 8 bit value
+const uint8 g_dxtMatch5[256][2] = {
+    {  0,  0 }, {  0,  0 }, {  0,  1 }, {  0,  1 }, {  1,  0 }, {  1,  0 }, {  1,  0 }, {  1,  1 },
+    {  1,  1 }, {  1,  1 }, {  1,  2 }, {  0,  4 }, {  2,  1 }, {  2,  1 }, {  2,  1 }, {  2,  2 },
+    {  2,  2 }, {  2,  2 }, {  2,  3 }, {  1,  5 }, {  3,  2 }, {  3,  2 }, {  4,  0 }, {  3,  3 },
+    {  3,  3 }, {  3,  3 }, {  3,  4 }, {  3,  4 }, {  3,  4 }, {  3,  5 }, {  4,  3 }, {  4,  3 },
+    {  3,  6 }, {  4,  4 }, {  4,  4 }, {  4,  5 }, {  4,  5 }, {  5,  4 }, {  5,  4 }, {  5,  4 },
+    {  6,  3 }, {  5,  5 }, {  5,  5 }, {  5,  6 }, {  4,  8 }, {  6,  5 }, {  6,  5 }, {  6,  5 },
+    {  6,  6 }, {  6,  6 }, {  6,  6 }, {  6,  7 }, {  5,  9 }, {  7,  6 }, {  7,  6 }, {  8,  4 },
+    {  7,  7 }, {  7,  7 }, {  7,  7 }, {  7,  8 }, {  7,  8 }, {  7,  8 }, {  7,  9 }, {  8,  7 },
+    {  8,  7 }, {  7, 10 }, {  8,  8 }, {  8,  8 }, {  8,  9 }, {  8,  9 }, {  9,  8 }, {  9,  8 },
+    {  9,  8 }, { 10,  7 }, {  9,  9 }, {  9,  9 }, {  9, 10 }, {  8, 12 }, { 10,  9 }, { 10,  9 },
+    { 10,  9 }, { 10, 10 }, { 10, 10 }, { 10, 10 }, { 10, 11 }, {  9, 13 }, { 11, 10 }, { 11, 10 },
+    { 12,  8 }, { 11, 11 }, { 11, 11 }, { 11, 11 }, { 11, 12 }, { 11, 12 }, { 11, 12 }, { 11, 13 },
+    { 12, 11 }, { 12, 11 }, { 11, 14 }, { 12, 12 }, { 12, 12 }, { 12, 13 }, { 12, 13 }, { 13, 12 },
+    { 13, 12 }, { 13, 12 }, { 14, 11 }, { 13, 13 }, { 13, 13 }, { 13, 14 }, { 12, 16 }, { 14, 13 },
+    { 14, 13 }, { 14, 13 }, { 14, 14 }, { 14, 14 }, { 14, 14 }, { 14, 15 }, { 13, 17 }, { 15, 14 },
+    { 15, 14 }, { 16, 12 }, { 15, 15 }, { 15, 15 }, { 15, 15 }, { 15, 16 }, { 15, 16 }, { 15, 16 },
+    { 15, 17 }, { 16, 15 }, { 16, 15 }, { 15, 18 }, { 16, 16 }, { 16, 16 }, { 16, 17 }, { 16, 17 },
+    { 17, 16 }, { 17, 16 }, { 17, 16 }, { 18, 15 }, { 17, 17 }, { 17, 17 }, { 17, 18 }, { 16, 20 },
+    { 18, 17 }, { 18, 17 }, { 18, 17 }, { 18, 18 }, { 18, 18 }, { 18, 18 }, { 18, 19 }, { 17, 21 },
+    { 19, 18 }, { 19, 18 }, { 20, 16 }, { 19, 19 }, { 19, 19 }, { 19, 19 }, { 19, 20 }, { 19, 20 },
+    { 19, 20 }, { 19, 21 }, { 20, 19 }, { 20, 19 }, { 19, 22 }, { 20, 20 }, { 20, 20 }, { 20, 21 },
+    { 20, 21 }, { 21, 20 }, { 21, 20 }, { 21, 20 }, { 22, 19 }, { 21, 21 }, { 21, 21 }, { 21, 22 },
+    { 20, 24 }, { 22, 21 }, { 22, 21 }, { 22, 21 }, { 22, 22 }, { 22, 22 }, { 22, 22 }, { 22, 23 },
+    { 21, 25 }, { 23, 22 }, { 23, 22 }, { 24, 20 }, { 23, 23 }, { 23, 23 }, { 23, 23 }, { 23, 24 },
+    { 23, 24 }, { 23, 24 }, { 23, 25 }, { 24, 23 }, { 24, 23 }, { 23, 26 }, { 24, 24 }, { 24, 24 },
+    { 24, 25 }, { 24, 25 }, { 25, 24 }, { 25, 24 }, { 25, 24 }, { 26, 23 }, { 25, 25 }, { 25, 25 },
+    { 25, 26 }, { 24, 28 }, { 26, 25 }, { 26, 25 }, { 26, 25 }, { 26, 26 }, { 26, 26 }, { 26, 26 },
+    { 26, 27 }, { 25, 29 }, { 27, 26 }, { 27, 26 }, { 28, 24 }, { 27, 27 }, { 27, 27 }, { 27, 27 },
+    { 27, 28 }, { 27, 28 }, { 27, 28 }, { 27, 29 }, { 28, 27 }, { 28, 27 }, { 27, 30 }, { 28, 28 },
+    { 28, 28 }, { 28, 29 }, { 28, 29 }, { 29, 28 }, { 29, 28 }, { 29, 28 }, { 30, 27 }, { 29, 29 },
+    { 29, 29 }, { 29, 30 }, { 29, 30 }, { 30, 29 }, { 30, 29 }, { 30, 29 }, { 30, 30 }, { 30, 30 },
+    { 30, 30 }, { 30, 31 }, { 30, 31 }, { 31, 30 }, { 31, 30 }, { 31, 30 }, { 31, 31 }, { 31, 31 }
+};
+
+const uint8 g_dxtMatch6[256][2] = {
+    {  0,  0 }, {  0,  1 }, {  1,  0 }, {  1,  1 }, {  1,  1 }, {  1,  2 }, {  2,  1 }, {  2,  2 },
+    {  2,  2 }, {  2,  3 }, {  3,  2 }, {  3,  3 }, {  3,  3 }, {  3,  4 }, {  4,  3 }, {  4,  4 },
+    {  4,  4 }, {  4,  5 }, {  5,  4 }, {  5,  5 }, {  5,  5 }, {  5,  6 }, {  6,  5 }, {  0, 17 },
+    {  6,  6 }, {  6,  7 }, {  7,  6 }, {  2, 16 }, {  7,  7 }, {  7,  8 }, {  8,  7 }, {  3, 17 },
+    {  8,  8 }, {  8,  9 }, {  9,  8 }, {  5, 16 }, {  9,  9 }, {  9, 10 }, { 10,  9 }, {  6, 17 },
+    { 10, 10 }, { 10, 11 }, { 11, 10 }, {  8, 16 }, { 11, 11 }, { 11, 12 }, { 12, 11 }, {  9, 17 },
+    { 12, 12 }, { 12, 13 }, { 13, 12 }, { 11, 16 }, { 13, 13 }, { 13, 14 }, { 14, 13 }, { 12, 17 },
+    { 14, 14 }, { 14, 15 }, { 15, 14 }, { 14, 16 }, { 15, 15 }, { 15, 16 }, { 16, 14 }, { 16, 15 },
+    { 15, 18 }, { 16, 16 }, { 16, 17 }, { 17, 16 }, { 18, 15 }, { 17, 17 }, { 17, 18 }, { 18, 17 },
+    { 20, 14 }, { 18, 18 }, { 18, 19 }, { 19, 18 }, { 21, 15 }, { 19, 19 }, { 19, 20 }, { 20, 19 },
+    { 23, 14 }, { 20, 20 }, { 20, 21 }, { 21, 20 }, { 24, 15 }, { 21, 21 }, { 21, 22 }, { 22, 21 },
+    { 26, 14 }, { 22, 22 }, { 22, 23 }, { 23, 22 }, { 27, 15 }, { 23, 23 }, { 23, 24 }, { 24, 23 },
+    { 19, 33 }, { 24, 24 }, { 24, 25 }, { 25, 24 }, { 21, 32 }, { 25, 25 }, { 25, 26 }, { 26, 25 },
+    { 22, 33 }, { 26, 26 }, { 26, 27 }, { 27, 26 }, { 24, 32 }, { 27, 27 }, { 27, 28 }, { 28, 27 },
+    { 25, 33 }, { 28, 28 }, { 28, 29 }, { 29, 28 }, { 27, 32 }, { 29, 29 }, { 29, 30 }, { 30, 29 },
+    { 28, 33 }, { 30, 30 }, { 30, 31 }, { 31, 30 }, { 30, 32 }, { 31, 31 }, { 31, 32 }, { 32, 30 },
+    { 32, 31 }, { 31, 34 }, { 32, 32 }, { 32, 33 }, { 33, 32 }, { 34, 31 }, { 33, 33 }, { 33, 34 },
+    { 34, 33 }, { 36, 30 }, { 34, 34 }, { 34, 35 }, { 35, 34 }, { 37, 31 }, { 35, 35 }, { 35, 36 },
+    { 36, 35 }, { 39, 30 }, { 36, 36 }, { 36, 37 }, { 37, 36 }, { 40, 31 }, { 37, 37 }, { 37, 38 },
+    { 38, 37 }, { 42, 30 }, { 38, 38 }, { 38, 39 }, { 39, 38 }, { 43, 31 }, { 39, 39 }, { 39, 40 },
+    { 40, 39 }, { 35, 49 }, { 40, 40 }, { 40, 41 }, { 41, 40 }, { 37, 48 }, { 41, 41 }, { 41, 42 },
+    { 42, 41 }, { 38, 49 }, { 42, 42 }, { 42, 43 }, { 43, 42 }, { 40, 48 }, { 43, 43 }, { 43, 44 },
+    { 44, 43 }, { 41, 49 }, { 44, 44 }, { 44, 45 }, { 45, 44 }, { 43, 48 }, { 45, 45 }, { 45, 46 },
+    { 46, 45 }, { 44, 49 }, { 46, 46 }, { 46, 47 }, { 47, 46 }, { 46, 48 }, { 47, 47 }, { 47, 48 },
+    { 48, 46 }, { 48, 47 }, { 47, 50 }, { 48, 48 }, { 48, 49 }, { 49, 48 }, { 50, 47 }, { 49, 49 },
+    { 49, 50 }, { 50, 49 }, { 52, 46 }, { 50, 50 }, { 50, 51 }, { 51, 50 }, { 53, 47 }, { 51, 51 },
+    { 51, 52 }, { 52, 51 }, { 55, 46 }, { 52, 52 }, { 52, 53 }, { 53, 52 }, { 56, 47 }, { 53, 53 },
+    { 53, 54 }, { 54, 53 }, { 58, 46 }, { 54, 54 }, { 54, 55 }, { 55, 54 }, { 59, 47 }, { 55, 55 },
+    { 55, 56 }, { 56, 55 }, { 61, 46 }, { 56, 56 }, { 56, 57 }, { 57, 56 }, { 62, 47 }, { 57, 57 },
+    { 57, 58 }, { 58, 57 }, { 58, 58 }, { 58, 58 }, { 58, 59 }, { 59, 58 }, { 59, 59 }, { 59, 59 },
+    { 59, 60 }, { 60, 59 }, { 60, 60 }, { 60, 60 }, { 60, 61 }, { 61, 60 }, { 61, 61 }, { 61, 61 },
+    { 61, 62 }, { 62, 61 }, { 62, 62 }, { 62, 62 }, { 62, 63 }, { 63, 62 }, { 63, 63 }, { 63, 63 }
+};
+
+// BC7 partitions of two subsets, bit i is set for pixel i (row by row) in the second subset
+const uint16 g_bc7Partitions2[64] = {
+    0xCCCC, 0x8888, 0xEEEE, 0xECC8, 0xC880, 0xFEEC, 0xFEC8, 0xEC80,
+    0xC800, 0xFFEC, 0xFE80, 0xE800, 0xFFE8, 0xFF00, 0xFFF0, 0xF000,
+    0xF710, 0x008E, 0x7100, 0x08CE, 0x008C, 0x7310, 0x3100, 0x8CCE,
+    0x088C, 0x3110, 0x6666, 0x366C, 0x17E8, 0x0FF0, 0x718E, 0x399C,
+    0xAAAA, 0xF0F0, 0x5A5A, 0x33CC, 0x3C3C, 0x55AA, 0x9696, 0xA55A,
+    0x73CE, 0x13C8, 0x324C, 0x3BDC, 0x6996, 0xC33C, 0x9966, 0x0660,
+    0x0272, 0x04E4, 0x4E40, 0x2720, 0xC936, 0x936C, 0x39C6, 0x639C,
+    0x9336, 0x9CC6, 0x817E, 0xE718, 0xCCF0, 0x0FCC, 0x7744, 0xEE22
+};
+
+// Anchor pixels of the second subsets, their indices have the highest bit left out
+const uint8 g_bc7Anchor2[64] = {
+    15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15,
+    15,  2,  8,  2,  2,  8,  8, 15,  2,  8,  2,  2,  8,  8,  2,  2,
+    15, 15,  6,  8,  2,  8, 15, 15,  2,  8,  2,  2,  2, 15, 15,  6,
+     6,  2,  6,  8, 15, 15,  2,  2, 15, 15, 15, 15, 15,  2,  2, 15
+};
+
+// BC7 interpolation weights of 3 and 4 bit indices, in 1/64
+const uint8 g_bc7Weights3[8] = { 0, 9, 18, 27, 37, 46, 55, 64 };
+const uint8 g_bc7Weights4[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+// BC7 mode 1 endpoint channels, 6 bit, which expand with each p-bit closest to each 8 bit value
+const uint8 g_bc7Match6[2][256] = {
+    {
+         0,  0,  0,  1,  1,  1,  1,  2,  2,  2,  2,  3,  3,  3,  3,  4,
+         4,  4,  4,  5,  5,  5,  5,  6,  6,  6,  6,  7,  7,  7,  7,  8,
+         8,  8,  8,  9,  9,  9,  9, 10, 10, 10, 10, 11, 11, 11, 11, 12,
+        12, 12, 12, 13, 13, 13, 13, 14, 14, 14, 14, 15, 15, 15, 15, 16,
+        16, 16, 16, 17, 17, 17, 17, 18, 18, 18, 18, 19, 19, 19, 19, 20,
+        20, 20, 20, 21, 21, 21, 21, 22, 22, 22, 22, 23, 23, 23, 23, 24,
+        24, 24, 24, 25, 25, 25, 25, 26, 26, 26, 26, 27, 27, 27, 27, 28,
+        28, 28, 28, 29, 29, 29, 29, 30, 30, 30, 30, 31, 31, 31, 31, 32,
+        32, 32, 32, 32, 33, 33, 33, 33, 34, 34, 34, 34, 35, 35, 35, 35,
+        36, 36, 36, 36, 37, 37, 37, 37, 38, 38, 38, 38, 39, 39, 39, 39,
+        40, 40, 40, 40, 41, 41, 41, 41, 42, 42, 42, 42, 43, 43, 43, 43,
+        44, 44, 44, 44, 45, 45, 45, 45, 46, 46, 46, 46, 47, 47, 47, 47,
+        48, 48, 48, 48, 49, 49, 49, 49, 50, 50, 50, 50, 51, 51, 51, 51,
+        52, 52, 52, 52, 53, 53, 53, 53, 54, 54, 54, 54, 55, 55, 55, 55,
+        56, 56, 56, 56, 57, 57, 57, 57, 58, 58, 58, 58, 59, 59, 59, 59,
+        60, 60, 60, 60, 61, 61, 61, 61, 62, 62, 62, 62, 63, 63, 63, 63
+    },
+    {
+         0,  0,  0,  0,  0,  1,  1,  1,  1,  2,  2,  2,  2,  3,  3,  3,
+         3,  4,  4,  4,  4,  5,  5,  5,  5,  6,  6,  6,  6,  7,  7,  7,
+         7,  8,  8,  8,  8,  9,  9,  9,  9, 10, 10, 10, 10, 11, 11, 11,
+        11, 12, 12, 12, 12, 13, 13, 13, 13, 14, 14, 14, 14, 15, 15, 15,
+        15, 16, 16, 16, 16, 17, 17, 17, 17, 18, 18, 18, 18, 19, 19, 19,
+        19, 20, 20, 20, 20, 21, 21, 21, 21, 22, 22, 22, 22, 23, 23, 23,
+        23, 24, 24, 24, 24, 25, 25, 25, 25, 26, 26, 26, 26, 27, 27, 27,
+        27, 28, 28, 28, 28, 29, 29, 29, 29, 30, 30, 30, 30, 31, 31, 31,
+        31, 32, 32, 32, 32, 32, 33, 33, 33, 33, 34, 34, 34, 34, 35, 35,
+        35, 35, 36, 36, 36, 36, 37, 37, 37, 37, 38, 38, 38, 38, 39, 39,
+        39, 39, 40, 40, 40, 40, 41, 41, 41, 41, 42, 42, 42, 42, 43, 43,
+        43, 43, 44, 44, 44, 44, 45, 45, 45, 45, 46, 46, 46, 46, 47, 47,
+        47, 47, 48, 48, 48, 48, 49, 49, 49, 49, 50, 50, 50, 50, 51, 51,
+        51, 51, 52, 52, 52, 52, 53, 53, 53, 53, 54, 54, 54, 54, 55, 55,
+        55, 55, 56, 56, 56, 56, 57, 57, 57, 57, 58, 58, 58, 58, 59, 59,
+        59, 59, 60, 60, 60, 60, 61, 61, 61, 61, 62, 62, 62, 62, 63, 63
+    }
+};
+
+// ASTC codes of 5 trits (t0 + 3*t1 + 9*t2 + 27*t3 + 81*t4) and of 3 quints (q0 + 5*q1 + 25*q2), as interleaved with
+// the bits of the integer sequence
+const uint8 g_astcTrits[243] = {
+      0,   1,   2,   4,   5,   6,   8,   9,  10,  16,  17,  18,  20,  21,  22,  24,
+     25,  26,   3,   7,  11,  19,  23,  27,  12,  13,  14,  32,  33,  34,  36,  37,
+     38,  40,  41,  42,  48,  49,  50,  52,  53,  54,  56,  57,  58,  35,  39,  43,
+     51,  55,  59,  44,  45,  46,  64,  65,  66,  68,  69,  70,  72,  73,  74,  80,
+     81,  82,  84,  85,  86,  88,  89,  90,  67,  71,  75,  83,  87,  91,  76,  77,
+     78, 128, 129, 130, 132, 133, 134, 136, 137, 138, 144, 145, 146, 148, 149, 150,
+    152, 153, 154, 131, 135, 139, 147, 151, 155, 140, 141, 142, 160, 161, 162, 164,
+    165, 166, 168, 169, 170, 176, 177, 178, 180, 181, 182, 184, 185, 186, 163, 167,
+    171, 179, 183, 187, 172, 173, 174, 192, 193, 194, 196, 197, 198, 200, 201, 202,
+    208, 209, 210, 212, 213, 214, 216, 217, 218, 195, 199, 203, 211, 215, 219, 204,
+    205, 206,  96,  97,  98, 100, 101, 102, 104, 105, 106, 112, 113, 114, 116, 117,
+    118, 120, 121, 122,  99, 103, 107, 115, 119, 123, 108, 109, 110, 224, 225, 226,
+    228, 229, 230, 232, 233, 234, 240, 241, 242, 244, 245, 246, 248, 249, 250, 227,
+    231, 235, 243, 247, 251, 236, 237, 238,  28,  29,  30,  60,  61,  62,  92,  93,
+     94, 156, 157, 158, 188, 189, 190, 220, 221, 222,  31,  63,  95, 159, 191, 223,
+    124, 125, 126
+};
+
+const uint8 g_astcQuints[125] = {
+      0,   1,   2,   3,   4,   8,   9,  10,  11,  12,  16,  17,  18,  19,  20,  24,
+     25,  26,  27,  28,   5,  13,  21,  29,   6,  32,  33,  34,  35,  36,  40,  41,
+     42,  43,  44,  48,  49,  50,  51,  52,  56,  57,  58,  59,  60,  37,  45,  53,
+     61,  14,  64,  65,  66,  67,  68,  72,  73,  74,  75,  76,  80,  81,  82,  83,
+     84,  88,  89,  90,  91,  92,  69,  77,  85,  93,  22,  96,  97,  98,  99, 100,
+    104, 105, 106, 107, 108, 112, 113, 114, 115, 116, 120, 121, 122, 123, 124, 101,
+    109, 117, 125,  30, 102, 103,  70,  71,  38, 110, 111,  78,  79,  46, 118, 119,
+     86,  87,  54, 126, 127,  94,  95,  62,  39,  47,  55,  63,   7
+};
+
 #ifdef __SSE4_1__
 const uint8 g_flags_AVX2[64] =
 {
@@ -105,5 +300,24 @@ const __m128i g_table256_SIMD[4] =
     _mm_setr_epi32( 18*256,  24*256,  33*256,  47*256),
     _mm_setr_epi32( 60*256,  80*256, 106*256, 183*256)
 };
+const __m128i g_alpha_SIMD[16] =
+{
+    _mm_setr_epi16(  -3,  -6,  -9, -15,   2,   5,   8,  14 ),
+    _mm_setr_epi16(  -3,  -7, -10, -13,   2,   6,   9,  12 ),
+    _mm_setr_epi16(  -2,  -5,  -8, -13,   1,   4,   7,  12 ),
+    _mm_setr_epi16(  -2,  -4,  -6, -13,   1,   3,   5,  12 ),
+    _mm_setr_epi16(  -3,  -6,  -8, -12,   2,   5,   7,  11 ),
+    _mm_setr_epi16(  -3,  -7,  -9, -11,   2,   6,   8,  10 ),
+    _mm_setr_epi16(  -4,  -7,  -8, -11,   3,   6,   7,  10 ),
+    _mm_setr_epi16(  -3,  -5,  -8, -11,   2,   4,   7,  10 ),
+    _mm_setr_epi16(  -2,  -6,  -8, -10,   1,   5,   7,   9 ),
+    _mm_setr_epi16(  -2,  -5,  -8, -10,   1,   4,   7,   9 ),
+    _mm_setr_epi16(  -2,  -4,  -8, -10,   1,   3,   7,   9 ),
+    _mm_setr_epi16(  -2,  -5,  -7, -10,   1,   4,   6,   9 ),
+    _mm_setr_epi16(  -3,  -4,  -7, -10,   2,   3,   6,   9 ),
+    _mm_setr_epi16(  -1,  -2,  -3, -10,   0,   1,   2,   9 ),
+    _mm_setr_epi16(  -4,  -6,  -8,  -9,   3,   5,   7,   8 ),
+    _mm_setr_epi16(  -3,  -5,  -7,  -9,   2,   4,   6,   8 )
+};
 #endif
 
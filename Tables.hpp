@@ -9,17 +9,35 @@
 extern const int32 g_table[8][4];
 extern const int64 g_table256[8][4];
 
+extern const int32 g_tableTH[8];
+
+extern const int32 g_alpha[16][8];
+extern const int32 g_alphaRange[16];
+
 extern const uint32 g_id[4][16];
 
 extern const uint32 g_avg2[16];
 
 extern const uint32 g_flags[64];
 
+extern const uint8 g_dxtMatch5[256][2];
+extern const uint8 g_dxtMatch6[256][2];
+
+extern const uint16 g_bc7Partitions2[64];
+extern const uint8 g_bc7Anchor2[64];
+extern const uint8 g_bc7Weights3[8];
+extern const uint8 g_bc7Weights4[16];
+extern const uint8 g_bc7Match6[2][256];
+
+extern const uint8 g_astcTrits[243];
+extern const uint8 g_astcQuints[125];
+
 #ifdef __SSE4_1__
 extern const uint8 g_flags_AVX2[64];
 extern const __m128i g_table_SIMD[2];
 extern const __m128i g_table128_SIMD[2];
 extern const __m128i g_table256_SIMD[4];
+extern const __m128i g_alpha_SIMD[16];
 #endif
 
 #endif
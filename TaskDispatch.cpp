@@ -5,16 +5,163 @@
 #include "System.hpp"
 #include "TaskDispatch.hpp"
 
-static TaskDispatch* s_instance = nullptr;
+TaskDispatch* TaskDispatch::s_instance = nullptr;
+
+// Dispatcher the current thread belongs to and the index of its deque there.
+static const size_t NoDeque = size_t( -1 );
+static thread_local TaskDispatch* s_owner = nullptr;
+static thread_local size_t s_index = NoDeque;
+
+enum { SpinCount = 64 };
+
+// Number of tasks moved between a thread's pool and the shared pool at once.
+enum { PoolBatch = 256 };
+
+// Free tasks owned by one thread of the dispatcher. Tasks are returned to the
+// pool of the thread that executed them; surplus is handed back to the shared
+// pool in batches, so that producer threads can pick it up again.
+struct TaskDispatch::TaskPool
+{
+    TaskPool() : head( nullptr ), count( 0 ) {}
+
+    Task* head;
+    size_t count;
+};
+
+// Chase-Lev work-stealing deque (Le, Pop, Cohen, Zappa Nardelli, "Correct and
+// Efficient Work-Stealing for Weak Memory Models"). Push and Pop may only be
+// called by the owner, Steal by any thread. Arrays retired on growth are kept
+// until the deque is destroyed, as a concurrent thief may still read them.
+class TaskDispatch::Deque
+{
+    struct Array
+    {
+        Array( int64 size ) : size( size ), mask( size - 1 ), data( new std::atomic<Task*>[size] ) {}
+
+        Task* Get( int64 i ) const { return data[i & mask].load( std::memory_order_relaxed ); }
+        void Put( int64 i, Task* task ) { data[i & mask].store( task, std::memory_order_relaxed ); }
+
+        int64 size, mask;
+        std::unique_ptr<std::atomic<Task*>[]> data;
+    };
+
+public:
+    Deque()
+        : m_top( 0 )
+        , m_bottom( 0 )
+        , m_array( new Array( 256 ) )
+    {
+    }
+
+    ~Deque()
+    {
+        delete m_array.load( std::memory_order_relaxed );
+        for( auto& array : m_retired )
+        {
+            delete array;
+        }
+    }
+
+    void Push( Task* task )
+    {
+        const int64 b = m_bottom.load( std::memory_order_relaxed );
+        const int64 t = m_top.load( std::memory_order_acquire );
+        Array* array = m_array.load( std::memory_order_relaxed );
+        if( b - t > array->size - 1 )
+        {
+            array = Grow( array, t, b );
+        }
+        array->Put( b, task );
+        std::atomic_thread_fence( std::memory_order_release );
+        m_bottom.store( b + 1, std::memory_order_relaxed );
+    }
+
+    Task* Pop()
+    {
+        const int64 b = m_bottom.load( std::memory_order_relaxed ) - 1;
+        Array* array = m_array.load( std::memory_order_relaxed );
+        m_bottom.store( b, std::memory_order_relaxed );
+        std::atomic_thread_fence( std::memory_order_seq_cst );
+        int64 t = m_top.load( std::memory_order_relaxed );
+        if( t > b )
+        {
+            m_bottom.store( b + 1, std::memory_order_relaxed );
+            return nullptr;
+        }
+        Task* task = array->Get( b );
+        if( t == b )
+        {
+            // Last element, race against thieves for it.
+            if( !m_top.compare_exchange_strong( t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed ) )
+            {
+                task = nullptr;
+            }
+            m_bottom.store( b + 1, std::memory_order_relaxed );
+        }
+        return task;
+    }
+
+    Task* Steal()
+    {
+        int64 t = m_top.load( std::memory_order_acquire );
+        std::atomic_thread_fence( std::memory_order_seq_cst );
+        const int64 b = m_bottom.load( std::memory_order_acquire );
+        if( t >= b ) return nullptr;
+        Array* array = m_array.load( std::memory_order_acquire );
+        Task* task = array->Get( t );
+        if( !m_top.compare_exchange_strong( t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed ) )
+        {
+            return nullptr;
+        }
+        return task;
+    }
+
+private:
+    Array* Grow( Array* array, int64 t, int64 b )
+    {
+        Array* grown = new Array( array->size * 2 );
+        for( int64 i=t; i<b; i++ )
+        {
+            grown->Put( i, array->Get( i ) );
+        }
+        m_retired.push_back( array );
+        m_array.store( grown, std::memory_order_release );
+        return grown;
+    }
+
+    std::atomic<int64> m_top;
+    std::atomic<int64> m_bottom;
+    std::atomic<Array*> m_array;
+    std::vector<Array*> m_retired;
+};
 
 TaskDispatch::TaskDispatch( size_t workers )
-    : m_exit( false )
+    : m_shared( nullptr )
+    , m_queued( 0 )
     , m_jobs( 0 )
+    , m_sleeping( 0 )
+    , m_exit( false )
 {
-    assert( !s_instance );
-    s_instance = this;
+    if( !s_instance ) s_instance = this;
 
     assert( workers >= 1 );
+
+    // Deque 0 belongs to the constructing thread, which executes tasks when
+    // waiting. A thread already owning a deque of another dispatcher leaves it
+    // unused, other threads still steal from it.
+    m_deques.reserve( workers );
+    m_pools.reserve( workers );
+    for( size_t i=0; i<workers; i++ )
+    {
+        m_deques.emplace_back( new Deque );
+        m_pools.emplace_back( new TaskPool );
+    }
+    if( !s_owner )
+    {
+        s_owner = this;
+        s_index = 0;
+    }
+
     workers--;
 
     m_workers.reserve( workers );
@@ -22,7 +169,7 @@ TaskDispatch::TaskDispatch( size_t workers )
     {
         char tmp[16];
         sprintf( tmp, "Worker %zu", i );
-        auto worker = std::thread( [this]{ Worker(); } );
+        auto worker = std::thread( [this, i]{ Worker( i + 1 ); } );
         System::SetThreadName( worker, tmp );
         m_workers.emplace_back( std::move( worker ) );
     }
@@ -32,7 +179,10 @@ TaskDispatch::TaskDispatch( size_t workers )
 
 TaskDispatch::~TaskDispatch()
 {
-    m_exit = true;
+    {
+        std::lock_guard<std::mutex> lock( m_parkLock );
+        m_exit = true;
+    }
     m_cvWork.notify_all();
 
     for( auto& worker : m_workers )
@@ -40,67 +190,302 @@ TaskDispatch::~TaskDispatch()
         worker.join();
     }
 
-    assert( s_instance );
-    s_instance = nullptr;
+    if( s_owner == this )
+    {
+        s_owner = nullptr;
+        s_index = NoDeque;
+    }
+
+    if( s_instance == this ) s_instance = nullptr;
+}
+
+TaskGroup::TaskGroup()
+    : m_dispatch( TaskDispatch::s_instance )
+    , m_pending( 0 )
+{
+    assert( m_dispatch );
+}
+
+TaskGroup::TaskGroup( TaskDispatch& dispatch )
+    : m_dispatch( &dispatch )
+    , m_pending( 0 )
+{
+}
+
+TaskGroup::~TaskGroup()
+{
+    assert( m_pending == 0 );
+}
+
+size_t TaskDispatch::LocalIndex() const
+{
+    return s_owner == this ? s_index : NoDeque;
+}
+
+TaskDispatch::Task* TaskDispatch::AllocTask()
+{
+    const size_t idx = LocalIndex();
+    if( idx < m_pools.size() )
+    {
+        auto& pool = *m_pools[idx];
+        if( !pool.head )
+        {
+            std::lock_guard<std::mutex> lock( m_poolLock );
+            pool.count = PoolBatch;
+            pool.head = TakeShared( pool.count );
+        }
+        auto task = pool.head;
+        pool.head = task->m_next;
+        pool.count--;
+        return task;
+    }
+    else
+    {
+        std::lock_guard<std::mutex> lock( m_poolLock );
+        size_t num = 1;
+        auto task = TakeShared( num );
+        if( num > 1 )
+        {
+            // A fresh chunk was allocated, keep the remainder.
+            m_shared = task->m_next;
+        }
+        return task;
+    }
 }
 
-void TaskDispatch::Queue( const std::function<void(void)>& f )
+void TaskDispatch::FreeTask( Task* task )
 {
-    std::unique_lock<std::mutex> lock( s_instance->m_queueLock );
-    s_instance->m_queue.emplace_back( f );
-    const auto size = s_instance->m_queue.size();
-    lock.unlock();
-    if( size > 1 )
+    const size_t idx = LocalIndex();
+    if( idx < m_pools.size() )
+    {
+        auto& pool = *m_pools[idx];
+        task->m_next = pool.head;
+        pool.head = task;
+        if( ++pool.count >= PoolBatch * 2 )
+        {
+            auto first = pool.head;
+            auto last = first;
+            for( int i=1; i<PoolBatch; i++ ) last = last->m_next;
+            pool.head = last->m_next;
+            pool.count -= PoolBatch;
+
+            std::lock_guard<std::mutex> lock( m_poolLock );
+            last->m_next = m_shared;
+            m_shared = first;
+        }
+    }
+    else
     {
-        s_instance->m_cvWork.notify_one();
+        std::lock_guard<std::mutex> lock( m_poolLock );
+        task->m_next = m_shared;
+        m_shared = task;
     }
 }
 
-void TaskDispatch::Queue( std::function<void(void)>&& f )
+// Takes up to num tasks from the shared pool, or a new chunk of PoolBatch
+// tasks if it is empty. Returns the list and stores its length in num. Must
+// be called with m_poolLock held.
+TaskDispatch::Task* TaskDispatch::TakeShared( size_t& num )
 {
-    std::unique_lock<std::mutex> lock( s_instance->m_queueLock );
-    s_instance->m_queue.emplace_back( std::move( f ) );
-    const auto size = s_instance->m_queue.size();
-    lock.unlock();
-    if( size > 1 )
+    if( !m_shared )
     {
-        s_instance->m_cvWork.notify_one();
+        auto chunk = new Task[PoolBatch];
+        m_chunks.emplace_back( chunk );
+        for( int i=0; i<PoolBatch-1; i++ )
+        {
+            chunk[i].m_next = chunk + i + 1;
+        }
+        num = PoolBatch;
+        return chunk;
     }
+
+    auto head = m_shared;
+    auto last = head;
+    size_t taken = 1;
+    while( taken < num && last->m_next )
+    {
+        last = last->m_next;
+        taken++;
+    }
+    m_shared = last->m_next;
+    last->m_next = nullptr;
+    num = taken;
+    return head;
+}
+
+static bool CounterDone( const void* ctx )
+{
+    return *(const std::atomic<size_t>*)ctx == 0;
 }
 
 void TaskDispatch::Sync()
 {
-    std::unique_lock<std::mutex> lock( s_instance->m_queueLock );
-    while( !s_instance->m_queue.empty() )
+    s_instance->Help( CounterDone, &s_instance->m_jobs );
+}
+
+void TaskDispatch::Wait( TaskGroup& group )
+{
+    group.m_dispatch->Help( CounterDone, &group.m_pending );
+}
+
+void TaskDispatch::Wake()
+{
+    auto self = s_instance;
+    if( self && self->m_sleeping > 0 )
+    {
+        std::lock_guard<std::mutex> lock( self->m_parkLock );
+        self->m_cvWork.notify_all();
+    }
+}
+
+// Executes tasks until done( ctx ) returns true.
+void TaskDispatch::Help( bool(*done)( const void* ), const void* ctx )
+{
+    const size_t idx = LocalIndex();
+    uint32 seed = 0x9E3779B9;
+    int spin = 0;
+    for(;;)
+    {
+        if( done( ctx ) ) return;
+        auto task = GetTask( idx, seed );
+        if( task )
+        {
+            Execute( task );
+            spin = 0;
+        }
+        else if( ++spin < SpinCount )
+        {
+            std::this_thread::yield();
+        }
+        else
+        {
+            std::unique_lock<std::mutex> lock( m_parkLock );
+            m_sleeping++;
+            m_cvWork.wait( lock, [this, done, ctx]{ return m_queued > 0 || done( ctx ); } );
+            m_sleeping--;
+            spin = 0;
+        }
+    }
+}
+
+void TaskDispatch::Push( Task* task )
+{
+    // Counters are raised before the task becomes visible, so that they never
+    // underflow when the task is taken right away.
+    m_jobs++;
+    m_queued++;
+    const size_t idx = LocalIndex();
+    if( idx < m_deques.size() )
+    {
+        m_deques[idx]->Push( task );
+    }
+    else
+    {
+        std::lock_guard<std::mutex> lock( m_injectLock );
+        m_injected.push_back( task );
+    }
+    // Pairs with the m_sleeping increment of a parking thread; one of the two
+    // threads is guaranteed to observe the other's update.
+    if( m_sleeping > 0 )
     {
-        auto f = s_instance->m_queue.back();
-        s_instance->m_queue.pop_back();
-        lock.unlock();
-        f();
-        lock.lock();
+        std::lock_guard<std::mutex> lock( m_parkLock );
+        m_cvWork.notify_one();
     }
-    s_instance->m_cvJobs.wait( lock, []{ return s_instance->m_jobs == 0; } );
 }
 
-void TaskDispatch::Worker()
+TaskDispatch::Task* TaskDispatch::GetTask( size_t idx, uint32& seed )
 {
+    if( m_queued <= 0 ) return nullptr;
+    if( idx < m_deques.size() )
+    {
+        auto task = m_deques[idx]->Pop();
+        if( task )
+        {
+            m_queued--;
+            return task;
+        }
+    }
+    return Steal( idx, seed );
+}
+
+TaskDispatch::Task* TaskDispatch::Steal( size_t idx, uint32& seed )
+{
+    seed ^= seed << 13;
+    seed ^= seed >> 17;
+    seed ^= seed << 5;
+
+    const size_t num = m_deques.size();
+    const size_t start = seed % num;
+    for( size_t i=0; i<num; i++ )
+    {
+        size_t victim = start + i;
+        if( victim >= num ) victim -= num;
+        if( victim == idx ) continue;
+        auto task = m_deques[victim]->Steal();
+        if( task )
+        {
+            m_queued--;
+            return task;
+        }
+    }
+
+    std::lock_guard<std::mutex> lock( m_injectLock );
+    if( m_injected.empty() ) return nullptr;
+    auto task = m_injected.front();
+    m_injected.pop_front();
+    m_queued--;
+    return task;
+}
+
+void TaskDispatch::Execute( Task* task )
+{
+    auto group = task->m_group;
+    task->Run();
+    FreeTask( task );
+    // The group may be destroyed by its waiter as soon as the counter drops,
+    // it must not be touched afterwards.
+    const bool groupDone = group && --group->m_pending == 0;
+    if( --m_jobs == 0 || groupDone )
+    {
+        std::lock_guard<std::mutex> lock( m_parkLock );
+        m_cvWork.notify_all();
+    }
+}
+
+void TaskDispatch::Park()
+{
+    std::unique_lock<std::mutex> lock( m_parkLock );
+    m_sleeping++;
+    m_cvWork.wait( lock, [this]{ return m_queued > 0 || m_exit; } );
+    m_sleeping--;
+}
+
+void TaskDispatch::Worker( size_t idx )
+{
+    s_owner = this;
+    s_index = idx;
+    uint32 seed = uint32( idx ) * 0x9E3779B9 + 1;
+    int spin = 0;
     for(;;)
     {
-        std::unique_lock<std::mutex> lock( m_queueLock );
-        m_cvWork.wait( lock, [this]{ return !m_queue.empty() || m_exit; } );
-        if( m_exit ) return;
-        auto f = m_queue.back();
-        m_queue.pop_back();
-        m_jobs++;
-        lock.unlock();
-        f();
-        lock.lock();
-        m_jobs--;
-        bool notify = m_jobs == 0 && m_queue.empty();
-        lock.unlock();
-        if( notify )
-        {
-            m_cvJobs.notify_all();
+        auto task = GetTask( idx, seed );
+        if( task )
+        {
+            Execute( task );
+            spin = 0;
+        }
+        else if( m_exit )
+        {
+            return;
+        }
+        else if( ++spin < SpinCount )
+        {
+            std::this_thread::yield();
+        }
+        else
+        {
+            Park();
+            spin = 0;
         }
     }
 }
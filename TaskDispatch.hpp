@@ -3,32 +3,158 @@
 
 #include <atomic>
 #include <condition_variable>
-#include <functional>
+#include <deque>
+#include <memory>
 #include <mutex>
+#include <new>
 #include <thread>
+#include <type_traits>
+#include <utility>
 #include <vector>
 
+#include "Types.hpp"
+
+class TaskDispatch;
+
+// Tracks the completion of a set of tasks queued to one dispatcher, so that
+// independent jobs sharing a dispatcher can be waited on separately.
+class TaskGroup
+{
+public:
+    // Binds the group to the default (first created) dispatcher.
+    TaskGroup();
+    explicit TaskGroup( TaskDispatch& dispatch );
+    ~TaskGroup();
+
+    bool Done() const { return m_pending == 0; }
+
+private:
+    friend class TaskDispatch;
+
+    TaskDispatch* m_dispatch;
+    std::atomic<size_t> m_pending;
+};
+
+// Work-stealing task dispatcher. Every thread taking part in the dispatch
+// (the constructing thread and the worker threads) owns a deque: tasks are
+// pushed and popped at its bottom by the owner and stolen from its top by the
+// others. Tasks queued from any other thread go through a locked injection
+// queue. Workers only park on the condition variable when no work is left.
+//
+// Queued callables are moved into fixed-size task objects taken from a pool,
+// so queueing and executing a task does not touch the allocator once the pool
+// has warmed up.
+//
+// More than one dispatcher may exist. The static Queue( f ) and Sync() act on
+// the default one, which is the first dispatcher created; task groups select
+// the dispatcher they are bound to.
 class TaskDispatch
 {
 public:
     TaskDispatch( size_t workers );
     ~TaskDispatch();
 
-    static void Queue( const std::function<void(void)>& f );
-    static void Queue( std::function<void(void)>&& f );
+    template<class T>
+    static void Queue( T&& f )
+    {
+        auto task = s_instance->AllocTask();
+        task->Set( std::forward<T>( f ) );
+        task->m_group = nullptr;
+        s_instance->Push( task );
+    }
 
+    template<class T>
+    static void Queue( T&& f, TaskGroup& group )
+    {
+        auto dispatch = group.m_dispatch;
+        auto task = dispatch->AllocTask();
+        task->Set( std::forward<T>( f ) );
+        task->m_group = &group;
+        group.m_pending++;
+        dispatch->Push( task );
+    }
+
+    // Waits for all tasks of the default dispatcher.
     static void Sync();
+    // Executes tasks until all tasks of the group are done.
+    static void Wait( TaskGroup& group );
+
+    // Executes tasks of the default dispatcher until done() returns true.
+    // Whoever makes the condition true must call Wake() afterwards.
+    template<class Pred>
+    static void WaitFor( const Pred& done )
+    {
+        s_instance->Help( []( const void* ctx ){ return (*(const Pred*)ctx)(); }, &done );
+    }
+    static void Wake();
 
 private:
-    void Worker();
+    friend class TaskGroup;
+
+    class Task
+    {
+    public:
+        enum { Size = 128 };
 
-    std::vector<std::function<void(void)>> m_queue;
-    std::mutex m_queueLock;
-    std::condition_variable m_cvWork, m_cvJobs;
+        Task() : m_run( nullptr ), m_next( nullptr ), m_group( nullptr ) {}
+
+        template<class T>
+        void Set( T&& f )
+        {
+            typedef typename std::decay<T>::type F;
+            static_assert( sizeof( F ) <= sizeof( m_storage ), "Task callable does not fit inline storage" );
+            static_assert( alignof( F ) <= 16, "Task callable is overaligned" );
+            new( m_storage ) F( std::forward<T>( f ) );
+            m_run = []( void* ptr ) { F& func = *(F*)ptr; func(); func.~F(); };
+        }
+
+        // Runs and destroys the stored callable.
+        void Run() { m_run( m_storage ); }
+
+        void(*m_run)( void* );
+        Task* m_next;
+        TaskGroup* m_group;
+        alignas( 16 ) char m_storage[Size - 4 * sizeof( void* )];
+    };
+
+    class Deque;
+    struct TaskPool;
+
+    Task* AllocTask();
+    void FreeTask( Task* task );
+    Task* TakeShared( size_t& num );
+
+    size_t LocalIndex() const;
+    void Help( bool(*done)( const void* ), const void* ctx );
+
+    void Push( Task* task );
+    Task* GetTask( size_t idx, uint32& seed );
+    Task* Steal( size_t idx, uint32& seed );
+    void Execute( Task* task );
+    void Park();
+
+    void Worker( size_t idx );
+
+    std::vector<std::unique_ptr<Deque>> m_deques;
+    std::vector<std::unique_ptr<TaskPool>> m_pools;
+
+    Task* m_shared;
+    std::vector<std::unique_ptr<Task[]>> m_chunks;
+    std::mutex m_poolLock;
+
+    std::deque<Task*> m_injected;
+    std::mutex m_injectLock;
+
+    std::mutex m_parkLock;
+    std::condition_variable m_cvWork;
+    std::atomic<int64> m_queued;
+    std::atomic<size_t> m_jobs;
+    std::atomic<int> m_sleeping;
     std::atomic<bool> m_exit;
-    size_t m_jobs;
 
     std::vector<std::thread> m_workers;
+
+    static TaskDispatch* s_instance;
 };
 
 #endif